@@ -0,0 +1,81 @@
+"""
+Load-time benchmark of the engine's Arrow IPC export against CSV.
+
+Loads the files written by bench/arrow_bench.c (the same readings as an
+Arrow IPC file, an Arrow IPC stream and CSV) the way analysis code would,
+and checks that every format holds the same table:
+
+- arrow file (mmap):  pyarrow.ipc.open_file over a memory map, zero-copy
+- arrow file:         pyarrow.ipc.open_file reading the file into memory
+- arrow stream:       pyarrow.ipc.open_stream
+- feather (pandas):   pandas.read_feather, i.e. Arrow file to a DataFrame
+- csv (pyarrow):      pyarrow.csv.read_csv, multithreaded
+- csv (pandas):       pandas.read_csv
+
+Usage:
+    make arrow-bench && python3 app/arrow_load_bench.py [PREFIX] [--repeats N]
+"""
+
+import argparse
+import statistics
+import time
+
+import pandas as pd
+import pyarrow as pa
+import pyarrow.csv as pa_csv
+import pyarrow.ipc as ipc
+
+
+def time_call(function, repeats):
+    """Return the median wall time of function() in seconds, and its last result."""
+    samples = []
+    result = None
+    for _ in range(repeats):
+        start = time.perf_counter()
+        result = function()
+        samples.append(time.perf_counter() - start)
+    return statistics.median(samples), result
+
+
+def main():
+    """Time each loader and print a table of median load times."""
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('prefix', nargs='?', default='/tmp/glucose_readings', help='Prefix of the files to load')
+    parser.add_argument('--repeats', type=int, default=3, help='Timed repetitions per loader')
+    args = parser.parse_args()
+
+    arrow_path = args.prefix + '.arrow'
+    stream_path = args.prefix + '.arrows'
+    csv_path = args.prefix + '.csv'
+
+    loaders = {
+        'arrow file (mmap)': lambda: ipc.open_file(pa.memory_map(arrow_path)).read_all(),
+        'arrow file': lambda: ipc.open_file(pa.OSFile(arrow_path)).read_all(),
+        'arrow stream': lambda: ipc.open_stream(pa.OSFile(stream_path)).read_all(),
+        'feather (pandas)': lambda: pd.read_feather(arrow_path),
+        'csv (pyarrow)': lambda: pa_csv.read_csv(csv_path),
+        'csv (pandas)': lambda: pd.read_csv(csv_path),
+    }
+
+    results = {}
+    print(f"{'loader':<18} {'median s':>10} {'rows':>12}")
+    for name, loader in loaders.items():
+        seconds, result = time_call(loader, args.repeats)
+        results[name] = result
+        print(f"{name:<18} {seconds:>10.3f} {len(result):>12}")
+
+    # The CSV holds times as Unix seconds; compare it with the Arrow table as such
+    table = results['arrow file']
+    table.validate(full=True)
+    as_csv = table.set_column(1, 'time', table.column('time').cast(pa.int64()))
+    checks = {
+        'stream equals file': results['arrow stream'].equals(table),
+        'csv equals file': results['csv (pyarrow)'].cast(as_csv.schema).equals(as_csv),
+    }
+    for check, passed in checks.items():
+        print(f"{check}: {'ok' if passed else 'MISMATCH'}")
+    return 0 if all(checks.values()) else 1
+
+
+if __name__ == '__main__':
+    raise SystemExit(main())
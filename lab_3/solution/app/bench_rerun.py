@@ -0,0 +1,111 @@
+"""
+Rerun latency benchmark for the dashboard's statistics and alarm paths.
+
+Measures the analysis work done on every Streamlit rerun at several history
+lengths, comparing the pure-Python path (``GlucoseAnalyzer`` and
+``AlarmSystem``) with the native path (``libglucose.so`` via glucose_native):
+
+- python:       list -> numpy array -> statistics, plus Python alarm checks
+- native full:  C accumulator over the whole numpy buffer, zero-copy
+- native incr:  one reading added and one evicted, then alarms (dashboard path)
+- rerun:        ring-buffer append, native incr and LTTB chart downsampling,
+                i.e. all per-rerun data work the dashboard does
+
+Usage:
+    make lib && python3 app/bench_rerun.py [--sizes 30,10000,20160,1000000]
+"""
+
+import argparse
+import statistics
+import time
+
+import numpy as np
+
+import glucose_native
+from downsample import downsample_series
+from glucose_dashboard import CHART_POINTS, AlarmSystem, GlucoseAnalyzer
+from history_buffer import GlucoseHistory
+
+
+def time_call(function, repeats):
+    """Return the median wall time of function() in microseconds."""
+    samples = []
+    for _ in range(repeats):
+        start = time.perf_counter()
+        function()
+        samples.append((time.perf_counter() - start) * 1e6)
+    return statistics.median(samples)
+
+
+def bench_size(size, repeats):
+    """Time each path for a history of the given length."""
+    rng = np.random.default_rng(42)
+    values = rng.uniform(40, 400, size).round(1)
+    history = values.tolist()
+
+    def python_path():
+        GlucoseAnalyzer.calculate_statistics(history)
+        AlarmSystem.check_alarms(history[-1], history[::-1])
+
+    results = {'python': time_call(python_path, repeats)}
+
+    if glucose_native.available():
+        config = glucose_native.default_config()
+
+        def native_full():
+            stats = glucose_native.RunningStats(config)
+            stats.add(values)
+            stats.statistics()
+            glucose_native.evaluate_alarms(values[-1], values[-2], config)
+
+        running = glucose_native.RunningStats(config)
+        running.add(values)
+        newest = float(values[-1])
+
+        def native_incremental():
+            running.add(newest)
+            running.remove(newest)
+            running.statistics()
+            glucose_native.evaluate_alarms(newest, float(values[-2]), config)
+
+        results['native full'] = time_call(native_full, repeats)
+        results['native incr'] = time_call(native_incremental, repeats)
+
+        history = GlucoseHistory(size)
+        start = np.datetime64('2026-01-01T00:00')
+        for offset, value in enumerate(values):
+            history.append(value, start + np.timedelta64(offset, 'm'))
+        clock = [size]
+
+        def rerun():
+            evicted = history.append(newest, start + np.timedelta64(clock[0], 'm'))
+            clock[0] += 1
+            running.add(newest)
+            running.remove(evicted)
+            running.statistics()
+            glucose_native.evaluate_alarms(newest, float(values[-2]), config)
+            downsample_series(history.timestamps.view(), history.values.view(), CHART_POINTS)
+
+        results['rerun'] = time_call(rerun, repeats)
+
+    return results
+
+
+def main():
+    """Run the benchmark and print a table of median rerun latencies."""
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--sizes', default='30,10000,20160,1000000', help='Comma-separated history lengths')
+    parser.add_argument('--repeats', type=int, default=50, help='Timed repetitions per path')
+    args = parser.parse_args()
+
+    if not glucose_native.available():
+        print("libglucose.so not found; run 'make lib' to include the native paths")
+
+    print(f"{'readings':>10}  {'path':<12} {'median us':>12}")
+    for size in (int(value) for value in args.sizes.split(',')):
+        for path, micros in bench_size(size, args.repeats).items():
+            print(f"{size:>10}  {path:<12} {micros:>12.1f}")
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,88 @@
+"""
+Chart downsampling with largest-triangle-three-buckets (LTTB).
+
+Charts draw a fixed number of points regardless of how long the history
+is. LTTB keeps the first and last readings and, for every bucket in
+between, the reading that forms the largest triangle with its neighbours,
+so hypo and hyper excursions stay visible after downsampling. The C kernel
+in libglucose.so is used when available; otherwise a numpy version runs.
+"""
+
+import numpy as np
+
+import glucose_native
+
+
+def lttb_indices_numpy(x, y, threshold):
+    """
+    Pure-numpy LTTB, used when libglucose.so is not available.
+
+    Args:
+        x (numpy.ndarray): Ascending x coordinates as float64
+        y (numpy.ndarray): y coordinates, same length as x
+        threshold (int): Maximum number of points to keep
+
+    Returns:
+        numpy.ndarray: Indices of the selected points, ascending
+    """
+    count = len(x)
+    if threshold >= count or threshold < 3:
+        return np.arange(count)
+
+    every = (count - 2) / (threshold - 2)
+    edges = (np.arange(threshold - 1) * every).astype(np.intp) + 1
+    edges[-1] = count - 1
+    indices = np.empty(threshold, dtype=np.intp)
+    indices[0] = 0
+    indices[-1] = count - 1
+    anchor = 0
+
+    for bucket in range(threshold - 2):
+        start, end = edges[bucket], edges[bucket + 1]
+        next_end = edges[bucket + 2] if bucket + 2 < len(edges) else count
+        avg_x = x[end:next_end].mean()
+        avg_y = y[end:next_end].mean()
+
+        area = np.abs((x[anchor] - avg_x) * (y[start:end] - y[anchor]) -
+                      (x[anchor] - x[start:end]) * (avg_y - y[anchor]))
+        anchor = start + int(np.argmax(area))
+        indices[bucket + 1] = anchor
+
+    return indices
+
+
+def lttb_indices(x, y, threshold):
+    """
+    Select at most threshold points to draw.
+
+    Args:
+        x (numpy.ndarray): Ascending x coordinates as float64
+        y (numpy.ndarray): y coordinates, same length as x
+        threshold (int): Maximum number of points to keep
+
+    Returns:
+        numpy.ndarray: Indices of the selected points, ascending
+    """
+    if glucose_native.available():
+        return glucose_native.lttb(x, y, threshold)
+    return lttb_indices_numpy(np.asarray(x, dtype=np.float64), np.asarray(y, dtype=np.float64), threshold)
+
+
+def downsample_series(timestamps, values, threshold):
+    """
+    Downsample a time series for display.
+
+    Args:
+        timestamps (numpy.ndarray): datetime64 timestamps, oldest first
+        values (numpy.ndarray): Readings, same length as timestamps
+        threshold (int): Maximum number of points to keep
+
+    Returns:
+        tuple: (timestamps, values) of the selected points
+    """
+    if len(values) <= threshold:
+        return timestamps, values
+
+    x = timestamps.astype('datetime64[ms]', copy=False).view(np.int64).astype(np.float64)
+    indices = lttb_indices(x, np.asarray(values, dtype=np.float64), threshold)
+    return timestamps[indices], values[indices]
@@ -7,6 +7,10 @@ in a user-friendly web interface. It provides:
 - Statistics calculation (Time in Range, averages, variability)
 - Alarm system for hypoglycemia, hyperglycemia, and rapid changes
 - Interactive visualization of glucose trends
+
+When the C engine is running with ``--telemetry``, the dashboard reads the
+engine's readings, statistics and alarms from shared memory instead of
+generating and analyzing its own data.
 """
 
 import streamlit as st
@@ -15,6 +19,19 @@ import numpy as np
 from datetime import datetime, timedelta
 import random
 
+import glucose_native
+from downsample import downsample_series
+from history_buffer import GlucoseHistory
+from telemetry_feed import (TelemetryFeed, alarms_from_flags, alarms_from_slot, history_valid_indices,
+                            stats_from_slot)
+
+
+# History kept per session: 14 days at a 1-minute cadence
+HISTORY_CAPACITY = 14 * 24 * 60
+
+# Maximum number of points drawn per chart, regardless of history length
+CHART_POINTS = 500
+
 
 # ============================================================================
 # Data Generator Module (Python equivalent of data_generator.c)
@@ -77,12 +94,12 @@ class GlucoseAnalyzer:
         Calculate glucose statistics from history.
         
         Args:
-            glucose_history (list): List of glucose readings
+            glucose_history (list or numpy.ndarray): Glucose readings
             
         Returns:
             dict: Statistics including TIR, averages, and variability
         """
-        if not glucose_history or len(glucose_history) == 0:
+        if glucose_history is None or len(glucose_history) == 0:
             return {
                 'time_in_range': 0.0,
                 'time_below_range': 0.0,
@@ -92,7 +109,7 @@ class GlucoseAnalyzer:
             }
         
         # Convert to numpy array for easier calculation
-        values = np.array(glucose_history)
+        values = np.asarray(glucose_history, dtype=np.float64)
         
         # Calculate range percentages
         in_range = np.sum((values >= GlucoseAnalyzer.HYPO_THRESHOLD) & 
@@ -129,7 +146,8 @@ class AlarmSystem:
         
         Args:
             current_glucose (float): Current glucose reading
-            glucose_history (list): Historical glucose readings
+            glucose_history (list): Historical glucose readings, newest first and
+                without gaps (the rapid-change rule compares the first two)
             
         Returns:
             list: List of active alarm dictionaries with type, message, and severity
@@ -199,18 +217,20 @@ def get_glucose_color_and_emoji(glucose_value):
 
 def initialize_session_state():
     """Initialize Streamlit session state for glucose data management."""
-    if 'glucose_history' not in st.session_state:
-        st.session_state.glucose_history = []
-        st.session_state.timestamp_history = []
+    if 'history' not in st.session_state:
+        st.session_state.history = GlucoseHistory(HISTORY_CAPACITY)
         st.session_state.generator = GlucoseDataGenerator()
+        # Statistics over the history, updated per reading by the C accumulator
+        st.session_state.running_stats = glucose_native.RunningStats() if glucose_native.available() else None
         
         # Generate initial 30 readings
         base_time = datetime.now()
         for i in range(30):
             glucose = st.session_state.generator.generate_glucose_value()
             timestamp = base_time - timedelta(minutes=(29 - i) * 5)
-            st.session_state.glucose_history.append(glucose)
-            st.session_state.timestamp_history.append(timestamp)
+            st.session_state.history.append(glucose, timestamp)
+        if st.session_state.running_stats is not None:
+            st.session_state.running_stats.add(st.session_state.history.values.view())
 
 
 def generate_new_reading():
@@ -218,13 +238,86 @@ def generate_new_reading():
     new_glucose = st.session_state.generator.generate_glucose_value()
     new_timestamp = datetime.now()
     
-    # Add to history and maintain last 30 readings
-    st.session_state.glucose_history.append(new_glucose)
-    st.session_state.timestamp_history.append(new_timestamp)
-    
-    if len(st.session_state.glucose_history) > 30:
-        st.session_state.glucose_history.pop(0)
-        st.session_state.timestamp_history.pop(0)
+    # Add to history; the ring buffer evicts the oldest reading once full
+    evicted = st.session_state.history.append(new_glucose, new_timestamp)
+
+    running_stats = st.session_state.running_stats
+    if running_stats is not None:
+        running_stats.add(new_glucose)
+        if evicted is not None:
+            running_stats.remove(evicted)
+
+
+def load_simulated_view():
+    """
+    Build the dashboard view from the built-in Python generator.
+
+    Returns:
+        dict: History, timestamps, statistics and alarms to display
+    """
+    history = st.session_state.history.values.view()
+    running_stats = st.session_state.running_stats
+
+    if running_stats is not None:
+        # O(1) per rerun: statistics are maintained incrementally and only
+        # the latest two readings are needed for the alarm rules
+        current = history[-1]
+        previous = history[-2] if len(history) >= 2 else 0.0
+        flags = glucose_native.evaluate_alarms(current, previous, running_stats.config)
+        stats = running_stats.statistics()
+        alarms = alarms_from_flags(flags, current, current - previous)
+    else:
+        stats = GlucoseAnalyzer.calculate_statistics(history)
+        alarms = AlarmSystem.check_alarms(history[-1], history[::-1])
+
+    return {
+        'source': 'Python simulator',
+        'glucose_history': history,
+        'timestamp_history': st.session_state.history.timestamps.view(),
+        'stats': stats,
+        'alarms': alarms
+    }
+
+
+def load_engine_view(feed):
+    """
+    Build the dashboard view from the C engine's shared-memory telemetry.
+
+    Statistics and alarms are taken from the engine as published; nothing
+    is re-derived in Python.
+
+    Args:
+        feed (TelemetryFeed): Mapped telemetry segment with at least one patient
+
+    Returns:
+        dict or None: History, timestamps, statistics and alarms to display,
+        or None if no patient's slot could be read consistently
+    """
+    rows = feed.snapshot()
+    if len(rows) == 0:
+        return None
+    patient_ids = [int(patient_id) for patient_id in rows['patient_id']]
+    selected = st.sidebar.selectbox("Patient", patient_ids)
+    slot = rows[patient_ids.index(selected)]
+
+    # The engine keeps history newest first; history_valid marks the entries
+    # holding readings, the others are warm-up or sensor dropouts. Each entry
+    # is one sample interval older than the one before it, and the newest
+    # valid entry is the reading at slot['timestamp'].
+    indices = history_valid_indices(slot)[::-1]
+    valid = slot['history'][indices]
+    latest = np.datetime64(datetime.fromtimestamp(int(slot['timestamp'])), 'ms')
+    interval = np.timedelta64(feed.sample_interval_s, 's')
+    newest = indices[-1] if len(indices) > 0 else 0
+    timestamps = latest - interval * (indices - newest)
+
+    return {
+        'source': f'C engine (shared memory), patient {selected}',
+        'glucose_history': valid,
+        'timestamp_history': timestamps,
+        'stats': stats_from_slot(slot),
+        'alarms': alarms_from_slot(slot)
+    }
 
 
 # ============================================================================
@@ -258,6 +351,15 @@ def main():
     
     # Initialize session state
     initialize_session_state()
+
+    # Prefer the C engine's live data when it is publishing telemetry
+    feed = TelemetryFeed.try_open()
+    view = None
+    if feed is not None and feed.patient_count > 0:
+        view = load_engine_view(feed)
+    if view is None:
+        view = load_simulated_view()
+    engine_mode = view['source'].startswith('C engine')
     
     # ========================================================================
     # Header Section
@@ -265,13 +367,14 @@ def main():
     
     st.title("🩸 Glucose Monitoring Dashboard")
     st.markdown("━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━")
+    st.caption(f"Data source: {view['source']}")
     
     # ========================================================================
     # Current Glucose Display
     # ========================================================================
     
-    current_glucose = st.session_state.glucose_history[-1]
-    current_timestamp = st.session_state.timestamp_history[-1]
+    current_glucose = view['glucose_history'][-1]
+    current_timestamp = view['timestamp_history'][-1].astype(datetime)
     color_status, emoji = get_glucose_color_and_emoji(current_glucose)
     
     col1, col2, col3 = st.columns([1, 2, 1])
@@ -289,7 +392,10 @@ def main():
         st.caption(f"📅 {current_timestamp.strftime('%Y-%m-%d %H:%M:%S')}")
         
         # Refresh button
-        if st.button("🔄 Generate New Reading", use_container_width=True):
+        if engine_mode:
+            if st.button("🔄 Refresh", use_container_width=True):
+                st.rerun()
+        elif st.button("🔄 Generate New Reading", use_container_width=True):
             generate_new_reading()
             st.rerun()
     
@@ -301,7 +407,7 @@ def main():
     
     st.markdown("### 📊 Statistics")
     
-    stats = GlucoseAnalyzer.calculate_statistics(st.session_state.glucose_history)
+    stats = view['stats']
     
     col1, col2, col3, col4, col5 = st.columns(5)
     
@@ -351,17 +457,22 @@ def main():
     # Glucose Trend Visualization
     # ========================================================================
     
-    st.markdown("### 📈 Glucose Trend (Last 30 Readings)")
+    reading_count = len(view['glucose_history'])
+    st.markdown(f"### 📈 Glucose Trend (Last {reading_count} Readings)")
     
-    # Create DataFrame for visualization
+    # Draw a fixed number of points however long the history is
+    chart_times, chart_values = downsample_series(
+        view['timestamp_history'], view['glucose_history'], CHART_POINTS)
     df = pd.DataFrame({
-        'Time': st.session_state.timestamp_history,
-        'Glucose (mg/dL)': st.session_state.glucose_history
+        'Time': chart_times,
+        'Glucose (mg/dL)': chart_values
     })
     df.set_index('Time', inplace=True)
     
     # Create the chart
     st.line_chart(df, height=400, use_container_width=True)
+    if len(chart_values) < reading_count:
+        st.caption(f"Showing {len(chart_values)} of {reading_count} readings (LTTB downsampling)")
     
     # Add reference lines information
     col1, col2, col3 = st.columns(3)
@@ -380,7 +491,7 @@ def main():
     
     st.markdown("### ⚠️ Active Alarms")
     
-    alarms = AlarmSystem.check_alarms(current_glucose, st.session_state.glucose_history)
+    alarms = view['alarms']
     
     if alarms:
         for alarm in alarms:
@@ -430,13 +541,16 @@ def main():
             st.info("Dashboard will refresh every 10 seconds")
             import time
             time.sleep(10)
-            generate_new_reading()
+            if not engine_mode:
+                generate_new_reading()
             st.rerun()
         
         st.markdown("---")
         st.markdown("**Dashboard Statistics:**")
-        st.caption(f"Total Readings: {len(st.session_state.glucose_history)}")
-        st.caption(f"Time Span: ~{len(st.session_state.glucose_history) * 5} minutes")
+        timestamps = view['timestamp_history']
+        span = (timestamps[-1] - timestamps[0]).astype('timedelta64[s]').astype(int)
+        st.caption(f"Total Readings: {len(timestamps)}")
+        st.caption(f"Time Span: ~{span // 60} minutes")
 
 
 if __name__ == "__main__":
@@ -0,0 +1,245 @@
+"""
+ctypes binding to the C analysis and alarm code (``libglucose.so``).
+
+Build the library with ``make lib`` in ``lab_3/solution``. Set
+``GLUCOSE_NATIVE_LIB`` to load it from another path. Functions accept
+float64 numpy arrays and pass their memory straight to C without copying.
+If the library cannot be loaded, ``available()`` returns False and the
+dashboard falls back to its pure-Python implementation.
+"""
+
+import ctypes
+import os
+
+import numpy as np
+
+
+# ============================================================================
+# Library Loading
+# ============================================================================
+
+DEFAULT_LIBRARY_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'libglucose.so')
+
+
+class Config(ctypes.Structure):
+    """Mirror of ``Config`` in include/config.h."""
+    _fields_ = [
+        ('hypoglycemia_threshold', ctypes.c_int),
+        ('hyperglycemia_threshold', ctypes.c_int),
+        ('rapid_change_threshold', ctypes.c_int),
+        ('sleep_interval', ctypes.c_int),
+    ]
+
+
+class GlucoseStats(ctypes.Structure):
+    """Mirror of ``GlucoseStats`` in include/analysis.h."""
+    _fields_ = [
+        ('time_in_range', ctypes.c_double),
+        ('time_below_range', ctypes.c_double),
+        ('time_above_range', ctypes.c_double),
+        ('avg_glucose', ctypes.c_double),
+        ('glucose_variability', ctypes.c_double),
+    ]
+
+
+class GlucoseAccumulator(ctypes.Structure):
+    """Mirror of ``GlucoseAccumulator`` in include/glucose_kernels.h."""
+    _fields_ = [
+        ('count', ctypes.c_uint64),
+        ('below_range', ctypes.c_uint64),
+        ('in_range', ctypes.c_uint64),
+        ('above_range', ctypes.c_uint64),
+        ('mean', ctypes.c_double),
+        ('m2', ctypes.c_double),
+    ]
+
+
+_DOUBLE_P = ctypes.POINTER(ctypes.c_double)
+_UINT8_P = ctypes.POINTER(ctypes.c_uint8)
+_SIZE_P = ctypes.POINTER(ctypes.c_size_t)
+
+
+def _load(path):
+    """Load the library and declare the signatures used here."""
+    lib = ctypes.CDLL(path)
+
+    lib.initialize_config.argtypes = []
+    lib.initialize_config.restype = Config
+
+    lib.glucose_accumulator_init.argtypes = [ctypes.POINTER(GlucoseAccumulator)]
+    lib.glucose_accumulator_init.restype = ctypes.c_int
+    for name in ('glucose_accumulator_add', 'glucose_accumulator_remove'):
+        function = getattr(lib, name)
+        function.argtypes = [ctypes.POINTER(GlucoseAccumulator), _DOUBLE_P, ctypes.c_size_t,
+                             ctypes.POINTER(Config)]
+        function.restype = ctypes.c_int
+    lib.glucose_accumulator_merge.argtypes = [ctypes.POINTER(GlucoseAccumulator),
+                                              ctypes.POINTER(GlucoseAccumulator)]
+    lib.glucose_accumulator_merge.restype = ctypes.c_int
+    lib.glucose_accumulator_to_stats.argtypes = [ctypes.POINTER(GlucoseAccumulator),
+                                                 ctypes.POINTER(GlucoseStats)]
+    lib.glucose_accumulator_to_stats.restype = ctypes.c_int
+
+    lib.evaluate_glucose_alarm_values.argtypes = [ctypes.c_double, ctypes.c_double,
+                                                  ctypes.POINTER(Config), ctypes.POINTER(ctypes.c_uint)]
+    lib.evaluate_glucose_alarm_values.restype = ctypes.c_int
+    lib.glucose_scan_alarms.argtypes = [_DOUBLE_P, ctypes.c_size_t, ctypes.POINTER(Config), _UINT8_P]
+    lib.glucose_scan_alarms.restype = ctypes.c_long
+    lib.glucose_lttb.argtypes = [_DOUBLE_P, _DOUBLE_P, ctypes.c_size_t, ctypes.c_size_t, _SIZE_P]
+    lib.glucose_lttb.restype = ctypes.c_size_t
+
+    return lib
+
+
+try:
+    _lib = _load(os.environ.get('GLUCOSE_NATIVE_LIB', DEFAULT_LIBRARY_PATH))
+except OSError:
+    _lib = None
+
+
+def available():
+    """Return True if libglucose.so was loaded."""
+    return _lib is not None
+
+
+def default_config():
+    """Return the engine's default thresholds (``initialize_config()``)."""
+    return _lib.initialize_config()
+
+
+def _as_readings(values):
+    """
+    Return a float64, C-contiguous view of values and a pointer to its data.
+
+    Arrays that already have that layout are passed through without copying.
+    """
+    array = np.ascontiguousarray(values, dtype=np.float64)
+    return array, array.ctypes.data_as(_DOUBLE_P)
+
+
+# ============================================================================
+# Kernels
+# ============================================================================
+
+class RunningStats:
+    """Incrementally maintained glucose statistics backed by the C accumulator."""
+
+    def __init__(self, config=None):
+        """
+        Create an empty accumulator.
+
+        Args:
+            config (Config): Thresholds to classify readings (engine defaults if None)
+        """
+        self.config = config if config is not None else default_config()
+        self._acc = GlucoseAccumulator()
+        _lib.glucose_accumulator_init(ctypes.byref(self._acc))
+
+    def add(self, values):
+        """Add one reading or an array of readings."""
+        array, pointer = _as_readings(np.atleast_1d(values))
+        if _lib.glucose_accumulator_add(ctypes.byref(self._acc), pointer, array.size,
+                                        ctypes.byref(self.config)) != 0:
+            raise ValueError("Failed to add readings")
+
+    def remove(self, values):
+        """Remove one reading or an array of readings that were added earlier."""
+        array, pointer = _as_readings(np.atleast_1d(values))
+        if _lib.glucose_accumulator_remove(ctypes.byref(self._acc), pointer, array.size,
+                                           ctypes.byref(self.config)) != 0:
+            raise ValueError("Cannot remove more readings than were added")
+
+    def merge(self, other):
+        """Merge another RunningStats (computed with the same thresholds) into this one."""
+        _lib.glucose_accumulator_merge(ctypes.byref(self._acc), ctypes.byref(other._acc))
+
+    @property
+    def count(self):
+        """Number of readings currently accumulated."""
+        return int(self._acc.count)
+
+    def statistics(self):
+        """
+        Return the statistics in the dashboard's format.
+
+        Returns:
+            dict: Statistics including TIR, averages, and variability
+        """
+        acc = self._acc
+        if acc.count == 0:
+            return {
+                'time_in_range': 0.0,
+                'time_below_range': 0.0,
+                'time_above_range': 0.0,
+                'avg_glucose': 0.0,
+                'glucose_variability': 0.0
+            }
+
+        total = float(acc.count)
+        return {
+            'time_in_range': acc.in_range / total * 100,
+            'time_below_range': acc.below_range / total * 100,
+            'time_above_range': acc.above_range / total * 100,
+            'avg_glucose': acc.mean,
+            'glucose_variability': float(np.sqrt(acc.m2 / total))
+        }
+
+
+def evaluate_alarms(glucose_value, previous_value, config=None):
+    """
+    Evaluate the engine's alarm rules for one reading.
+
+    Args:
+        glucose_value (float): Current reading in mg/dL
+        previous_value (float): Previous reading in mg/dL, or 0.0 if none
+        config (Config): Thresholds (engine defaults if None)
+
+    Returns:
+        int: AlarmFlag bits
+    """
+    config = config if config is not None else default_config()
+    flags = ctypes.c_uint(0)
+    _lib.evaluate_glucose_alarm_values(float(glucose_value), float(previous_value),
+                                       ctypes.byref(config), ctypes.byref(flags))
+    return flags.value
+
+
+def scan_alarms(values, config=None):
+    """
+    Evaluate the alarm rules for every reading in an array.
+
+    Args:
+        values (numpy.ndarray): Readings, oldest first
+        config (Config): Thresholds (engine defaults if None)
+
+    Returns:
+        numpy.ndarray: AlarmFlag bits per reading (uint8)
+    """
+    config = config if config is not None else default_config()
+    array, pointer = _as_readings(values)
+    flags = np.empty(array.size, dtype=np.uint8)
+    _lib.glucose_scan_alarms(pointer, array.size, ctypes.byref(config), flags.ctypes.data_as(_UINT8_P))
+    return flags
+
+
+def lttb(x, y, threshold):
+    """
+    Select the points to draw with largest-triangle-three-buckets.
+
+    Args:
+        x (numpy.ndarray): Ascending x coordinates (e.g. timestamps as float64)
+        y (numpy.ndarray): y coordinates, same length as x
+        threshold (int): Maximum number of points to keep
+
+    Returns:
+        numpy.ndarray: Indices of the selected points, ascending
+    """
+    x_array, x_pointer = _as_readings(x)
+    y_array, y_pointer = _as_readings(y)
+    if x_array.size != y_array.size:
+        raise ValueError("x and y must have the same length")
+
+    indices = np.empty(x_array.size, dtype=np.uintp)
+    selected = _lib.glucose_lttb(x_pointer, y_pointer, x_array.size, threshold,
+                                 indices.ctypes.data_as(_SIZE_P))
+    return indices[:selected].astype(np.intp, copy=False)
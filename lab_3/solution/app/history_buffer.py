@@ -0,0 +1,103 @@
+"""
+Fixed-capacity history storage for the dashboard.
+
+Readings live in preallocated numpy ring buffers, so appending is O(1)
+however long the history is and no Python list is ever shifted. Each
+buffer stores every element twice (at ``i`` and ``i + capacity``), which
+keeps the oldest-to-newest window a contiguous slice: ``view()`` returns
+it without copying, ready to hand to numpy or the native kernels.
+"""
+
+import numpy as np
+
+
+class RingBuffer:
+    """Fixed-capacity FIFO over a preallocated numpy array."""
+
+    def __init__(self, capacity, dtype=np.float64):
+        """
+        Allocate an empty ring buffer.
+
+        Args:
+            capacity (int): Maximum number of elements kept
+            dtype: numpy dtype of the elements
+        """
+        if capacity < 1:
+            raise ValueError("capacity must be at least 1")
+        self.capacity = capacity
+        self._data = np.zeros(2 * capacity, dtype=dtype)
+        self._start = 0
+        self._size = 0
+
+    def __len__(self):
+        return self._size
+
+    def append(self, value):
+        """
+        Append one element, evicting the oldest one when full.
+
+        Args:
+            value: Element to append
+
+        Returns:
+            The evicted element, or None if the buffer was not full
+        """
+        evicted = None
+        if self._size == self.capacity:
+            evicted = self._data[self._start].copy()
+            self._start = (self._start + 1) % self.capacity
+        else:
+            self._size += 1
+
+        position = (self._start + self._size - 1) % self.capacity
+        self._data[position] = value
+        self._data[position + self.capacity] = value
+        return evicted
+
+    def view(self):
+        """
+        Return the elements oldest first.
+
+        Returns:
+            numpy.ndarray: Read-only view (no copy) valid until the next append
+        """
+        window = self._data[self._start:self._start + self._size]
+        window.flags.writeable = False
+        return window
+
+
+class GlucoseHistory:
+    """Glucose readings and their timestamps in matching ring buffers."""
+
+    def __init__(self, capacity):
+        """
+        Allocate an empty history.
+
+        Args:
+            capacity (int): Maximum number of readings kept
+        """
+        self.values = RingBuffer(capacity, np.float64)
+        self.timestamps = RingBuffer(capacity, 'datetime64[ms]')
+
+    def __len__(self):
+        return len(self.values)
+
+    @property
+    def capacity(self):
+        """Maximum number of readings kept."""
+        return self.values.capacity
+
+    def append(self, glucose, timestamp):
+        """
+        Append one reading.
+
+        Args:
+            glucose (float): Reading in mg/dL
+            timestamp (datetime): Time of the reading
+
+        Returns:
+            float or None: Evicted reading, or None if nothing was evicted
+        """
+        self.timestamps.append(np.datetime64(timestamp, 'ms'))
+        evicted = self.values.append(glucose)
+        return None if evicted is None else float(evicted)
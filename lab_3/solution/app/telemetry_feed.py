@@ -0,0 +1,293 @@
+"""
+Shared-memory telemetry reader for the C glucose engine.
+
+The C controller (``./data_generator --telemetry``) publishes every patient's
+latest reading, history, statistics and alarm flags into the POSIX
+shared-memory segment ``/glucose_telemetry`` (see ``include/telemetry.h``).
+This module maps that segment read-only and exposes it as numpy structured
+arrays without copying. Each patient slot is guarded by a seqlock, so
+snapshots are taken by copying the rows and retrying any row the engine was
+writing at the same time; readers never block the engine.
+"""
+
+import mmap
+import os
+
+import numpy as np
+
+
+# ============================================================================
+# Segment Layout (mirrors include/telemetry.h)
+# ============================================================================
+
+TELEMETRY_SHM_NAME = "/glucose_telemetry"
+TELEMETRY_MAGIC = 0x43554C47  # "GLUC"
+TELEMETRY_VERSION = 2
+TELEMETRY_HISTORY_LENGTH = 30
+HEADER_SIZE = 64
+SLOT_SIZE = 384
+
+HEADER_DTYPE = np.dtype({
+    'names': ['magic', 'version', 'capacity', 'slot_size', 'patient_count',
+              'sample_interval_s', 'publish_count', 'updated_unix_ns'],
+    'formats': ['<u4', '<u4', '<u4', '<u4', '<u4', '<u4', '<u8', '<u8'],
+    'offsets': [0, 4, 8, 12, 16, 20, 24, 32],
+    'itemsize': HEADER_SIZE,
+})
+
+SLOT_DTYPE = np.dtype({
+    'names': ['sequence', 'patient_id', 'alarm_flags', 'timestamp', 'glucose_value',
+              'history', 'time_in_range', 'time_below_range', 'time_above_range',
+              'avg_glucose', 'glucose_variability', 'reading_count', 'alarm_count', 'trend',
+              'history_valid'],
+    'formats': ['<u8', '<u4', '<u4', '<i8', '<f8',
+                ('<f8', (TELEMETRY_HISTORY_LENGTH,)), '<f8', '<f8', '<f8',
+                '<f8', '<f8', '<u4', '<u4', '<i4', '<u4'],
+    'offsets': [0, 8, 12, 16, 24, 32, 272, 280, 288, 296, 304, 312, 316, 320, 324],
+    'itemsize': SLOT_SIZE,
+})
+
+# AlarmFlag bits (include/alarm.h)
+ALARM_HYPOGLYCEMIA = 1 << 0
+ALARM_HYPERGLYCEMIA = 1 << 1
+ALARM_RAPID_INCREASE = 1 << 2
+ALARM_RAPID_DECREASE = 1 << 3
+
+# GlucoseTrend values (include/analysis.h)
+TREND_NAMES = {0: 'Rising', 1: 'Stable', 2: 'Falling'}
+
+
+class TelemetryFeed:
+    """Read-only, zero-copy view of the engine's telemetry segment."""
+
+    MAX_RETRIES = 100
+
+    def __init__(self, buffer):
+        """
+        Wrap a buffer holding a telemetry segment.
+
+        Args:
+            buffer: Object supporting the buffer protocol (mmap, bytes, ...)
+
+        Raises:
+            ValueError: If the buffer does not hold a compatible segment
+        """
+        self._buffer = buffer
+        self.header = np.frombuffer(buffer, dtype=HEADER_DTYPE, count=1)[0]
+
+        if int(self.header['magic']) != TELEMETRY_MAGIC:
+            raise ValueError("Not a glucose telemetry segment (bad magic)")
+        if int(self.header['version']) != TELEMETRY_VERSION:
+            raise ValueError(f"Unsupported telemetry version {int(self.header['version'])}")
+        if int(self.header['slot_size']) != SLOT_SIZE:
+            raise ValueError("Telemetry slot size does not match this reader")
+
+        capacity = int(self.header['capacity'])
+        if len(memoryview(buffer)) < HEADER_SIZE + capacity * SLOT_SIZE:
+            raise ValueError("Telemetry segment is truncated")
+
+        # Zero-copy view over every slot; rows may change while being read
+        self.slots = np.frombuffer(buffer, dtype=SLOT_DTYPE, count=capacity, offset=HEADER_SIZE)
+        # Rows left out of the last snapshot because they never stabilized
+        self.torn_rows = 0
+
+    @classmethod
+    def open(cls, name=TELEMETRY_SHM_NAME):
+        """
+        Map the engine's shared-memory segment read-only.
+
+        Args:
+            name (str): POSIX shared-memory name
+
+        Returns:
+            TelemetryFeed: Feed over the mapped segment
+
+        Raises:
+            OSError: If the segment does not exist
+            ValueError: If the segment is not compatible
+        """
+        path = os.path.join('/dev/shm', name.lstrip('/'))
+        with open(path, 'rb') as segment:
+            mapped = mmap.mmap(segment.fileno(), 0, access=mmap.ACCESS_READ)
+        return cls(mapped)
+
+    @classmethod
+    def try_open(cls, name=TELEMETRY_SHM_NAME):
+        """
+        Map the engine's segment if it is available.
+
+        Returns:
+            TelemetryFeed or None: Feed, or None if the engine is not publishing
+        """
+        try:
+            return cls.open(name)
+        except (OSError, ValueError):
+            return None
+
+    @property
+    def patient_count(self):
+        """Number of slots the engine is currently publishing."""
+        return min(int(self.header['patient_count']), len(self.slots))
+
+    @property
+    def sample_interval_s(self):
+        """Seconds between engine readings."""
+        return max(1, int(self.header['sample_interval_s']))
+
+    def snapshot(self):
+        """
+        Take a consistent copy of every active slot.
+
+        Rows are copied in one vectorized step. Rows whose sequence was odd
+        (being written) or changed during the copy are re-copied until they
+        are stable. A row still unstable after MAX_RETRIES attempts is left
+        out of the snapshot and counted in ``torn_rows``, so no returned row
+        is ever torn.
+
+        Returns:
+            numpy.ndarray: Structured array (SLOT_DTYPE) with one row per stable patient
+        """
+        count = self.patient_count
+        live = self.slots[:count]
+
+        before = live['sequence'].copy()
+        rows = live.copy()
+        after = live['sequence']
+        torn = np.flatnonzero((before & 1) | (before != after))
+
+        stable = np.ones(count, dtype=bool)
+        for index in torn:
+            stable[index] = False
+            for _ in range(self.MAX_RETRIES):
+                start = int(live['sequence'][index])
+                if start & 1:
+                    continue
+                row = live[index].copy()
+                if int(live['sequence'][index]) == start:
+                    rows[index] = row
+                    stable[index] = True
+                    break
+
+        self.torn_rows = int(count - np.count_nonzero(stable))
+        return rows if self.torn_rows == 0 else rows[stable]
+
+    def latest(self, patient_id):
+        """
+        Return a consistent copy of one patient's slot.
+
+        Args:
+            patient_id (int): Engine patient identifier
+
+        Returns:
+            numpy.void or None: Slot record, or None if the patient is not published
+        """
+        rows = self.snapshot()
+        matches = np.flatnonzero(rows['patient_id'] == patient_id)
+        if len(matches) == 0:
+            return None
+        return rows[matches[0]]
+
+
+def alarms_from_slot(slot):
+    """
+    Convert a slot's alarm flags into the dashboard's alarm dictionaries.
+
+    Args:
+        slot: Slot record returned by TelemetryFeed.snapshot() or latest()
+
+    Returns:
+        list: Alarm dictionaries with type, message, and severity
+    """
+    return alarms_from_flags(int(slot['alarm_flags']), float(slot['glucose_value']),
+                             history_change(slot))
+
+
+def history_valid_indices(slot):
+    """
+    Return the positions of a slot's history that hold readings.
+
+    Args:
+        slot: Slot record returned by TelemetryFeed.snapshot() or latest()
+
+    Returns:
+        np.ndarray: Indices into slot['history'], newest first
+    """
+    valid = int(slot['history_valid'])
+    return np.array([i for i in range(TELEMETRY_HISTORY_LENGTH) if (valid >> i) & 1], dtype=int)
+
+
+def history_change(slot):
+    """
+    Return the change between a slot's two newest history entries.
+
+    Args:
+        slot: Slot record returned by TelemetryFeed.snapshot() or latest()
+
+    Returns:
+        float: Change in mg/dL, or 0.0 if either entry is a dropout or warm-up gap
+    """
+    valid = int(slot['history_valid'])
+    if (valid & 0b11) != 0b11:
+        return 0.0
+    return float(slot['history'][0] - slot['history'][1])
+
+
+def alarms_from_flags(flags, glucose, change):
+    """
+    Convert AlarmFlag bits into the dashboard's alarm dictionaries.
+
+    Args:
+        flags (int): AlarmFlag bits
+        glucose (float): Reading the flags were evaluated on, in mg/dL
+        change (float): Change from the previous reading, in mg/dL
+
+    Returns:
+        list: Alarm dictionaries with type, message, and severity
+    """
+    alarms = []
+
+    if flags & ALARM_HYPOGLYCEMIA:
+        alarms.append({
+            'type': 'hypoglycemia',
+            'message': f'Hypoglycemia detected! Glucose: {glucose:.1f} mg/dL',
+            'severity': 'critical' if glucose < 54 else 'warning'
+        })
+    if flags & ALARM_HYPERGLYCEMIA:
+        alarms.append({
+            'type': 'hyperglycemia',
+            'message': f'Hyperglycemia detected! Glucose: {glucose:.1f} mg/dL',
+            'severity': 'critical' if glucose > 250 else 'warning'
+        })
+    if flags & ALARM_RAPID_INCREASE:
+        alarms.append({
+            'type': 'rapid_increase',
+            'message': f'Rapid glucose increase detected! (+{change:.1f} mg/dL)',
+            'severity': 'warning'
+        })
+    if flags & ALARM_RAPID_DECREASE:
+        alarms.append({
+            'type': 'rapid_decrease',
+            'message': f'Rapid glucose decrease detected! ({change:.1f} mg/dL)',
+            'severity': 'warning'
+        })
+
+    return alarms
+
+
+def stats_from_slot(slot):
+    """
+    Convert a slot's published statistics into the dashboard's stats dictionary.
+
+    Args:
+        slot: Slot record returned by TelemetryFeed.snapshot() or latest()
+
+    Returns:
+        dict: Statistics including TIR, averages, and variability
+    """
+    return {
+        'time_in_range': float(slot['time_in_range']),
+        'time_below_range': float(slot['time_below_range']),
+        'time_above_range': float(slot['time_above_range']),
+        'avg_glucose': float(slot['avg_glucose']),
+        'glucose_variability': float(slot['glucose_variability'])
+    }
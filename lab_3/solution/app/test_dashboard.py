@@ -201,6 +201,84 @@ def test_dashboard():
     
     print("  ✅ PASSED")
     
+    # Test 5: Shared-Memory Telemetry Layout
+    print("\n✓ Test 5: Telemetry Feed Layout")
+    from telemetry_feed import (TelemetryFeed, HEADER_DTYPE, SLOT_DTYPE, HEADER_SIZE, SLOT_SIZE,
+                                TELEMETRY_MAGIC, TELEMETRY_VERSION, ALARM_HYPOGLYCEMIA,
+                                alarms_from_slot, history_change, history_valid_indices, stats_from_slot)
+    segment = bytearray(HEADER_SIZE + 2 * SLOT_SIZE)
+    header = np.frombuffer(segment, dtype=HEADER_DTYPE, count=1)
+    header['magic'] = TELEMETRY_MAGIC
+    header['version'] = TELEMETRY_VERSION
+    header['capacity'] = 2
+    header['slot_size'] = SLOT_SIZE
+    header['patient_count'] = 2
+    header['sample_interval_s'] = 2
+    slots = np.frombuffer(segment, dtype=SLOT_DTYPE, count=2, offset=HEADER_SIZE)
+    slots['patient_id'] = [7, 8]
+    slots['sequence'] = [4, 5]  # Patient 8's slot is mid-write
+    slots['alarm_flags'][0] = ALARM_HYPOGLYCEMIA
+    slots['glucose_value'][0] = 50.0
+    slots['time_in_range'][0] = 75.0
+    slots['history'][0][:3] = [50.0, 0.0, 80.0]
+    slots['history_valid'][0] = 0b101  # Entry 1 is a sensor dropout
+
+    feed = TelemetryFeed(segment)
+    rows = feed.snapshot()
+    assert feed.patient_count == 2, "Patient count mismatch"
+    assert list(rows['patient_id']) == [7], "Torn slot was not left out"
+    assert feed.torn_rows == 1, "Torn row count mismatch"
+    assert feed.latest(7)['glucose_value'] == 50.0, "Latest reading mismatch"
+    assert alarms_from_slot(rows[0])[0]['severity'] == 'critical', "Hypoglycemia severity mismatch"
+    assert stats_from_slot(rows[0])['time_in_range'] == 75.0, "TIR mismatch"
+    assert list(history_valid_indices(rows[0])) == [0, 2], "Dropout should not be a valid entry"
+    assert history_change(rows[0]) == 0.0, "No change should be taken across a dropout"
+    rows['history_valid'][0] = 0b111
+    rows['history'][0][1] = 60.0
+    assert history_change(rows[0]) == -10.0, "Change between the two newest readings mismatch"
+    print(f"  Slot size: {SLOT_DTYPE.itemsize} bytes, patients: {list(rows['patient_id'])}")
+    print("  ✅ PASSED")
+
+    # Test 6: Native Kernels (libglucose.so, built with `make lib`)
+    print("\n✓ Test 6: Native Kernels")
+    import glucose_native
+    if glucose_native.available():
+        window = np.array(glucose_history[:20], dtype=np.float64)
+        running = glucose_native.RunningStats()
+        running.add(np.array(glucose_history, dtype=np.float64))
+        running.remove(np.array(glucose_history[20:], dtype=np.float64))
+        native_stats = running.statistics()
+        python_stats = GlucoseAnalyzer.calculate_statistics(window.tolist())
+        for key in python_stats:
+            assert abs(native_stats[key] - python_stats[key]) < 1e-6, f"{key} mismatch"
+        flags = glucose_native.evaluate_alarms(50, 100)
+        assert flags == (1 | 8), "Expected hypoglycemia and rapid decrease flags"
+        print(f"  Incremental stats match Python over {running.count} readings")
+        print("  ✅ PASSED")
+    else:
+        print("  ⚠️ Skipped (run 'make lib' to build libglucose.so)")
+
+    # Test 7: Ring Buffer History and Chart Downsampling
+    print("\n✓ Test 7: Ring Buffer and LTTB Downsampling")
+    from history_buffer import GlucoseHistory
+    from downsample import downsample_series, lttb_indices_numpy
+    history = GlucoseHistory(3)
+    evicted = [history.append(value, datetime(2025, 1, 1, 0, minute)) for minute, value in enumerate([1.0, 2.0, 3.0, 4.0])]
+    assert evicted == [None, None, None, 1.0], "Oldest reading should be evicted when full"
+    assert list(history.values.view()) == [2.0, 3.0, 4.0], "History should stay oldest first"
+
+    values = np.full(20160, 120.0)
+    values[5000], values[15000] = 45.0, 390.0
+    times = np.datetime64('2025-01-01T00:00') + np.arange(20160).astype('timedelta64[m]')
+    chart_times, chart_values = downsample_series(times, values, 500)
+    assert len(chart_values) == 500, "Chart should draw a fixed number of points"
+    assert 45.0 in chart_values and 390.0 in chart_values, "Extremes should survive downsampling"
+    x = times.astype(np.int64).astype(np.float64)
+    assert np.array_equal(lttb_indices_numpy(x, values, 500), np.flatnonzero(np.isin(times, chart_times))), \
+        "numpy and native LTTB should pick the same points"
+    print(f"  20160 readings → {len(chart_values)} chart points, extremes kept")
+    print("  ✅ PASSED")
+
     # Summary
     print("\n" + "=" * 60)
     print("✅ All Core Functionality Tests PASSED")
@@ -212,6 +290,8 @@ def test_dashboard():
     print("  ✅ Statistics calculation (TIR, avg, variability)")
     print("  ✅ Alarm system (hypo, hyper, rapid change)")
     print("  ✅ Color coding logic (green, yellow, red)")
+    print("  ✅ Shared-memory telemetry feed layout")
+    print("  ✅ Fixed-capacity history with LTTB chart downsampling")
     print("\n🚀 Ready to run: streamlit run glucose_dashboard.py")
     print("=" * 60)
 
@@ -0,0 +1,290 @@
+/**
+ * @file archive_bench.c
+ * @brief Scan throughput of the reading archive on fleet-sized histories.
+ *
+ * Usage: archive_bench [--dir DIR] [--generate] [--patients N] [--days D]
+ *                      [--interval S] [--threads LIST] [--cold]
+ *
+ * With --generate, DIR is filled with N patients x D days of synthetic
+ * readings every S seconds (a mean-reverting random walk with meal spikes
+ * and occasional hypoglycemic dips), written through the archive writer tick by tick as
+ * the controller would. The defaults produce about 6.9 GB, more than the
+ * memory of the machines this runs on, so scans stream from disk.
+ *
+ * Each query then runs once per thread count in LIST (e.g. "1,2,4"):
+ * fleet stats and histogram over the last 92 days, every hypoglycemic
+ * episode, readings above 250 mg/dL, and one patient's full history.
+ * Throughput is readings decoded per second of wall time and per second
+ * of worker CPU time, i.e. per core. With --cold, the archive is dropped
+ * from the page cache before every scan.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../include/archive_scan.h"
+#include "../include/latency.h"
+#include "../include/reading_archive.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BENCH_MAX_THREAD_COUNTS 8
+#define BENCH_BASE_TIME 1767225600 // 2026-01-01T00:00:00Z
+
+// Structure to hold benchmark settings
+typedef struct {
+    const char* directory;
+    int generate;
+    uint32_t patients;
+    uint32_t days;
+    uint32_t interval;                              // Seconds between readings
+    unsigned int threads[BENCH_MAX_THREAD_COUNTS]; // Thread counts to compare
+    int thread_counts;
+    int cold;
+} ArchiveBenchOptions;
+
+/**
+ * @brief Parses a comma-separated list of thread counts.
+ *
+ * @return 0 on success, -1 on invalid arguments.
+ */
+static int parse_threads(const char* list, ArchiveBenchOptions* options) {
+    options->thread_counts = 0;
+    while (*list != '\0') {
+        char* end;
+        long value = strtol(list, &end, 10);
+        if (end == list || value <= 0 || value > ARCHIVE_SCAN_MAX_THREADS ||
+            options->thread_counts == BENCH_MAX_THREAD_COUNTS) return -1;
+        options->threads[options->thread_counts++] = (unsigned int)value;
+        list = *end == ',' ? end + 1 : end;
+        if (*end != ',' && *end != '\0') return -1;
+    }
+    return options->thread_counts > 0 ? 0 : -1;
+}
+
+/**
+ * @brief Parses command-line options.
+ *
+ * @return 0 on success, -1 on invalid arguments.
+ */
+static int parse_options(int argc, char* argv[], ArchiveBenchOptions* options) {
+    options->directory = "/tmp/glucose_archive";
+    options->generate = 0;
+    options->patients = 20000;
+    options->days = 120;
+    options->interval = 300;
+    options->threads[0] = 1;
+    options->thread_counts = 1;
+    options->cold = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--generate") == 0) {
+            options->generate = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "--cold") == 0) {
+            options->cold = 1;
+            continue;
+        }
+        if (i + 1 >= argc) return -1;
+        long value = strtol(argv[i + 1], NULL, 10);
+
+        if (strcmp(argv[i], "--dir") == 0) {
+            options->directory = argv[i + 1];
+        } else if (strcmp(argv[i], "--patients") == 0 && value > 0) {
+            options->patients = (uint32_t)value;
+        } else if (strcmp(argv[i], "--days") == 0 && value > 0) {
+            options->days = (uint32_t)value;
+        } else if (strcmp(argv[i], "--interval") == 0 && value > 0 && value <= 86400) {
+            options->interval = (uint32_t)value;
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            if (parse_threads(argv[i + 1], options) != 0) return -1;
+        } else {
+            return -1;
+        }
+        i++;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Returns the next value of a xorshift generator.
+ */
+static uint32_t next_random(uint32_t* state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/**
+ * @brief Fills the archive directory with synthetic readings.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int generate_archive(const ArchiveBenchOptions* options) {
+    static ReadingArchive archive;
+    if (reading_archive_open(&archive, options->directory) != 0) {
+        printf("Error: Cannot open archive %s\n", options->directory);
+        return -1;
+    }
+
+    // Per patient: value in tenths of mg/dL, readings left in a spike (> 0) or dip (< 0), generator state
+    int32_t* value = malloc(options->patients * sizeof(int32_t));
+    int32_t* event = calloc(options->patients, sizeof(int32_t));
+    uint32_t* state = malloc(options->patients * sizeof(uint32_t));
+    if (value == NULL || event == NULL || state == NULL) {
+        free(value);
+        free(event);
+        free(state);
+        reading_archive_close(&archive);
+        return -1;
+    }
+    for (uint32_t p = 0; p < options->patients; p++) {
+        state[p] = 2654435761u * (p + 1) | 1;
+        value[p] = 1000 + (int32_t)(next_random(&state[p]) % 800);
+    }
+
+    uint64_t ticks = (uint64_t)options->days * 86400 / options->interval;
+    uint64_t start = latency_now_ns();
+    int status = 0;
+    for (uint64_t tick = 0; tick < ticks && status == 0; tick++) {
+        time_t t = (time_t)(BENCH_BASE_TIME + tick * options->interval);
+        for (uint32_t p = 0; p < options->patients && status == 0; p++) {
+            uint32_t r = next_random(&state[p]);
+            // Meals drive glucose up a few times a day, and rarely it drops below range
+            int32_t target = 1200, pull = 16;
+            if (event[p] > 0) {
+                target = 2800;
+                pull = 8;
+                event[p]--;
+            } else if (event[p] < 0) {
+                target = 450;
+                pull = 4;
+                event[p]++;
+            } else if (r % 100 == 0) {
+                event[p] = 12 + (int32_t)((r >> 8) % 24);
+            } else if (r % 3000 == 1) {
+                event[p] = -(6 + (int32_t)((r >> 8) % 12));
+            }
+
+            value[p] += (target - value[p]) / pull + (int32_t)((r >> 16) % 121) - 60;
+            if (value[p] < 400) value[p] = 400;
+            if (value[p] > 4000) value[p] = 4000;
+            status = reading_archive_append(&archive, p + 1, t, (GlucoseFixed)value[p]);
+        }
+    }
+    if (reading_archive_close(&archive) != 0) status = -1;
+    double seconds = (latency_now_ns() - start) / 1e9;
+
+    printf("Generated %llu readings (%llu blocks, %.2f GB) in %.1f s (%.0f readings/s)\n",
+           (unsigned long long)archive.stats.readings, (unsigned long long)archive.stats.blocks,
+           archive.stats.bytes_written / 1e9, seconds, archive.stats.readings / seconds);
+    free(value);
+    free(event);
+    free(state);
+    return status;
+}
+
+/**
+ * @brief Writes back and evicts every shard file from the page cache.
+ */
+static void drop_cached_archive(const char* directory) {
+    for (uint32_t shard = 0; shard < ARCHIVE_SHARDS; shard++) {
+        for (int index = 0; index <= 1; index++) {
+            char path[ARCHIVE_PATH_MAX];
+            if (reading_archive_path(directory, shard, index, path) != 0) continue;
+            int fd = open(path, O_RDONLY);
+            if (fd < 0) continue;
+            fdatasync(fd);
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            close(fd);
+        }
+    }
+}
+
+/**
+ * @brief Runs one query and prints its throughput.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int run_query(const ArchiveBenchOptions* options, const char* name, ArchiveQuery* query,
+                     unsigned int threads) {
+    if (options->cold) drop_cached_archive(options->directory);
+    query->threads = threads;
+
+    ArchiveScanResult result;
+    if (archive_scan(options->directory, query, &result) != 0) {
+        printf("Error: Scan failed: %s\n", name);
+        return -1;
+    }
+
+    const ArchiveScanStats* scan = &result.scan;
+    double matched = result.stats.time_in_range + result.stats.time_below_range + result.stats.time_above_range;
+    printf("  %-16s %2u threads  %7.2f s  %6.1f M readings/s  %6.1f M/s per core  %6.0f MB/s  "
+           "blocks %llu/%llu (+%llu ids only)",
+           name, scan->threads, scan->seconds, scan->readings_scanned / scan->seconds / 1e6,
+           scan->thread_seconds > 0.0 ? scan->readings_scanned / scan->thread_seconds / 1e6 : 0.0,
+           scan->bytes_read / scan->seconds / 1e6,
+           (unsigned long long)scan->blocks_read, (unsigned long long)scan->blocks_indexed,
+           (unsigned long long)scan->blocks_ids_only);
+    if (query->outputs & ARCHIVE_OUTPUT_EPISODES) {
+        printf("  %u episodes\n", result.episode_count);
+    } else {
+        printf("  %.0f readings, mean %.1f mg/dL\n", matched, result.stats.avg_glucose);
+    }
+
+    archive_scan_free(&result);
+    return 0;
+}
+
+/**
+ * @brief Main function.
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv Array of command-line arguments.
+ * @return 0 on success, 1 on error.
+ */
+int main(int argc, char* argv[]) {
+    ArchiveBenchOptions options;
+    if (parse_options(argc, argv, &options) != 0) {
+        printf("Usage: %s [--dir DIR] [--generate] [--patients N] [--days D] [--interval S] "
+               "[--threads LIST] [--cold]\n", argv[0]);
+        return 1;
+    }
+    if (options.generate && generate_archive(&options) != 0) return 1;
+
+    int64_t end = BENCH_BASE_TIME + (int64_t)options.days * 86400;
+    ArchiveQuery quarter = archive_default_query();
+    quarter.from = end - 92 * 86400;
+    quarter.to = end;
+    quarter.outputs = ARCHIVE_OUTPUT_STATS | ARCHIVE_OUTPUT_HISTOGRAM;
+
+    ArchiveQuery episodes = archive_default_query();
+    episodes.outputs = ARCHIVE_OUTPUT_EPISODES;
+
+    ArchiveQuery high = archive_default_query();
+    high.min_value = glucose_to_fixed(250.0);
+
+    ArchiveQuery patient = archive_default_query();
+    patient.min_patient_id = patient.max_patient_id = options.patients / 2 + 1;
+    patient.outputs = ARCHIVE_OUTPUT_STATS | ARCHIVE_OUTPUT_EPISODES;
+
+    printf("Archive scans of %s%s\n", options.directory, options.cold ? " (cold page cache)" : "");
+    for (int i = 0; i < options.thread_counts; i++) {
+        unsigned int threads = options.threads[i];
+        if (run_query(&options, "stats+histogram", &quarter, threads) != 0 ||
+            run_query(&options, "episodes", &episodes, threads) != 0 ||
+            run_query(&options, "above 250", &high, threads) != 0 ||
+            run_query(&options, "one patient", &patient, threads) != 0) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
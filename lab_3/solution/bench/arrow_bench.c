@@ -0,0 +1,224 @@
+/**
+ * @file arrow_bench.c
+ * @brief Export throughput of readings as Arrow IPC, compared with CSV.
+ *
+ * Usage: arrow_bench [--rows N] [--patients P] [--out PREFIX]
+ *
+ * Generates N synthetic readings of P patients (every patient every five
+ * minutes, a mean-reverting random walk) in column arrays, then writes
+ * them three times, each timed including the final fsync:
+ *
+ *   PREFIX.arrow   Arrow IPC file, record batches straight from the columns
+ *   PREFIX.arrows  Arrow IPC stream, the same batches
+ *   PREFIX.csv     CSV with the same columns, via fprintf as fleet reports do
+ *
+ * app/arrow_load_bench.py then times loading the files in pyarrow and
+ * pandas, and checks that both formats hold the same table.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../include/arrow_export.h"
+#include "../include/arrow_ipc.h"
+#include "../include/latency.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BENCH_BASE_TIME 1767225600 // 2026-01-01T00:00:00Z
+#define BENCH_INTERVAL_S 300
+#define BENCH_PATH_MAX 256
+
+// Structure to hold benchmark settings
+typedef struct {
+    uint64_t rows;
+    uint32_t patients;
+    const char* prefix;
+} ArrowBenchOptions;
+
+// Readings in the column layout of readings.arrow
+typedef struct {
+    uint32_t* patient_id;
+    int64_t* time;
+    double* glucose;
+} ReadingColumns;
+
+/**
+ * @brief Parses command-line options.
+ *
+ * @return 0 on success, -1 on invalid arguments.
+ */
+static int parse_options(int argc, char* argv[], ArrowBenchOptions* options) {
+    options->rows = 10000000;
+    options->patients = 10000;
+    options->prefix = "/tmp/glucose_readings";
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) return -1;
+        long long value = strtoll(argv[i + 1], NULL, 10);
+
+        if (strcmp(argv[i], "--rows") == 0 && value > 0) {
+            options->rows = (uint64_t)value;
+        } else if (strcmp(argv[i], "--patients") == 0 && value > 0 && value <= UINT32_MAX) {
+            options->patients = (uint32_t)value;
+        } else if (strcmp(argv[i], "--out") == 0) {
+            options->prefix = argv[i + 1];
+        } else {
+            return -1;
+        }
+        i++;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Returns the next value of a xorshift generator.
+ */
+static uint32_t next_random(uint32_t* state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/**
+ * @brief Fills the columns with readings of every patient, tick by tick.
+ *
+ * @return 0 on success, -1 if out of memory.
+ */
+static int generate_readings(const ArrowBenchOptions* options, ReadingColumns* columns) {
+    columns->patient_id = malloc(options->rows * sizeof(uint32_t));
+    columns->time = malloc(options->rows * sizeof(int64_t));
+    columns->glucose = malloc(options->rows * sizeof(double));
+    int32_t* value = malloc(options->patients * sizeof(int32_t)); // Tenths of mg/dL
+    if (columns->patient_id == NULL || columns->time == NULL || columns->glucose == NULL || value == NULL) {
+        free(value);
+        return -1;
+    }
+
+    uint32_t state = 2463534242u;
+    for (uint32_t p = 0; p < options->patients; p++) value[p] = 1000 + (int32_t)(next_random(&state) % 800);
+    for (uint64_t row = 0; row < options->rows; row++) {
+        uint32_t p = (uint32_t)(row % options->patients);
+        value[p] += (1200 - value[p]) / 16 + (int32_t)(next_random(&state) % 121) - 60;
+        if (value[p] < 400) value[p] = 400;
+        columns->patient_id[row] = p + 1;
+        columns->time[row] = BENCH_BASE_TIME + (int64_t)(row / options->patients) * BENCH_INTERVAL_S;
+        columns->glucose[row] = value[p] / 10.0;
+    }
+    free(value);
+    return 0;
+}
+
+/**
+ * @brief Writes the readings as an Arrow IPC file or stream, in batches of ARROW_EXPORT_BATCH_ROWS.
+ *
+ * @return Bytes written, or 0 on error.
+ */
+static uint64_t write_arrow(const char* path, ArrowIpcFormat format, const ReadingColumns* columns, uint64_t rows) {
+    const ArrowField fields[] = {
+        {"patient_id", ARROW_TYPE_UINT32, 0},
+        {"time", ARROW_TYPE_TIMESTAMP, 0},
+        {"glucose", ARROW_TYPE_FLOAT64, 0},
+    };
+    ArrowIpcWriter writer;
+    if (arrow_ipc_open(&writer, path, format, fields, 3) != 0) return 0;
+
+    int status = 0;
+    for (uint64_t first = 0; first < rows && status == 0; first += ARROW_EXPORT_BATCH_ROWS) {
+        uint32_t count = rows - first < ARROW_EXPORT_BATCH_ROWS ? (uint32_t)(rows - first) : ARROW_EXPORT_BATCH_ROWS;
+        ArrowColumn batch[] = {
+            {columns->patient_id + first, NULL},
+            {columns->time + first, NULL},
+            {columns->glucose + first, NULL},
+        };
+        status = arrow_ipc_write_batch(&writer, batch, count);
+    }
+    if (status == 0 && fsync(writer.fd) != 0) status = -1;
+    if (arrow_ipc_close(&writer) != 0) status = -1;
+    return status == 0 ? writer.stats.bytes_written : 0;
+}
+
+/**
+ * @brief Writes the readings as CSV with a header line.
+ *
+ * @return Bytes written, or 0 on error.
+ */
+static uint64_t write_csv(const char* path, const ReadingColumns* columns, uint64_t rows) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) return 0;
+
+    int status = fprintf(file, "patient_id,time,glucose\n") < 0 ? -1 : 0;
+    for (uint64_t row = 0; row < rows && status == 0; row++) {
+        if (fprintf(file, "%u,%lld,%.1f\n", columns->patient_id[row], (long long)columns->time[row],
+                    columns->glucose[row]) < 0) status = -1;
+    }
+    if (status == 0 && (fflush(file) != 0 || fsync(fileno(file)) != 0)) status = -1;
+    long size = ftell(file);
+    if (fclose(file) != 0) status = -1;
+    return status == 0 && size > 0 ? (uint64_t)size : 0;
+}
+
+/**
+ * @brief Prints one result line.
+ */
+static void print_result(const char* format, const char* path, uint64_t rows, uint64_t bytes, double seconds) {
+    printf("%-13s %8.1f MB  %7.3f s  %7.1f M rows/s  %7.0f MB/s  %s\n", format, bytes / 1e6, seconds,
+           rows / seconds / 1e6, bytes / seconds / 1e6, path);
+}
+
+/**
+ * @brief Runs the benchmark.
+ */
+int main(int argc, char* argv[]) {
+    ArrowBenchOptions options;
+    if (parse_options(argc, argv, &options) != 0 || strlen(options.prefix) > BENCH_PATH_MAX - 8) {
+        printf("Usage: %s [--rows N] [--patients P] [--out PREFIX]\n", argv[0]);
+        return 1;
+    }
+
+    ReadingColumns columns = {NULL, NULL, NULL};
+    if (generate_readings(&options, &columns) != 0) {
+        printf("Error: Out of memory for %llu readings\n", (unsigned long long)options.rows);
+        return 1;
+    }
+    printf("%llu readings of %u patients (%.1f MB of columns)\n\n", (unsigned long long)options.rows,
+           options.patients, options.rows * (sizeof(uint32_t) + sizeof(int64_t) + sizeof(double)) / 1e6);
+
+    char arrow_path[BENCH_PATH_MAX];
+    char stream_path[BENCH_PATH_MAX];
+    char csv_path[BENCH_PATH_MAX];
+    snprintf(arrow_path, sizeof(arrow_path), "%s.arrow", options.prefix);
+    snprintf(stream_path, sizeof(stream_path), "%s.arrows", options.prefix);
+    snprintf(csv_path, sizeof(csv_path), "%s.csv", options.prefix);
+
+    int status = 0;
+    uint64_t start = latency_now_ns();
+    uint64_t bytes = write_arrow(arrow_path, ARROW_IPC_FILE, &columns, options.rows);
+    double seconds = (latency_now_ns() - start) / 1e9;
+    if (bytes > 0) print_result("Arrow file", arrow_path, options.rows, bytes, seconds);
+    else status = 1;
+
+    start = latency_now_ns();
+    bytes = write_arrow(stream_path, ARROW_IPC_STREAM, &columns, options.rows);
+    seconds = (latency_now_ns() - start) / 1e9;
+    if (bytes > 0) print_result("Arrow stream", stream_path, options.rows, bytes, seconds);
+    else status = 1;
+
+    start = latency_now_ns();
+    bytes = write_csv(csv_path, &columns, options.rows);
+    seconds = (latency_now_ns() - start) / 1e9;
+    if (bytes > 0) print_result("CSV", csv_path, options.rows, bytes, seconds);
+    else status = 1;
+
+    if (status != 0) printf("Error: Failed to write the output files\n");
+    else printf("\nCompare load times with: python app/arrow_load_bench.py %s\n", options.prefix);
+    free(columns.patient_id);
+    free(columns.time);
+    free(columns.glucose);
+    return status;
+}
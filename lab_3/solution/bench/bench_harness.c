@@ -0,0 +1,326 @@
+/**
+ * @file bench_harness.c
+ * @brief Contains the calibration, sampling and reporting logic of the benchmark harness.
+ */
+
+#define _GNU_SOURCE
+
+#include "bench_harness.h"
+#include "../include/latency.h"
+#include <math.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_MAX_SAMPLES 1000
+
+// Counters of the benchmark thread, opened on first use and kept open for the life of the process
+static PerfCounters perf_counters;
+static int perf_state = 0; // 0 = not opened yet, 1 = open, -1 = unavailable
+
+/**
+ * @brief Returns the two-sided 95% Student-t critical value.
+ *
+ * @param degrees_of_freedom Number of samples minus one.
+ * @return Critical value for the confidence interval half-width.
+ */
+static double student_t_95(int degrees_of_freedom) {
+    static const double table[] = {
+        0.0, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262,
+        2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093,
+        2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045,
+        2.042
+    };
+    if (degrees_of_freedom <= 0) return 0.0;
+    if (degrees_of_freedom <= 30) return table[degrees_of_freedom];
+    if (degrees_of_freedom <= 60) return 2.000;
+    if (degrees_of_freedom <= 120) return 1.980;
+    return 1.960;
+}
+
+/**
+ * @brief Orders doubles ascending for qsort().
+ */
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Times one batch of iterations.
+ *
+ * @return Elapsed wall time in nanoseconds.
+ */
+static uint64_t time_batch(const BenchCase* bench, uint64_t iterations) {
+    uint64_t start = latency_now_ns();
+    bench->run(bench->context, iterations);
+    return latency_now_ns() - start;
+}
+
+/**
+ * @brief Opens the counters on first use and says which events are missing.
+ *
+ * @return Pointer to the open counters, or NULL if no event can be counted.
+ */
+static PerfCounters* get_perf_counters(void) {
+    if (perf_state == 0) {
+        perf_state = perf_counters_open(&perf_counters) == 0 ? 1 : -1;
+        if (perf_state < 0) {
+            fprintf(stderr, "Note: Performance counters unavailable (%s), reporting timings only\n",
+                    strerror(perf_counters.first_error));
+        } else if (perf_counters.open_count < PERF_COUNTER_EVENT_COUNT) {
+            fprintf(stderr, "Note: Not counting");
+            for (int e = 0; e < PERF_COUNTER_EVENT_COUNT; e++) {
+                if (perf_counters.fds[e] < 0) fprintf(stderr, " %s", perf_counter_name((PerfCounterEvent)e));
+            }
+            fprintf(stderr, " (%s)\n", strerror(perf_counters.first_error));
+        }
+    }
+    return perf_state > 0 ? &perf_counters : NULL;
+}
+
+/**
+ * @brief Returns harness settings suitable for a quick, stable run.
+ *
+ * @return BenchOptions structure with default values.
+ */
+BenchOptions bench_default_options(void) {
+    BenchOptions options;
+    options.samples = 30;
+    options.warmup_ms = 200;
+    options.min_sample_ms = 10;
+    options.cpu = 0;
+    options.perf_counters = 0;
+    return options;
+}
+
+/**
+ * @brief Pins the calling thread to a CPU.
+ *
+ * @param cpu CPU index to pin to.
+ * @return 0 on success, -1 on error.
+ */
+int bench_pin_to_cpu(int cpu) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) return -1;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) return -1;
+
+    return 0;
+}
+
+/**
+ * @brief Runs one benchmark: calibrate, warm up, sample and summarize.
+ *
+ * The batch size is doubled until one batch takes at least
+ * min_sample_ms, so timer overhead is amortized over many operations.
+ * The benchmark then runs untimed for warmup_ms before samples are taken.
+ * Counters, if requested, run over all samples as one region, so they
+ * cover the same operations as the timings but not the calibration and
+ * warm-up.
+ *
+ * @param bench Pointer to the benchmark to run.
+ * @param options Pointer to the harness settings.
+ * @param result Pointer to the BenchResult structure to fill.
+ * @return 0 on success, -1 on error.
+ */
+int bench_run(const BenchCase* bench, const BenchOptions* options, BenchResult* result) {
+    if (bench == NULL || bench->run == NULL || options == NULL || result == NULL) return -1;
+    if (options->samples < 2 || options->samples > BENCH_MAX_SAMPLES) return -1;
+
+    uint64_t min_sample_ns = (uint64_t)options->min_sample_ms * 1000000ull;
+    uint64_t warmup_ns = (uint64_t)options->warmup_ms * 1000000ull;
+
+    // Calibrate the batch size
+    uint64_t iterations = 1;
+    while (time_batch(bench, iterations) < min_sample_ns && iterations < (1ull << 40)) {
+        iterations *= 2;
+    }
+
+    // Warm up caches, branch predictors and CPU frequency
+    uint64_t warmup_start = latency_now_ns();
+    while (latency_now_ns() - warmup_start < warmup_ns) {
+        bench->run(bench->context, iterations);
+    }
+
+    PerfCounters* counters = options->perf_counters ? get_perf_counters() : NULL;
+    memset(&result->counters, 0, sizeof(result->counters));
+    if (counters != NULL && perf_counters_start(counters) != 0) counters = NULL;
+
+    double samples[BENCH_MAX_SAMPLES];
+    double sum = 0.0;
+    for (int i = 0; i < options->samples; i++) {
+        samples[i] = (double)time_batch(bench, iterations) / (double)iterations;
+        sum += samples[i];
+    }
+
+    if (counters != NULL && perf_counters_stop(counters, &result->counters) == 0) {
+        double operations = (double)iterations * (double)options->samples;
+        for (int e = 0; e < PERF_COUNTER_EVENT_COUNT; e++) result->counters.counts[e] /= operations;
+    }
+
+    double mean = sum / options->samples;
+    double squares = 0.0;
+    for (int i = 0; i < options->samples; i++) {
+        double diff = samples[i] - mean;
+        squares += diff * diff;
+    }
+    double stddev = sqrt(squares / (options->samples - 1));
+    double half_width = student_t_95(options->samples - 1) * stddev / sqrt((double)options->samples);
+
+    qsort(samples, (size_t)options->samples, sizeof(samples[0]), compare_doubles);
+
+    result->name = bench->name;
+    result->iterations = iterations;
+    result->samples = options->samples;
+    result->mean_ns = mean;
+    result->median_ns = (options->samples % 2 == 1)
+        ? samples[options->samples / 2]
+        : 0.5 * (samples[options->samples / 2 - 1] + samples[options->samples / 2]);
+    result->min_ns = samples[0];
+    result->stddev_ns = stddev;
+    result->ci95_low_ns = mean - half_width;
+    result->ci95_high_ns = mean + half_width;
+
+    return 0;
+}
+
+/**
+ * @brief Returns non-zero if any event of a result was counted.
+ */
+static int has_counters(const BenchResult* result) {
+    for (int e = 0; e < PERF_COUNTER_EVENT_COUNT; e++) {
+        if (result->counters.valid[e]) return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Prints one counter column, or "-" if the event was not counted.
+ */
+static void print_counter(FILE* out, const PerfCounterReading* counters, PerfCounterEvent event) {
+    if (counters->valid[event]) fprintf(out, " %12.4g", counters->counts[event]);
+    else fprintf(out, " %12s", "-");
+}
+
+/**
+ * @brief Prints the per-op counters of every result that has them.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int print_counter_table(FILE* out, const BenchResult* results, size_t count) {
+    size_t with_counters = 0;
+    for (size_t i = 0; i < count; i++) with_counters += has_counters(&results[i]) != 0;
+    if (with_counters == 0) return 0;
+
+    fprintf(out, "--- Performance Counters (per op) ---\n");
+    fprintf(out, "%-34s %12s %12s %6s %12s %12s %12s %12s %12s\n", "benchmark", "cycles", "instructions", "IPC",
+            "branch miss", "L1d miss", "LLC miss", "dTLB miss", "page faults");
+
+    for (size_t i = 0; i < count; i++) {
+        const PerfCounterReading* counters = &results[i].counters;
+        if (!has_counters(&results[i])) continue;
+
+        fprintf(out, "%-34s", results[i].name);
+        print_counter(out, counters, PERF_COUNTER_CYCLES);
+        print_counter(out, counters, PERF_COUNTER_INSTRUCTIONS);
+        if (counters->valid[PERF_COUNTER_CYCLES] && counters->valid[PERF_COUNTER_INSTRUCTIONS] &&
+            counters->counts[PERF_COUNTER_CYCLES] > 0.0) {
+            fprintf(out, " %6.2f", counters->counts[PERF_COUNTER_INSTRUCTIONS] / counters->counts[PERF_COUNTER_CYCLES]);
+        } else {
+            fprintf(out, " %6s", "-");
+        }
+        for (int e = PERF_COUNTER_BRANCH_MISSES; e < PERF_COUNTER_EVENT_COUNT; e++) {
+            print_counter(out, counters, (PerfCounterEvent)e);
+        }
+        fprintf(out, "\n");
+    }
+
+    fprintf(out, "-------------------------------------\n\n");
+
+    return 0;
+}
+
+/**
+ * @brief Prints a human-readable results table.
+ *
+ * @param out Stream to print to.
+ * @param results Array of results.
+ * @param count Number of results.
+ * @return 0 on success, -1 on error.
+ */
+int bench_print_table(FILE* out, const BenchResult* results, size_t count) {
+    if (out == NULL || (results == NULL && count > 0)) return -1;
+
+    fprintf(out, "\n--- Benchmark Results (ns/op) ---\n");
+    fprintf(out, "%-34s %12s %12s %12s %22s\n", "benchmark", "mean", "median", "min", "95% CI");
+
+    for (size_t i = 0; i < count; i++) {
+        const BenchResult* r = &results[i];
+        fprintf(out, "%-34s %12.2f %12.2f %12.2f   [%8.2f, %8.2f]\n",
+                r->name, r->mean_ns, r->median_ns, r->min_ns, r->ci95_low_ns, r->ci95_high_ns);
+    }
+
+    fprintf(out, "---------------------------------\n\n");
+
+    return print_counter_table(out, results, count);
+}
+
+/**
+ * @brief Writes results as a JSON document for comparing builds.
+ *
+ * @param out Stream to write to.
+ * @param results Array of results.
+ * @param count Number of results.
+ * @param options Pointer to the settings the results were collected with.
+ * @return 0 on success, -1 on error.
+ */
+int bench_write_json(FILE* out, const BenchResult* results, size_t count, const BenchOptions* options) {
+    if (out == NULL || options == NULL || (results == NULL && count > 0)) return -1;
+
+    char timestamp[32];
+    time_t now = time(NULL);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"timestamp\": \"%s\",\n", timestamp);
+    fprintf(out, "  \"compiler\": \"%s\",\n", __VERSION__);
+    fprintf(out, "  \"cpu\": %d,\n", options->cpu);
+    fprintf(out, "  \"samples\": %d,\n", options->samples);
+    fprintf(out, "  \"warmup_ms\": %d,\n", options->warmup_ms);
+    fprintf(out, "  \"min_sample_ms\": %d,\n", options->min_sample_ms);
+    fprintf(out, "  \"perf_counters\": %d,\n", options->perf_counters);
+    fprintf(out, "  \"benchmarks\": [\n");
+
+    for (size_t i = 0; i < count; i++) {
+        const BenchResult* r = &results[i];
+        fprintf(out, "    {\"name\": \"%s\", \"unit\": \"ns/op\", \"iterations\": %llu, "
+                     "\"mean\": %.4f, \"median\": %.4f, \"min\": %.4f, \"stddev\": %.4f, "
+                     "\"ci95_low\": %.4f, \"ci95_high\": %.4f",
+                r->name, (unsigned long long)r->iterations,
+                r->mean_ns, r->median_ns, r->min_ns, r->stddev_ns,
+                r->ci95_low_ns, r->ci95_high_ns);
+
+        // Counted events only, per op
+        if (has_counters(r)) {
+            const char* separator = "";
+            fprintf(out, ", \"counters\": {");
+            for (int e = 0; e < PERF_COUNTER_EVENT_COUNT; e++) {
+                if (!r->counters.valid[e]) continue;
+                fprintf(out, "%s\"%s\": %.6g", separator, perf_counter_name((PerfCounterEvent)e), r->counters.counts[e]);
+                separator = ", ";
+            }
+            fprintf(out, "}");
+        }
+        fprintf(out, "}%s\n", (i + 1 < count) ? "," : "");
+    }
+
+    fprintf(out, "  ]\n");
+    fprintf(out, "}\n");
+
+    return ferror(out) ? -1 : 0;
+}
@@ -0,0 +1,117 @@
+#ifndef BENCH_HARNESS_H
+#define BENCH_HARNESS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "perf_counters.h"
+
+/**
+ * @file bench_harness.h
+ * @brief Minimal microbenchmark harness for the glucose monitoring hot paths.
+ *
+ * A benchmark is a function that runs its operation a given number of
+ * times. The harness calibrates the batch size so every sample lasts at
+ * least a minimum duration, warms up, collects samples on a pinned CPU and
+ * reports ns/op with a 95% confidence interval. Optionally, hardware
+ * counters (see perf_counters.h) are collected over the timed samples and
+ * reported per op next to the timings.
+ */
+
+/**
+ * @brief Function under test.
+ *
+ * @param context Benchmark-specific state.
+ * @param iterations Number of operations to run back to back.
+ */
+typedef void (*BenchFunction)(void* context, uint64_t iterations);
+
+// Structure describing one benchmark
+typedef struct {
+    const char* name;  // Unique benchmark name (used in JSON output)
+    BenchFunction run; // Function under test
+    void* context;     // Passed through to run()
+} BenchCase;
+
+// Structure to hold harness settings
+typedef struct {
+    int samples;           // Number of timed samples per benchmark
+    int warmup_ms;         // Warm-up time before sampling
+    int min_sample_ms;     // Minimum duration of one sample
+    int cpu;               // CPU to pin to, or -1 to leave affinity unchanged
+    int perf_counters;     // Non-zero to count hardware events over the samples
+} BenchOptions;
+
+// Structure to hold the result of one benchmark
+typedef struct {
+    const char* name;         // Benchmark name
+    uint64_t iterations;      // Operations per sample
+    int samples;              // Number of samples taken
+    double mean_ns;           // Mean ns/op across samples
+    double median_ns;         // Median ns/op across samples
+    double min_ns;            // Fastest sample in ns/op
+    double stddev_ns;         // Sample standard deviation in ns/op
+    double ci95_low_ns;       // Lower bound of the 95% confidence interval
+    double ci95_high_ns;      // Upper bound of the 95% confidence interval
+    PerfCounterReading counters; // Events per op over all samples; none valid if not collected
+} BenchResult;
+
+/**
+ * @brief Keeps the compiler from optimizing away a computed value.
+ *
+ * @param pointer Address of the value that must be considered used.
+ */
+static inline void bench_do_not_optimize(const void* pointer) {
+    __asm__ __volatile__("" : : "g"(pointer) : "memory");
+}
+
+/**
+ * @brief Returns harness settings suitable for a quick, stable run.
+ *
+ * @return BenchOptions structure with default values.
+ */
+BenchOptions bench_default_options(void);
+
+/**
+ * @brief Pins the calling thread to a CPU.
+ *
+ * @param cpu CPU index to pin to.
+ * @return 0 on success, -1 on error.
+ */
+int bench_pin_to_cpu(int cpu);
+
+/**
+ * @brief Runs one benchmark: calibrate, warm up, sample and summarize.
+ *
+ * @param bench Pointer to the benchmark to run.
+ * @param options Pointer to the harness settings.
+ * @param result Pointer to the BenchResult structure to fill.
+ * @return 0 on success, -1 on error.
+ */
+int bench_run(const BenchCase* bench, const BenchOptions* options, BenchResult* result);
+
+/**
+ * @brief Prints a human-readable results table.
+ *
+ * If any result has counters, a second table lists them per op, with
+ * "-" for events that were not counted.
+ *
+ * @param out Stream to print to.
+ * @param results Array of results.
+ * @param count Number of results.
+ * @return 0 on success, -1 on error.
+ */
+int bench_print_table(FILE* out, const BenchResult* results, size_t count);
+
+/**
+ * @brief Writes results as a JSON document for comparing builds.
+ *
+ * @param out Stream to write to.
+ * @param results Array of results.
+ * @param count Number of results.
+ * @param options Pointer to the settings the results were collected with.
+ * @return 0 on success, -1 on error.
+ */
+int bench_write_json(FILE* out, const BenchResult* results, size_t count, const BenchOptions* options);
+
+#endif // BENCH_HARNESS_H
@@ -0,0 +1,839 @@
+/**
+ * @file bench_hot_paths.c
+ * @brief Microbenchmarks for the per-reading hot paths of the glucose monitor.
+ *
+ * Usage: bench_hot_paths [--json FILE] [--samples N] [--warmup-ms N]
+ *                        [--min-sample-ms N] [--cpu N] [--filter TEXT] [--perf]
+ *
+ * With --perf, cycles, instructions, branch, cache and dTLB misses and
+ * page faults are counted over each benchmark's samples and reported per
+ * op (see perf_counters.h); events the kernel refuses are left out.
+ *
+ * Console output of the print paths is sent to /dev/null while they are
+ * measured, so the numbers reflect formatting cost rather than terminal speed.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "bench_harness.h"
+#include "../include/alarm.h"
+#include "../include/analysis.h"
+#include "../include/config.h"
+#include "../include/config_store.h"
+#include "../include/data_generator.h"
+#include "../include/glucose_filter.h"
+#include "../include/glucose_kernels.h"
+#include "../include/latency.h"
+#include "../include/metrics.h"
+#include "../include/patient_registry.h"
+#include "../include/resampler.h"
+#include "../include/risk_index.h"
+#include "../include/rollup_cube.h"
+#include "../include/terminal_ui.h"
+#include "../include/visualization.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define FIXTURE_SIZE 1024 // Power of two so the index wraps with a mask
+
+// Shared state for the benchmarks that replay pre-generated readings
+typedef struct {
+    GeneratedData readings[FIXTURE_SIZE];
+    double values[FIXTURE_SIZE];
+    GlucoseFixed fixed_values[FIXTURE_SIZE]; // The same readings in fixed point
+    double gapped[FIXTURE_SIZE];             // The same readings with every 16th missing (NaN)
+    uint64_t valid[GLUCOSE_VALIDITY_WORDS(FIXTURE_SIZE)]; // Validity bitmap of gapped
+    double filled[FIXTURE_SIZE];             // Scratch copy of gapped for interpolation
+    uint64_t filled_valid[GLUCOSE_VALIDITY_WORDS(FIXTURE_SIZE)];
+    uint8_t flags[FIXTURE_SIZE];
+    GlucoseStats stats;
+    GlucoseAccumulator accumulator;
+    Config config;
+    uint64_t cursor;
+} ReadingFixture;
+
+// Per-patient thresholds for FIXTURE_SIZE patients, as a published ConfigTable holds them
+typedef struct {
+    ConfigTable table;
+    int32_t hypoglycemia[FIXTURE_SIZE];
+    int32_t hyperglycemia[FIXTURE_SIZE];
+    int32_t rapid_change[FIXTURE_SIZE];
+    double previous[FIXTURE_SIZE];
+    uint8_t flags[FIXTURE_SIZE];
+} ThresholdFixture;
+
+// A small fleet on a default-sized dashboard, drawn to /dev/null
+typedef struct {
+    PatientRegistry registry;
+    TerminalUI ui;
+    TerminalStatus status;
+} DashboardFixture;
+
+#define DASHBOARD_PATIENTS 64 // More than fit on the screen, so the table is clipped as in a real fleet
+
+// A fleet-sized at-risk ranking, plus the same scores as a flat array for the full-scan baseline
+typedef struct {
+    RiskIndex index;
+    double* scores;  // Score of each slot
+    uint32_t count;
+    uint64_t cursor;
+} RiskFixture;
+
+#define RISK_PATIENTS (1u << 20) // About 1M patients
+#define RISK_TOP_K 10
+
+// 30 days of 5-minute readings for one patient, raw and rolled up
+#define ROLLUP_READINGS (30 * 24 * 12)
+#define ROLLUP_INTERVAL_S 300
+#define ROLLUP_BASE_TIME 1760000000
+
+typedef struct {
+    RollupCube queried;  // Holds the 30 days below in slot 0
+    RollupCube updated;  // Receives readings for FIXTURE_SIZE patients
+    time_t times[ROLLUP_READINGS];
+    GlucoseFixed values[ROLLUP_READINGS];
+    Config config;
+    uint64_t cursor;
+} RollupFixture;
+
+// Smoothers of FIXTURE_SIZE patients, one per patient and as one bank, fed the fixture's readings
+typedef struct {
+    GlucoseFilter filters[FIXTURE_SIZE];
+    GlucoseFilterBank bank;
+    GlucoseFilterParams params;
+    double tick[FIXTURE_SIZE]; // One reading per patient
+    uint64_t tick_valid[GLUCOSE_VALIDITY_WORDS(FIXTURE_SIZE)]; // Every 16th reading missing
+    double times[FIXTURE_SIZE]; // Time of each patient's reading, a FILTER_INTERVAL_S later every tick
+    uint64_t cursor;
+} FilterFixture;
+
+#define FILTER_INTERVAL_S 300
+
+// FIXTURE_SIZE patients' jittered 5-minute readings, resampled onto the default grid
+typedef struct {
+    Resampler resampler;
+    uint32_t jitter[FIXTURE_SIZE]; // Seconds late of each patient's readings, below 2 minutes
+    uint64_t cursor;
+} ResamplerFixture;
+
+static ReadingFixture fixture;
+static ThresholdFixture thresholds;
+static PatientRegistry registry;
+static DashboardFixture dashboard;
+static RiskFixture risk;
+static RollupFixture rollup;
+static FilterFixture smoothing;
+static ResamplerFixture resampling;
+
+/**
+ * @brief Fills the fixture with a reproducible sequence of readings.
+ */
+static void build_fixture(void) {
+    GeneratedData data;
+    memset(&data, 0, sizeof(data));
+    srand(42);
+
+    for (int i = 0; i < FIXTURE_SIZE; i++) {
+        generate_glucose_data(&data);
+        fixture.readings[i] = data;
+        fixture.values[i] = data.glucose_value;
+        fixture.fixed_values[i] = data.glucose_history[0];
+        fixture.gapped[i] = i % 16 == 15 ? NAN : data.glucose_value;
+        if (i % 16 != 15) fixture.valid[i / 64] |= UINT64_C(1) << (i % 64);
+    }
+
+    fixture.config = initialize_config();
+    initialize_glucose_statistics(&fixture.stats);
+    glucose_accumulator_init(&fixture.accumulator);
+    fixture.cursor = 0;
+
+    // Patient i has reading i of the fixture and slightly different thresholds
+    for (int i = 0; i < FIXTURE_SIZE; i++) {
+        thresholds.hypoglycemia[i] = fixture.config.hypoglycemia_threshold + i % 11 - 5;
+        thresholds.hyperglycemia[i] = fixture.config.hyperglycemia_threshold + i % 21 - 10;
+        thresholds.rapid_change[i] = fixture.config.rapid_change_threshold + i % 7 - 3;
+        thresholds.previous[i] = glucose_from_fixed(fixture.readings[i].glucose_history[1]);
+    }
+    thresholds.table.defaults = fixture.config;
+    thresholds.table.row_count = FIXTURE_SIZE;
+    thresholds.table.override_count = FIXTURE_SIZE;
+    thresholds.table.hypoglycemia_threshold = thresholds.hypoglycemia;
+    thresholds.table.hyperglycemia_threshold = thresholds.hyperglycemia;
+    thresholds.table.rapid_change_threshold = thresholds.rapid_change;
+}
+
+/**
+ * @brief Generates one new reading per iteration.
+ */
+static void bench_generate(void* context, uint64_t iterations) {
+    GeneratedData* data = context;
+    for (uint64_t i = 0; i < iterations; i++) {
+        generate_glucose_data(data);
+    }
+    bench_do_not_optimize(data);
+}
+
+/**
+ * @brief Folds one pre-generated reading into the running statistics per iteration.
+ */
+static void bench_update_statistics(void* context, uint64_t iterations) {
+    ReadingFixture* f = context;
+    for (uint64_t i = 0; i < iterations; i++) {
+        const GeneratedData* data = &f->readings[(f->cursor++) & (FIXTURE_SIZE - 1)];
+        update_glucose_statistics(&f->stats, data, &f->config);
+    }
+    bench_do_not_optimize(&f->stats);
+}
+
+/**
+ * @brief Adds one pre-generated reading to the array-kernel accumulator per iteration.
+ */
+static void bench_accumulator_add(void* context, uint64_t iterations) {
+    ReadingFixture* f = context;
+    for (uint64_t i = 0; i < iterations; i++) {
+        glucose_accumulator_add(&f->accumulator, &f->values[(f->cursor++) & (FIXTURE_SIZE - 1)], 1, &f->config);
+    }
+    bench_do_not_optimize(&f->accumulator);
+}
+
+/**
+ * @brief Adds the fixture to the accumulator a whole array at a time; one reading per iteration.
+ */
+static void bench_accumulator_add_array(void* context, uint64_t iterations) {
+    ReadingFixture* f = context;
+    while (iterations > 0) {
+        size_t count = iterations < FIXTURE_SIZE ? (size_t)iterations : FIXTURE_SIZE;
+        glucose_accumulator_add(&f->accumulator, f->values, count, &f->config);
+        iterations -= count;
+    }
+    bench_do_not_optimize(&f->accumulator);
+}
+
+/**
+ * @brief Same as bench_accumulator_add_array() on the fixed-point readings.
+ */
+static void bench_accumulator_add_fixed(void* context, uint64_t iterations) {
+    ReadingFixture* f = context;
+    while (iterations > 0) {
+        size_t count = iterations < FIXTURE_SIZE ? (size_t)iterations : FIXTURE_SIZE;
+        glucose_accumulator_add_fixed(&f->accumulator, f->fixed_values, count, &f->config);
+        iterations -= count;
+    }
+    bench_do_not_optimize(&f->accumulator);
+}
+
+/**
+ * @brief Same as bench_accumulator_add_array() on the readings with gaps; one entry per iteration.
+ */
+static void bench_accumulator_add_masked(void* context, uint64_t iterations) {
+    ReadingFixture* f = context;
+    while (iterations > 0) {
+        size_t count = iterations < FIXTURE_SIZE ? (size_t)iterations : FIXTURE_SIZE;
+        glucose_accumulator_add_masked(&f->accumulator, f->gapped, f->valid, count, &f->config);
+        iterations -= count;
+    }
+    bench_do_not_optimize(&f->accumulator);
+}
+
+/**
+ * @brief Scans the fixture for alarms a whole array at a time; one reading per iteration.
+ */
+static void bench_scan_alarms(void* context, uint64_t iterations) {
+    ReadingFixture* f = context;
+    long alarms = 0;
+    while (iterations > 0) {
+        size_t count = iterations < FIXTURE_SIZE ? (size_t)iterations : FIXTURE_SIZE;
+        alarms += glucose_scan_alarms(f->values, count, &f->config, f->flags);
+        iterations -= count;
+    }
+    bench_do_not_optimize(&alarms);
+    bench_do_not_optimize(f->flags);
+}
+
+/**
+ * @brief Same as bench_scan_alarms() on the fixed-point readings.
+ */
+static void bench_scan_alarms_fixed(void* context, uint64_t iterations) {
+    ReadingFixture* f = context;
+    long alarms = 0;
+    while (iterations > 0) {
+        size_t count = iterations < FIXTURE_SIZE ? (size_t)iterations : FIXTURE_SIZE;
+        alarms += glucose_scan_alarms_fixed(f->fixed_values, count, &f->config, f->flags);
+        iterations -= count;
+    }
+    bench_do_not_optimize(&alarms);
+    bench_do_not_optimize(f->flags);
+}
+
+/**
+ * @brief Same as bench_scan_alarms() on the readings with gaps; one entry per iteration.
+ */
+static void bench_scan_alarms_masked(void* context, uint64_t iterations) {
+    ReadingFixture* f = context;
+    long alarms = 0;
+    while (iterations > 0) {
+        size_t count = iterations < FIXTURE_SIZE ? (size_t)iterations : FIXTURE_SIZE;
+        alarms += glucose_scan_alarms_masked(f->gapped, f->valid, count, &f->config, f->flags);
+        iterations -= count;
+    }
+    bench_do_not_optimize(&alarms);
+    bench_do_not_optimize(f->flags);
+}
+
+/**
+ * @brief Restores the gaps and fills them by interpolation; one entry per iteration.
+ */
+static void bench_interpolate_gaps(void* context, uint64_t iterations) {
+    ReadingFixture* f = context;
+    size_t filled = 0;
+    while (iterations > 0) {
+        size_t count = iterations < FIXTURE_SIZE ? (size_t)iterations : FIXTURE_SIZE;
+        memcpy(f->filled, f->gapped, count * sizeof(double));
+        memcpy(f->filled_valid, f->valid, sizeof(f->valid));
+        filled += glucose_interpolate_gaps(f->filled, f->filled_valid, count, 3);
+        iterations -= count;
+    }
+    bench_do_not_optimize(&filled);
+    bench_do_not_optimize(f->filled);
+}
+
+/**
+ * @brief Computes the trend of one pre-generated reading per iteration.
+ */
+static void bench_trend(void* context, uint64_t iterations) {
+    ReadingFixture* f = context;
+    int sum = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        sum += (int)calculate_glucose_trend(&f->readings[(f->cursor++) & (FIXTURE_SIZE - 1)]);
+    }
+    bench_do_not_optimize(&sum);
+}
+
+/**
+ * @brief Checks and prints the alarms of one pre-generated reading per iteration.
+ */
+static void bench_alarms(void* context, uint64_t iterations) {
+    ReadingFixture* f = context;
+    for (uint64_t i = 0; i < iterations; i++) {
+        check_and_print_alarms(&f->readings[(f->cursor++) & (FIXTURE_SIZE - 1)], &f->config);
+    }
+}
+
+/**
+ * @brief Looks up one patient's thresholds and evaluates its alarms per iteration.
+ */
+static void bench_alarm_rows(void* context, uint64_t iterations) {
+    ThresholdFixture* t = context;
+    unsigned int sum = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        uint32_t patient = (uint32_t)(fixture.cursor++) & (FIXTURE_SIZE - 1);
+        Config config;
+        unsigned int flags;
+        config_table_get(&t->table, patient, &config);
+        evaluate_glucose_alarms(&fixture.readings[patient], &config, &flags);
+        sum += flags;
+    }
+    bench_do_not_optimize(&sum);
+}
+
+/**
+ * @brief Evaluates the alarms of one patient per iteration straight from the threshold columns.
+ */
+static void bench_alarm_columns(void* context, uint64_t iterations) {
+    ThresholdFixture* t = context;
+    long alarms = 0;
+    while (iterations > 0) {
+        size_t count = iterations < FIXTURE_SIZE ? (size_t)iterations : FIXTURE_SIZE;
+        alarms += glucose_scan_alarm_columns(fixture.values, t->previous, t->hypoglycemia, t->hyperglycemia,
+                                             t->rapid_change, count, t->flags);
+        iterations -= count;
+    }
+    bench_do_not_optimize(&alarms);
+    bench_do_not_optimize(t->flags);
+}
+
+/**
+ * @brief Prints one pre-generated reading per iteration.
+ */
+static void bench_print_data(void* context, uint64_t iterations) {
+    ReadingFixture* f = context;
+    for (uint64_t i = 0; i < iterations; i++) {
+        print_glucose_data(&f->readings[(f->cursor++) & (FIXTURE_SIZE - 1)]);
+    }
+}
+
+/**
+ * @brief Prints the running statistics once per iteration.
+ */
+static void bench_print_statistics(void* context, uint64_t iterations) {
+    ReadingFixture* f = context;
+    for (uint64_t i = 0; i < iterations; i++) {
+        print_glucose_statistics(&f->stats);
+    }
+}
+
+/**
+ * @brief Measures a stage probe while latency recording is disabled.
+ */
+static void bench_latency_disabled(void* context, uint64_t iterations) {
+    (void)context;
+    latency_set_enabled(false);
+    for (uint64_t i = 0; i < iterations; i++) {
+        LATENCY_BEGIN(start);
+        LATENCY_END(LATENCY_STAGE_ANALYZE, start);
+    }
+}
+
+/**
+ * @brief Measures a stage probe while latency recording is enabled.
+ */
+static void bench_latency_enabled(void* context, uint64_t iterations) {
+    (void)context;
+    latency_set_enabled(true);
+    for (uint64_t i = 0; i < iterations; i++) {
+        LATENCY_BEGIN(start);
+        LATENCY_END(LATENCY_STAGE_ANALYZE, start);
+    }
+    latency_set_enabled(false);
+}
+
+/**
+ * @brief Counts a reading and its alarms into this thread's metrics, as every processed reading does.
+ */
+static void bench_metrics_count(void* context, uint64_t iterations) {
+    (void)context;
+    for (uint64_t i = 0; i < iterations; i++) metrics_count_reading((unsigned int)(i & 15));
+}
+
+/**
+ * @brief Removes a registered patient and registers it again per iteration.
+ *
+ * The registry is pre-filled, so every iteration recycles a freed slot.
+ */
+static void bench_registry_churn(void* context, uint64_t iterations) {
+    PatientRegistry* r = context;
+    Config config = initialize_config();
+    for (uint64_t i = 0; i < iterations; i++) {
+        PatientHandle handle;
+        patient_registry_handle_at(r, (uint32_t)(i * 7919u) % patient_registry_count(r), &handle);
+        uint32_t patient_id = patient_registry_get(r, handle)->patient_id;
+        patient_registry_remove(r, handle);
+        patient_registry_add(r, patient_id, &config, &handle);
+    }
+}
+
+/**
+ * @brief Adds one reading to a patient and presents a dashboard frame per iteration.
+ *
+ * Only the changed rows differ from the previous frame, as at a steady
+ * reading rate; the UI must be open on the redirected stdout.
+ */
+static void bench_dashboard_frame(void* context, uint64_t iterations) {
+    DashboardFixture* d = context;
+    uint32_t patient_count = patient_registry_count(&d->registry);
+    for (uint64_t i = 0; i < iterations; i++) {
+        PatientState* patient = patient_registry_at(&d->registry, (uint32_t)(d->status.readings % patient_count));
+        generate_glucose_data(&patient->data);
+        update_glucose_statistics(&patient->stats, &patient->data, &patient->config);
+        evaluate_glucose_alarms(&patient->data, &patient->config, &patient->alarm_flags);
+        d->status.readings++;
+
+        terminal_ui_begin_frame(&d->ui);
+        terminal_ui_draw_fleet(&d->ui, &d->registry, &d->status);
+        terminal_ui_present(&d->ui);
+    }
+}
+
+/**
+ * @brief Ranks every slot of the 1M-patient fixture by the current low of a fixture reading.
+ *
+ * @return 0 on success, -1 on error (out of memory).
+ */
+static int build_risk_fixture(void) {
+    risk.count = RISK_PATIENTS;
+    risk.scores = malloc(sizeof(double) * RISK_PATIENTS);
+    if (risk.scores == NULL || risk_index_init(&risk.index) != 0) return -1;
+
+    for (uint32_t slot = 0; slot < RISK_PATIENTS; slot++) {
+        // Multiplying by an odd constant spreads the readings over the slots
+        risk.scores[slot] = -fixture.values[(slot * 2654435761u) & (FIXTURE_SIZE - 1)];
+        if (risk_index_update(&risk.index, slot, slot + 1, risk.scores[slot]) != 0) return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Gives one patient of the 1M-patient ranking a new reading per iteration.
+ */
+static void bench_risk_update(void* context, uint64_t iterations) {
+    RiskFixture* r = context;
+    for (uint64_t i = 0; i < iterations; i++) {
+        uint64_t step = r->cursor++;
+        uint32_t slot = (uint32_t)(step * 2654435761u) & (RISK_PATIENTS - 1);
+        r->scores[slot] = -fixture.values[step & (FIXTURE_SIZE - 1)];
+        risk_index_update(&r->index, slot, slot + 1, r->scores[slot]);
+    }
+}
+
+/**
+ * @brief Reads the RISK_TOP_K lowest current readings from the 1M-patient ranking.
+ */
+static void bench_risk_top(void* context, uint64_t iterations) {
+    RiskFixture* r = context;
+    RiskEntry top[RISK_TOP_K];
+    for (uint64_t i = 0; i < iterations; i++) {
+        risk_index_top(&r->index, RISK_TOP_K, top);
+        bench_do_not_optimize(top);
+    }
+}
+
+/**
+ * @brief Finds the RISK_TOP_K lowest current readings by scanning all 1M patients.
+ *
+ * The baseline the ranking replaces: a bounded insertion sort over the fleet per query.
+ */
+static void bench_risk_scan(void* context, uint64_t iterations) {
+    RiskFixture* r = context;
+    for (uint64_t i = 0; i < iterations; i++) {
+        double top[RISK_TOP_K];
+        uint32_t found = 0;
+        for (uint32_t slot = 0; slot < r->count; slot++) {
+            double score = r->scores[slot];
+            if (found == RISK_TOP_K && score <= top[RISK_TOP_K - 1]) continue;
+            uint32_t at = found < RISK_TOP_K ? found++ : RISK_TOP_K - 1;
+            while (at > 0 && top[at - 1] < score) {
+                top[at] = top[at - 1];
+                at--;
+            }
+            top[at] = score;
+        }
+        bench_do_not_optimize(top);
+    }
+}
+
+/**
+ * @brief Fills 30 days of readings for one patient and rolls them up.
+ */
+static void build_rollup_fixture(void) {
+    rollup.config = initialize_config();
+    rollup_cube_init(&rollup.queried, 0);
+    rollup_cube_init(&rollup.updated, 0);
+    for (int i = 0; i < ROLLUP_READINGS; i++) {
+        rollup.times[i] = ROLLUP_BASE_TIME + (time_t)i * ROLLUP_INTERVAL_S;
+        rollup.values[i] = fixture.fixed_values[i & (FIXTURE_SIZE - 1)];
+        rollup_cube_add(&rollup.queried, 0, 1, rollup.times[i], rollup.values[i], &rollup.config);
+    }
+}
+
+/**
+ * @brief Adds one reading per iteration, FIXTURE_SIZE patients in turn, 5 minutes apart per patient.
+ */
+static void bench_rollup_add(void* context, uint64_t iterations) {
+    RollupFixture* r = context;
+    for (uint64_t i = 0; i < iterations; i++) {
+        uint64_t step = r->cursor++;
+        uint32_t slot = (uint32_t)(step & (FIXTURE_SIZE - 1));
+        time_t t = ROLLUP_BASE_TIME + (time_t)(step / FIXTURE_SIZE) * ROLLUP_INTERVAL_S;
+        rollup_cube_add(&r->updated, slot, slot + 1, t, fixture.fixed_values[step & (FIXTURE_SIZE - 1)], &r->config);
+    }
+}
+
+/**
+ * @brief Computes time in range by hour of day over 30 days from the rollups.
+ */
+static void bench_rollup_hour_profile(void* context, uint64_t iterations) {
+    RollupFixture* r = context;
+    RollupBucket profile[ROLLUP_HOURS_PER_DAY];
+    for (uint64_t i = 0; i < iterations; i++) {
+        rollup_cube_hour_profile(&r->queried, 0, ROLLUP_BASE_TIME,
+                                 ROLLUP_BASE_TIME + (time_t)ROLLUP_READINGS * ROLLUP_INTERVAL_S, profile);
+        bench_do_not_optimize(profile);
+    }
+}
+
+/**
+ * @brief Computes the same profile by re-reading the 30 days of raw readings.
+ */
+static void bench_raw_hour_profile(void* context, uint64_t iterations) {
+    RollupFixture* r = context;
+    for (uint64_t i = 0; i < iterations; i++) {
+        uint32_t count[ROLLUP_HOURS_PER_DAY] = {0};
+        uint32_t in_range[ROLLUP_HOURS_PER_DAY] = {0};
+        int low = r->config.hypoglycemia_threshold * GLUCOSE_FIXED_SCALE;
+        int high = r->config.hyperglycemia_threshold * GLUCOSE_FIXED_SCALE;
+        for (int j = 0; j < ROLLUP_READINGS; j++) {
+            int hour = (int)((r->times[j] / 3600) % ROLLUP_HOURS_PER_DAY);
+            count[hour]++;
+            in_range[hour] += r->values[j] >= low && r->values[j] <= high;
+        }
+        bench_do_not_optimize(count);
+        bench_do_not_optimize(in_range);
+    }
+}
+
+/**
+ * @brief Prepares the smoothers, all started on the fixture's first readings.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int build_filter_fixture(void) {
+    smoothing.params = glucose_filter_default_params();
+    if (glucose_filter_bank_init(&smoothing.bank, FIXTURE_SIZE) != 0) return -1;
+    for (int i = 0; i < FIXTURE_SIZE; i++) {
+        glucose_filter_init(&smoothing.filters[i]);
+        smoothing.tick[i] = fixture.values[i];
+        if (i % 16 != 15) smoothing.tick_valid[i / 64] |= 1ull << (i % 64);
+        smoothing.times[i] = (double)ROLLUP_BASE_TIME;
+    }
+    return 0;
+}
+
+/**
+ * @brief Adds one reading per iteration to one patient's smoother, FIXTURE_SIZE patients in turn.
+ */
+static void bench_filter_update(void* context, uint64_t iterations) {
+    FilterFixture* f = context;
+    for (uint64_t i = 0; i < iterations; i++) {
+        uint64_t step = f->cursor++;
+        GlucoseFilter* filter = &f->filters[step & (FIXTURE_SIZE - 1)];
+        time_t t = ROLLUP_BASE_TIME + (time_t)(step / FIXTURE_SIZE + 1) * FILTER_INTERVAL_S;
+        glucose_filter_update(filter, &f->params, fixture.values[(step * 7) & (FIXTURE_SIZE - 1)], t);
+    }
+    bench_do_not_optimize(f->filters);
+}
+
+/**
+ * @brief Adds one tick of readings to the bank of FIXTURE_SIZE patients per iteration.
+ */
+static void bench_filter_bank_tick(void* context, uint64_t iterations) {
+    FilterFixture* f = context;
+    for (uint64_t i = 0; i < iterations; i++) {
+        for (int p = 0; p < FIXTURE_SIZE; p++) f->times[p] += FILTER_INTERVAL_S;
+        glucose_filter_bank_update(&f->bank, &f->params, f->tick, f->tick_valid, f->times);
+        bench_do_not_optimize(f->bank.level);
+    }
+}
+
+/**
+ * @brief Evaluates alarms with rapid changes taken from the filtered series.
+ */
+static void bench_filtered_alarms(void* context, uint64_t iterations) {
+    FilterFixture* f = context;
+    unsigned int flags = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        uint32_t index = (uint32_t)(f->cursor++ & (FIXTURE_SIZE - 1));
+        glucose_series_alarms(&fixture.readings[index], &f->filters[index], GLUCOSE_SERIES_FILTERED,
+                              &fixture.config, &flags);
+        bench_do_not_optimize(&flags);
+    }
+}
+
+/**
+ * @brief Prepares an empty resampler and each patient's reading jitter.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int build_resampler_fixture(void) {
+    ResamplerOptions options = resampler_default_options();
+    if (resampler_init(&resampling.resampler, &options) != 0) return -1;
+    for (int i = 0; i < FIXTURE_SIZE; i++) resampling.jitter[i] = (uint32_t)(i * 37) % 120;
+    return 0;
+}
+
+/**
+ * @brief Resamples one reading per iteration, FIXTURE_SIZE patients in turn, every 16th reading missing.
+ */
+static void bench_resampler_add(void* context, uint64_t iterations) {
+    ResamplerFixture* f = context;
+    long points = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        uint64_t step = f->cursor++;
+        uint32_t patient = (uint32_t)(step & (FIXTURE_SIZE - 1));
+        uint64_t reading = step / FIXTURE_SIZE;
+        reading += reading / 15; // Skips every 16th reading slot, leaving a 10-minute gap
+        time_t t = ROLLUP_BASE_TIME + (time_t)(reading * FILTER_INTERVAL_S) + f->jitter[(patient + reading) & (FIXTURE_SIZE - 1)];
+        points += resampler_add(&f->resampler, patient, patient + 1, t, fixture.values[(step * 7) & (FIXTURE_SIZE - 1)]);
+    }
+    bench_do_not_optimize(&points);
+}
+
+/**
+ * @brief Prints command-line usage.
+ *
+ * @param program Name of the executable.
+ */
+static void print_usage(const char* program) {
+    fprintf(stderr, "Usage: %s [--json FILE] [--samples N] [--warmup-ms N] "
+                    "[--min-sample-ms N] [--cpu N] [--filter TEXT] [--perf]\n", program);
+}
+
+/**
+ * @brief Runs the selected benchmarks and reports the results.
+ *
+ * @return Exit status: 0 on success, 1 on error.
+ */
+int main(int argc, char** argv) {
+    BenchOptions options = bench_default_options();
+    const char* json_path = NULL;
+    const char* filter = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+            options.samples = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--warmup-ms") == 0 && i + 1 < argc) {
+            options.warmup_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--min-sample-ms") == 0 && i + 1 < argc) {
+            options.min_sample_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--cpu") == 0 && i + 1 < argc) {
+            options.cpu = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "--perf") == 0) {
+            options.perf_counters = 1;
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (options.cpu >= 0 && bench_pin_to_cpu(options.cpu) != 0) {
+        fprintf(stderr, "Warning: Failed to pin to CPU %d, continuing unpinned...\n", options.cpu);
+        options.cpu = -1;
+    }
+
+    build_fixture();
+
+    Config registry_config = initialize_config();
+    patient_registry_init(&registry);
+    for (uint32_t id = 0; id < 4 * PATIENT_SLAB_CAPACITY; id++) {
+        PatientHandle handle;
+        patient_registry_add(&registry, id, &registry_config, &handle);
+    }
+
+    patient_registry_init(&dashboard.registry);
+    for (uint32_t id = 1; id <= DASHBOARD_PATIENTS; id++) {
+        PatientHandle handle;
+        patient_registry_add(&dashboard.registry, id, &registry_config, &handle);
+        PatientState* patient = patient_registry_get(&dashboard.registry, handle);
+        for (int reading = 0; reading < 30; reading++) {
+            generate_glucose_data(&patient->data);
+            update_glucose_statistics(&patient->stats, &patient->data, &patient->config);
+        }
+    }
+    dashboard.status = (TerminalStatus){"benchmark", 0, 0.0, 0, 0};
+
+    if (build_risk_fixture() != 0) {
+        fprintf(stderr, "Error: Failed to build the risk ranking fixture\n");
+        return 1;
+    }
+
+    build_rollup_fixture();
+
+    if (build_filter_fixture() != 0) {
+        fprintf(stderr, "Error: Failed to build the smoother fixture\n");
+        return 1;
+    }
+
+    if (build_resampler_fixture() != 0) {
+        fprintf(stderr, "Error: Failed to build the resampler fixture\n");
+        return 1;
+    }
+
+    GeneratedData generator_state = fixture.readings[FIXTURE_SIZE - 1];
+    const BenchCase cases[] = {
+        {"generate_glucose_data", bench_generate, &generator_state},
+        {"update_glucose_statistics", bench_update_statistics, &fixture},
+        {"glucose_accumulator_add", bench_accumulator_add, &fixture},
+        {"glucose_accumulator_add_array", bench_accumulator_add_array, &fixture},
+        {"glucose_accumulator_add_fixed", bench_accumulator_add_fixed, &fixture},
+        {"glucose_scan_alarms", bench_scan_alarms, &fixture},
+        {"glucose_scan_alarms_fixed", bench_scan_alarms_fixed, &fixture},
+        {"glucose_accumulator_add_masked", bench_accumulator_add_masked, &fixture},
+        {"glucose_scan_alarms_masked", bench_scan_alarms_masked, &fixture},
+        {"glucose_interpolate_gaps", bench_interpolate_gaps, &fixture},
+        {"calculate_glucose_trend", bench_trend, &fixture},
+        {"check_and_print_alarms", bench_alarms, &fixture},
+        {"alarm_thresholds_per_patient", bench_alarm_rows, &thresholds},
+        {"glucose_scan_alarm_columns", bench_alarm_columns, &thresholds},
+        {"glucose_filter_update", bench_filter_update, &smoothing},
+        {"glucose_filter_bank_tick_1k", bench_filter_bank_tick, &smoothing},
+        {"glucose_series_alarms_filtered", bench_filtered_alarms, &smoothing},
+        {"resampler_add", bench_resampler_add, &resampling},
+        {"print_glucose_data", bench_print_data, &fixture},
+        {"print_glucose_statistics", bench_print_statistics, &fixture},
+        {"terminal_ui_fleet_frame", bench_dashboard_frame, &dashboard},
+        {"risk_index_update_1m", bench_risk_update, &risk},
+        {"risk_index_top10_1m", bench_risk_top, &risk},
+        {"risk_fleet_scan_top10_1m", bench_risk_scan, &risk},
+        {"rollup_cube_add", bench_rollup_add, &rollup},
+        {"rollup_hour_profile_30d", bench_rollup_hour_profile, &rollup},
+        {"raw_hour_profile_30d", bench_raw_hour_profile, &rollup},
+        {"patient_registry_remove_add", bench_registry_churn, &registry},
+        {"latency_probe_disabled", bench_latency_disabled, NULL},
+        {"latency_probe_enabled", bench_latency_enabled, NULL},
+        {"metrics_count_reading", bench_metrics_count, NULL},
+    };
+    const size_t case_count = sizeof(cases) / sizeof(cases[0]);
+
+    // Route the print paths to /dev/null and keep the real stdout for the report
+    fflush(stdout);
+    int report_fd = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    if (report_fd < 0 || null_fd < 0 || dup2(null_fd, STDOUT_FILENO) < 0) {
+        fprintf(stderr, "Error: Failed to redirect stdout\n");
+        return 1;
+    }
+    close(null_fd);
+    FILE* report = fdopen(report_fd, "w");
+    if (report == NULL) return 1;
+    if (terminal_ui_open(&dashboard.ui, STDOUT_FILENO, TERMINAL_UI_MAX_FPS) != 0) {
+        fprintf(stderr, "Error: Failed to open the terminal UI\n");
+        return 1;
+    }
+
+    BenchResult results[sizeof(cases) / sizeof(cases[0])];
+    size_t result_count = 0;
+
+    for (size_t i = 0; i < case_count; i++) {
+        if (filter != NULL && strstr(cases[i].name, filter) == NULL) continue;
+
+        fprintf(stderr, "Running %s...\n", cases[i].name);
+        if (bench_run(&cases[i], &options, &results[result_count]) != 0) {
+            fprintf(stderr, "Error: Benchmark %s failed\n", cases[i].name);
+            return 1;
+        }
+        fflush(stdout);
+        result_count++;
+    }
+
+    bench_print_table(report, results, result_count);
+    fflush(report);
+
+    if (json_path != NULL) {
+        FILE* json = fopen(json_path, "w");
+        if (json == NULL || bench_write_json(json, results, result_count, &options) != 0) {
+            fprintf(stderr, "Error: Failed to write %s\n", json_path);
+            if (json != NULL) fclose(json);
+            return 1;
+        }
+        fclose(json);
+        fprintf(report, "Results written to %s\n", json_path);
+    }
+
+    fclose(report);
+    terminal_ui_close(&dashboard.ui);
+    risk_index_destroy(&risk.index);
+    free(risk.scores);
+    rollup_cube_destroy(&rollup.updated);
+    glucose_filter_bank_destroy(&smoothing.bank);
+    resampler_destroy(&resampling.resampler);
+    rollup_cube_destroy(&rollup.queried);
+    patient_registry_destroy(&dashboard.registry);
+    patient_registry_destroy(&registry);
+    return 0;
+}
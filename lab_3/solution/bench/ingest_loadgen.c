@@ -0,0 +1,261 @@
+/**
+ * @file ingest_loadgen.c
+ * @brief Local load generator for the ingest server.
+ *
+ * Usage: ingest_loadgen [--connections N] [--rounds R] [--batch B]
+ *                       [--ack-every K] [--socket PATH | --tcp PORT]
+ *
+ * Opens N connections, each acting as a device gateway for B patients.
+ * Every round, each connection sends one frame carrying the next reading
+ * of each of its patients. Every K-th round (and the last one) frames ask
+ * for an acknowledgement; ingest latency is the time from writing such a
+ * frame to receiving its ack, i.e. including the queueing behind the
+ * other connections of the same round. Start the controller first:
+ *
+ *     ./data_generator --ingest-unix /tmp/glucose_ingest.sock
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../include/ingest_server.h"
+#include "../include/latency.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define READING_INTERVAL_S 300 // Simulated time between a patient's readings
+
+// Structure to hold load generator settings
+typedef struct {
+    uint32_t connections;
+    uint32_t rounds;
+    uint32_t batch;     // Patients (records per frame) per connection
+    uint32_t ack_every; // Request an ack every K rounds
+    const char* socket_path;
+    uint16_t tcp_port;  // Connect over loopback TCP instead when non-zero
+} LoadGenOptions;
+
+/**
+ * @brief Parses command-line options.
+ *
+ * @return 0 on success, -1 on invalid arguments.
+ */
+static int parse_options(int argc, char* argv[], LoadGenOptions* options) {
+    options->connections = 10000;
+    options->rounds = 50;
+    options->batch = 8;
+    options->ack_every = 10;
+    options->socket_path = INGEST_DEFAULT_SOCKET;
+    options->tcp_port = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) return -1;
+        long value = strtol(argv[i + 1], NULL, 10);
+
+        if (strcmp(argv[i], "--connections") == 0 && value > 0) {
+            options->connections = (uint32_t)value;
+        } else if (strcmp(argv[i], "--rounds") == 0 && value > 0) {
+            options->rounds = (uint32_t)value;
+        } else if (strcmp(argv[i], "--batch") == 0 && value > 0 && value <= INGEST_MAX_BATCH) {
+            options->batch = (uint32_t)value;
+        } else if (strcmp(argv[i], "--ack-every") == 0 && value > 0) {
+            options->ack_every = (uint32_t)value;
+        } else if (strcmp(argv[i], "--socket") == 0) {
+            options->socket_path = argv[i + 1];
+        } else if (strcmp(argv[i], "--tcp") == 0 && value > 0 && value <= 65535) {
+            options->tcp_port = (uint16_t)value;
+        } else {
+            return -1;
+        }
+        i++;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Opens one blocking connection to the ingest server.
+ *
+ * @return Connected descriptor, or -1 on error.
+ */
+static int connect_server(const LoadGenOptions* options) {
+    int fd;
+
+    if (options->tcp_port != 0) {
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons(options->tcp_port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        if (connect(fd, (const struct sockaddr*)&address, sizeof(address)) != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(options->socket_path) >= sizeof(address.sun_path)) return -1;
+    strcpy(address.sun_path, options->socket_path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (const struct sockaddr*)&address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief Writes or reads exactly length bytes, retrying on partial transfers.
+ *
+ * @param writing Non-zero to write, zero to read.
+ * @return 0 on success, -1 on error or end of file.
+ */
+static int transfer_all(int fd, void* data, size_t length, int writing) {
+    uint8_t* cursor = data;
+
+    while (length > 0) {
+        ssize_t done = writing ? write(fd, cursor, length) : read(fd, cursor, length);
+        if (done < 0 && errno == EINTR) continue;
+        if (done <= 0) return -1;
+        cursor += done;
+        length -= (size_t)done;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Fills a frame with the next reading of each patient of a connection.
+ */
+static void fill_frame(uint8_t* frame, const LoadGenOptions* options, uint32_t connection,
+                       uint32_t round, int ack, int64_t base_time) {
+    IngestFrameHeader header;
+    memset(&header, 0, sizeof(header));
+    header.length = (uint32_t)(sizeof(IngestFrameHeader) + options->batch * sizeof(IngestRecord));
+    header.version = INGEST_FRAME_VERSION;
+    header.flags = ack ? INGEST_FLAG_ACK : 0;
+    header.count = (uint16_t)options->batch;
+    header.sequence = round;
+    memcpy(frame, &header, sizeof(header));
+
+    IngestRecord* records = (IngestRecord*)(frame + sizeof(header));
+    for (uint32_t i = 0; i < options->batch; i++) {
+        records[i].patient_id = connection * options->batch + i + 1;
+        records[i].glucose_value = 40.0f + (float)(rand() % 3600) / 10.0f;
+        records[i].timestamp = base_time + (int64_t)round * READING_INTERVAL_S;
+    }
+}
+
+/**
+ * @brief Main entry point for the ingest load generator.
+ */
+int main(int argc, char* argv[]) {
+    LoadGenOptions options;
+    if (parse_options(argc, argv, &options) != 0) {
+        printf("Usage: %s [--connections N] [--rounds R] [--batch B] [--ack-every K] "
+               "[--socket PATH | --tcp PORT]\n", argv[0]);
+        return 1;
+    }
+
+    // Each connection needs a descriptor here and one in the server
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    int* fds = malloc(options.connections * sizeof(int));
+    uint64_t* sent_ns = calloc(options.connections, sizeof(uint64_t));
+    size_t frame_size = sizeof(IngestFrameHeader) + options.batch * sizeof(IngestRecord);
+    uint8_t* frame = malloc(frame_size);
+    if (fds == NULL || sent_ns == NULL || frame == NULL) {
+        printf("Error: Out of memory\n");
+        return 1;
+    }
+
+    for (uint32_t c = 0; c < options.connections; c++) {
+        fds[c] = connect_server(&options);
+        if (fds[c] < 0) {
+            printf("Error: Connection %u failed: %s\n", c, strerror(errno));
+            return 1;
+        }
+    }
+    printf("Opened %u connections (%u patients)\n", options.connections,
+           options.connections * options.batch);
+
+    latency_set_enabled(true);
+    srand(42);
+    int64_t base_time = 1767225600; // 2026-01-01T00:00:00Z
+    uint64_t acks_missing = 0;
+    uint64_t rejected = 0;
+    uint64_t start = latency_now_ns();
+
+    for (uint32_t round = 0; round < options.rounds; round++) {
+        int ack = (round + 1) % options.ack_every == 0 || round + 1 == options.rounds;
+
+        for (uint32_t c = 0; c < options.connections; c++) {
+            fill_frame(frame, &options, c, round, ack, base_time);
+            if (ack) sent_ns[c] = latency_now_ns();
+            if (transfer_all(fds[c], frame, frame_size, 1) != 0) {
+                printf("Error: Write failed on connection %u\n", c);
+                return 1;
+            }
+        }
+
+        if (!ack) continue;
+
+        // Acks arrive in order per connection, so the ack read here is for this round
+        for (uint32_t c = 0; c < options.connections; c++) {
+            IngestAck reply;
+            if (transfer_all(fds[c], &reply, sizeof(reply), 0) != 0 || reply.sequence != round) {
+                acks_missing++;
+                continue;
+            }
+            latency_record(LATENCY_STAGE_READING, latency_now_ns() - sent_ns[c]);
+            rejected += options.batch - reply.accepted;
+        }
+    }
+
+    // The last round was acknowledged, so every reading has been processed
+    double seconds = (double)(latency_now_ns() - start) / 1e9;
+    uint64_t readings = (uint64_t)options.connections * options.rounds * options.batch;
+
+    LatencySummary summary;
+    latency_get_summary(LATENCY_STAGE_READING, &summary);
+
+    printf("Ingest load test: %u connections x %u rounds x %u readings per frame\n",
+           options.connections, options.rounds, options.batch);
+    printf("  Readings:        %llu in %.2f s (%.0f readings/s, %.0f frames/s)\n",
+           (unsigned long long)readings, seconds, readings / seconds,
+           (double)options.connections * options.rounds / seconds);
+    printf("  Ingest latency:  p50 %.3f ms, p99 %.3f ms, p99.9 %.3f ms, max %.3f ms (%llu acks)\n",
+           summary.p50_ns / 1e6, summary.p99_ns / 1e6, summary.p999_ns / 1e6,
+           summary.max_ns / 1e6, (unsigned long long)summary.count);
+    printf("  Rejected:        %llu readings, %llu acks missing\n",
+           (unsigned long long)rejected, (unsigned long long)acks_missing);
+
+    for (uint32_t c = 0; c < options.connections; c++) close(fds[c]);
+    free(fds);
+    free(sent_ns);
+    free(frame);
+
+    return acks_missing == 0 ? 0 : 1;
+}
@@ -0,0 +1,239 @@
+/**
+ * @file latest_state_bench.c
+ * @brief Reader and writer throughput of the latest-state table.
+ *
+ * Usage: latest_state_bench [--patients N] [--readers R] [--seconds S]
+ *
+ * One writer thread publishes the state of N patients round-robin, as the
+ * engine does after every reading, while R reader threads copy random
+ * patients' slots, as dashboards and the API do. Each configuration runs
+ * for S seconds, first without readers, then with R of them, for:
+ *
+ *   seqlock  latest_state_publish() / latest_state_read()
+ *   rwlock   the same slots behind 256 striped pthread read-write locks,
+ *            the locking design the table replaces
+ *
+ * Every published state is built from one counter so that readers can
+ * check each copy field by field; a torn copy is counted and fails the
+ * run.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../include/latency.h"
+#include "../include/latest_state.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_MAX_READERS 64
+#define BENCH_LOCK_STRIPES 256
+
+// Locking baseline: the same states, one read-write lock per stripe of patients
+typedef struct {
+    LatestState* states;
+    pthread_rwlock_t locks[BENCH_LOCK_STRIPES];
+} LockedTable;
+
+// State shared by the threads of one run
+typedef struct {
+    int locked;               // Non-zero for the rwlock baseline
+    uint32_t patients;
+    LatestStateTable* table;
+    LockedTable* locked_table;
+    int stop;                 // Set to end the run (atomic)
+} BenchRun;
+
+// Counters of one thread
+typedef struct {
+    BenchRun* run;
+    unsigned int seed;
+    uint64_t operations;
+    uint64_t retries;
+    uint64_t torn;
+    pthread_t thread;
+} BenchThread;
+
+/**
+ * @brief Fills a patient's state from a counter, so a reader can tell a torn copy.
+ */
+static void fill_patient(PatientState* patient, uint32_t patient_id, uint64_t n) {
+    patient->patient_id = patient_id;
+    patient->alarm_flags = (unsigned int)(n & 7);
+    patient->alarm_count = (uint32_t)n;
+    patient->data.reading_time = (time_t)n;
+    patient->data.glucose_value = (double)n;
+    patient->stats.time_in_range = (double)n;
+    patient->stats.time_below_range = (double)n + 1.0;
+    patient->stats.time_above_range = (double)n + 2.0;
+    patient->stats.avg_glucose = (double)n * 0.5;
+    patient->stats.glucose_variability = (double)n * 2.0;
+}
+
+/**
+ * @brief Returns non-zero if a copied state mixes two publications.
+ */
+static int is_torn(const LatestState* state) {
+    double n = (double)state->timestamp;
+    return state->glucose_value != n || state->alarm_count != (uint32_t)state->timestamp ||
+           state->alarm_flags != ((uint32_t)state->timestamp & 7) || state->stats.time_in_range != n ||
+           state->stats.time_below_range != n + 1.0 || state->stats.time_above_range != n + 2.0 ||
+           state->stats.avg_glucose != n * 0.5 || state->stats.glucose_variability != n * 2.0;
+}
+
+/**
+ * @brief Publishes every patient round-robin until stopped.
+ */
+static void* writer_main(void* argument) {
+    BenchThread* self = argument;
+    BenchRun* run = self->run;
+    PatientState patient;
+    memset(&patient, 0, sizeof(patient));
+    uint64_t n = 1;
+
+    while (!__atomic_load_n(&run->stop, __ATOMIC_RELAXED)) {
+        for (uint32_t slot = 0; slot < run->patients; slot++, n++) {
+            fill_patient(&patient, slot + 1, n);
+            if (!run->locked) {
+                latest_state_publish(run->table, slot, &patient);
+                continue;
+            }
+            LatestState state = {patient.patient_id, patient.alarm_flags, (int64_t)patient.data.reading_time,
+                                 patient.data.glucose_value, (int32_t)calculate_glucose_trend(&patient.data),
+                                 patient.alarm_count, patient.stats};
+            pthread_rwlock_t* lock = &run->locked_table->locks[slot % BENCH_LOCK_STRIPES];
+            pthread_rwlock_wrlock(lock);
+            run->locked_table->states[slot] = state;
+            pthread_rwlock_unlock(lock);
+        }
+        self->operations += run->patients;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Copies random patients' states until stopped, checking each copy.
+ */
+static void* reader_main(void* argument) {
+    BenchThread* self = argument;
+    BenchRun* run = self->run;
+    LatestState state;
+
+    while (!__atomic_load_n(&run->stop, __ATOMIC_RELAXED)) {
+        for (int i = 0; i < 256; i++) {
+            uint32_t slot = (uint32_t)rand_r(&self->seed) % run->patients;
+            if (!run->locked) {
+                uint32_t retries;
+                if (latest_state_read(run->table, slot, &state, &retries) != 0) continue;
+                self->retries += retries;
+            } else {
+                pthread_rwlock_t* lock = &run->locked_table->locks[slot % BENCH_LOCK_STRIPES];
+                pthread_rwlock_rdlock(lock);
+                state = run->locked_table->states[slot];
+                pthread_rwlock_unlock(lock);
+            }
+            self->torn += is_torn(&state);
+            self->operations++;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Runs one writer and some readers for a while and prints their throughput.
+ *
+ * @return 0 on success, -1 on error or torn reads.
+ */
+static int run_threads(BenchRun* run, int readers, double seconds) {
+    static BenchThread threads[BENCH_MAX_READERS + 1];
+    memset(threads, 0, sizeof(threads));
+    __atomic_store_n(&run->stop, 0, __ATOMIC_RELAXED);
+
+    int started = 0;
+    for (int i = 0; i <= readers; i++) {
+        threads[i].run = run;
+        threads[i].seed = 12345u + (unsigned int)i;
+        if (pthread_create(&threads[i].thread, NULL, i == 0 ? writer_main : reader_main, &threads[i]) != 0) break;
+        started++;
+    }
+
+    uint64_t start = latency_now_ns();
+    struct timespec duration = {(time_t)seconds, (long)((seconds - (time_t)seconds) * 1e9)};
+    if (started == readers + 1) nanosleep(&duration, NULL);
+    __atomic_store_n(&run->stop, 1, __ATOMIC_RELAXED);
+    for (int i = 0; i < started; i++) pthread_join(threads[i].thread, NULL);
+    double elapsed = (latency_now_ns() - start) / 1e9;
+    if (started != readers + 1) return -1;
+
+    uint64_t reads = 0, retries = 0, torn = 0;
+    for (int i = 1; i <= readers; i++) {
+        reads += threads[i].operations;
+        retries += threads[i].retries;
+        torn += threads[i].torn;
+    }
+    printf("  %-8s %7d %18.0f %18.0f %14.5f %6llu\n", run->locked ? "rwlock" : "seqlock", readers,
+           threads[0].operations / elapsed, reads / elapsed, reads > 0 ? (double)retries / reads : 0.0,
+           (unsigned long long)torn);
+    return torn == 0 ? 0 : -1;
+}
+
+/**
+ * @brief Main function.
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv Array of command-line arguments.
+ * @return 0 on success, 1 on error.
+ */
+int main(int argc, char* argv[]) {
+    uint32_t patients = 100000;
+    int readers = 8;
+    double seconds = 2.0;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) patients = 0;
+        else if (strcmp(argv[i], "--patients") == 0) patients = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--readers") == 0) readers = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seconds") == 0) seconds = atof(argv[++i]);
+        else patients = 0;
+        if (patients == 0) break;
+    }
+    if (patients == 0 || patients > (uint32_t)LATEST_STATE_PAGE_SLOTS * LATEST_STATE_MAX_PAGES ||
+        readers < 1 || readers > BENCH_MAX_READERS || !(seconds > 0.0)) {
+        printf("Usage: %s [--patients N] [--readers R] [--seconds S]\n", argv[0]);
+        return 1;
+    }
+
+    static LatestStateTable table;
+    static LockedTable locked_table;
+    latest_state_init(&table);
+    locked_table.states = calloc(patients, sizeof(LatestState));
+    if (locked_table.states == NULL) return 1;
+    for (int i = 0; i < BENCH_LOCK_STRIPES; i++) pthread_rwlock_init(&locked_table.locks[i], NULL);
+
+    // Publish every patient once so readers never find an empty slot
+    PatientState patient;
+    memset(&patient, 0, sizeof(patient));
+    for (uint32_t slot = 0; slot < patients; slot++) {
+        fill_patient(&patient, slot + 1, 0);
+        if (latest_state_publish(&table, slot, &patient) != 0) return 1;
+        latest_state_read(&table, slot, &locked_table.states[slot], NULL);
+    }
+
+    printf("Latest-state table: %u patients, 1 writer, %.1f s per run\n", patients, seconds);
+    printf("  %-8s %7s %18s %18s %14s %6s\n", "mode", "readers", "writer updates/s", "reader copies/s",
+           "retries/copy", "torn");
+
+    int result = 0;
+    for (int locked = 0; locked < 2 && result == 0; locked++) {
+        BenchRun run = {locked, patients, &table, &locked_table, 0};
+        if (run_threads(&run, 0, seconds) != 0 || run_threads(&run, readers, seconds) != 0) result = -1;
+    }
+
+    for (int i = 0; i < BENCH_LOCK_STRIPES; i++) pthread_rwlock_destroy(&locked_table.locks[i]);
+    free(locked_table.states);
+    latest_state_destroy(&table);
+    if (result != 0) printf("Error: A reader saw a torn state\n");
+    return result == 0 ? 0 : 1;
+}
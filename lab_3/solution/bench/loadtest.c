@@ -0,0 +1,710 @@
+/**
+ * @file loadtest.c
+ * @brief Fleet-scale load test: N patients x M days at a fixed reading cadence.
+ *
+ * Usage: fleet_loadtest [--patients N] [--days M] [--cadence-min C] [--seed S]
+ *                       [--budget-ms B] [--summary FILE] [--wal DIR]
+ *                       [--checkpoint-ticks K] [--config FILE] [--reload-ms R]
+ *
+ * Simulated time advances one cadence step per tick and the loop runs as
+ * fast as possible. Every tick, all patients' readings arrive together and
+ * are pushed through generation, analysis and alarm evaluation stage by
+ * stage. Alarm latency is the time from the start of a tick to the alarm
+ * decision for each reading, i.e. including the queueing behind the other
+ * patients of the same tick. Console output is not part of the measurement.
+ *
+ * With --wal, every reading is also logged to a write-ahead log in DIR
+ * (one group commit per tick, a checkpoint every K ticks) as a fourth
+ * stage. After the run the state is recovered from DIR into a second
+ * registry, timed and compared with the live state. Recovery runs twice:
+ * eagerly, and lazily with the checkpoint dropped from the page cache,
+ * where the time to the first alarm decision for a single patient is
+ * measured separately from the background load of everyone else.
+ *
+ * Thresholds are read per patient from a published configuration table
+ * (FILE, or the built-in defaults). With --reload-ms, a second thread
+ * republishes the table every R ms while the simulation runs, and ticks
+ * that overlap a swap are timed separately from the others.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../include/alarm.h"
+#include "../include/analysis.h"
+#include "../include/config.h"
+#include "../include/config_store.h"
+#include "../include/data_generator.h"
+#include "../include/latency.h"
+#include "../include/patient_registry.h"
+#include "../include/state_store.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+// Structure to hold load test settings
+typedef struct {
+    long patients;
+    int days;
+    int cadence_min;
+    unsigned int seed;
+    int budget_ms; // Alarm latency budget used for the capacity estimate
+    const char* summary_path;
+    const char* wal_dir;  // State directory for the persistence stage, or NULL
+    int checkpoint_ticks; // Ticks between checkpoints
+    const char* config_path; // Threshold file, or NULL for the built-in defaults
+    int reload_ms;           // Milliseconds between table swaps during the run, 0 = none
+} LoadTestOptions;
+
+// Structure to hold load test measurements
+typedef struct {
+    uint64_t readings;
+    uint64_t alarms;
+    double wall_seconds;
+    double cpu_seconds;
+    double stage_seconds[4]; // generate, analyze, alarm, persist
+    long peak_rss_kb;
+    long state_rss_kb;
+    size_t registry_bytes;
+    double add_mean_ns;
+    uint64_t add_max_ns;
+    double churn_mean_ns;
+    uint64_t churn_max_ns;
+    LatencySummary alarm_latency;
+    StateStoreStats wal;    // Persistence counters (with --wal)
+    RecoveryStats recovery; // Recovery from the state directory (with --wal)
+    int recovered_match;    // Non-zero if the recovered state equals the live state
+    RecoveryStats lazy_recovery; // Lazy recovery from the state directory (with --wal)
+    double first_alarm_seconds;  // Lazy open to the first alarm decision
+    double lazy_load_seconds;    // Lazy open until every patient is loaded
+    int lazy_match;              // Non-zero if the lazily recovered state equals the live state
+    ConfigStoreStats config;     // Table swaps during the run (with --reload-ms)
+    uint64_t reload_ticks;       // Ticks during which a table was swapped
+    double reload_tick_ms;       // Mean duration of those ticks
+    double steady_tick_ms;       // Mean duration of the other ticks
+    double max_reload_tick_ms;
+    double max_steady_tick_ms;
+    double table_build_ms;       // Mean time the reload thread spent building a table
+} LoadTestResult;
+
+// Structure to hold the state of the thread that republishes the thresholds
+typedef struct {
+    ConfigStore* store;
+    const char* path; // File to reload, or NULL to republish the defaults
+    Config defaults;
+    int interval_ms;
+    int stop;         // Set to ask the thread to exit (atomic)
+    uint64_t builds;
+    uint64_t build_ns; // Time spent loading tables, competing with the simulation for CPU
+} ConfigReloader;
+
+// Registry shared by the load test phases (too large for the stack)
+static PatientRegistry registry;
+
+// Registry the state directory is recovered into (with --wal)
+static PatientRegistry recovered;
+
+/**
+ * @brief Removes and re-adds patients to measure slot reuse under churn.
+ *
+ * Every iteration removes the patient at a pseudo-random dense position
+ * and registers a new patient in its place, so the registry size stays
+ * constant while slots are recycled.
+ *
+ * @param config Pointer to the thresholds for new patients.
+ * @param iterations Number of remove/add pairs.
+ * @param result Pointer to the LoadTestResult structure to update.
+ * @return 0 on success, -1 on error.
+ */
+static int run_churn(const Config* config, uint32_t iterations, LoadTestResult* result) {
+    uint64_t total_ns = 0;
+    uint32_t next_id = patient_registry_count(&registry) + 1;
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        uint32_t count = patient_registry_count(&registry);
+
+        PatientHandle handle;
+        if (patient_registry_handle_at(&registry, (uint32_t)rand() % count, &handle) != 0) return -1;
+
+        uint64_t start = latency_now_ns();
+        if (patient_registry_remove(&registry, handle) != 0) return -1;
+        if (patient_registry_add(&registry, next_id++, config, &handle) != 0) return -1;
+        uint64_t elapsed = latency_now_ns() - start;
+
+        total_ns += elapsed;
+        if (elapsed > result->churn_max_ns) result->churn_max_ns = elapsed;
+    }
+
+    result->churn_mean_ns = iterations > 0 ? (double)total_ns / iterations : 0.0;
+    return 0;
+}
+
+/**
+ * @brief Reads the current resident set size from /proc.
+ *
+ * @return Resident set size in KiB, or -1 if unavailable.
+ */
+static long current_rss_kb(void) {
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (statm == NULL) return -1;
+
+    long pages_total = 0;
+    long pages_resident = 0;
+    int fields = fscanf(statm, "%ld %ld", &pages_total, &pages_resident);
+    fclose(statm);
+    if (fields != 2) return -1;
+
+    return pages_resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/**
+ * @brief Returns the CPU time consumed by the process so far.
+ *
+ * @return User plus system time in seconds.
+ */
+static double process_cpu_seconds(void) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0.0;
+    return (double)usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+           (double)usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+/**
+ * @brief Checks that every live patient was recovered with identical state.
+ *
+ * @return Non-zero if the registries hold the same patients and state.
+ */
+static int recovered_state_matches(void) {
+    uint32_t count = patient_registry_count(&registry);
+    if (patient_registry_count(&recovered) != count) return 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        const PatientState* live = patient_registry_at(&registry, i);
+        const PatientState* copy = patient_registry_find(&recovered, live->patient_id, NULL);
+        if (copy == NULL || copy->data.reading_time != live->data.reading_time ||
+            copy->data.glucose_value != live->data.glucose_value ||
+            memcmp(copy->data.glucose_history, live->data.glucose_history, sizeof(live->data.glucose_history)) != 0 ||
+            copy->data.history_valid != live->data.history_valid ||
+            memcmp(&copy->stats, &live->stats, sizeof(live->stats)) != 0 ||
+            copy->alarm_flags != live->alarm_flags || copy->alarm_count != live->alarm_count) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Recovers the state directory into a fresh registry and compares it.
+ *
+ * @param options Pointer to the load test settings.
+ * @param config Pointer to the default thresholds.
+ * @param result Pointer to the LoadTestResult structure to update.
+ * @return 0 on success, -1 on error.
+ */
+static int run_recovery(const LoadTestOptions* options, const Config* config, LoadTestResult* result) {
+    patient_registry_destroy(&recovered);
+    if (patient_registry_init(&recovered) != 0) return -1;
+
+    StateStore store;
+    if (state_store_open(&store, options->wal_dir, &recovered, config, 0, 0, &result->recovery) != 0) return -1;
+    result->recovered_match = recovered_state_matches();
+
+    return state_store_close(&store);
+}
+
+/**
+ * @brief Evicts a file from the page cache so the next read comes from disk.
+ *
+ * Only clean pages can be evicted; the checkpoint is synced before it is
+ * renamed into place, so all of it qualifies.
+ */
+static void drop_cached_file(const char* directory, const char* name) {
+    char path[STATE_STORE_PATH_MAX + 32];
+    snprintf(path, sizeof(path), "%s/%s", directory, name);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+/**
+ * @brief Records a reading for a patient and evaluates its alarms.
+ */
+static void process_reading(PatientState* patient, double glucose_value, time_t timestamp) {
+    record_glucose_reading(&patient->data, glucose_value, timestamp);
+    update_glucose_statistics(&patient->stats, &patient->data, &patient->config);
+    evaluate_glucose_alarms(&patient->data, &patient->config, &patient->alarm_flags);
+    if (patient->alarm_flags != ALARM_NONE) patient->alarm_count++;
+}
+
+/**
+ * @brief Recovers the state directory lazily and times the first alarm.
+ *
+ * With the checkpoint out of the page cache, the store is opened lazily
+ * and one reading is processed for a patient in the middle of the
+ * registry, as the first device to reconnect after a restart would. The
+ * same reading is applied to the live registry, then the remaining
+ * patients are loaded and the two registries compared.
+ *
+ * @param options Pointer to the load test settings.
+ * @param config Pointer to the default thresholds.
+ * @param result Pointer to the LoadTestResult structure to update.
+ * @return 0 on success, -1 on error.
+ */
+static int run_lazy_recovery(const LoadTestOptions* options, const Config* config, LoadTestResult* result) {
+    patient_registry_destroy(&recovered);
+    if (patient_registry_init(&recovered) != 0) return -1;
+    drop_cached_file(options->wal_dir, STATE_STORE_CHECKPOINT_FILE);
+
+    PatientState* live = patient_registry_at(&registry, patient_registry_count(&registry) / 2);
+    double glucose_value = 50.0; // Hypoglycemic, so the decision is an alarm
+    time_t timestamp = (time_t)live->data.reading_time + options->cadence_min * 60;
+
+    uint64_t start = latency_now_ns();
+    StateStore store;
+    if (state_store_open(&store, options->wal_dir, &recovered, config, 0, 1, &result->lazy_recovery) != 0) {
+        return -1;
+    }
+    PatientState* probe = state_store_find_patient(&store, &recovered, live->patient_id, NULL);
+    if (probe != NULL) process_reading(probe, glucose_value, timestamp);
+    result->first_alarm_seconds = (double)(latency_now_ns() - start) / 1e9;
+
+    while (state_store_prefetch(&store, &recovered, 4096) > 0) {
+        // The background thread pages histories in; yield while it catches up
+        sched_yield();
+    }
+    result->lazy_load_seconds = (double)(latency_now_ns() - start) / 1e9;
+
+    process_reading(live, glucose_value, timestamp);
+    result->lazy_match = probe != NULL && recovered_state_matches();
+
+    return state_store_close(&store);
+}
+
+/**
+ * @brief Builds a fresh threshold table from the file or the defaults.
+ *
+ * @return New table, or NULL on error.
+ */
+static ConfigTable* load_thresholds(const char* path, const Config* defaults) {
+    if (path == NULL) return config_table_create(defaults);
+
+    ConfigTable* table;
+    int error_line;
+    if (config_table_load(path, &table, &error_line) != 0) {
+        fprintf(stderr, "Error: Failed to load %s (line %d)\n", path, error_line);
+        return NULL;
+    }
+    return table;
+}
+
+/**
+ * @brief Republishes the threshold table at a fixed interval.
+ *
+ * @param argument Pointer to the ConfigReloader.
+ * @return NULL.
+ */
+static void* reload_thresholds(void* argument) {
+    ConfigReloader* reloader = argument;
+    struct timespec interval = {reloader->interval_ms / 1000, (long)(reloader->interval_ms % 1000) * 1000000L};
+
+    while (!__atomic_load_n(&reloader->stop, __ATOMIC_RELAXED)) {
+        nanosleep(&interval, NULL);
+        uint64_t start = latency_now_ns();
+        ConfigTable* table = load_thresholds(reloader->path, &reloader->defaults);
+        reloader->build_ns += latency_now_ns() - start;
+        reloader->builds++;
+        if (table != NULL && config_store_publish(reloader->store, table) != 0) config_table_free(table);
+        config_store_reclaim(reloader->store);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Runs the simulation and collects measurements.
+ *
+ * @param options Pointer to the load test settings.
+ * @param result Pointer to the LoadTestResult structure to fill.
+ * @return 0 on success, -1 on error.
+ */
+static int run_load_test(const LoadTestOptions* options, LoadTestResult* result) {
+    if (options == NULL || result == NULL || options->patients <= 0 ||
+        options->days <= 0 || options->cadence_min <= 0 || options->budget_ms <= 0 ||
+        options->checkpoint_ticks <= 0 || options->reload_ms < 0) return -1;
+
+    memset(result, 0, sizeof(*result));
+    Config config = initialize_config();
+    srand(options->seed);
+
+    // Thresholds are looked up per patient every tick, as the controller does
+    static ConfigStore thresholds;
+    ConfigTable* table = load_thresholds(options->config_path, &config);
+    if (table == NULL) return -1;
+    config = table->defaults;
+    if (config_store_init(&thresholds, table) != 0) {
+        config_table_free(table);
+        return -1;
+    }
+    int reader = config_store_register_reader(&thresholds);
+
+    if (options->patients > (long)PATIENT_SLAB_CAPACITY * PATIENT_REGISTRY_MAX_SLABS ||
+        patient_registry_init(&registry) != 0) {
+        config_store_destroy(&thresholds);
+        return -1;
+    }
+
+    long rss_before = current_rss_kb();
+    uint64_t add_total_ns = 0;
+    for (long p = 0; p < options->patients; p++) {
+        PatientHandle handle;
+        uint64_t start = latency_now_ns();
+        int status = patient_registry_add(&registry, (uint32_t)p + 1, &config, &handle);
+        uint64_t elapsed = latency_now_ns() - start;
+        if (status != 0) {
+            patient_registry_destroy(&registry);
+            config_store_destroy(&thresholds);
+            return -1;
+        }
+        add_total_ns += elapsed;
+        if (elapsed > result->add_max_ns) result->add_max_ns = elapsed;
+    }
+    long rss_after = current_rss_kb();
+    result->state_rss_kb = (rss_before >= 0 && rss_after >= 0) ? rss_after - rss_before : -1;
+    result->add_mean_ns = (double)add_total_ns / options->patients;
+    result->registry_bytes = patient_registry_memory_bytes(&registry);
+
+    if (run_churn(&config, 100000, result) != 0) {
+        patient_registry_destroy(&registry);
+        config_store_destroy(&thresholds);
+        return -1;
+    }
+
+    // The store must start empty; it is opened on the spare registry to check that
+    static StateStore store;
+    StateStore* persist = NULL;
+    if (options->wal_dir != NULL) {
+        if (patient_registry_init(&recovered) != 0 ||
+            state_store_open(&store, options->wal_dir, &recovered, &config, 0, 0, NULL) != 0) {
+            patient_registry_destroy(&registry);
+            config_store_destroy(&thresholds);
+            return -1;
+        }
+        persist = &store;
+        if (patient_registry_count(&recovered) != 0 || state_store_checkpoint(persist, &registry) != 0) {
+            fprintf(stderr, "Error: %s must be an empty or new directory\n", options->wal_dir);
+            state_store_close(persist);
+            patient_registry_destroy(&recovered);
+            patient_registry_destroy(&registry);
+            config_store_destroy(&thresholds);
+            return -1;
+        }
+    }
+
+    ConfigReloader reloader = {&thresholds, options->config_path, config, options->reload_ms, 0, 0, 0};
+    pthread_t reload_thread;
+    int reloading = options->reload_ms > 0 &&
+                    pthread_create(&reload_thread, NULL, reload_thresholds, &reloader) == 0;
+    if (options->reload_ms > 0 && !reloading) fprintf(stderr, "Warning: Failed to start the reload thread\n");
+    uint64_t steady_ticks = 0;
+    uint64_t reload_tick_ns = 0;
+    uint64_t steady_tick_ns = 0;
+
+    latency_reset();
+
+    long ticks = (long)options->days * 24 * 60 / options->cadence_min;
+    time_t sim_time = 1700000000; // Fixed start so runs are comparable
+    double cpu_start = process_cpu_seconds();
+    uint64_t wall_start = latency_now_ns();
+    uint64_t stage_ns[4] = {0, 0, 0, 0};
+
+    for (long tick = 0; tick < ticks; tick++) {
+        uint64_t tick_start = latency_now_ns();
+        uint64_t published = __atomic_load_n(&thresholds.stats.published, __ATOMIC_RELAXED);
+        const ConfigTable* current = config_store_read(&thresholds);
+
+        for (uint32_t p = 0; p < (uint32_t)options->patients; p++) {
+            generate_glucose_data_at(&patient_registry_at(&registry, p)->data, sim_time);
+        }
+        uint64_t generated = latency_now_ns();
+
+        for (uint32_t p = 0; p < (uint32_t)options->patients; p++) {
+            PatientState* patient = patient_registry_at(&registry, p);
+            config_table_get(current, patient->patient_id, &patient->config);
+            update_glucose_statistics(&patient->stats, &patient->data, &patient->config);
+        }
+        uint64_t analyzed = latency_now_ns();
+
+        for (uint32_t p = 0; p < (uint32_t)options->patients; p++) {
+            PatientState* patient = patient_registry_at(&registry, p);
+            evaluate_glucose_alarms(&patient->data, &patient->config, &patient->alarm_flags);
+            if (patient->alarm_flags != ALARM_NONE) {
+                patient->alarm_count++;
+                result->alarms++;
+            }
+            latency_record(LATENCY_STAGE_READING, latency_now_ns() - tick_start);
+        }
+        uint64_t alarmed = latency_now_ns();
+
+        if (persist != NULL) {
+            for (uint32_t p = 0; p < (uint32_t)options->patients; p++) {
+                const PatientState* patient = patient_registry_at(&registry, p);
+                state_store_log_reading(persist, patient->patient_id, patient->data.glucose_value,
+                                        patient->data.reading_time);
+            }
+            int status = state_store_commit(persist);
+            if (status == 0 && (tick + 1) % options->checkpoint_ticks == 0) {
+                status = state_store_checkpoint(persist, &registry);
+            }
+            if (status != 0) {
+                fprintf(stderr, "Error: Failed to persist tick %ld\n", tick);
+                if (reloading) {
+                    __atomic_store_n(&reloader.stop, 1, __ATOMIC_RELAXED);
+                    pthread_join(reload_thread, NULL);
+                }
+                state_store_close(persist);
+                patient_registry_destroy(&recovered);
+                patient_registry_destroy(&registry);
+                config_store_destroy(&thresholds);
+                return -1;
+            }
+        }
+        uint64_t persisted = latency_now_ns();
+
+        stage_ns[0] += generated - tick_start;
+        stage_ns[1] += analyzed - generated;
+        stage_ns[2] += alarmed - analyzed;
+        stage_ns[3] += persisted - alarmed;
+        sim_time += options->cadence_min * 60;
+
+        config_store_quiescent(&thresholds, reader); // current is not used past this point
+        uint64_t tick_ns = persisted - tick_start;
+        if (__atomic_load_n(&thresholds.stats.published, __ATOMIC_RELAXED) != published) {
+            result->reload_ticks++;
+            reload_tick_ns += tick_ns;
+            if (tick_ns / 1e6 > result->max_reload_tick_ms) result->max_reload_tick_ms = tick_ns / 1e6;
+        } else {
+            steady_ticks++;
+            steady_tick_ns += tick_ns;
+            if (tick_ns / 1e6 > result->max_steady_tick_ms) result->max_steady_tick_ms = tick_ns / 1e6;
+        }
+    }
+
+    result->wall_seconds = (double)(latency_now_ns() - wall_start) / 1e9;
+    result->cpu_seconds = process_cpu_seconds() - cpu_start;
+    result->readings = (uint64_t)ticks * (uint64_t)options->patients;
+    for (int s = 0; s < 4; s++) result->stage_seconds[s] = (double)stage_ns[s] / 1e9;
+    if (result->reload_ticks > 0) result->reload_tick_ms = (double)reload_tick_ns / 1e6 / result->reload_ticks;
+    if (steady_ticks > 0) result->steady_tick_ms = (double)steady_tick_ns / 1e6 / steady_ticks;
+
+    if (reloading) {
+        __atomic_store_n(&reloader.stop, 1, __ATOMIC_RELAXED);
+        pthread_join(reload_thread, NULL);
+        if (reloader.builds > 0) result->table_build_ms = (double)reloader.build_ns / 1e6 / reloader.builds;
+    }
+    config_store_unregister_reader(&thresholds, reader);
+    config_store_reclaim(&thresholds);
+    result->config = thresholds.stats;
+    config_store_destroy(&thresholds);
+    latency_get_summary(LATENCY_STAGE_READING, &result->alarm_latency);
+
+    struct rusage usage;
+    result->peak_rss_kb = (getrusage(RUSAGE_SELF, &usage) == 0) ? usage.ru_maxrss : -1;
+
+    // Keep the final state observable so the work cannot be elided
+    volatile double sink = 0.0;
+    for (uint32_t p = 0; p < (uint32_t)options->patients; p++) {
+        sink += patient_registry_at(&registry, p)->stats.avg_glucose;
+    }
+    (void)sink;
+
+    // The log since the last checkpoint is left for recovery to replay
+    int status = 0;
+    if (persist != NULL) {
+        if (state_store_close(persist) != 0) status = -1;
+        result->wal = persist->stats;
+        if (status == 0 && run_recovery(options, &config, result) != 0) status = -1;
+        if (status == 0 && run_lazy_recovery(options, &config, result) != 0) status = -1;
+        patient_registry_destroy(&recovered);
+    }
+
+    patient_registry_destroy(&registry);
+    return status;
+}
+
+/**
+ * @brief Prints the load test results to the terminal.
+ *
+ * @param options Pointer to the load test settings.
+ * @param result Pointer to the measurements.
+ */
+static void print_load_test_report(const LoadTestOptions* options, const LoadTestResult* result) {
+    static const char* const stage_names[4] = {"generate", "analyze", "alarm", "persist"};
+    double wall = result->wall_seconds > 0.0 ? result->wall_seconds : 1e-9;
+
+    printf("\n--- Load Test Results ---\n");
+    printf("Patients: %ld, Days: %d, Cadence: %d min\n",
+           options->patients, options->days, options->cadence_min);
+    printf("Readings: %llu (%llu with alarms)\n",
+           (unsigned long long)result->readings, (unsigned long long)result->alarms);
+    printf("Wall time: %.3f s, CPU time: %.3f s (%.1f%% utilization)\n",
+           result->wall_seconds, result->cpu_seconds, result->cpu_seconds / wall * 100.0);
+    printf("Sustained throughput: %.0f readings/sec\n", (double)result->readings / wall);
+    // A tick must finish within the budget, and the throughput must keep up with the cadence
+    double budget_capacity = (double)result->readings / wall * options->budget_ms / 1000.0;
+    double throughput_capacity = (double)result->readings / wall * options->cadence_min * 60.0;
+    printf("Capacity (single core): %.0f patients within a %d ms alarm budget, "
+           "%.0f patients by throughput at %d-minute cadence\n",
+           budget_capacity, options->budget_ms, throughput_capacity, options->cadence_min);
+    printf("Peak RSS: %ld KiB\n", result->peak_rss_kb);
+    printf("Per-patient memory: %zu bytes (state), %.1f bytes (registry incl. slack), "
+           "%.1f bytes (measured RSS)\n",
+           sizeof(PatientState), (double)result->registry_bytes / options->patients,
+           result->state_rss_kb >= 0 ? result->state_rss_kb * 1024.0 / options->patients : -1.0);
+    printf("Registry add: mean %.1f ns, max %llu ns; churn (remove + add): mean %.1f ns, max %llu ns\n",
+           result->add_mean_ns, (unsigned long long)result->add_max_ns,
+           result->churn_mean_ns, (unsigned long long)result->churn_max_ns);
+
+    printf("Stage time share:\n");
+    for (int s = 0; s < (options->wal_dir != NULL ? 4 : 3); s++) {
+        printf("  %-10s %8.3f s  %5.1f%%\n", stage_names[s], result->stage_seconds[s],
+               result->stage_seconds[s] / wall * 100.0);
+    }
+
+    printf("Alarm latency (tick start to decision): p50 %.3f ms, p99 %.3f ms, p99.9 %.3f ms, max %.3f ms\n",
+           result->alarm_latency.p50_ns / 1e6, result->alarm_latency.p99_ns / 1e6,
+           result->alarm_latency.p999_ns / 1e6, result->alarm_latency.max_ns / 1e6);
+
+    if (options->reload_ms > 0) {
+        printf("Configuration reloads: %llu tables published, %llu reclaimed; ticks with a swap: %llu, "
+               "mean %.3f ms (max %.3f ms) vs %.3f ms (max %.3f ms) without; %.3f ms to build a table\n",
+               (unsigned long long)result->config.published, (unsigned long long)result->config.reclaimed,
+               (unsigned long long)result->reload_ticks, result->reload_tick_ms, result->max_reload_tick_ms,
+               result->steady_tick_ms, result->max_steady_tick_ms, result->table_build_ms);
+    }
+
+    if (options->wal_dir != NULL) {
+        const RecoveryStats* recovery = &result->recovery;
+        printf("Write-ahead log: %llu records in %llu group commits (%.1f MiB), %llu checkpoints of %.1f MiB; "
+               "overhead %.1f%% of wall time (%.2f ms per tick)\n",
+               (unsigned long long)result->wal.records_logged, (unsigned long long)result->wal.groups_committed,
+               result->wal.wal_bytes / 1048576.0, (unsigned long long)result->wal.checkpoints,
+               result->wal.checkpoint_bytes / 1048576.0, result->stage_seconds[3] / wall * 100.0,
+               result->wal.groups_committed > 0 ? result->stage_seconds[3] * 1e3 / result->wal.groups_committed : 0.0);
+        printf("Recovery: %.3f s (checkpoint of %u patients %.3f s, replay of %llu records on %u threads %.3f s), "
+               "state %s\n",
+               recovery->checkpoint_seconds + recovery->replay_seconds, recovery->checkpoint_patients,
+               recovery->checkpoint_seconds, (unsigned long long)recovery->records_replayed, recovery->threads,
+               recovery->replay_seconds, result->recovered_match ? "matches" : "DIFFERS");
+        printf("Lazy recovery (checkpoint not cached): first alarm decision after %.2f ms, "
+               "all %u patients loaded after %.3f s, state %s\n",
+               result->first_alarm_seconds * 1e3, result->lazy_recovery.checkpoint_patients,
+               result->lazy_load_seconds, result->lazy_match ? "matches" : "DIFFERS");
+    }
+    printf("-------------------------\n\n");
+}
+
+/**
+ * @brief Appends the results as one JSON line to the summary file.
+ *
+ * @param options Pointer to the load test settings.
+ * @param result Pointer to the measurements.
+ * @return 0 on success, -1 on error.
+ */
+static int append_summary(const LoadTestOptions* options, const LoadTestResult* result) {
+    FILE* out = fopen(options->summary_path, "a");
+    if (out == NULL) return -1;
+
+    char timestamp[32];
+    time_t now = time(NULL);
+    struct tm t_storage;
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime_r(&now, &t_storage));
+    double wall = result->wall_seconds > 0.0 ? result->wall_seconds : 1e-9;
+
+    fprintf(out, "{\"timestamp\": \"%s\", \"patients\": %ld, \"days\": %d, \"cadence_min\": %d, "
+                 "\"readings\": %llu, \"alarms\": %llu, \"wall_s\": %.6f, \"cpu_s\": %.6f, "
+                 "\"readings_per_sec\": %.1f, \"capacity_at_budget\": %.0f, \"peak_rss_kb\": %ld, \"bytes_per_patient\": %.1f, "
+                 "\"add_mean_ns\": %.1f, \"churn_mean_ns\": %.1f, "
+                 "\"stage_s\": {\"generate\": %.6f, \"analyze\": %.6f, \"alarm\": %.6f, \"persist\": %.6f}, "
+                 "\"recovery_s\": %.6f, \"first_alarm_s\": %.6f, \"lazy_load_s\": %.6f, "
+                 "\"config_reloads\": %llu, \"reload_tick_ms\": %.6f, \"steady_tick_ms\": %.6f, "
+                 "\"alarm_latency_ns\": {\"p50\": %llu, \"p99\": %llu, \"p999\": %llu, \"max\": %llu}}\n",
+            timestamp, options->patients, options->days, options->cadence_min,
+            (unsigned long long)result->readings, (unsigned long long)result->alarms,
+            result->wall_seconds, result->cpu_seconds, (double)result->readings / wall,
+            (double)result->readings / wall * options->budget_ms / 1000.0,
+            result->peak_rss_kb, (double)result->registry_bytes / options->patients,
+            result->add_mean_ns, result->churn_mean_ns,
+            result->stage_seconds[0], result->stage_seconds[1], result->stage_seconds[2], result->stage_seconds[3],
+            result->recovery.checkpoint_seconds + result->recovery.replay_seconds,
+            result->first_alarm_seconds, result->lazy_load_seconds,
+            (unsigned long long)result->config.published, result->reload_tick_ms, result->steady_tick_ms,
+            (unsigned long long)result->alarm_latency.p50_ns,
+            (unsigned long long)result->alarm_latency.p99_ns,
+            (unsigned long long)result->alarm_latency.p999_ns,
+            (unsigned long long)result->alarm_latency.max_ns);
+
+    int status = ferror(out) ? -1 : 0;
+    fclose(out);
+    return status;
+}
+
+/**
+ * @brief Parses options, runs the load test and records the summary.
+ *
+ * @return Exit status: 0 on success, 1 on error.
+ */
+int main(int argc, char** argv) {
+    LoadTestOptions options = {10000, 1, 5, 42, 100, "loadtest_history.jsonl", NULL, 12, NULL, 0};
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--patients") == 0 && i + 1 < argc) {
+            options.patients = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--days") == 0 && i + 1 < argc) {
+            options.days = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--cadence-min") == 0 && i + 1 < argc) {
+            options.cadence_min = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            options.seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--budget-ms") == 0 && i + 1 < argc) {
+            options.budget_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--summary") == 0 && i + 1 < argc) {
+            options.summary_path = argv[++i];
+        } else if (strcmp(argv[i], "--wal") == 0 && i + 1 < argc) {
+            options.wal_dir = argv[++i];
+        } else if (strcmp(argv[i], "--checkpoint-ticks") == 0 && i + 1 < argc) {
+            options.checkpoint_ticks = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--config") == 0 && i + 1 < argc) {
+            options.config_path = argv[++i];
+        } else if (strcmp(argv[i], "--reload-ms") == 0 && i + 1 < argc) {
+            options.reload_ms = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--patients N] [--days M] [--cadence-min C] "
+                            "[--seed S] [--budget-ms B] [--summary FILE] [--wal DIR] "
+                            "[--checkpoint-ticks K] [--config FILE] [--reload-ms R]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    LoadTestResult result;
+    if (run_load_test(&options, &result) != 0) {
+        fprintf(stderr, "Error: Load test failed (check options and available memory)\n");
+        return 1;
+    }
+
+    print_load_test_report(&options, &result);
+
+    if (append_summary(&options, &result) != 0) {
+        fprintf(stderr, "Error: Failed to append summary to %s\n", options.summary_path);
+        return 1;
+    }
+    printf("Summary appended to %s\n", options.summary_path);
+
+    return 0;
+}
@@ -0,0 +1,176 @@
+/**
+ * @file perf_counters.c
+ * @brief Contains the perf_event_open groups behind the benchmark counters.
+ */
+
+#define _GNU_SOURCE
+
+#include "perf_counters.h"
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Kind, encoding and group of one event
+typedef struct {
+    const char* name;
+    uint32_t type;
+    uint64_t config;
+    int group;
+} PerfCounterSpec;
+
+#define CACHE_READ_MISS(cache) \
+    ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+// Indexed by PerfCounterEvent; events of a group are contiguous, leader first
+static const PerfCounterSpec specs[PERF_COUNTER_EVENT_COUNT] = {
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, 0},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, 0},
+    {"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, 0},
+    {"l1d_misses", PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D), 1},
+    {"llc_misses", PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_LL), 1},
+    {"dtlb_misses", PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_DTLB), 1},
+    {"page_faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, 2},
+};
+
+/**
+ * @brief Opens one event of the calling thread, on any CPU.
+ *
+ * @param spec Event to open.
+ * @param group_fd Leader of its group, or -1 to open a new group.
+ * @return File descriptor, or -1 on error (errno set).
+ */
+static int open_event(const PerfCounterSpec* spec, int group_fd) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = spec->type;
+    attr.config = spec->config;
+    attr.disabled = group_fd < 0; // Members follow their leader
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+/**
+ * @brief Opens every event that the kernel allows for the calling thread.
+ *
+ * An event that is refused is skipped; the next event of its group
+ * becomes the leader if the refused one was to lead.
+ *
+ * @param counters Pointer to the PerfCounters structure to initialize.
+ * @return 0 if at least one event was opened, -1 if none was (see first_error).
+ */
+int perf_counters_open(PerfCounters* counters) {
+    if (counters == NULL) return -1;
+
+    memset(counters, 0, sizeof(*counters));
+    for (int g = 0; g < PERF_COUNTER_GROUP_COUNT; g++) counters->leaders[g] = -1;
+
+    for (int e = 0; e < PERF_COUNTER_EVENT_COUNT; e++) {
+        int* leader = &counters->leaders[specs[e].group];
+        counters->fds[e] = open_event(&specs[e], *leader);
+        if (counters->fds[e] < 0) {
+            if (counters->first_error == 0) counters->first_error = errno;
+            continue;
+        }
+        if (*leader < 0) *leader = counters->fds[e];
+        counters->open_count++;
+    }
+
+    return counters->open_count > 0 ? 0 : -1;
+}
+
+/**
+ * @brief Resets and starts all groups at the beginning of a region.
+ *
+ * @param counters Pointer to the open PerfCounters structure.
+ * @return 0 on success, -1 on error.
+ */
+int perf_counters_start(PerfCounters* counters) {
+    if (counters == NULL) return -1;
+
+    for (int g = 0; g < PERF_COUNTER_GROUP_COUNT; g++) {
+        int leader = counters->leaders[g];
+        if (leader < 0) continue;
+        if (ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP) != 0 ||
+            ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP) != 0) return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Stops all groups at the end of a region and reads their counts.
+ *
+ * A group read returns its events in the order they joined the group,
+ * which is their order in specs. Counts are scaled up by enabled over
+ * running time when the group was multiplexed; a group that never ran
+ * leaves its events invalid.
+ *
+ * @param counters Pointer to the open PerfCounters structure.
+ * @param reading Pointer to the PerfCounterReading structure to fill.
+ * @return 0 on success, -1 on error.
+ */
+int perf_counters_stop(PerfCounters* counters, PerfCounterReading* reading) {
+    if (counters == NULL || reading == NULL) return -1;
+
+    memset(reading, 0, sizeof(*reading));
+    int result = 0;
+    for (int g = 0; g < PERF_COUNTER_GROUP_COUNT; g++) {
+        int leader = counters->leaders[g];
+        if (leader < 0) continue;
+        if (ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP) != 0) result = -1;
+
+        // nr, time_enabled, time_running, then one value per event
+        uint64_t values[3 + PERF_COUNTER_EVENT_COUNT];
+        ssize_t length = read(leader, values, sizeof(values));
+        if (length < (ssize_t)(3 * sizeof(uint64_t))) {
+            result = -1;
+            continue;
+        }
+        uint64_t nr = values[0];
+        if (values[2] == 0 || length < (ssize_t)((3 + nr) * sizeof(uint64_t))) continue; // Never scheduled
+        double scale = (double)values[1] / (double)values[2];
+
+        uint64_t next = 0;
+        for (int e = 0; e < PERF_COUNTER_EVENT_COUNT && next < nr; e++) {
+            if (specs[e].group != g || counters->fds[e] < 0) continue;
+            reading->counts[e] = (double)values[3 + next++] * scale;
+            reading->valid[e] = 1;
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Closes every open event.
+ *
+ * @param counters Pointer to the PerfCounters structure.
+ * @return 0 on success, -1 on error.
+ */
+int perf_counters_close(PerfCounters* counters) {
+    if (counters == NULL) return -1;
+
+    int result = 0;
+    for (int e = 0; e < PERF_COUNTER_EVENT_COUNT; e++) {
+        if (counters->fds[e] >= 0 && close(counters->fds[e]) != 0) result = -1;
+        counters->fds[e] = -1;
+    }
+    for (int g = 0; g < PERF_COUNTER_GROUP_COUNT; g++) counters->leaders[g] = -1;
+    counters->open_count = 0;
+    return result;
+}
+
+/**
+ * @brief Returns the short name of an event, as used in reports and JSON.
+ *
+ * @param event Event to name.
+ * @return Constant string naming the event, or "unknown".
+ */
+const char* perf_counter_name(PerfCounterEvent event) {
+    if (event < 0 || event >= PERF_COUNTER_EVENT_COUNT) return "unknown";
+    return specs[event].name;
+}
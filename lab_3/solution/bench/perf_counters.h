@@ -0,0 +1,97 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <stdint.h>
+
+/**
+ * @file perf_counters.h
+ * @brief Hardware performance counters of the calling thread, via perf_event_open.
+ *
+ * Events are opened in groups, and each group is scheduled onto the PMU
+ * as a unit, so the counts within a group always cover the same
+ * instructions and ratios like IPC are exact:
+ *
+ *   core:   cycles, instructions, branch misses
+ *   memory: L1d read misses, LLC read misses, dTLB read misses
+ *   os:     page faults (a software event, available without a PMU)
+ *
+ * When the PMU has fewer counters than are asked for, the kernel
+ * multiplexes the groups; counts are scaled by the share of the region
+ * each group actually ran. Only user-space execution is counted, which
+ * is allowed at the default perf_event_paranoid level of 2.
+ *
+ * Counters degrade per event: an event the kernel refuses (no PMU in a
+ * VM, perf_event_paranoid above 2, a seccomp filter, an unsupported
+ * cache event) is left out, and its counts are reported as unavailable.
+ */
+
+// Events counted per region
+typedef enum {
+    PERF_COUNTER_CYCLES,
+    PERF_COUNTER_INSTRUCTIONS,
+    PERF_COUNTER_BRANCH_MISSES,
+    PERF_COUNTER_L1D_MISSES,
+    PERF_COUNTER_LLC_MISSES,
+    PERF_COUNTER_DTLB_MISSES,
+    PERF_COUNTER_PAGE_FAULTS,
+    PERF_COUNTER_EVENT_COUNT
+} PerfCounterEvent;
+
+#define PERF_COUNTER_GROUP_COUNT 3
+
+// Structure to hold the open counters of the calling thread
+typedef struct {
+    int fds[PERF_COUNTER_EVENT_COUNT];     // -1 if the event could not be opened
+    int leaders[PERF_COUNTER_GROUP_COUNT]; // First opened event of each group, or -1
+    int open_count;                        // Events opened
+    int first_error;                       // errno of the first event refused, or 0
+} PerfCounters;
+
+// Counts of one region
+typedef struct {
+    double counts[PERF_COUNTER_EVENT_COUNT]; // Scaled for multiplexing
+    uint8_t valid[PERF_COUNTER_EVENT_COUNT]; // Non-zero if the event was counted
+} PerfCounterReading;
+
+/**
+ * @brief Opens every event that the kernel allows for the calling thread.
+ *
+ * @param counters Pointer to the PerfCounters structure to initialize.
+ * @return 0 if at least one event was opened, -1 if none was (see first_error).
+ */
+int perf_counters_open(PerfCounters* counters);
+
+/**
+ * @brief Resets and starts all groups at the beginning of a region.
+ *
+ * @param counters Pointer to the open PerfCounters structure.
+ * @return 0 on success, -1 on error.
+ */
+int perf_counters_start(PerfCounters* counters);
+
+/**
+ * @brief Stops all groups at the end of a region and reads their counts.
+ *
+ * @param counters Pointer to the open PerfCounters structure.
+ * @param reading Pointer to the PerfCounterReading structure to fill.
+ * @return 0 on success, -1 on error.
+ */
+int perf_counters_stop(PerfCounters* counters, PerfCounterReading* reading);
+
+/**
+ * @brief Closes every open event.
+ *
+ * @param counters Pointer to the PerfCounters structure.
+ * @return 0 on success, -1 on error.
+ */
+int perf_counters_close(PerfCounters* counters);
+
+/**
+ * @brief Returns the short name of an event, as used in reports and JSON.
+ *
+ * @param event Event to name.
+ * @return Constant string naming the event, or "unknown".
+ */
+const char* perf_counter_name(PerfCounterEvent event);
+
+#endif // PERF_COUNTERS_H
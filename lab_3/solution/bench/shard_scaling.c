@@ -0,0 +1,206 @@
+/**
+ * @file shard_scaling.c
+ * @brief Throughput of the sharded runtime as shards are added.
+ *
+ * Usage: shard_scaling [--patients N] [--ticks T] [--shards LIST] [--no-pin]
+ *
+ * For each shard count in LIST (default: 1, 2, 4, ... up to the CPUs the
+ * process may run on), N patients are spread over the shards and run in
+ * two ways:
+ *
+ *   simulate  Each shard generates and analyzes T readings for each of
+ *             its own patients, flat out. Nothing is shared, so this is
+ *             the scaling limit of the runtime.
+ *   routed    This thread routes T readings per patient, prepared in
+ *             advance, to the shards' inboxes, as the ingest loop does;
+ *             the single router bounds the throughput.
+ *
+ * Readings/sec, speedup over one shard and parallel efficiency (speedup
+ * divided by shards) are printed per mode. The merged fleet summary is
+ * checked against the number of readings sent.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../include/latency.h"
+#include "../include/shard_runtime.h"
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SCALING_MAX_COUNTS 16
+#define SCALING_BASE_TIME 1767225600 // 2026-01-01T00:00:00Z
+
+// Structure to hold benchmark settings
+typedef struct {
+    uint32_t patients;
+    uint32_t ticks;
+    uint32_t shards[SCALING_MAX_COUNTS];
+    int shard_counts;
+    int pin;
+} ScalingOptions;
+
+/**
+ * @brief Parses command-line options.
+ *
+ * @return 0 on success, -1 on invalid arguments.
+ */
+static int parse_options(int argc, char* argv[], ScalingOptions* options) {
+    options->patients = 100000;
+    options->ticks = 20;
+    options->shard_counts = 0;
+    options->pin = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--no-pin") == 0) {
+            options->pin = 0;
+            continue;
+        }
+        if (i + 1 >= argc) return -1;
+        long value = strtol(argv[i + 1], NULL, 10);
+
+        if (strcmp(argv[i], "--patients") == 0 && value > 0) {
+            options->patients = (uint32_t)value;
+        } else if (strcmp(argv[i], "--ticks") == 0 && value > 0) {
+            options->ticks = (uint32_t)value;
+        } else if (strcmp(argv[i], "--shards") == 0) {
+            const char* list = argv[i + 1];
+            while (*list != '\0') {
+                char* end;
+                long count = strtol(list, &end, 10);
+                if (end == list || count <= 0 || count > SHARD_MAX || options->shard_counts == SCALING_MAX_COUNTS ||
+                    (*end != ',' && *end != '\0')) return -1;
+                options->shards[options->shard_counts++] = (uint32_t)count;
+                list = *end == ',' ? end + 1 : end;
+            }
+        } else {
+            return -1;
+        }
+        i++;
+    }
+
+    // Powers of two up to the CPU count, and the CPU count itself
+    if (options->shard_counts == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        if (cpus < 1) cpus = 1;
+        if (cpus > SHARD_MAX) cpus = SHARD_MAX;
+        for (uint32_t count = 1; count < (uint32_t)cpus && options->shard_counts < SCALING_MAX_COUNTS - 1; count *= 2) {
+            options->shards[options->shard_counts++] = count;
+        }
+        options->shards[options->shard_counts++] = (uint32_t)cpus;
+    }
+    return 0;
+}
+
+/**
+ * @brief Runs the shards until every one has simulated its ticks.
+ *
+ * @return Readings per second, or -1.0 on error.
+ */
+static double run_simulate(const ScalingOptions* options, uint32_t shards) {
+    static ShardRuntime runtime;
+    ShardRuntimeOptions runtime_options = shard_runtime_default_options();
+    runtime_options.shard_count = shards;
+    runtime_options.pin = options->pin;
+    runtime_options.patient_count = options->patients;
+    runtime_options.ticks = options->ticks;
+    runtime_options.start_time = SCALING_BASE_TIME;
+
+    uint64_t start = latency_now_ns();
+    if (shard_runtime_start(&runtime, &runtime_options) != 0) return -1.0;
+    while (!shard_runtime_done(&runtime)) {
+        struct timespec poll = {0, 1000000};
+        nanosleep(&poll, NULL);
+    }
+    double seconds = (latency_now_ns() - start) / 1e9;
+
+    ShardSummary fleet;
+    if (shard_runtime_stop(&runtime, &fleet) != 0) return -1.0;
+    if (fleet.readings != (uint64_t)options->patients * options->ticks || fleet.patients != options->patients) {
+        printf("Error: Fleet summary has %llu readings of %u patients\n",
+               (unsigned long long)fleet.readings, fleet.patients);
+        return -1.0;
+    }
+    return fleet.readings / seconds;
+}
+
+/**
+ * @brief Routes prepared readings through the shards' inboxes.
+ *
+ * @return Readings per second, or -1.0 on error.
+ */
+static double run_routed(const ScalingOptions* options, uint32_t shards, const float* values) {
+    static ShardRuntime runtime;
+    ShardRuntimeOptions runtime_options = shard_runtime_default_options();
+    runtime_options.shard_count = shards;
+    runtime_options.mode = SHARD_MODE_INBOX;
+    runtime_options.pin = options->pin;
+
+    uint64_t start = latency_now_ns();
+    if (shard_runtime_start(&runtime, &runtime_options) != 0) return -1.0;
+    for (uint32_t tick = 0; tick < options->ticks; tick++) {
+        for (uint32_t p = 0; p < options->patients; p++) {
+            IngestRecord record = {p + 1, values[(tick * 7919u + p) & 4095], SCALING_BASE_TIME + (int64_t)tick * 300};
+            // A full inbox means its shard is behind; let it catch up
+            while (shard_runtime_submit(&runtime, &record) != 0) sched_yield();
+        }
+    }
+
+    ShardSummary fleet;
+    if (shard_runtime_stop(&runtime, &fleet) != 0) return -1.0; // Waits for the inboxes to drain
+    double seconds = (latency_now_ns() - start) / 1e9;
+    if (fleet.readings != (uint64_t)options->patients * options->ticks) {
+        printf("Error: Fleet summary has %llu readings\n", (unsigned long long)fleet.readings);
+        return -1.0;
+    }
+    return fleet.readings / seconds;
+}
+
+/**
+ * @brief Main function.
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv Array of command-line arguments.
+ * @return 0 on success, 1 on error.
+ */
+int main(int argc, char* argv[]) {
+    ScalingOptions options;
+    if (parse_options(argc, argv, &options) != 0) {
+        printf("Usage: %s [--patients N] [--ticks T] [--shards LIST] [--no-pin]\n", argv[0]);
+        return 1;
+    }
+
+    // Same distribution as the generator, prepared so the router only routes
+    static float values[4096];
+    unsigned int seed = 42;
+    for (int i = 0; i < 4096; i++) {
+        GeneratedData data;
+        memset(&data, 0, sizeof(data));
+        generate_glucose_data_r(&data, SCALING_BASE_TIME, &seed);
+        values[i] = (float)data.glucose_value;
+    }
+
+    printf("Shard scaling: %u patients x %u readings, %ld CPUs online%s\n", options.patients, options.ticks,
+           sysconf(_SC_NPROCESSORS_ONLN), options.pin ? ", shards pinned" : "");
+    printf("  %-8s %6s %16s %9s %11s\n", "mode", "shards", "readings/s", "speedup", "efficiency");
+
+    const char* modes[2] = {"simulate", "routed"};
+    for (int mode = 0; mode < 2; mode++) {
+        double baseline = 0.0;
+        for (int i = 0; i < options.shard_counts; i++) {
+            uint32_t shards = options.shards[i];
+            double rate = mode == 0 ? run_simulate(&options, shards) : run_routed(&options, shards, values);
+            if (rate < 0.0) {
+                printf("Error: %s run with %u shards failed\n", modes[mode], shards);
+                return 1;
+            }
+            if (i == 0) baseline = rate / shards;
+            double speedup = rate / baseline;
+            printf("  %-8s %6u %16.0f %8.2fx %10.0f%%\n", modes[mode], shards, rate, speedup, 100.0 * speedup / shards);
+        }
+    }
+
+    return 0;
+}
@@ -9,6 +9,73 @@
  * @brief Header file for glucose alarm functions.
  */
 
+// Alarm conditions, combined as bit flags
+typedef enum {
+    ALARM_NONE = 0,
+    ALARM_HYPOGLYCEMIA = 1 << 0,   // Glucose below the hypoglycemia threshold
+    ALARM_HYPERGLYCEMIA = 1 << 1,  // Glucose above the hyperglycemia threshold
+    ALARM_RAPID_INCREASE = 1 << 2, // Rise larger than the rapid change threshold
+    ALARM_RAPID_DECREASE = 1 << 3  // Fall larger than the rapid change threshold
+} AlarmFlag;
+
+/**
+ * @brief Evaluates the level rules (hypo- and hyperglycemia) for one reading.
+ *
+ * @param glucose_value Glucose reading in mg/dL.
+ * @param config Pointer to the Config structure containing thresholds.
+ * @return Active AlarmFlag bits, ALARM_NONE if config is NULL.
+ */
+unsigned int glucose_level_alarms(double glucose_value, const Config* config);
+
+/**
+ * @brief Evaluates the rapid-change rules for the change between two readings.
+ *
+ * @param change Change from the previous reading in mg/dL.
+ * @param config Pointer to the Config structure containing thresholds.
+ * @return Active AlarmFlag bits, ALARM_NONE if config is NULL.
+ */
+unsigned int glucose_change_alarms(double change, const Config* config);
+
+/**
+ * @brief Evaluates alarm conditions for a single reading.
+ *
+ * For callers holding plain values, such as arrays that mark gaps with
+ * 0.0: the change between the two readings is only checked if
+ * previous_value is a reading (positive). GeneratedData histories track
+ * their gaps in a validity bitmap instead; see evaluate_glucose_alarms().
+ *
+ * @param glucose_value Current glucose reading in mg/dL.
+ * @param previous_value Previous glucose reading in mg/dL, or 0.0 if none.
+ * @param config Pointer to the Config structure containing thresholds.
+ * @param flags Pointer to receive the active AlarmFlag bits.
+ * @return 0 on success, -1 on error.
+ */
+int evaluate_glucose_alarm_values(double glucose_value, double previous_value,
+                                  const Config* config, unsigned int* flags);
+
+/**
+ * @brief Evaluates alarm conditions without printing anything.
+ *
+ * Applies the same rules as check_and_print_alarms() and reports the
+ * active conditions as a combination of AlarmFlag values. A rapid change
+ * is only evaluated if history entries 0 and 1 are both valid.
+ *
+ * @param data Pointer to the GeneratedData structure containing glucose data.
+ * @param config Pointer to the Config structure containing thresholds.
+ * @param flags Pointer to receive the active AlarmFlag bits.
+ * @return 0 on success, -1 on error.
+ */
+int evaluate_glucose_alarms(const GeneratedData* data, const Config* config, unsigned int* flags);
+
+/**
+ * @brief Prints the alarm messages for previously evaluated alarm flags.
+ *
+ * @param data Pointer to the GeneratedData structure the flags were evaluated on.
+ * @param flags AlarmFlag bits returned by evaluate_glucose_alarms().
+ * @return 0 on success, -1 on error.
+ */
+int print_glucose_alarms(const GeneratedData* data, unsigned int flags);
+
 /**
  * @brief Checks and prints alarms based on glucose data and configuration.
  *
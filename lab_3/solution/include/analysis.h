@@ -18,6 +18,13 @@ typedef struct {
     double glucose_variability; // Standard deviation of glucose values
 } GlucoseStats;
 
+// Direction of the most recent glucose change
+typedef enum {
+    TREND_RISING,  // Glucose increased by more than the stability threshold
+    TREND_STABLE,  // Glucose changed by no more than the stability threshold
+    TREND_FALLING  // Glucose decreased by more than the stability threshold
+} GlucoseTrend;
+
 /**
  * @brief Initializes the glucose statistics structure.
  *
@@ -53,4 +60,25 @@ int update_glucose_statistics(GlucoseStats* stats, const GeneratedData* data, co
  */
 int print_glucose_statistics(const GlucoseStats* stats);
 
+/**
+ * @brief Classifies a change in glucose as a trend.
+ *
+ * Changes within ±5 mg/dL are reported as stable.
+ *
+ * @param change Change in mg/dL since the previous reading.
+ * @return GlucoseTrend indicating direction (RISING, STABLE, or FALLING).
+ */
+GlucoseTrend classify_glucose_change(double change);
+
+/**
+ * @brief Calculates the glucose trend from the two most recent readings.
+ *
+ * Compares the current glucose value with the previous reading in the
+ * history. Changes within ±5 mg/dL are reported as stable.
+ *
+ * @param data Pointer to the GeneratedData structure containing glucose history.
+ * @return GlucoseTrend indicating direction (RISING, STABLE, or FALLING).
+ */
+GlucoseTrend calculate_glucose_trend(const GeneratedData* data);
+
 #endif // ANALYSIS_H
@@ -0,0 +1,120 @@
+#ifndef ARCHIVE_SCAN_H
+#define ARCHIVE_SCAN_H
+
+#include <stdint.h>
+#include "analysis.h"
+#include "config.h"
+#include "glucose_fixed.h"
+#include "reading_archive.h"
+
+/**
+ * @file archive_scan.h
+ * @brief Parallel time-range scans over the reading archive.
+ *
+ * A scan splits the archive by shard, i.e. by patient, over a pool of
+ * threads; each thread takes the next unscanned shard until none are
+ * left, so every patient's readings are seen by one thread in order and
+ * episodes need no merging across threads. Predicates are pushed down to
+ * the block index: blocks whose time, patient id or value range cannot
+ * match are never read (nor shards other than a single patient's own),
+ * and blocks that can only end episodes are read
+ * without their value column. Runs of blocks to read are fetched with one
+ * pread per ARCHIVE_SCAN_READ_BYTES, so files larger than memory stream
+ * from disk sequentially.
+ *
+ * Results come back as GlucoseStats, a value histogram and a list of
+ * hypoglycemic episodes, merged over all threads.
+ */
+
+#define ARCHIVE_SCAN_MAX_THREADS 64
+#define ARCHIVE_SCAN_READ_BYTES (1 << 20)  // Largest single read of consecutive blocks
+#define ARCHIVE_HISTOGRAM_BIN_MG_DL 10
+#define ARCHIVE_HISTOGRAM_BINS 41          // 0-9.9, 10-19.9, ..., 400 mg/dL and above
+#define ARCHIVE_EPISODE_MAX_GAP_S 900      // Default: three missed 5-minute readings end an episode
+#define ARCHIVE_EPISODE_MIN_DURATION_S 900 // Default: clinically significant after 15 minutes
+
+// Results a scan computes
+typedef enum {
+    ARCHIVE_OUTPUT_STATS = 1 << 0,     // GlucoseStats of the matching readings
+    ARCHIVE_OUTPUT_HISTOGRAM = 1 << 1, // Matching readings per ARCHIVE_HISTOGRAM_BIN_MG_DL
+    ARCHIVE_OUTPUT_EPISODES = 1 << 2   // Runs of readings below the hypoglycemia threshold
+} ArchiveOutput;
+
+// What to scan for
+typedef struct {
+    int64_t from;                  // Start of the time range
+    int64_t to;                    // End of the time range (exclusive)
+    uint32_t min_patient_id;       // Patient id range (inclusive)
+    uint32_t max_patient_id;
+    GlucoseFixed min_value;        // Value range of readings counted in stats and histogram (inclusive)
+    GlucoseFixed max_value;
+    Config config;                 // Range thresholds; episodes are readings below hypoglycemia_threshold
+    uint32_t episode_max_gap;      // Seconds between readings that end an episode
+    uint32_t episode_min_duration; // Shorter episodes are not reported
+    unsigned int outputs;          // ArchiveOutput bits
+    unsigned int threads;          // Worker threads, 0 = one per online CPU
+    int verify;                    // Non-zero to check block checksums while scanning
+} ArchiveQuery;
+
+// One hypoglycemic episode
+typedef struct {
+    uint32_t patient_id;
+    uint32_t readings;   // Readings below the threshold in the episode
+    int64_t start;       // First reading below the threshold
+    int64_t end;         // Last reading below the threshold
+    GlucoseFixed nadir;  // Lowest reading
+} ArchiveEpisode;
+
+// How the scan went
+typedef struct {
+    uint64_t blocks_indexed;   // Blocks in the archive
+    uint64_t blocks_read;      // Blocks read in full
+    uint64_t blocks_ids_only;  // Blocks read without their value column
+    uint64_t readings_scanned; // Readings decoded
+    uint64_t readings_matched; // Readings counted in stats and histogram
+    uint64_t bytes_read;
+    uint64_t checksum_errors;  // Blocks skipped because their checksum did not match
+    double seconds;            // Wall-clock time
+    double thread_seconds;     // CPU time of all workers
+    unsigned int threads;
+} ArchiveScanStats;
+
+// Structure to hold the results of a scan
+typedef struct {
+    GlucoseStats stats;            // As update_glucose_statistics() keeps them
+    GlucoseFixed min_value;        // Lowest matching reading
+    GlucoseFixed max_value;
+    uint64_t histogram[ARCHIVE_HISTOGRAM_BINS];
+    ArchiveEpisode* episodes;      // Sorted by patient, then start; free with archive_scan_free()
+    uint32_t episode_count;
+    ArchiveScanStats scan;
+} ArchiveScanResult;
+
+/**
+ * @brief Returns a query for every reading of every patient, with stats only.
+ *
+ * @return ArchiveQuery structure with default values.
+ */
+ArchiveQuery archive_default_query(void);
+
+/**
+ * @brief Scans an archive directory in parallel.
+ *
+ * Blocks still buffered by a ReadingArchive that is open for appending
+ * are not seen; flush it first.
+ *
+ * @param directory Archive directory.
+ * @param query Pointer to the query.
+ * @param result Pointer to the ArchiveScanResult structure to fill.
+ * @return 0 on success, -1 on error (invalid arguments, unreadable archive or out of memory).
+ */
+int archive_scan(const char* directory, const ArchiveQuery* query, ArchiveScanResult* result);
+
+/**
+ * @brief Frees the episode list of a scan result.
+ *
+ * @param result Pointer to the ArchiveScanResult structure.
+ */
+void archive_scan_free(ArchiveScanResult* result);
+
+#endif // ARCHIVE_SCAN_H
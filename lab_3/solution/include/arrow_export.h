@@ -0,0 +1,94 @@
+#ifndef ARROW_EXPORT_H
+#define ARROW_EXPORT_H
+
+#include <stdint.h>
+#include "arrow_ipc.h"
+#include "patient_registry.h"
+
+/**
+ * @file arrow_export.h
+ * @brief Export of readings, alarm events and per-patient statistics as Arrow IPC files.
+ *
+ * The engine's output goes to three Arrow IPC files in a directory, for
+ * pandas (read_feather), Polars (read_ipc) or pyarrow to load without
+ * parsing:
+ *
+ *   readings.arrow       patient_id, time, glucose (mg/dL)
+ *   alarms.arrow         patient_id, time, glucose, alarm_flags (AlarmFlag bits),
+ *                        one row per reading that raised at least one alarm
+ *   patient_stats.arrow  patient_id, time and glucose of the latest reading,
+ *                        time in/below/above range (percent), avg_glucose,
+ *                        glucose_variability (standard deviation),
+ *                        reading_count and alarm_count, one row per
+ *                        registered patient
+ *
+ * Readings and alarm events are appended to column buffers as they
+ * arrive. Each full buffer of ARROW_EXPORT_BATCH_ROWS rows is written as
+ * one record batch directly from those buffers (see arrow_ipc.h), which
+ * are then reused. Statistics are gathered from the registry into columns
+ * when the export is closed; patients without a reading yet have nulls
+ * instead of statistics. The files are complete once the export is
+ * closed, which writes their footers.
+ */
+
+#define ARROW_EXPORT_BATCH_ROWS 65536
+#define ARROW_EXPORT_PATH_MAX 256
+#define ARROW_EXPORT_READINGS_FILE "readings.arrow"
+#define ARROW_EXPORT_ALARMS_FILE "alarms.arrow"
+#define ARROW_EXPORT_STATS_FILE "patient_stats.arrow"
+
+// Rows of one table waiting to become a record batch
+typedef struct {
+    uint32_t patient_id[ARROW_EXPORT_BATCH_ROWS];
+    int64_t time[ARROW_EXPORT_BATCH_ROWS];
+    double glucose[ARROW_EXPORT_BATCH_ROWS];
+    uint8_t alarm_flags[ARROW_EXPORT_BATCH_ROWS]; // Alarm events only
+    uint32_t count;
+} ArrowEventColumns;
+
+// Counters since the export was opened
+typedef struct {
+    uint64_t readings;      // Rows written to readings.arrow
+    uint64_t alarms;        // Rows written to alarms.arrow
+    uint32_t patients;      // Rows written to patient_stats.arrow
+    uint64_t bytes_written; // Of all three files
+} ArrowExportStats;
+
+// Structure to hold an open export
+typedef struct {
+    char directory[ARROW_EXPORT_PATH_MAX];
+    ArrowIpcWriter readings;
+    ArrowIpcWriter alarms;
+    ArrowEventColumns* pending_readings;
+    ArrowEventColumns* pending_alarms;
+    ArrowExportStats stats;
+} ArrowExport;
+
+/**
+ * @brief Creates the export directory if needed and starts the reading and alarm files.
+ *
+ * @param exporter Pointer to the ArrowExport structure to initialize.
+ * @param directory Directory to write the files to.
+ * @return 0 on success, -1 on error.
+ */
+int arrow_export_open(ArrowExport* exporter, const char* directory);
+
+/**
+ * @brief Appends a patient's latest reading, and its alarms if it raised any.
+ *
+ * @param exporter Pointer to the ArrowExport structure.
+ * @param patient Pointer to the patient, after its reading was processed.
+ * @return 0 on success, -1 on error (a full batch could not be written).
+ */
+int arrow_export_reading(ArrowExport* exporter, const PatientState* patient);
+
+/**
+ * @brief Writes the remaining rows, the statistics of every patient and the file footers.
+ *
+ * @param exporter Pointer to the ArrowExport structure.
+ * @param registry Pointer to the registry whose patients' statistics are written, or NULL for none.
+ * @return 0 on success, -1 on error.
+ */
+int arrow_export_close(ArrowExport* exporter, PatientRegistry* registry);
+
+#endif // ARROW_EXPORT_H
@@ -0,0 +1,136 @@
+#ifndef ARROW_IPC_H
+#define ARROW_IPC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file arrow_ipc.h
+ * @brief Writer of Apache Arrow IPC streams and files from column buffers.
+ *
+ * pandas, Polars and pyarrow load Arrow IPC data by mapping its column
+ * buffers, with no parsing. This writer produces both variants of the
+ * format (https://arrow.apache.org/docs/format/Columnar.html):
+ *
+ *   stream  Schema message, record batch messages, end-of-stream marker.
+ *           Readable while it is written, e.g. pyarrow.ipc.open_stream().
+ *   file    "ARROW1" magic, the same messages, then a footer indexing the
+ *           batches for random access, e.g. pyarrow.ipc.open_file(),
+ *           pandas.read_feather() or polars.read_ipc().
+ *
+ * Message metadata is encoded as Flatbuffers by hand, so there is no
+ * dependency on the Arrow or Flatbuffers libraries. Only flat schemas of
+ * fixed-width columns are supported: unsigned integers, int64, float32,
+ * float64 and UTC timestamps in seconds.
+ *
+ * Batches are zero-copy: each column's values and validity bitmap are
+ * handed to writev() straight from the caller's arrays, together with the
+ * encoded metadata and padding. Column arrays use the Arrow in-memory
+ * layout already: values are dense, in host byte order (recorded in the
+ * schema), and a validity bitmap holds bit i % 64 of word i / 64 set for
+ * a present value, as in glucose_kernels.h.
+ */
+
+#define ARROW_IPC_MAX_FIELDS 16
+#define ARROW_IPC_ALIGNMENT 8  // Body buffers start at multiples of this
+
+// Column types
+typedef enum {
+    ARROW_TYPE_UINT8 = 0,
+    ARROW_TYPE_UINT16,
+    ARROW_TYPE_UINT32,
+    ARROW_TYPE_INT64,
+    ARROW_TYPE_FLOAT32,
+    ARROW_TYPE_FLOAT64,
+    ARROW_TYPE_TIMESTAMP  // int64 seconds since the epoch, UTC
+} ArrowType;
+
+// IPC variants
+typedef enum {
+    ARROW_IPC_STREAM = 0,
+    ARROW_IPC_FILE
+} ArrowIpcFormat;
+
+// One column of the schema
+typedef struct {
+    const char* name;   // Must stay valid until the writer is closed
+    ArrowType type;
+    int nullable;       // Non-zero if batches may carry a validity bitmap for this column
+} ArrowField;
+
+// One column of a batch
+typedef struct {
+    const void* values;    // rows values of the field's type
+    const uint64_t* valid; // Validity bitmap, or NULL if every value is present
+} ArrowColumn;
+
+// Position of a record batch in a file, for the footer
+typedef struct {
+    uint64_t offset;          // Of the message, from the start of the file
+    uint32_t metadata_length; // Prefix and metadata, padded
+    uint64_t body_length;
+} ArrowIpcBlock;
+
+// Counters since the writer was opened
+typedef struct {
+    uint64_t batches;
+    uint64_t rows;
+    uint64_t bytes_written;
+} ArrowIpcStats;
+
+// Flatbuffer being encoded, reused for every message
+typedef struct {
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+    int failed;         // Set if growing failed; the contents are then unusable
+} ArrowIpcMetadata;
+
+// Structure to hold an open writer
+typedef struct {
+    int fd;
+    ArrowIpcFormat format;
+    ArrowField fields[ARROW_IPC_MAX_FIELDS];
+    uint32_t field_count;
+    ArrowIpcBlock* blocks;   // Record batches written so far (files only)
+    uint32_t block_count;
+    uint32_t block_capacity;
+    ArrowIpcMetadata metadata;
+    ArrowIpcStats stats;
+} ArrowIpcWriter;
+
+/**
+ * @brief Creates or replaces a file and writes the schema to it.
+ *
+ * @param writer Pointer to the ArrowIpcWriter structure to initialize.
+ * @param path File to write.
+ * @param format Stream or file variant.
+ * @param fields Pointer to the columns of the schema (copied).
+ * @param field_count Number of columns, 1 to ARROW_IPC_MAX_FIELDS.
+ * @return 0 on success, -1 on error.
+ */
+int arrow_ipc_open(ArrowIpcWriter* writer, const char* path, ArrowIpcFormat format,
+                   const ArrowField* fields, uint32_t field_count);
+
+/**
+ * @brief Writes one record batch.
+ *
+ * A batch may start anywhere in the caller's value arrays, but a validity
+ * bitmap must start at bit 0 of its first word.
+ *
+ * @param writer Pointer to the ArrowIpcWriter structure.
+ * @param columns Pointer to one column per field, in schema order.
+ * @param rows Number of rows in the batch.
+ * @return 0 on success, -1 on error (including a bitmap for a non-nullable field).
+ */
+int arrow_ipc_write_batch(ArrowIpcWriter* writer, const ArrowColumn* columns, uint32_t rows);
+
+/**
+ * @brief Ends the stream (and writes the footer of a file), then closes it.
+ *
+ * @param writer Pointer to the ArrowIpcWriter structure.
+ * @return 0 on success, -1 on error.
+ */
+int arrow_ipc_close(ArrowIpcWriter* writer);
+
+#endif // ARROW_IPC_H
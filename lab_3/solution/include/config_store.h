@@ -0,0 +1,216 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#include "config.h"
+
+/**
+ * @file config_store.h
+ * @brief File-backed, hot-reloadable thresholds with per-patient overrides.
+ *
+ * A configuration file holds the default thresholds and any number of
+ * per-patient overrides:
+ *
+ *     # Defaults
+ *     hypoglycemia_threshold = 70
+ *     hyperglycemia_threshold = 180
+ *     rapid_change_threshold = 30
+ *     sleep_interval = 2
+ *     # patient <id> <key>=<value> ...
+ *     patient 42 hypoglycemia_threshold=80 rapid_change_threshold=20
+ *
+ * A loaded file becomes an immutable ConfigTable whose thresholds are
+ * stored as columns indexed by patient id, so a run of patients can be
+ * evaluated with vector loads (see glucose_scan_alarm_columns()).
+ *
+ * Tables are published read-copy-update style: readers load the current
+ * pointer without taking a lock, and a publisher swaps in a new table
+ * atomically. The old table is freed only once every registered reader
+ * has passed a quiescent point (config_store_quiescent()) after the swap,
+ * so a reader may keep using the table it loaded until its next
+ * quiescent point.
+ */
+
+#define CONFIG_STORE_MAX_READERS 72 // Every shard of a ShardRuntime, plus the controller and tools
+#define CONFIG_STORE_MAX_RETIRED 64     // Tables waiting for readers before publishing fails
+#define CONFIG_TABLE_MAX_ROWS (1u << 22) // Highest patient id with an override, plus one
+#define CONFIG_STORE_PATH_MAX 256
+
+// Immutable thresholds of one configuration version
+typedef struct {
+    uint64_t version;                 // Assigned when published
+    Config defaults;                  // For patients without an override
+    uint32_t row_count;               // Patient ids below this have a row in the columns
+    uint32_t override_count;          // Patients with at least one override
+    int32_t* hypoglycemia_threshold;  // Column of row_count entries, indexed by patient id
+    int32_t* hyperglycemia_threshold; // Column of row_count entries
+    int32_t* rapid_change_threshold;  // Column of row_count entries
+} ConfigTable;
+
+// Counters since the store was initialized
+typedef struct {
+    uint64_t published;     // Tables swapped in
+    uint64_t reclaimed;     // Old tables freed after every reader moved on
+    uint64_t reload_errors; // Watched file changes that failed to load or publish
+} ConfigStoreStats;
+
+// Structure to hold the published table and its readers
+typedef struct {
+    ConfigTable* current;       // Published table (atomic)
+    uint64_t epoch;             // Incremented by every publish (atomic)
+    uint64_t reader_epoch[CONFIG_STORE_MAX_READERS]; // Epoch at each reader's last quiescent point, 0 = free (atomic)
+    pthread_mutex_t writer_lock; // Serializes publishers; readers never take it
+    ConfigTable* retired[CONFIG_STORE_MAX_RETIRED];
+    uint64_t retired_epoch[CONFIG_STORE_MAX_RETIRED]; // Epoch that made each table unreachable
+    uint32_t retired_count;
+
+    // File watcher
+    char path[CONFIG_STORE_PATH_MAX];
+    pthread_t watch_thread;
+    int watch_running;
+    int watch_stop;             // Set to ask the watcher to exit (atomic)
+    int watch_interval_ms;
+    struct timespec watch_mtime;
+    ConfigStoreStats stats;     // Updated under writer_lock
+} ConfigStore;
+
+/**
+ * @brief Loads a configuration file into a new table.
+ *
+ * Settings missing from the file keep the values of initialize_config().
+ *
+ * @param path Configuration file.
+ * @param table Pointer to receive the table (free with config_table_free()).
+ * @param error_line Pointer to receive the line of a syntax error (0 for
+ *                   other errors), or NULL.
+ * @return 0 on success, -1 on error.
+ */
+int config_table_load(const char* path, ConfigTable** table, int* error_line);
+
+/**
+ * @brief Creates a table with default thresholds and no overrides.
+ *
+ * @param defaults Pointer to the thresholds for every patient.
+ * @return New table (free with config_table_free()), or NULL on error.
+ */
+ConfigTable* config_table_create(const Config* defaults);
+
+/**
+ * @brief Frees a table that was never published or has been reclaimed.
+ *
+ * @param table Table to free, or NULL.
+ */
+void config_table_free(ConfigTable* table);
+
+/**
+ * @brief Returns the thresholds of one patient.
+ *
+ * @param table Pointer to the table.
+ * @param patient_id External patient identifier.
+ * @param config Pointer to receive the patient's thresholds.
+ */
+static inline void config_table_get(const ConfigTable* table, uint32_t patient_id, Config* config) {
+    *config = table->defaults;
+    if (patient_id < table->row_count) {
+        config->hypoglycemia_threshold = table->hypoglycemia_threshold[patient_id];
+        config->hyperglycemia_threshold = table->hyperglycemia_threshold[patient_id];
+        config->rapid_change_threshold = table->rapid_change_threshold[patient_id];
+    }
+}
+
+/**
+ * @brief Initializes a store and publishes its first table.
+ *
+ * @param store Pointer to the ConfigStore structure to initialize.
+ * @param table Initial table; the store takes ownership.
+ * @return 0 on success, -1 on error.
+ */
+int config_store_init(ConfigStore* store, ConfigTable* table);
+
+/**
+ * @brief Registers the calling thread as a reader.
+ *
+ * @param store Pointer to the ConfigStore.
+ * @return Reader slot for config_store_quiescent(), or -1 if all slots are taken.
+ */
+int config_store_register_reader(ConfigStore* store);
+
+/**
+ * @brief Unregisters a reader; it must not use any table it loaded afterwards.
+ *
+ * @param store Pointer to the ConfigStore.
+ * @param reader Slot returned by config_store_register_reader().
+ */
+void config_store_unregister_reader(ConfigStore* store, int reader);
+
+/**
+ * @brief Returns the current table without taking a lock.
+ *
+ * The table stays valid until the calling reader's next quiescent point.
+ *
+ * @param store Pointer to the ConfigStore.
+ * @return Current table.
+ */
+static inline const ConfigTable* config_store_read(ConfigStore* store) {
+    return __atomic_load_n(&store->current, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief Reports that a reader holds no table pointer it loaded earlier.
+ *
+ * Call between units of work, e.g. once per tick or poll iteration.
+ *
+ * @param store Pointer to the ConfigStore.
+ * @param reader Slot returned by config_store_register_reader().
+ */
+static inline void config_store_quiescent(ConfigStore* store, int reader) {
+    __atomic_store_n(&store->reader_epoch[reader], __atomic_load_n(&store->epoch, __ATOMIC_SEQ_CST),
+                     __ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief Publishes a new table and retires the previous one.
+ *
+ * Never waits for readers. Fails if too many retired tables are still
+ * waiting for readers to pass a quiescent point.
+ *
+ * @param store Pointer to the ConfigStore.
+ * @param table New table; the store takes ownership on success.
+ * @return 0 on success, -1 on error.
+ */
+int config_store_publish(ConfigStore* store, ConfigTable* table);
+
+/**
+ * @brief Frees retired tables no reader can still be using.
+ *
+ * @param store Pointer to the ConfigStore.
+ * @return Number of tables freed.
+ */
+uint32_t config_store_reclaim(ConfigStore* store);
+
+/**
+ * @brief Starts a thread that reloads a file whenever it changes.
+ *
+ * The file's modification time is checked every interval; a file that
+ * fails to load is reported and the current table stays in place.
+ *
+ * @param store Pointer to the ConfigStore.
+ * @param path Configuration file to watch.
+ * @param interval_ms Milliseconds between checks.
+ * @return 0 on success, -1 on error.
+ */
+int config_store_watch(ConfigStore* store, const char* path, int interval_ms);
+
+/**
+ * @brief Stops the watcher and frees every table.
+ *
+ * Readers must have stopped using the store.
+ *
+ * @param store Pointer to the ConfigStore to destroy.
+ * @return 0 on success, -1 on error.
+ */
+int config_store_destroy(ConfigStore* store);
+
+#endif // CONFIG_STORE_H
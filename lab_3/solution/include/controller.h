@@ -6,14 +6,73 @@
  * @brief Header file for the controller logic.
  */
 
+#include <stdint.h>
+
+// Structure to hold command-line options of the controller
+typedef struct {
+    uint32_t patient_count;    // Number of simulated patients (telemetry slots when ingesting)
+    int publish_telemetry;     // Non-zero to publish to the shared-memory feed
+    const char* ingest_socket; // Unix socket to receive device readings on, or NULL
+    uint16_t ingest_port;      // Loopback TCP port to receive device readings on, or 0
+    const char* state_dir;     // Directory for the write-ahead log and checkpoints, or NULL
+    int lazy_restore;          // Non-zero to load restored patients on first use
+    const char* config_path;   // Threshold file reloaded on change, or NULL for built-in defaults
+    int terminal_ui;           // Non-zero to show the full-screen dashboard instead of printing readings
+    int frame_rate;            // Maximum dashboard frames per second
+    const char* archive_dir;   // Directory to archive every reading to, or NULL
+    const char* report_path;   // Write reports of every archived patient here and exit, or NULL
+    uint32_t report_days;      // Days up to the latest archived reading covered by reports
+    uint32_t shard_count;      // Pinned shard threads owning the patients, or 0 to run them on the main thread
+    int smooth;                // Non-zero to take rapid-change alarms from the Kalman-filtered series
+    uint32_t resample_minutes; // Grid of each patient's resampled series in minutes, or 0 for none
+    const char* arrow_dir;     // Directory to export readings, alarms and statistics to as Arrow IPC files, or NULL
+    uint16_t metrics_port;     // Loopback TCP port to serve Prometheus metrics on, or 0
+} ControllerOptions;
+
+/**
+ * @brief Returns the default controller options (a single patient).
+ *
+ * @return ControllerOptions structure with default values.
+ */
+ControllerOptions default_controller_options(void);
+
+/**
+ * @brief Parses command-line arguments into controller options.
+ *
+ * Recognized options: --patients N, --telemetry, --ingest-unix PATH,
+ * --ingest-tcp PORT, --state-dir DIR, --lazy-restore, --config FILE, --tui,
+ * --fps N, --archive-dir DIR, --report FILE, --report-days N, --shards N,
+ * --smooth, --resample MIN, --arrow-dir DIR, --metrics-port PORT.
+ *
+ * @param argc Argument count from main().
+ * @param argv Argument vector from main().
+ * @param options Pointer to the ControllerOptions structure to fill.
+ * @return 0 on success, -1 on error (unknown option or invalid value).
+ */
+int parse_controller_options(int argc, char** argv, ControllerOptions* options);
+
 /**
  * @brief Runs the controller to manage glucose data generation.
  *
- * This function initializes the data generator, updates statistics, formats
- * data as CSV, and handles visualization and alarms.
+ * This function registers the simulated patients, then generates data,
+ * updates statistics and handles visualization and alarms for each of
+ * them on every tick. If an ingest socket or port is set, readings are
+ * received from device gateways instead of being generated. If a state
+ * directory is set, the registry is restored from it at startup and every
+ * change is logged to it. If an archive directory is set, every reading
+ * is also appended to a reading archive. If a report file is set, reports
+ * of every archived patient are written to it instead. If a shard count is
+ * set, patients are run on that many pinned shard threads instead. If
+ * smoothing is set, rapid-change alarms use the filtered rate of change
+ * (not with a state directory). If a resampling grid is set, each patient's readings are also resampled
+ * onto it. If an Arrow directory is set, readings, alarm events and
+ * per-patient statistics are exported to it as Arrow IPC files. If a
+ * metrics port is set, engine metrics are served on it in Prometheus
+ * text format.
  *
+ * @param options Pointer to the controller options.
  * @return 0 on success, -1 on error.
  */
-int run_controller(void);
+int run_controller(const ControllerOptions* options);
 
 #endif // CONTROLLER_H
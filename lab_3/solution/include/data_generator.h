@@ -4,14 +4,33 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
+#include <stdint.h>
+#include "glucose_fixed.h"
+
+#define GLUCOSE_HISTORY_VALID_MASK 0x3FFFFFFFu // One validity bit per history entry
 
 // Structure to hold generated glucose data
 typedef struct {
-    char timestamp[32];           // ISO timestamp of the reading
-    double glucose_value;         // Current glucose value in mg/dL
-    double glucose_history[30];   // Last 30 glucose values
+    char timestamp[32];                // ISO timestamp of the reading
+    time_t reading_time;               // Unix time of the reading
+    double glucose_value;              // Current glucose value in mg/dL, a multiple of 0.1
+    GlucoseFixed glucose_history[30];  // Last 30 glucose values in fixed point, newest first
+    uint32_t history_valid;            // Bit i is set if glucose_history[i] holds a reading
 } GeneratedData;
 
+/**
+ * @brief Returns non-zero if a history entry holds a reading.
+ *
+ * Entries that are not valid (warm-up, sensor dropouts) hold 0.
+ *
+ * @param data Pointer to the GeneratedData structure.
+ * @param index History index, 0 for the current reading.
+ * @return 1 if the entry holds a reading, 0 otherwise.
+ */
+static inline int glucose_history_valid(const GeneratedData* data, int index) {
+    return (int)((data->history_valid >> index) & 1u);
+}
+
 /**
  * @file data_generator.h
  * @brief Header file for glucose data generation functions.
@@ -40,4 +59,56 @@ int initialize_data_generator(void);
  */
 int generate_glucose_data(GeneratedData* data);
 
+/**
+ * @brief Generates a new set of glucose data stamped with a given time.
+ *
+ * Same as generate_glucose_data(), but uses the supplied timestamp instead
+ * of the wall clock so simulations can run faster than real time.
+ *
+ * @param data Pointer to the GeneratedData structure to populate.
+ * @param timestamp Time of the reading.
+ * @return 0 on success, -1 on error.
+ */
+int generate_glucose_data_at(GeneratedData* data, time_t timestamp);
+
+/**
+ * @brief Generates a new set of glucose data from a caller-owned random state.
+ *
+ * Same as generate_glucose_data_at(), but draws from *seed with rand_r(),
+ * so threads generating readings in parallel neither share nor lock the
+ * generator state. With a NULL seed, rand() is used.
+ *
+ * @param data Pointer to the GeneratedData structure to populate.
+ * @param timestamp Time of the reading.
+ * @param seed Pointer to the random state of the calling thread, or NULL.
+ * @return 0 on success, -1 on error.
+ */
+int generate_glucose_data_r(GeneratedData* data, time_t timestamp, unsigned int* seed);
+
+/**
+ * @brief Records an externally measured reading and updates the glucose history.
+ *
+ * Stamps the reading, stores its value and shifts it into the history
+ * exactly as generate_glucose_data() does for simulated readings. The
+ * value is rounded to the 0.1 mg/dL resolution of the history.
+ *
+ * @param data Pointer to the GeneratedData structure to update.
+ * @param glucose_value Measured glucose value in mg/dL.
+ * @param timestamp Time of the reading.
+ * @return 0 on success, -1 on error.
+ */
+int record_glucose_reading(GeneratedData* data, double glucose_value, time_t timestamp);
+
+/**
+ * @brief Records a sensor dropout: shifts a missing entry into the glucose history.
+ *
+ * The latest reading (glucose_value, reading_time and timestamp) is left
+ * as is, but it is no longer the previous reading of the next one, so no
+ * rapid change is evaluated across the gap.
+ *
+ * @param data Pointer to the GeneratedData structure to update.
+ * @return 0 on success, -1 on error.
+ */
+int record_missing_reading(GeneratedData* data);
+
 #endif // DATA_GENERATOR_H
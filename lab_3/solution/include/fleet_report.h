@@ -0,0 +1,122 @@
+#ifndef FLEET_REPORT_H
+#define FLEET_REPORT_H
+
+#include <stdint.h>
+#include "config.h"
+#include "config_store.h"
+#include "glucose_fixed.h"
+
+/**
+ * @file fleet_report.h
+ * @brief Batch reports of every patient in the reading archive over a window of days.
+ *
+ * A batch reads each shard of the archive once, in file order, and keeps
+ * one accumulator per patient: counts below, in and above the patient's
+ * thresholds, the sum and sum of squares, a 1 mg/dL histogram for
+ * percentiles, and the state of the current low and high episode. Every
+ * metric of a report comes out of that single pass. Shards are shared out
+ * over a pool of threads as in archive_scan(), so each patient is reported
+ * by exactly one thread.
+ *
+ * Reports are written as CSV, one line per patient, or as a binary file:
+ * a FleetReportHeader followed by row_count FleetReportRow records in
+ * patient id order, in host byte order.
+ */
+
+#define FLEET_REPORT_DAYS 14
+#define FLEET_REPORT_MAGIC 0x50524c47u // "GLRP"
+#define FLEET_REPORT_VERSION 1
+#define FLEET_REPORT_BINS 401          // 1 mg/dL bins for percentiles, 400 mg/dL and above in the last
+
+// Output formats
+typedef enum {
+    FLEET_REPORT_BINARY = 0,
+    FLEET_REPORT_CSV
+} FleetReportFormat;
+
+// Report of one patient over the window
+typedef struct {
+    uint32_t patient_id;
+    uint32_t readings;
+    float avg_glucose;          // mg/dL
+    float sd_glucose;           // mg/dL
+    float time_below_range;     // Percent of readings below the patient's hypoglycemia threshold
+    float time_in_range;
+    float time_above_range;
+    GlucoseFixed min_value;
+    GlucoseFixed percentiles[5]; // 5th, 25th, 50th, 75th and 95th, to the mg/dL below
+    GlucoseFixed max_value;
+    uint16_t low_episodes;      // Runs below the hypoglycemia threshold of at least 15 minutes
+    uint16_t high_episodes;     // Runs above the hyperglycemia threshold of at least 15 minutes
+    uint16_t reserved;
+} FleetReportRow;
+
+typedef char fleet_report_row_size_check[sizeof(FleetReportRow) == 48 ? 1 : -1];
+
+// Start of a binary report file
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t row_size;  // sizeof(FleetReportRow)
+    uint32_t row_count;
+    int64_t from;       // Window start
+    int64_t to;         // Window end (exclusive)
+} FleetReportHeader;
+
+// What to report on
+typedef struct {
+    int64_t from;       // Window start; when from == to, the window is the last
+    int64_t to;         // `days` days up to the latest reading in the archive
+    uint32_t days;
+    const ConfigTable* thresholds; // Per-patient thresholds, or NULL to use config for everyone
+    Config config;
+    unsigned int threads;          // Worker threads, 0 = one per online CPU
+} FleetReportOptions;
+
+// How the batch went
+typedef struct {
+    uint32_t patients;     // Reports produced
+    uint64_t readings;     // Readings in the window
+    uint64_t bytes_read;
+    int64_t from;          // Window actually reported
+    int64_t to;
+    double seconds;        // Wall-clock time
+    double thread_seconds; // CPU time of all workers
+    unsigned int threads;
+} FleetReportStats;
+
+/**
+ * @brief Returns options for 14-day reports up to the latest reading, with default thresholds.
+ *
+ * @return FleetReportOptions structure with default values.
+ */
+FleetReportOptions fleet_report_default_options(void);
+
+/**
+ * @brief Computes the report of every patient with readings in the window.
+ *
+ * @param directory Archive directory.
+ * @param options Pointer to the report options.
+ * @param rows Pointer to receive a malloc'ed array of reports in patient id order (NULL if none).
+ * @param count Pointer to receive the number of reports.
+ * @param stats Pointer to the FleetReportStats structure to fill, or NULL.
+ * @return 0 on success, -1 on error (invalid arguments, unreadable archive or out of memory).
+ */
+int fleet_report_build(const char* directory, const FleetReportOptions* options,
+                       FleetReportRow** rows, uint32_t* count, FleetReportStats* stats);
+
+/**
+ * @brief Writes reports to a file.
+ *
+ * @param path File to create or replace.
+ * @param format Output format.
+ * @param rows Pointer to the reports.
+ * @param count Number of reports.
+ * @param from Window start, recorded in binary files.
+ * @param to Window end, recorded in binary files.
+ * @return 0 on success, -1 on error.
+ */
+int fleet_report_save(const char* path, FleetReportFormat format, const FleetReportRow* rows, uint32_t count,
+                      int64_t from, int64_t to);
+
+#endif // FLEET_REPORT_H
@@ -0,0 +1,220 @@
+#ifndef GLUCOSE_FILTER_H
+#define GLUCOSE_FILTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "analysis.h"
+#include "config.h"
+#include "data_generator.h"
+#include "glucose_kernels.h"
+
+/**
+ * @file glucose_filter.h
+ * @brief Streaming Kalman smoother of glucose readings, with their rate of change.
+ *
+ * Each patient's readings are tracked by a constant-velocity Kalman
+ * filter: the state is the glucose level and its rate of change in
+ * mg/dL per minute, and the true rate is allowed to drift (random
+ * acceleration). Per patient this is O(1) state, the estimate and its
+ * 2x2 covariance, updated in O(1) per reading with the actual time since
+ * the previous reading. Sensor noise that makes two raw samples differ
+ * by more than the rapid-change threshold barely moves the filtered rate,
+ * whereas a sustained change does.
+ *
+ * GlucoseFilter follows one patient reading by reading, as the ingest
+ * loop does. GlucoseFilterBank holds the same state for many patients in
+ * columns and updates all of them for one tick in a single branch-free,
+ * vectorized pass, as the simulation loop does. Both follow the same
+ * rules: a missing or stale reading leaves the filter unchanged, and
+ * each patient restarts after a gap of their own.
+ *
+ * Trend and rapid-change alarms can be computed from either series:
+ * GLUCOSE_SERIES_RAW compares the two newest raw readings, as
+ * calculate_glucose_trend() and evaluate_glucose_alarms() do, and
+ * GLUCOSE_SERIES_FILTERED uses the filtered rate over the interval since
+ * the previous reading. Level alarms (hypo/hyperglycemia) always use the
+ * raw reading, so smoothing never delays them.
+ */
+
+#define GLUCOSE_FILTER_MEASUREMENT_SD 10.0 // mg/dL, sensor noise of a reading
+#define GLUCOSE_FILTER_ACCELERATION_SD 0.5  // mg/dL per minute per sqrt(minute), drift of the true rate
+#define GLUCOSE_FILTER_INITIAL_RATE_SD 2.0  // mg/dL per minute, rate uncertainty before the second reading
+#define GLUCOSE_FILTER_MAX_GAP_MIN 60.0     // Longer gaps restart the filter from the next reading
+
+// Which series trend and rapid-change rules look at
+typedef enum {
+    GLUCOSE_SERIES_RAW = 0,   // The two newest raw readings
+    GLUCOSE_SERIES_FILTERED   // The filtered rate of change
+} GlucoseSeries;
+
+// Noise model of the filter
+typedef struct {
+    double measurement_variance; // (mg/dL)^2
+    double process_noise;        // Variance added to the rate per minute, (mg/dL/min)^2 / min
+} GlucoseFilterParams;
+
+// Filter state of one patient
+typedef struct {
+    double level;       // Filtered glucose, mg/dL
+    double rate;        // Filtered rate of change, mg/dL per minute
+    double p00;         // Covariance of the estimate: level variance,
+    double p01;         // level/rate covariance,
+    double p11;         // and rate variance
+    double interval;    // Minutes between the two latest readings
+    int64_t last_time;  // Time of the latest reading
+    uint32_t readings;  // Readings since the filter (re)started
+} GlucoseFilter;
+
+// Filter state of many patients, one column per GlucoseFilter field. Times
+// and reading counts are doubles too, so the update loop uses one lane width.
+typedef struct {
+    double* level;
+    double* rate;
+    double* p00;
+    double* p01;
+    double* p11;
+    double* interval;   // Minutes between each patient's two latest readings
+    double* last_time;  // Time of each patient's latest reading, in seconds
+    double* readings;   // Readings since each filter (re)started
+    size_t count;       // Patients in the bank
+} GlucoseFilterBank;
+
+/**
+ * @brief Returns the default noise model for CGM readings.
+ *
+ * @return GlucoseFilterParams structure with default values.
+ */
+GlucoseFilterParams glucose_filter_default_params(void);
+
+/**
+ * @brief Resets a patient's filter; the next reading starts it.
+ *
+ * @param filter Pointer to the GlucoseFilter structure to initialize.
+ * @return 0 on success, -1 on error.
+ */
+int glucose_filter_init(GlucoseFilter* filter);
+
+/**
+ * @brief Adds a reading to a patient's filter.
+ *
+ * Readings that are not positive, or not newer than the previous one,
+ * are ignored. After a gap longer than GLUCOSE_FILTER_MAX_GAP_MIN the
+ * filter restarts from the reading.
+ *
+ * @param filter Pointer to the patient's GlucoseFilter.
+ * @param params Pointer to the noise model.
+ * @param value Reading in mg/dL.
+ * @param timestamp Time of the reading.
+ * @return 0 on success, -1 on error or if the reading was ignored.
+ */
+int glucose_filter_update(GlucoseFilter* filter, const GlucoseFilterParams* params, double value, time_t timestamp);
+
+/**
+ * @brief Allocates a bank of filters, all waiting for their first reading.
+ *
+ * @param bank Pointer to the GlucoseFilterBank structure to initialize.
+ * @param count Number of patients.
+ * @return 0 on success, -1 on error.
+ */
+int glucose_filter_bank_init(GlucoseFilterBank* bank, size_t count);
+
+/**
+ * @brief Grows a bank; the added filters wait for their first reading.
+ *
+ * @param bank Pointer to the GlucoseFilterBank structure.
+ * @param count Number of patients wanted; a smaller count leaves the bank as is.
+ * @return 0 on success, -1 on error (the bank is unchanged).
+ */
+int glucose_filter_bank_grow(GlucoseFilterBank* bank, size_t count);
+
+/**
+ * @brief Frees the columns of a bank.
+ *
+ * @param bank Pointer to the GlucoseFilterBank structure to destroy.
+ * @return 0 on success, -1 on error.
+ */
+int glucose_filter_bank_destroy(GlucoseFilterBank* bank);
+
+/**
+ * @brief Adds one tick of readings to every filter of a bank.
+ *
+ * Entry i of values and times belongs to patient i, and bit i of the
+ * validity bitmap (layout of glucose_kernels.h) tells whether patient i
+ * has a reading this tick; other entries of values may hold anything.
+ * Each reading is handled as glucose_filter_update() would: a value that
+ * is not positive or not newer than the patient's previous reading is
+ * ignored, the prediction spans the time since that reading, and a gap
+ * longer than GLUCOSE_FILTER_MAX_GAP_MIN restarts the patient's filter.
+ * The loop has no branches, so the compiler updates several patients per
+ * vector instruction.
+ *
+ * @param bank Pointer to the GlucoseFilterBank structure.
+ * @param params Pointer to the noise model.
+ * @param values Reading of each patient for this tick, bank->count entries.
+ * @param valid Validity bitmap of values, GLUCOSE_VALIDITY_WORDS(bank->count) words.
+ * @param times Time of each reading in seconds, bank->count entries.
+ * @return Number of readings added, or -1 on error.
+ */
+long glucose_filter_bank_update(GlucoseFilterBank* bank, const GlucoseFilterParams* params,
+                                const double* values, const uint64_t* valid, const double* times);
+
+/**
+ * @brief Copies one patient's filter out of a bank.
+ *
+ * @param bank Pointer to the GlucoseFilterBank structure.
+ * @param index Patient in the bank.
+ * @param filter Pointer to the GlucoseFilter structure to fill.
+ * @return 0 on success, -1 on error.
+ */
+int glucose_filter_bank_get(const GlucoseFilterBank* bank, size_t index, GlucoseFilter* filter);
+
+/**
+ * @brief Stores one patient's filter into a bank, e.g. after glucose_filter_update().
+ *
+ * @param bank Pointer to the GlucoseFilterBank structure.
+ * @param index Patient in the bank.
+ * @param filter Pointer to the patient's GlucoseFilter.
+ * @return 0 on success, -1 on error.
+ */
+int glucose_filter_bank_set(GlucoseFilterBank* bank, size_t index, const GlucoseFilter* filter);
+
+/**
+ * @brief Returns the change since the previous reading according to a series.
+ *
+ * @param data Pointer to the patient's GeneratedData.
+ * @param filter Pointer to the patient's GlucoseFilter (used for GLUCOSE_SERIES_FILTERED).
+ * @param series Series to look at.
+ * @param change Pointer to receive the change in mg/dL.
+ * @return 0 on success, -1 on error or if the series has no previous reading yet.
+ */
+int glucose_series_change(const GeneratedData* data, const GlucoseFilter* filter, GlucoseSeries series,
+                          double* change);
+
+/**
+ * @brief Returns the glucose trend according to a series.
+ *
+ * @param data Pointer to the patient's GeneratedData.
+ * @param filter Pointer to the patient's GlucoseFilter (used for GLUCOSE_SERIES_FILTERED).
+ * @param series Series to look at.
+ * @return GlucoseTrend value; TREND_STABLE without a previous reading.
+ */
+GlucoseTrend glucose_series_trend(const GeneratedData* data, const GlucoseFilter* filter, GlucoseSeries series);
+
+/**
+ * @brief Evaluates alarms with rapid changes taken from a series.
+ *
+ * Level alarms use the raw reading in both cases. With
+ * GLUCOSE_SERIES_RAW this is exactly evaluate_glucose_alarms().
+ *
+ * @param data Pointer to the patient's GeneratedData.
+ * @param filter Pointer to the patient's GlucoseFilter (used for GLUCOSE_SERIES_FILTERED).
+ * @param series Series to take rapid changes from.
+ * @param config Pointer to the Config structure containing thresholds.
+ * @param flags Pointer to receive the active AlarmFlag bits.
+ * @return 0 on success, -1 on error.
+ */
+int glucose_series_alarms(const GeneratedData* data, const GlucoseFilter* filter, GlucoseSeries series,
+                          const Config* config, unsigned int* flags);
+
+#endif // GLUCOSE_FILTER_H
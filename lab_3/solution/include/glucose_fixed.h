@@ -0,0 +1,46 @@
+#ifndef GLUCOSE_FIXED_H
+#define GLUCOSE_FIXED_H
+
+#include <stdint.h>
+
+/**
+ * @file glucose_fixed.h
+ * @brief Compact 16-bit fixed-point representation of glucose readings.
+ *
+ * Sensors report 30-400 mg/dL with at most 0.1 mg/dL resolution, so a
+ * reading fits in an unsigned 16-bit count of tenths of a mg/dL. Histories,
+ * checkpoints and the fixed-point array kernels use this form; values are
+ * converted to floating point only where statistics are computed. Whether
+ * a history entry holds a reading is tracked in GeneratedData's
+ * history_valid bits; entries without one hold 0.
+ */
+
+typedef uint16_t GlucoseFixed;
+
+#define GLUCOSE_FIXED_SCALE 10       // Fixed-point units per mg/dL
+#define GLUCOSE_FIXED_MAX UINT16_MAX // 6553.5 mg/dL, far above any sensor range
+
+/**
+ * @brief Converts a reading in mg/dL to fixed point, rounding to the nearest 0.1 mg/dL.
+ *
+ * @param glucose_value Reading in mg/dL.
+ * @return Fixed-point reading, clamped to 0..GLUCOSE_FIXED_MAX.
+ */
+static inline GlucoseFixed glucose_to_fixed(double glucose_value) {
+    double scaled = glucose_value * GLUCOSE_FIXED_SCALE + 0.5;
+    if (!(scaled >= 0.0)) return 0; // Also catches NaN
+    if (scaled >= (double)GLUCOSE_FIXED_MAX) return GLUCOSE_FIXED_MAX;
+    return (GlucoseFixed)scaled;
+}
+
+/**
+ * @brief Converts a fixed-point reading back to mg/dL.
+ *
+ * @param glucose_value Fixed-point reading.
+ * @return Reading in mg/dL.
+ */
+static inline double glucose_from_fixed(GlucoseFixed glucose_value) {
+    return (double)glucose_value / GLUCOSE_FIXED_SCALE;
+}
+
+#endif // GLUCOSE_FIXED_H
@@ -0,0 +1,237 @@
+#ifndef GLUCOSE_KERNELS_H
+#define GLUCOSE_KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "analysis.h"
+#include "config.h"
+#include "glucose_fixed.h"
+
+/**
+ * @file glucose_kernels.h
+ * @brief Array kernels over contiguous buffers of glucose readings.
+ *
+ * These functions apply the analysis and alarm rules to whole arrays of
+ * readings (oldest first) instead of one GeneratedData at a time. They are
+ * built into libglucose.so so that callers outside the engine, such as the
+ * dashboard, can run them directly on their own buffers.
+ *
+ * Arrays with gaps (sensor warm-up, dropouts) come with a validity bitmap
+ * instead of a 0.0 sentinel: bit i % 64 of word i / 64 is set if entry i
+ * holds a reading. On little-endian hosts this is the byte layout of an
+ * Apache Arrow validity bitmap. The masked kernels ignore whatever the
+ * entries without a reading hold, NaN included, without branching on them.
+ */
+
+#define GLUCOSE_VALIDITY_WORDS(count) (((count) + 63) / 64) // Bitmap words for count entries
+
+// Running statistics that can be updated, reverted and merged in O(1)
+typedef struct {
+    uint64_t count;       // Number of readings accumulated
+    uint64_t below_range; // Readings below the hypoglycemia threshold
+    uint64_t in_range;    // Readings within the target range
+    uint64_t above_range; // Readings above the hyperglycemia threshold
+    double mean;          // Mean glucose value
+    double m2;            // Sum of squared deviations from the mean
+} GlucoseAccumulator;
+
+/**
+ * @brief Initializes an empty accumulator.
+ *
+ * @param acc Pointer to the GlucoseAccumulator structure to initialize.
+ * @return 0 on success, -1 on error.
+ */
+int glucose_accumulator_init(GlucoseAccumulator* acc);
+
+/**
+ * @brief Adds readings to the accumulator.
+ *
+ * @param acc Pointer to the GlucoseAccumulator structure to update.
+ * @param values Readings to add.
+ * @param count Number of readings.
+ * @param config Pointer to the Config structure containing threshold values.
+ * @return 0 on success, -1 on error.
+ */
+int glucose_accumulator_add(GlucoseAccumulator* acc, const double* values, size_t count, const Config* config);
+
+/**
+ * @brief Adds fixed-point readings to the accumulator.
+ *
+ * Gives the same statistics as glucose_accumulator_add() on the readings
+ * converted to mg/dL, but sums blocks of readings in integer arithmetic,
+ * sixteen readings per AVX2 instruction, and converts each block's sums
+ * to floating point only once.
+ *
+ * @param acc Pointer to the GlucoseAccumulator structure to update.
+ * @param values Fixed-point readings to add.
+ * @param count Number of readings.
+ * @param config Pointer to the Config structure containing threshold values.
+ * @return 0 on success, -1 on error.
+ */
+int glucose_accumulator_add_fixed(GlucoseAccumulator* acc, const GlucoseFixed* values, size_t count,
+                                  const Config* config);
+
+/**
+ * @brief Adds the valid readings of an array with gaps to the accumulator.
+ *
+ * Gives the same statistics as glucose_accumulator_add() on the valid
+ * readings alone. Each block of 64 readings is summed with its validity
+ * word as a mask, several lanes per vector instruction, and merged in.
+ *
+ * @param acc Pointer to the GlucoseAccumulator structure to update.
+ * @param values Readings, valid or not.
+ * @param valid Validity bitmap of values.
+ * @param count Number of entries.
+ * @param config Pointer to the Config structure containing threshold values.
+ * @return 0 on success, -1 on error.
+ */
+int glucose_accumulator_add_masked(GlucoseAccumulator* acc, const double* values, const uint64_t* valid,
+                                   size_t count, const Config* config);
+
+/**
+ * @brief Removes readings previously added to the accumulator.
+ *
+ * @param acc Pointer to the GlucoseAccumulator structure to update.
+ * @param values Readings to remove.
+ * @param count Number of readings.
+ * @param config Pointer to the Config structure used when they were added.
+ * @return 0 on success, -1 on error (removing more readings than were added).
+ */
+int glucose_accumulator_remove(GlucoseAccumulator* acc, const double* values, size_t count, const Config* config);
+
+/**
+ * @brief Merges one accumulator into another.
+ *
+ * @param acc Pointer to the GlucoseAccumulator structure to update.
+ * @param other Pointer to the GlucoseAccumulator structure to merge in.
+ * @return 0 on success, -1 on error.
+ */
+int glucose_accumulator_merge(GlucoseAccumulator* acc, const GlucoseAccumulator* other);
+
+/**
+ * @brief Converts an accumulator into the engine's GlucoseStats form.
+ *
+ * @param acc Pointer to the GlucoseAccumulator structure to read.
+ * @param stats Pointer to receive the statistics.
+ * @return 0 on success, -1 on error.
+ */
+int glucose_accumulator_to_stats(const GlucoseAccumulator* acc, GlucoseStats* stats);
+
+/**
+ * @brief Evaluates the alarm rules for every reading in an array.
+ *
+ * Each reading is compared with the one before it for rapid changes; a
+ * previous value of 0.0 means no data, as in the engine's history.
+ *
+ * @param values Readings, oldest first.
+ * @param count Number of readings.
+ * @param config Pointer to the Config structure containing thresholds.
+ * @param flags Array of count entries to receive the AlarmFlag bits.
+ * @return Number of readings with at least one alarm, or -1 on error.
+ */
+long glucose_scan_alarms(const double* values, size_t count, const Config* config, uint8_t* flags);
+
+/**
+ * @brief Evaluates the alarm rules for every entry of an array with gaps.
+ *
+ * Entries without a reading get no alarm. A rapid change is only
+ * evaluated between two adjacent valid readings, so a gap is never taken
+ * for a change. The loop is branch-free over each 64-entry block.
+ *
+ * @param values Readings, oldest first, valid or not.
+ * @param valid Validity bitmap of values.
+ * @param count Number of entries.
+ * @param config Pointer to the Config structure containing thresholds.
+ * @param flags Array of count entries to receive the AlarmFlag bits.
+ * @return Number of readings with at least one alarm, or -1 on error.
+ */
+long glucose_scan_alarms_masked(const double* values, const uint64_t* valid, size_t count, const Config* config,
+                                uint8_t* flags);
+
+/**
+ * @brief Evaluates the alarm rules for every fixed-point reading in an array.
+ *
+ * Same rules as glucose_scan_alarms(), compared in tenths of a mg/dL, so
+ * the loop runs on 16-bit lanes without converting the readings. Changes
+ * are exact: a change of exactly the rapid-change threshold never alarms,
+ * whereas the difference of two doubles such as 83.4 and 53.4 can round
+ * past it.
+ *
+ * @param values Fixed-point readings, oldest first.
+ * @param count Number of readings.
+ * @param config Pointer to the Config structure containing thresholds.
+ * @param flags Array of count entries to receive the AlarmFlag bits.
+ * @return Number of readings with at least one alarm, or -1 on error.
+ */
+long glucose_scan_alarms_fixed(const GlucoseFixed* values, size_t count, const Config* config, uint8_t* flags);
+
+/**
+ * @brief Evaluates the alarm rules for a run of patients with their own thresholds.
+ *
+ * Entry i of every array belongs to the same patient, e.g. patients with
+ * consecutive ids, whose thresholds are read straight from a ConfigTable's
+ * columns starting at the first id. The loop has no branches, so the
+ * compiler evaluates several patients per vector instruction.
+ *
+ * @param values Current reading of each patient.
+ * @param previous Previous reading of each patient, or 0.0 if none.
+ * @param hypoglycemia Hypoglycemia threshold of each patient.
+ * @param hyperglycemia Hyperglycemia threshold of each patient.
+ * @param rapid_change Rapid change threshold of each patient.
+ * @param count Number of patients.
+ * @param flags Array of count entries to receive the AlarmFlag bits.
+ * @return Number of patients with at least one alarm, or -1 on error.
+ */
+long glucose_scan_alarm_columns(const double* restrict values, const double* restrict previous,
+                                const int32_t* restrict hypoglycemia, const int32_t* restrict hyperglycemia,
+                                const int32_t* restrict rapid_change, size_t count, uint8_t* restrict flags);
+
+/**
+ * @brief Builds the validity bitmap of an array that marks gaps with 0.0.
+ *
+ * Entries that are not positive (0.0, negative or NaN) are not valid.
+ * Bits past count in the last word are cleared.
+ *
+ * @param values Readings.
+ * @param count Number of entries.
+ * @param valid Array of GLUCOSE_VALIDITY_WORDS(count) words to receive the bitmap.
+ * @return Number of valid entries.
+ */
+size_t glucose_validity_from_values(const double* values, size_t count, uint64_t* valid);
+
+/**
+ * @brief Fills short gaps by linear interpolation between the readings around them.
+ *
+ * A run of at most max_gap entries without a reading, with a reading on
+ * both sides, is filled in place and marked valid. Longer gaps and gaps
+ * at either end of the array are left alone, so a dropout is never
+ * bridged with made-up data beyond the limit. Entries are assumed to be
+ * evenly spaced in time.
+ *
+ * @param values Readings, oldest first; filled entries are overwritten.
+ * @param valid Validity bitmap of values; bits of filled entries are set.
+ * @param count Number of entries.
+ * @param max_gap Longest gap to fill, in entries (0 fills nothing).
+ * @return Number of entries filled.
+ */
+size_t glucose_interpolate_gaps(double* values, uint64_t* valid, size_t count, size_t max_gap);
+
+/**
+ * @brief Selects the points to draw for a downsampled chart.
+ *
+ * Uses largest-triangle-three-buckets (LTTB): the first and last points are
+ * always kept and one point is picked per bucket in between, namely the one
+ * forming the largest triangle with the previously picked point and the
+ * average of the next bucket. Peaks and dips survive downsampling.
+ *
+ * @param x Point x coordinates (e.g. timestamps), ascending.
+ * @param y Point y coordinates (e.g. glucose values).
+ * @param count Number of points.
+ * @param threshold Maximum number of points to select (at least 3 to downsample).
+ * @param indices Array of at least min(count, threshold) entries to receive
+ *                the selected point indices in ascending order.
+ * @return Number of selected points, or 0 on error.
+ */
+size_t glucose_lttb(const double* x, const double* y, size_t count, size_t threshold, size_t* indices);
+
+#endif // GLUCOSE_KERNELS_H
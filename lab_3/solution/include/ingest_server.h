@@ -0,0 +1,129 @@
+#ifndef INGEST_SERVER_H
+#define INGEST_SERVER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file ingest_server.h
+ * @brief Epoll-based server that receives device readings over local sockets.
+ *
+ * Device gateways connect over a Unix-domain socket or loopback TCP and
+ * stream length-prefixed binary frames, each carrying a batch of
+ * (patient, timestamp, value) records. One thread serves thousands of
+ * connections with edge-triggered epoll; complete frames are handed to a
+ * callback straight out of the receive buffer.
+ *
+ * Frame layout (little-endian, host byte order on the local machine):
+ *   IngestFrameHeader       16 bytes
+ *   IngestRecord[count]     16 bytes each
+ *
+ * Frames are multiples of 16 bytes, so records inside the receive buffer
+ * are always naturally aligned. A frame with INGEST_FLAG_ACK set is
+ * answered with an IngestAck once its records have been processed.
+ */
+
+#define INGEST_FRAME_VERSION 1
+#define INGEST_FLAG_ACK 0x01           // Reply with an IngestAck after processing
+#define INGEST_MAX_BATCH 1024          // Maximum records per frame
+#define INGEST_DEFAULT_SOCKET "/tmp/glucose_ingest.sock"
+
+// Frame header
+typedef struct {
+    uint32_t length;   // Total frame size in bytes, header included
+    uint8_t version;   // INGEST_FRAME_VERSION
+    uint8_t flags;     // INGEST_FLAG_* bits
+    uint16_t count;    // Number of records that follow
+    uint32_t sequence; // Sender-chosen frame number, echoed in the ack
+    uint32_t reserved;
+} IngestFrameHeader;
+
+// One device reading
+typedef struct {
+    uint32_t patient_id;
+    float glucose_value; // mg/dL; NaN reports a sensor dropout of a known patient
+    int64_t timestamp;   // Unix time of the reading
+} IngestRecord;
+
+// Reply to a frame sent with INGEST_FLAG_ACK
+typedef struct {
+    uint32_t sequence; // Sequence of the acknowledged frame
+    uint32_t accepted; // Records the handler accepted
+} IngestAck;
+
+/**
+ * @brief Callback invoked for every complete frame.
+ *
+ * @param context Caller-supplied pointer given to ingest_server_open().
+ * @param records Records of the frame (valid only during the call).
+ * @param count Number of records.
+ * @return Number of records accepted.
+ */
+typedef uint32_t (*IngestHandler)(void* context, const IngestRecord* records, size_t count);
+
+// Per-connection state; only a partially received frame is buffered
+typedef struct {
+    uint8_t* pending;          // Start of an incomplete frame, or NULL
+    uint32_t pending_length;   // Bytes held in pending
+    uint32_t pending_capacity; // Bytes allocated for pending
+    int open;                  // Non-zero while the descriptor is a connection
+} IngestConnection;
+
+// Counters since the server was opened
+typedef struct {
+    uint64_t connections_accepted;
+    uint64_t connections_closed;
+    uint64_t frames;
+    uint64_t records;
+    uint64_t bytes;
+    uint64_t protocol_errors; // Connections dropped for malformed frames
+    uint64_t ack_errors;      // Connections dropped for a partial ack or a peer gone before it
+} IngestStats;
+
+// Structure to hold the server
+typedef struct {
+    int epoll_fd;
+    int unix_fd;                   // Listening Unix-domain socket, or -1
+    int tcp_fd;                    // Listening loopback TCP socket, or -1
+    char unix_path[108];
+    IngestConnection* connections; // Indexed by file descriptor
+    uint32_t connection_capacity;  // Highest supported descriptor + 1
+    uint32_t open_connections;
+    uint8_t* buffer;               // Receive buffer shared by all connections
+    size_t buffer_size;
+    IngestHandler handler;
+    void* context;
+    IngestStats stats;
+} IngestServer;
+
+/**
+ * @brief Opens the listening sockets and the epoll instance.
+ *
+ * @param server Pointer to the IngestServer structure to initialize.
+ * @param unix_path Unix-domain socket path, or NULL for none.
+ * @param tcp_port Loopback TCP port, or 0 for none.
+ * @param handler Callback for complete frames.
+ * @param context Pointer passed to the handler.
+ * @return 0 on success, -1 on error.
+ */
+int ingest_server_open(IngestServer* server, const char* unix_path, uint16_t tcp_port,
+                       IngestHandler handler, void* context);
+
+/**
+ * @brief Waits for socket activity and processes it.
+ *
+ * @param server Pointer to the open IngestServer.
+ * @param timeout_ms Maximum time to wait in milliseconds (-1 waits forever).
+ * @return Number of records processed, or -1 on error.
+ */
+long ingest_server_poll(IngestServer* server, int timeout_ms);
+
+/**
+ * @brief Closes every connection and listening socket.
+ *
+ * @param server Pointer to the IngestServer to close.
+ * @return 0 on success, -1 on error.
+ */
+int ingest_server_close(IngestServer* server);
+
+#endif // INGEST_SERVER_H
@@ -0,0 +1,153 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @file latency.h
+ * @brief Per-stage latency instrumentation backed by HDR-style histograms.
+ *
+ * Each thread records into its own histogram set, so the hot path never
+ * shares a cache line with another writer. Readers merge all per-thread
+ * histograms when a summary is requested. Threads beyond
+ * LATENCY_MAX_THREADS share one overflow histogram set, updated with
+ * locked adds, so their samples are still counted.
+ *
+ * Instrumentation is compiled in when GLUCOSE_LATENCY is defined (the
+ * default, see the Makefile) and is switched on at runtime with
+ * latency_set_enabled(). When compiled in but disabled, each stage costs a
+ * single relaxed load and a predictable branch.
+ */
+
+// Stages of a controller tick that can be timed
+typedef enum {
+    LATENCY_STAGE_GENERATE, // generate_glucose_data()
+    LATENCY_STAGE_ANALYZE,  // update_glucose_statistics()
+    LATENCY_STAGE_ALARM,    // check_alarms()
+    LATENCY_STAGE_READING,  // Arrival of a reading to its alarm decision
+    LATENCY_STAGE_RENDER,   // Drawing and sending one terminal UI frame
+    LATENCY_STAGE_COUNT
+} LatencyStage;
+
+// Histogram resolution: 2^LATENCY_SUB_BUCKET_BITS linear sub-buckets per power of two
+#define LATENCY_SUB_BUCKET_BITS 5
+#define LATENCY_SUB_BUCKET_COUNT (1 << LATENCY_SUB_BUCKET_BITS)
+#define LATENCY_MAX_VALUE_BITS 40 // Values are clamped at ~18 minutes
+#define LATENCY_BUCKET_COUNT ((LATENCY_MAX_VALUE_BITS - LATENCY_SUB_BUCKET_BITS + 1) * LATENCY_SUB_BUCKET_COUNT)
+
+// Threads with a recorder of their own: every shard of a ShardRuntime, plus the
+// controller and tools. Further threads share one overflow recorder.
+#define LATENCY_MAX_THREADS 72
+
+// Structure to hold a merged latency summary for one stage
+typedef struct {
+    uint64_t count;   // Number of recorded samples
+    uint64_t p50_ns;  // Median latency in nanoseconds
+    uint64_t p99_ns;  // 99th percentile latency in nanoseconds
+    uint64_t p999_ns; // 99.9th percentile latency in nanoseconds
+    uint64_t max_ns;  // Largest recorded latency in nanoseconds
+    double mean_ns;   // Mean latency in nanoseconds
+} LatencySummary;
+
+extern int latency_enabled_flag;
+
+/**
+ * @brief Reports whether latency recording is enabled at runtime.
+ *
+ * @return true if stages should be timed, false otherwise.
+ */
+static inline bool latency_is_enabled(void) {
+    return __atomic_load_n(&latency_enabled_flag, __ATOMIC_RELAXED) != 0;
+}
+
+/**
+ * @brief Enables or disables latency recording at runtime.
+ *
+ * @param enabled true to start recording, false to stop.
+ * @return 0 on success, -1 on error.
+ */
+int latency_set_enabled(bool enabled);
+
+/**
+ * @brief Reads the monotonic clock in nanoseconds.
+ *
+ * @return Current monotonic time in nanoseconds.
+ */
+uint64_t latency_now_ns(void);
+
+/**
+ * @brief Records one latency sample into the calling thread's histogram.
+ *
+ * @param stage Stage the sample belongs to.
+ * @param elapsed_ns Measured duration in nanoseconds.
+ * @return 0 on success, -1 on error (invalid stage).
+ */
+int latency_record(LatencyStage stage, uint64_t elapsed_ns);
+
+/**
+ * @brief Merges all per-thread histograms for a stage into a summary.
+ *
+ * @param stage Stage to summarize.
+ * @param summary Pointer to the LatencySummary structure to fill.
+ * @return 0 on success, -1 on error.
+ */
+int latency_get_summary(LatencyStage stage, LatencySummary* summary);
+
+/**
+ * @brief Merges all per-thread histograms for a stage into cumulative counts at given bounds.
+ *
+ * counts[i] receives the samples whose histogram bucket lies at or below
+ * bounds_ns[i], the way Prometheus histogram buckets count. A bucket that
+ * straddles a bound is counted at the next bound, so each count can miss
+ * samples within the histogram's resolution (about 3%) below its bound.
+ *
+ * @param stage Stage to export.
+ * @param bounds_ns Ascending upper bounds in nanoseconds.
+ * @param bound_count Number of bounds.
+ * @param counts Array of bound_count cumulative counts to fill.
+ * @param count Pointer to receive the number of samples, including those above every bound.
+ * @param total_ns Pointer to receive the sum of all samples in nanoseconds.
+ * @return 0 on success, -1 on error.
+ */
+int latency_get_histogram(LatencyStage stage, const uint64_t* bounds_ns, int bound_count, uint64_t* counts,
+                          uint64_t* count, uint64_t* total_ns);
+
+/**
+ * @brief Returns the display name of a stage.
+ *
+ * @param stage Stage to name.
+ * @return Constant string naming the stage, or "unknown".
+ */
+const char* latency_stage_name(LatencyStage stage);
+
+/**
+ * @brief Clears every recorded sample in all per-thread histograms.
+ *
+ * Intended for benchmarks and tests. Must not run while any thread
+ * records: the clear is a plain memset, so a concurrent sample can be lost
+ * or survive the reset half-written.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int latency_reset(void);
+
+/**
+ * @brief Prints p50/p99/p999/max latency for every stage with samples.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int print_latency_report(void);
+
+#ifdef GLUCOSE_LATENCY
+#define LATENCY_BEGIN(start) uint64_t start = latency_is_enabled() ? latency_now_ns() : 0
+#define LATENCY_END(stage, start) \
+    do { \
+        if (start != 0) latency_record((stage), latency_now_ns() - start); \
+    } while (0)
+#else
+#define LATENCY_BEGIN(start) ((void)0)
+#define LATENCY_END(stage, start) ((void)0)
+#endif
+
+#endif // LATENCY_H
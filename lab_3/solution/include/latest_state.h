@@ -0,0 +1,104 @@
+#ifndef LATEST_STATE_H
+#define LATEST_STATE_H
+
+#include <stdint.h>
+#include "analysis.h"
+#include "patient_registry.h"
+
+/**
+ * @file latest_state.h
+ * @brief In-process table of every patient's latest state for lock-free readers.
+ *
+ * The engine thread owns the patient registry and may not be blocked by
+ * dashboards, report jobs or the API. Instead it copies each patient's
+ * latest reading, trend, alarm state and raw GlucoseStats into a slot of
+ * this table after every update. Each slot has its own seqlock: the
+ * writer never waits, and readers copy the slot and retry if the writer
+ * was in the middle of it, so they never see a torn GlucoseStats.
+ *
+ * Slots are indexed like registry slots (PatientHandle.slot) and allocated
+ * in pages of PATIENT_SLAB_CAPACITY that are never moved or freed while
+ * the table is in use, so readers can hold no reference that goes stale.
+ * Only one thread may publish to a table; any number may read it.
+ */
+
+#define LATEST_STATE_PAGE_SLOTS PATIENT_SLAB_CAPACITY
+#define LATEST_STATE_MAX_PAGES PATIENT_REGISTRY_MAX_SLABS
+#define LATEST_STATE_SLOT_SIZE 128 // Two cache lines, so neighbouring slots never share one
+
+// Latest state of one patient, as published
+typedef struct {
+    uint32_t patient_id;      // 0 = slot never published
+    uint32_t alarm_flags;     // AlarmFlag bits of the latest reading
+    int64_t timestamp;        // Unix time of the latest reading
+    double glucose_value;     // Latest reading in mg/dL
+    int32_t trend;            // GlucoseTrend value
+    uint32_t alarm_count;     // Readings that raised at least one alarm
+    GlucoseStats stats;       // Running statistics, as kept in PatientState
+} LatestState;
+
+// One slot: seqlock sequence and the state it guards
+typedef struct {
+    uint64_t sequence;        // Seqlock: odd while being written
+    LatestState state;
+    uint8_t reserved[LATEST_STATE_SLOT_SIZE - sizeof(uint64_t) - sizeof(LatestState)];
+} LatestStateSlot;
+
+// Structure to hold the table
+typedef struct {
+    LatestStateSlot* pages[LATEST_STATE_MAX_PAGES]; // Allocated by the writer, published with a release store
+    uint32_t slot_count;      // Highest published slot + 1 (atomic)
+    uint64_t publish_count;   // Slot updates so far (atomic)
+} LatestStateTable;
+
+/**
+ * @brief Initializes an empty table.
+ *
+ * @param table Pointer to the LatestStateTable structure to initialize.
+ * @return 0 on success, -1 on error.
+ */
+int latest_state_init(LatestStateTable* table);
+
+/**
+ * @brief Frees every page. No reader may use the table afterwards.
+ *
+ * @param table Pointer to the LatestStateTable structure to destroy.
+ * @return 0 on success, -1 on error.
+ */
+int latest_state_destroy(LatestStateTable* table);
+
+/**
+ * @brief Publishes a patient's latest state into a slot (writer thread only).
+ *
+ * Never blocks on readers. The slot's page is allocated on first use.
+ *
+ * @param table Pointer to the LatestStateTable structure.
+ * @param slot Slot to write, usually the patient's registry slot.
+ * @param patient Pointer to the patient's state.
+ * @return 0 on success, -1 on error (invalid slot or out of memory).
+ */
+int latest_state_publish(LatestStateTable* table, uint32_t slot, const PatientState* patient);
+
+/**
+ * @brief Copies a consistent snapshot of a slot, from any thread.
+ *
+ * Retries without locking while the writer is updating the slot, yielding
+ * the CPU now and then in case the writer was preempted in the middle of it.
+ *
+ * @param table Pointer to the LatestStateTable structure.
+ * @param slot Slot to read.
+ * @param state Pointer to the LatestState structure to fill.
+ * @param retries Pointer to receive the number of retried copies, or NULL.
+ * @return 0 on success, -1 if the slot has never been published.
+ */
+int latest_state_read(const LatestStateTable* table, uint32_t slot, LatestState* state, uint32_t* retries);
+
+/**
+ * @brief Returns the number of slots readers should consider, from any thread.
+ *
+ * @param table Pointer to the LatestStateTable structure.
+ * @return Highest published slot + 1.
+ */
+uint32_t latest_state_slot_count(const LatestStateTable* table);
+
+#endif // LATEST_STATE_H
@@ -0,0 +1,159 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "latest_state.h"
+
+/**
+ * @file metrics.h
+ * @brief Engine counters and gauges, served in Prometheus text format on localhost.
+ *
+ * Like the latency histograms (see latency.h), every thread counts into
+ * its own block: a counter update is a relaxed load and store on a cache
+ * line no other thread writes, never a locked instruction. Gauges (queue
+ * depths, memory held by a thread's tables) are set by the thread that
+ * owns what they measure. Nothing is aggregated until a scrape, which
+ * sums the blocks of all threads. Threads beyond METRICS_MAX_THREADS
+ * share one overflow block, whose counters take a locked add.
+ *
+ * The metrics server answers GET /metrics on 127.0.0.1 from its own
+ * thread with:
+ *
+ *   glucose_readings_total, glucose_readings_rejected_total
+ *   glucose_alarms_total{type}            Alarms raised, by AlarmFlag
+ *   glucose_stage_latency_seconds{stage}  Histogram per LatencyStage
+ *   glucose_queue_depth{queue}            Gauges below
+ *   glucose_ingest_connections
+ *   glucose_memory_bytes{area}            Registry and latest-state tables
+ *   process_resident_memory_bytes, process_virtual_memory_bytes
+ *   glucose_patients, glucose_patients_in_alarm{type}
+ *
+ * The last two are read from a LatestStateTable on every scrape, when the
+ * server is given one. Latency buckets only fill while latency recording
+ * is enabled (latency_set_enabled()).
+ */
+
+// Threads with a recorder of their own: every shard of a ShardRuntime, plus the
+// controller and tools. Further threads share one overflow recorder.
+#define METRICS_MAX_THREADS 72
+#define METRICS_CACHE_LINE 64
+#define METRICS_BACKLOG 16
+#define METRICS_POLL_MS 250       // Longest wait before the server notices it should stop
+#define METRICS_REQUEST_MAX 2048  // Bytes of a request read before it is answered
+#define METRICS_TIMEOUT_S 2       // Receive and send timeout of a scrape connection
+
+// Monotonic counters
+typedef enum {
+    METRIC_READINGS,           // Readings processed
+    METRIC_REJECTED,           // Readings dropped (invalid value or registry full)
+    METRIC_ALARM_HYPOGLYCEMIA, // Readings that raised each alarm
+    METRIC_ALARM_HYPERGLYCEMIA,
+    METRIC_ALARM_RAPID_INCREASE,
+    METRIC_ALARM_RAPID_DECREASE,
+    METRIC_COUNTER_COUNT
+} MetricCounter;
+
+// Gauges, summed over the threads that set them
+typedef enum {
+    METRIC_GAUGE_INGEST_CONNECTIONS, // Open ingest connections
+    METRIC_GAUGE_WAL_GROUP,          // WAL records waiting for the next group commit
+    METRIC_GAUGE_RESTORE_PENDING,    // Restored patients still only in the mapped checkpoint
+    METRIC_GAUGE_ARROW_PENDING,      // Rows buffered for the next Arrow record batches
+    METRIC_GAUGE_SHARD_INBOX,        // Readings routed to shards and not yet taken
+    METRIC_GAUGE_REGISTRY_BYTES,     // Slabs and id index of patient registries
+    METRIC_GAUGE_COUNT
+} MetricGauge;
+
+// Counters of the server since it was started
+typedef struct {
+    uint64_t scrapes;      // GET /metrics answered
+    uint64_t bad_requests; // Other requests, answered with an error status
+} MetricsServerStats;
+
+// Structure to hold a running metrics server
+typedef struct {
+    int listen_fd;
+    uint16_t port;                  // Port listened on, also when started on port 0
+    const LatestStateTable* latest; // Scanned on every scrape, or NULL
+    pthread_t thread;
+    int running;
+    int stop;                       // Set to ask the thread to exit (atomic)
+    MetricsServerStats stats;       // Written by the server thread only
+} MetricsServer;
+
+/**
+ * @brief Adds to a counter of the calling thread.
+ *
+ * @param counter Counter to add to.
+ * @param amount Amount to add.
+ * @return 0 on success, -1 on error (invalid counter).
+ */
+int metrics_count(MetricCounter counter, uint64_t amount);
+
+/**
+ * @brief Counts one processed reading and the alarms it raised.
+ *
+ * @param alarm_flags AlarmFlag bits of the reading.
+ * @return 0 on success.
+ */
+int metrics_count_reading(unsigned int alarm_flags);
+
+/**
+ * @brief Sets the calling thread's part of a gauge.
+ *
+ * Threads beyond METRICS_MAX_THREADS share one part, which holds the
+ * value set last.
+ *
+ * @param gauge Gauge to set.
+ * @param value Value as seen by the calling thread.
+ * @return 0 on success, -1 on error (invalid gauge).
+ */
+int metrics_set_gauge(MetricGauge gauge, uint64_t value);
+
+/**
+ * @brief Sums a counter over all threads.
+ *
+ * @param counter Counter to read.
+ * @return Sum of the counter, 0 if invalid.
+ */
+uint64_t metrics_get_counter(MetricCounter counter);
+
+/**
+ * @brief Sums a gauge over all threads.
+ *
+ * @param gauge Gauge to read.
+ * @return Sum of the gauge, 0 if invalid.
+ */
+uint64_t metrics_get_gauge(MetricGauge gauge);
+
+/**
+ * @brief Renders every metric in Prometheus text exposition format (version 0.0.4).
+ *
+ * @param latest Pointer to the table to count patients in, or NULL.
+ * @param text Pointer to receive the text, to be freed by the caller.
+ * @param length Pointer to receive the length of the text.
+ * @return 0 on success, -1 on error.
+ */
+int metrics_render(const LatestStateTable* latest, char** text, size_t* length);
+
+/**
+ * @brief Starts serving GET /metrics on 127.0.0.1 from a new thread.
+ *
+ * @param server Pointer to the MetricsServer structure to initialize.
+ * @param port TCP port, or 0 for any free port (see server->port).
+ * @param latest Pointer to the table to count patients in on every scrape, or NULL.
+ * @return 0 on success, -1 on error.
+ */
+int metrics_server_start(MetricsServer* server, uint16_t port, const LatestStateTable* latest);
+
+/**
+ * @brief Stops the server thread and closes its socket.
+ *
+ * @param server Pointer to the MetricsServer structure.
+ * @return 0 on success, -1 on error.
+ */
+int metrics_server_stop(MetricsServer* server);
+
+#endif // METRICS_H
@@ -0,0 +1,175 @@
+#ifndef PATIENT_REGISTRY_H
+#define PATIENT_REGISTRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "data_generator.h"
+#include "analysis.h"
+#include "config.h"
+
+/**
+ * @file patient_registry.h
+ * @brief Slab-allocated registry of per-patient monitoring state.
+ *
+ * Patient state is stored densely in fixed-size slabs that are allocated
+ * once and never returned to the allocator until the registry is
+ * destroyed, so adding and removing patients never fragments the heap and
+ * never costs a malloc per patient. Removing a patient moves the last
+ * active patient into the freed position, keeping iteration over active
+ * patients contiguous. Callers refer to patients through handles that
+ * carry a generation counter, so a handle to a removed patient is detected
+ * instead of silently aliasing the slot's next occupant. Patients can also
+ * be found by their external identifier through an open-addressing index,
+ * so readings arriving from outside the engine are routed in O(1).
+ */
+
+// Number of patients stored in one slab
+#define PATIENT_SLAB_CAPACITY 1024
+
+// Maximum number of slabs (limits the registry to 4M patients)
+#define PATIENT_REGISTRY_MAX_SLABS 4096
+
+// Structure to hold everything the engine tracks for one patient
+typedef struct {
+    uint32_t patient_id;      // External patient identifier
+    GeneratedData data;       // Latest reading and glucose history
+    GlucoseStats stats;       // Running statistics
+    unsigned int alarm_flags; // AlarmFlag bits of the latest reading
+    uint32_t alarm_count;     // Readings that raised at least one alarm
+    Config config;            // Thresholds used for this patient
+} PatientState;
+
+// Stable reference to a registered patient
+typedef struct {
+    uint32_t slot;       // Slot index, stable while the patient is registered
+    uint32_t generation; // Incremented whenever the slot is reused
+} PatientHandle;
+
+// One slab: dense patient storage plus the handle tables for its index range
+typedef struct {
+    PatientState states[PATIENT_SLAB_CAPACITY];          // Dense state, indexed by position
+    uint32_t dense_to_slot[PATIENT_SLAB_CAPACITY];       // Owning slot of each dense position
+    uint32_t slot_to_dense[PATIENT_SLAB_CAPACITY];       // Dense position (or next free slot)
+    uint32_t slot_generation[PATIENT_SLAB_CAPACITY];     // Current generation of each slot
+} PatientSlab;
+
+// Structure to hold the registry
+typedef struct {
+    PatientSlab* slabs[PATIENT_REGISTRY_MAX_SLABS];
+    uint32_t slab_count;   // Slabs allocated so far
+    uint32_t active_count; // Registered patients (dense size)
+    uint32_t slot_count;   // Slots handed out at least once
+    uint32_t free_slot;    // Head of the free slot list, or UINT32_MAX
+    uint32_t* id_index;    // Patient id -> slot + 1 (0 = empty), linear probing
+    uint32_t id_index_capacity; // Power of two, kept at least twice active_count
+} PatientRegistry;
+
+/**
+ * @brief Initializes an empty registry.
+ *
+ * @param registry Pointer to the PatientRegistry structure to initialize.
+ * @return 0 on success, -1 on error.
+ */
+int patient_registry_init(PatientRegistry* registry);
+
+/**
+ * @brief Releases every slab owned by the registry.
+ *
+ * @param registry Pointer to the PatientRegistry structure to destroy.
+ * @return 0 on success, -1 on error.
+ */
+int patient_registry_destroy(PatientRegistry* registry);
+
+/**
+ * @brief Preallocates slabs for at least the given number of patients.
+ *
+ * @param registry Pointer to the PatientRegistry structure.
+ * @param patient_count Number of patients to reserve room for.
+ * @return 0 on success, -1 on error.
+ */
+int patient_registry_reserve(PatientRegistry* registry, uint32_t patient_count);
+
+/**
+ * @brief Registers a patient in O(1), reusing a freed slot if one exists.
+ *
+ * The new patient's history, statistics and alarm state start empty.
+ *
+ * @param registry Pointer to the PatientRegistry structure.
+ * @param patient_id External patient identifier, unique within the registry.
+ * @param config Pointer to the thresholds to use for this patient.
+ * @param handle Pointer to receive the patient's handle.
+ * @return 0 on success, -1 on error (invalid arguments, duplicate id or registry full).
+ */
+int patient_registry_add(PatientRegistry* registry, uint32_t patient_id,
+                         const Config* config, PatientHandle* handle);
+
+/**
+ * @brief Unregisters a patient in O(1).
+ *
+ * The last active patient is moved into the freed dense position, so
+ * pointers returned by patient_registry_get() or patient_registry_at()
+ * must not be held across a removal.
+ *
+ * @param registry Pointer to the PatientRegistry structure.
+ * @param handle Handle of the patient to remove.
+ * @return 0 on success, -1 on error (invalid or stale handle).
+ */
+int patient_registry_remove(PatientRegistry* registry, PatientHandle handle);
+
+/**
+ * @brief Looks up a patient's state by handle.
+ *
+ * @param registry Pointer to the PatientRegistry structure.
+ * @param handle Handle returned by patient_registry_add().
+ * @return Pointer to the patient's state, or NULL if the handle is stale.
+ */
+PatientState* patient_registry_get(PatientRegistry* registry, PatientHandle handle);
+
+/**
+ * @brief Looks up a patient's state by external identifier.
+ *
+ * @param registry Pointer to the PatientRegistry structure.
+ * @param patient_id External patient identifier.
+ * @param index Optional pointer to receive the patient's dense position.
+ * @return Pointer to the patient's state, or NULL if the id is not registered.
+ */
+PatientState* patient_registry_find(PatientRegistry* registry, uint32_t patient_id, uint32_t* index);
+
+/**
+ * @brief Returns the patient at a dense position for iteration.
+ *
+ * Positions 0 .. patient_registry_count() - 1 are always occupied.
+ *
+ * @param registry Pointer to the PatientRegistry structure.
+ * @param index Dense position.
+ * @return Pointer to the patient's state, or NULL if out of range.
+ */
+PatientState* patient_registry_at(PatientRegistry* registry, uint32_t index);
+
+/**
+ * @brief Returns the handle of the patient at a dense position.
+ *
+ * @param registry Pointer to the PatientRegistry structure.
+ * @param index Dense position.
+ * @param handle Pointer to receive the patient's handle.
+ * @return 0 on success, -1 on error (out of range).
+ */
+int patient_registry_handle_at(const PatientRegistry* registry, uint32_t index, PatientHandle* handle);
+
+/**
+ * @brief Returns the number of registered patients.
+ *
+ * @param registry Pointer to the PatientRegistry structure.
+ * @return Number of registered patients (0 if registry is NULL).
+ */
+uint32_t patient_registry_count(const PatientRegistry* registry);
+
+/**
+ * @brief Returns the memory currently held by the registry.
+ *
+ * @param registry Pointer to the PatientRegistry structure.
+ * @return Bytes used by the registry, its slabs and its id index.
+ */
+size_t patient_registry_memory_bytes(const PatientRegistry* registry);
+
+#endif // PATIENT_REGISTRY_H
@@ -0,0 +1,188 @@
+#ifndef READING_ARCHIVE_H
+#define READING_ARCHIVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "glucose_fixed.h"
+
+/**
+ * @file reading_archive.h
+ * @brief Append-only, block-indexed archive of every reading, for retrospective scans.
+ *
+ * Readings are spread over ARCHIVE_SHARDS shards by patient id, so all
+ * readings of a patient live in one shard in arrival order. Each shard
+ * buffers ARCHIVE_BLOCK_READINGS readings and writes them as one columnar
+ * block: patient ids, then times as offsets from the block's first
+ * second, then fixed-point values, 10 bytes per reading. A separate index
+ * file holds one entry per block with its file offset and the minimum and
+ * maximum patient id, time and value, so scans decide which blocks to
+ * read from the index alone (see archive_scan.h).
+ *
+ * The archive is for analysis, not recovery: blocks still buffered when
+ * the process dies, or whose write fails, are lost, and the write-ahead
+ * log remains the source of truth for patient state. Opening an archive
+ * drops index entries and data left behind by an interrupted block write.
+ *
+ * Directory layout:
+ *   shard-SS.dat   Block payloads, back to back
+ *   shard-SS.idx   ArchiveBlockIndex per block, in file order
+ */
+
+#define ARCHIVE_SHARDS 64
+#define ARCHIVE_BLOCK_READINGS 4096
+#define ARCHIVE_PATH_MAX 256
+#define ARCHIVE_READING_BYTES (sizeof(uint32_t) + sizeof(uint32_t) + sizeof(GlucoseFixed))
+#define ARCHIVE_TIME_LIMIT ((int64_t)1 << 40) // Reading times are kept in [0, ARCHIVE_TIME_LIMIT)
+
+// Index entry of one block
+typedef struct {
+    uint64_t offset;         // Position of the payload in the shard's data file
+    uint32_t count;          // Readings in the block
+    uint32_t min_patient_id;
+    uint32_t max_patient_id;
+    GlucoseFixed min_value;
+    GlucoseFixed max_value;
+    int64_t min_time;        // Reading times are stored as offsets from this
+    int64_t max_time;
+    uint64_t payload_checksum; // Of the payload, checked by scans that ask for it
+    uint64_t checksum;         // Of this entry up to here
+} ArchiveBlockIndex;
+
+typedef char archive_block_index_size_check[sizeof(ArchiveBlockIndex) == 56 ? 1 : -1];
+
+// Readings of one shard waiting to become a block
+typedef struct {
+    uint32_t patient_id[ARCHIVE_BLOCK_READINGS];
+    int64_t time[ARCHIVE_BLOCK_READINGS];
+    GlucoseFixed value[ARCHIVE_BLOCK_READINGS];
+    uint32_t count;
+    int64_t min_time;        // Earliest and latest buffered time, valid while count > 0
+    int64_t max_time;
+    int data_fd;             // Shard data file, opened with the archive; -1 if that failed
+    int index_fd;            // Shard index file, opened with the archive; -1 if that failed
+    uint64_t data_size;      // Bytes of valid payload in the data file
+    uint64_t index_size;     // Bytes of valid entries in the index file
+} ArchiveShard;
+
+// Counters since the archive was opened
+typedef struct {
+    uint64_t readings;      // Readings appended
+    uint64_t blocks;        // Blocks written
+    uint64_t bytes_written; // Payload and index bytes written
+    uint64_t rejected;      // Readings with a time outside [0, ARCHIVE_TIME_LIMIT), not buffered
+    uint64_t dropped;       // Buffered readings lost to a failed block write
+} ArchiveStats;
+
+// Structure to hold an archive open for appending
+typedef struct {
+    char directory[ARCHIVE_PATH_MAX];
+    ArchiveShard* shards;    // ARCHIVE_SHARDS buffers, about 57 KiB each
+    uint8_t* payload;        // One block being encoded
+    ArchiveStats stats;
+} ReadingArchive;
+
+/**
+ * @brief Opens or creates an archive directory for appending.
+ *
+ * @param archive Pointer to the ReadingArchive structure to initialize.
+ * @param directory Archive directory; created if missing.
+ * @return 0 on success, -1 on error.
+ */
+int reading_archive_open(ReadingArchive* archive, const char* directory);
+
+/**
+ * @brief Buffers a reading, writing its shard's block when the block is full.
+ *
+ * A block stores times as 32-bit offsets from its earliest second, so a
+ * reading that would stretch the buffered block past that span has the
+ * block written first. A block that cannot be written is dropped and
+ * counted in stats.dropped; the shard keeps buffering from empty.
+ *
+ * @param archive Pointer to the ReadingArchive structure.
+ * @param patient_id External patient identifier.
+ * @param reading_time Time of the reading, in [0, ARCHIVE_TIME_LIMIT).
+ * @param value Reading in fixed point.
+ * @return 0 on success, -1 on error (time rejected or a block could not be written).
+ */
+int reading_archive_append(ReadingArchive* archive, uint32_t patient_id, time_t reading_time, GlucoseFixed value);
+
+/**
+ * @brief Writes every partly filled block, e.g. periodically or before a scan.
+ *
+ * @param archive Pointer to the ReadingArchive structure.
+ * @return 0 on success, -1 on error.
+ */
+int reading_archive_flush(ReadingArchive* archive);
+
+/**
+ * @brief Flushes the archive and closes its files.
+ *
+ * @param archive Pointer to the ReadingArchive structure to close.
+ * @return 0 on success, -1 on error.
+ */
+int reading_archive_close(ReadingArchive* archive);
+
+/**
+ * @brief Returns the shard holding a patient's readings.
+ *
+ * @param patient_id External patient identifier.
+ * @return Shard number, 0 .. ARCHIVE_SHARDS - 1.
+ */
+uint32_t reading_archive_shard(uint32_t patient_id);
+
+/**
+ * @brief Builds the path of a shard's data or index file.
+ *
+ * @param directory Archive directory.
+ * @param shard Shard number.
+ * @param index Non-zero for the index file, zero for the data file.
+ * @param path Buffer of ARCHIVE_PATH_MAX bytes to receive the path.
+ * @return 0 on success, -1 on error (path too long).
+ */
+int reading_archive_path(const char* directory, uint32_t shard, int index, char* path);
+
+/**
+ * @brief Reads and validates a shard's block index.
+ *
+ * Entries after the first invalid one, or past the end of the data file,
+ * are not returned.
+ *
+ * @param directory Archive directory.
+ * @param shard Shard number.
+ * @param entries Pointer to receive a malloc'ed array of entries (NULL if none).
+ * @param count Pointer to receive the number of entries.
+ * @return 0 on success (a missing shard has no entries), -1 on error.
+ */
+int reading_archive_load_index(const char* directory, uint32_t shard, ArchiveBlockIndex** entries, uint32_t* count);
+
+/**
+ * @brief Computes the checksum of a block payload.
+ *
+ * @param payload Pointer to the payload.
+ * @param length Payload bytes, a multiple of 8.
+ * @return Checksum.
+ */
+uint64_t reading_archive_checksum(const void* payload, size_t length);
+
+/**
+ * @brief Returns where a column starts in a block payload.
+ *
+ * Payloads hold uint32_t patient ids, uint32_t time offsets and
+ * GlucoseFixed values, count of each, in that order.
+ *
+ * @param count Readings in the block.
+ * @param column 0 = patient ids, 1 = time offsets, 2 = values.
+ * @return Byte offset of the column.
+ */
+size_t reading_archive_column_offset(uint32_t count, int column);
+
+/**
+ * @brief Returns the size of a block payload.
+ *
+ * @param count Readings in the block.
+ * @return Payload bytes, padded to a multiple of 8.
+ */
+size_t reading_archive_payload_bytes(uint32_t count);
+
+#endif // READING_ARCHIVE_H
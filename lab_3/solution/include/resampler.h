@@ -0,0 +1,126 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * @file resampler.h
+ * @brief Streaming resampler of irregular readings onto a fixed time grid.
+ *
+ * Devices and gateways deliver readings at jittered, irregular times,
+ * whereas windowed and variability metrics assume evenly spaced samples.
+ * The resampler turns each patient's readings into a series on a grid of
+ * fixed interval (e.g. 1, 5 or 15 minutes), aligned to the epoch so every
+ * patient's grid points fall at the same times.
+ *
+ * It runs incrementally, one reading at a time: a reading completes every
+ * grid point between the previous reading and itself, each linearly
+ * interpolated between the two. If the two readings are further apart than
+ * the gap limit, those grid points are marked missing instead of being
+ * bridged. A grid point is therefore known once the first reading after
+ * it arrives.
+ *
+ * Each patient's series is a dense array of values plus a validity bitmap
+ * in the layout of glucose_kernels.h, starting at a bitmap word boundary,
+ * so the masked kernels (glucose_accumulator_add_masked(),
+ * glucose_scan_alarms_masked()) consume it without copying. A series keeps
+ * at least the last window_points grid points; older ones are dropped in
+ * blocks, in amortized O(1) per point.
+ *
+ * Series are indexed by registry slot (PatientHandle.slot) and remember
+ * their patient id, so a reused slot starts a new series.
+ */
+
+#define RESAMPLER_DEFAULT_INTERVAL 300 // Seconds between grid points (5 minutes)
+#define RESAMPLER_DEFAULT_MAX_GAP 1200 // Readings further apart are not interpolated between (20 minutes)
+#define RESAMPLER_DEFAULT_WINDOW 256   // Grid points kept per patient, at least (21 hours at 5 minutes)
+
+// Grid and gap limit of a resampler
+typedef struct {
+    uint32_t interval;      // Seconds between grid points
+    uint32_t max_gap;       // Seconds; longer gaps between readings leave their grid points missing
+    uint32_t window_points; // Grid points kept per patient, rounded up to a multiple of 64
+} ResamplerOptions;
+
+// Resampled series of one patient
+typedef struct {
+    uint32_t patient_id;    // Owner, to detect reuse of the registry slot (0 = unused)
+    uint32_t count;         // Grid points in values
+    int64_t start_time;     // Time of values[0]
+    int64_t last_time;      // Time of the latest reading
+    double last_value;      // Latest reading in mg/dL
+    double* values;         // Grid values in mg/dL, 2 * window_points entries, allocated on first use
+    uint64_t* valid;        // Validity bitmap of values
+} ResampledSeries;
+
+// Counters of a resampler
+typedef struct {
+    uint64_t readings;      // Readings accepted
+    uint64_t rejected;      // Readings not newer than the previous one, or not positive
+    uint64_t points;        // Grid points produced
+    uint64_t missing;       // Grid points produced as missing (gap limit exceeded)
+    uint64_t restarts;      // Series restarted after a gap longer than their window
+} ResamplerStats;
+
+// Structure to hold the resampler
+typedef struct {
+    ResamplerOptions options;
+    ResampledSeries* series; // Indexed by registry slot
+    uint32_t capacity;       // Slots with a series
+    ResamplerStats stats;
+} Resampler;
+
+/**
+ * @brief Returns the default options: a 5-minute grid and a 20-minute gap limit.
+ *
+ * @return ResamplerOptions structure with default values.
+ */
+ResamplerOptions resampler_default_options(void);
+
+/**
+ * @brief Initializes an empty resampler.
+ *
+ * @param resampler Pointer to the Resampler structure to initialize.
+ * @param options Pointer to the grid and gap limit; interval and window_points must not be 0.
+ * @return 0 on success, -1 on error.
+ */
+int resampler_init(Resampler* resampler, const ResamplerOptions* options);
+
+/**
+ * @brief Frees every series.
+ *
+ * @param resampler Pointer to the Resampler structure to destroy.
+ * @return 0 on success, -1 on error.
+ */
+int resampler_destroy(Resampler* resampler);
+
+/**
+ * @brief Adds a patient's reading and completes the grid points up to it.
+ *
+ * Readings that are not positive, or not newer than the patient's
+ * previous one, are rejected.
+ *
+ * @param resampler Pointer to the Resampler structure.
+ * @param slot Series to update, usually the patient's registry slot.
+ * @param patient_id Patient the reading belongs to.
+ * @param timestamp Time of the reading.
+ * @param value Reading in mg/dL.
+ * @return Number of grid points completed (possibly 0), or -1 on error or rejection.
+ */
+long resampler_add(Resampler* resampler, uint32_t slot, uint32_t patient_id, time_t timestamp, double value);
+
+/**
+ * @brief Returns a patient's resampled series.
+ *
+ * The pointer, and the arrays it holds, stay valid until the next call to
+ * resampler_add() or resampler_destroy().
+ *
+ * @param resampler Pointer to the Resampler structure.
+ * @param slot Series to return.
+ * @return Pointer to the series, or NULL if the slot has none.
+ */
+const ResampledSeries* resampler_series(const Resampler* resampler, uint32_t slot);
+
+#endif // RESAMPLER_H
@@ -0,0 +1,166 @@
+#ifndef RISK_INDEX_H
+#define RISK_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "patient_registry.h"
+#include "rollup_cube.h"
+
+/**
+ * @file risk_index.h
+ * @brief Incrementally maintained "patients at risk" rankings.
+ *
+ * Each ranking is an indexed binary max-heap of patient scores. A position
+ * table maps every registry slot to its place in the heap, so a patient's
+ * score is inserted, changed or removed in O(log n) as soon as their
+ * statistics change, and the worst K patients are read from the top of
+ * the heap in O(K log K) without touching the rest of the fleet.
+ */
+
+// Largest K accepted by risk_index_top()
+#define RISK_INDEX_TOP_MAX 256
+
+// What a ranking orders patients by
+typedef enum {
+    RISK_BY_CURRENT_LOW = 0,   // Lowest current glucose first, every patient with a reading
+    RISK_BY_TIME_BELOW_RANGE,  // Highest share of the last 24 hours' readings below range first, patients with any
+    RISK_BY_ALARM_COUNT,       // Most alarms first, patients with any
+    RISK_CRITERION_COUNT
+} RiskCriterion;
+
+// One ranked patient
+typedef struct {
+    double score;        // Larger is worse; the current low ranking stores -glucose
+    uint32_t patient_id; // External patient identifier
+    uint32_t slot;       // Registry slot, stable while the patient is registered
+} RiskEntry;
+
+// Structure to hold one ranking
+typedef struct {
+    RiskEntry* heap;            // Max-heap of ranked patients
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t* position;         // Slot -> heap position + 1, 0 = not ranked
+    uint32_t position_capacity;
+} RiskIndex;
+
+// Structure to hold one ranking per criterion
+typedef struct {
+    RiskIndex indexes[RISK_CRITERION_COUNT];
+} RiskRanking;
+
+/**
+ * @brief Initializes an empty ranking.
+ *
+ * @param index Pointer to the RiskIndex structure to initialize.
+ * @return 0 on success, -1 on error.
+ */
+int risk_index_init(RiskIndex* index);
+
+/**
+ * @brief Releases the heap and position table of a ranking.
+ *
+ * @param index Pointer to the RiskIndex structure to destroy.
+ * @return 0 on success, -1 on error.
+ */
+int risk_index_destroy(RiskIndex* index);
+
+/**
+ * @brief Inserts a patient or changes their score in O(log n).
+ *
+ * @param index Pointer to the RiskIndex structure.
+ * @param slot Registry slot of the patient.
+ * @param patient_id External patient identifier, used to break ties.
+ * @param score New score; larger is worse.
+ * @return 0 on success, -1 on error (invalid arguments or out of memory).
+ */
+int risk_index_update(RiskIndex* index, uint32_t slot, uint32_t patient_id, double score);
+
+/**
+ * @brief Removes a patient in O(log n); patients not ranked are ignored.
+ *
+ * @param index Pointer to the RiskIndex structure.
+ * @param slot Registry slot of the patient.
+ * @return 0 on success, -1 on error.
+ */
+int risk_index_remove(RiskIndex* index, uint32_t slot);
+
+/**
+ * @brief Copies the K worst patients, worst first, in O(K log K).
+ *
+ * Equal scores are ordered by patient id.
+ *
+ * @param index Pointer to the RiskIndex structure.
+ * @param k Number of patients wanted (at most RISK_INDEX_TOP_MAX).
+ * @param entries Array of at least k entries to receive the patients.
+ * @return Number of entries written (fewer than k if fewer are ranked).
+ */
+uint32_t risk_index_top(const RiskIndex* index, uint32_t k, RiskEntry* entries);
+
+/**
+ * @brief Returns the number of ranked patients.
+ *
+ * @param index Pointer to the RiskIndex structure.
+ * @return Number of ranked patients (0 if index is NULL).
+ */
+uint32_t risk_index_count(const RiskIndex* index);
+
+/**
+ * @brief Initializes one empty ranking per criterion.
+ *
+ * @param ranking Pointer to the RiskRanking structure to initialize.
+ * @return 0 on success, -1 on error.
+ */
+int risk_ranking_init(RiskRanking* ranking);
+
+/**
+ * @brief Releases every ranking.
+ *
+ * @param ranking Pointer to the RiskRanking structure to destroy.
+ * @return 0 on success, -1 on error.
+ */
+int risk_ranking_destroy(RiskRanking* ranking);
+
+/**
+ * @brief Re-ranks a patient whose statistics or alarms changed.
+ *
+ * Call after update_glucose_statistics(), the alarm check and
+ * rollup_cube_add(). A patient drops out of a ranking when they have no
+ * reading, no time below range or no alarms, respectively, so only
+ * patients at risk are ranked.
+ *
+ * Time below range is the share of readings below range in the hour of
+ * the latest reading and the 23 before it, read from the rollup cube.
+ * Without a cube (the shards of a ShardRuntime keep none, and restored
+ * patients are ranked before the cube is filled) the share of all
+ * readings in the patient's statistics is ranked instead.
+ *
+ * @param ranking Pointer to the RiskRanking structure.
+ * @param slot Registry slot of the patient.
+ * @param patient Pointer to the patient's current state.
+ * @param rollups Pointer to the cube holding the patient's hourly rollups, or NULL.
+ * @return 0 on success, -1 on error.
+ */
+int risk_ranking_update(RiskRanking* ranking, uint32_t slot, const PatientState* patient, const RollupCube* rollups);
+
+/**
+ * @brief Removes a patient from every ranking, e.g. before unregistering them.
+ *
+ * @param ranking Pointer to the RiskRanking structure.
+ * @param slot Registry slot of the patient.
+ * @return 0 on success, -1 on error.
+ */
+int risk_ranking_remove(RiskRanking* ranking, uint32_t slot);
+
+/**
+ * @brief Copies the K worst patients of one criterion, worst first.
+ *
+ * @param ranking Pointer to the RiskRanking structure.
+ * @param criterion Ranking to read.
+ * @param k Number of patients wanted (at most RISK_INDEX_TOP_MAX).
+ * @param entries Array of at least k entries to receive the patients.
+ * @return Number of entries written.
+ */
+uint32_t risk_ranking_top(const RiskRanking* ranking, RiskCriterion criterion, uint32_t k, RiskEntry* entries);
+
+#endif // RISK_INDEX_H
@@ -0,0 +1,202 @@
+#ifndef ROLLUP_CUBE_H
+#define ROLLUP_CUBE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "analysis.h"
+#include "config.h"
+#include "glucose_fixed.h"
+
+/**
+ * @file rollup_cube.h
+ * @brief Patient x day x hour rollups of glucose readings for reports.
+ *
+ * Every reading is added to the bucket of its patient, day and hour of day
+ * as it is analyzed. Buckets hold counts, sums and sums of squares in fixed
+ * point plus range counters, so they merge exactly in any order: hours
+ * compose into days, days into weeks, patients into a fleet. A report over
+ * any date range reads O(buckets) instead of re-reading raw readings.
+ *
+ * Each patient keeps a ring of the last ROLLUP_DAYS days. Day blocks are
+ * taken from shared chunks only for days with readings, so memory follows
+ * patient-days actually covered rather than patients times retention.
+ * Days and hours are counted in local time, using the UTC offset given at
+ * initialization.
+ */
+
+#define ROLLUP_DAYS 35          // Retention: any 30-day window plus five whole weeks
+#define ROLLUP_HOURS_PER_DAY 24
+#define ROLLUP_CHUNK_DAYS 1024  // Day blocks allocated at a time
+#define ROLLUP_MAX_CHUNKS 16384 // Limits the cube to 16M patient-days
+#define ROLLUP_MAX_AHEAD_DAYS 1 // Days a reading may lie after the newest day of the cube
+
+// Mergeable aggregate of the readings of one hour, or of any set of hours
+typedef struct {
+    uint32_t count;       // Readings
+    uint32_t below;       // Readings below the patient's hypoglycemia threshold
+    uint32_t above;       // Readings above the patient's hyperglycemia threshold
+    GlucoseFixed min;     // Lowest reading, 0 if count is 0
+    GlucoseFixed max;     // Highest reading
+    uint64_t sum;         // Sum of readings in fixed point
+    uint64_t sum_squares; // Sum of squared readings in fixed point
+} RollupBucket;
+
+typedef char rollup_bucket_size_check[sizeof(RollupBucket) == 32 ? 1 : -1];
+
+// The 24 hourly buckets of one patient-day
+typedef struct {
+    int32_t day;       // Local day number since the epoch
+    uint32_t next_free; // Free list link (block index + 1) while unused
+    RollupBucket hours[ROLLUP_HOURS_PER_DAY];
+} RollupDay;
+
+// Ring of a patient's day blocks
+typedef struct {
+    uint32_t patient_id;          // Owner, to detect reuse of the registry slot
+    uint32_t days[ROLLUP_DAYS];   // Day block index + 1 per ring position, 0 = none
+} RollupPatient;
+
+// Structure to hold the cube
+typedef struct {
+    RollupPatient* patients;    // Indexed by registry slot
+    uint32_t patient_capacity;
+    RollupDay* chunks[ROLLUP_MAX_CHUNKS];
+    uint32_t chunk_count;
+    uint32_t day_count;         // Day blocks handed out at least once
+    uint32_t free_day;          // Head of the free block list, block index + 1, 0 = empty
+    int32_t utc_offset;         // Seconds added to reading times to get local time
+    int64_t newest_day;         // Newest local day with a reading, INT64_MIN before the first
+    uint64_t late_readings;     // Readings older than the retained days, dropped
+    uint64_t future_readings;   // Readings too far after newest_day and today, dropped
+} RollupCube;
+
+/**
+ * @brief Initializes an empty cube.
+ *
+ * @param cube Pointer to the RollupCube structure to initialize.
+ * @param utc_offset Seconds east of UTC of the local time used for days and hours.
+ * @return 0 on success, -1 on error.
+ */
+int rollup_cube_init(RollupCube* cube, int32_t utc_offset);
+
+/**
+ * @brief Releases every patient ring and day block.
+ *
+ * @param cube Pointer to the RollupCube structure to destroy.
+ * @return 0 on success, -1 on error.
+ */
+int rollup_cube_destroy(RollupCube* cube);
+
+/**
+ * @brief Adds one reading to its patient's hourly bucket.
+ *
+ * Call next to update_glucose_statistics(), with the same thresholds.
+ * Only readings within a window around the newest day of the cube are
+ * kept: readings older than the retained days of the patient or of that
+ * day are counted in late_readings, and readings more than
+ * ROLLUP_MAX_AHEAD_DAYS after both that day and today (local wall-clock
+ * day) in future_readings, and are dropped. The first reading is checked
+ * against today too. A reading with a clock in the future therefore
+ * cannot claim a ring position and have every current reading of its day
+ * rejected as late, and one with a clock in the past (such as time 0)
+ * only anchors the window until the next current reading moves it.
+ *
+ * @param cube Pointer to the RollupCube structure.
+ * @param slot Registry slot of the patient.
+ * @param patient_id External patient identifier; a new id in a slot starts an empty ring.
+ * @param reading_time Time of the reading.
+ * @param value Reading in fixed point.
+ * @param config Pointer to the thresholds used for the range counters.
+ * @return 0 on success, -1 on error (invalid arguments, out of memory, late or future reading).
+ */
+int rollup_cube_add(RollupCube* cube, uint32_t slot, uint32_t patient_id, time_t reading_time,
+                    GlucoseFixed value, const Config* config);
+
+/**
+ * @brief Drops a patient's rollups, e.g. before unregistering them.
+ *
+ * @param cube Pointer to the RollupCube structure.
+ * @param slot Registry slot of the patient.
+ * @return 0 on success, -1 on error.
+ */
+int rollup_cube_remove(RollupCube* cube, uint32_t slot);
+
+/**
+ * @brief Returns the start of the local day holding a time.
+ *
+ * @param cube Pointer to the RollupCube structure.
+ * @param t Any time.
+ * @return Local midnight at or before t.
+ */
+time_t rollup_cube_day_start(const RollupCube* cube, time_t t);
+
+/**
+ * @brief Merges every hour of a patient that overlaps [from, to).
+ *
+ * @param cube Pointer to the RollupCube structure.
+ * @param slot Registry slot of the patient.
+ * @param from Start of the range.
+ * @param to End of the range (exclusive).
+ * @param totals Pointer to receive the merged bucket.
+ * @return 0 on success, -1 on error.
+ */
+int rollup_cube_totals(const RollupCube* cube, uint32_t slot, time_t from, time_t to, RollupBucket* totals);
+
+/**
+ * @brief Merges a patient's hours into consecutive windows, e.g. days or weeks.
+ *
+ * Window i covers bucket_hours hours from from + i * bucket_hours hours.
+ *
+ * @param cube Pointer to the RollupCube structure.
+ * @param slot Registry slot of the patient.
+ * @param from Start of the first window.
+ * @param bucket_hours Hours per window (1 = hourly, 24 = daily, 168 = weekly).
+ * @param window_count Number of windows.
+ * @param windows Array of window_count buckets to receive the totals.
+ * @return 0 on success, -1 on error.
+ */
+int rollup_cube_series(const RollupCube* cube, uint32_t slot, time_t from, uint32_t bucket_hours,
+                       uint32_t window_count, RollupBucket* windows);
+
+/**
+ * @brief Merges a patient's hours in [from, to) by hour of day, e.g. for TIR by hour.
+ *
+ * @param cube Pointer to the RollupCube structure.
+ * @param slot Registry slot of the patient.
+ * @param from Start of the range.
+ * @param to End of the range (exclusive).
+ * @param profile Array of ROLLUP_HOURS_PER_DAY buckets to receive the totals.
+ * @return 0 on success, -1 on error.
+ */
+int rollup_cube_hour_profile(const RollupCube* cube, uint32_t slot, time_t from, time_t to,
+                             RollupBucket profile[ROLLUP_HOURS_PER_DAY]);
+
+/**
+ * @brief Adds one bucket into another.
+ *
+ * @param into Pointer to the bucket to add to.
+ * @param from Pointer to the bucket to add.
+ */
+void rollup_bucket_merge(RollupBucket* into, const RollupBucket* from);
+
+/**
+ * @brief Converts a bucket into statistics as update_glucose_statistics() keeps them.
+ *
+ * The result can be printed with print_glucose_statistics().
+ *
+ * @param bucket Pointer to the bucket to convert.
+ * @param stats Pointer to the GlucoseStats structure to fill.
+ * @return 0 on success, -1 on error.
+ */
+int rollup_bucket_stats(const RollupBucket* bucket, GlucoseStats* stats);
+
+/**
+ * @brief Returns the memory currently held by the cube.
+ *
+ * @param cube Pointer to the RollupCube structure.
+ * @return Bytes used by the cube, its patient rings and day blocks.
+ */
+size_t rollup_cube_memory_bytes(const RollupCube* cube);
+
+#endif // ROLLUP_CUBE_H
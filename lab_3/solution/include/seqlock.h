@@ -0,0 +1,60 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @file seqlock.h
+ * @brief Sequence-lock helpers for single-writer, many-reader records.
+ *
+ * The writer makes the sequence odd before changing a record and even
+ * again afterwards. Readers never block the writer: they read the
+ * sequence, copy the record, and retry if the sequence was odd or changed
+ * in the meantime. Only one thread may write a given record.
+ */
+
+/**
+ * @brief Marks the start of a write (sequence becomes odd).
+ *
+ * @param sequence Pointer to the record's sequence counter.
+ */
+static inline void seqlock_write_begin(uint64_t* sequence) {
+    uint64_t value = __atomic_load_n(sequence, __ATOMIC_RELAXED);
+    __atomic_store_n(sequence, value + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Marks the end of a write (sequence becomes even).
+ *
+ * @param sequence Pointer to the record's sequence counter.
+ */
+static inline void seqlock_write_end(uint64_t* sequence) {
+    uint64_t value = __atomic_load_n(sequence, __ATOMIC_RELAXED);
+    __atomic_store_n(sequence, value + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Starts a read attempt.
+ *
+ * @param sequence Pointer to the record's sequence counter.
+ * @return Sequence value to pass to seqlock_read_retry().
+ */
+static inline uint64_t seqlock_read_begin(const uint64_t* sequence) {
+    return __atomic_load_n(sequence, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Checks whether a read attempt must be repeated.
+ *
+ * @param sequence Pointer to the record's sequence counter.
+ * @param start Value returned by seqlock_read_begin().
+ * @return true if the copied record may be torn and must be read again.
+ */
+static inline bool seqlock_read_retry(const uint64_t* sequence, uint64_t start) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return (start & 1) != 0 || __atomic_load_n(sequence, __ATOMIC_RELAXED) != start;
+}
+
+#endif // SEQLOCK_H
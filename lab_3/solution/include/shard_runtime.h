@@ -0,0 +1,198 @@
+#ifndef SHARD_RUNTIME_H
+#define SHARD_RUNTIME_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#include "config.h"
+#include "config_store.h"
+#include "ingest_server.h"
+#include "patient_registry.h"
+#include "risk_index.h"
+
+/**
+ * @file shard_runtime.h
+ * @brief Shared-nothing runtime: patients hashed to shards, one pinned thread per shard.
+ *
+ * Each shard owns a patient registry, its rankings and its counters, and
+ * only the shard's own thread ever touches them, so the hot path takes no
+ * locks and shares no cache lines. Readings reach a shard either from the
+ * shard itself (simulation: each shard generates readings for its own
+ * patients, with its own random state) or through its inbox, a
+ * single-producer, single-consumer ring filled by one router thread, e.g.
+ * the ingest loop.
+ *
+ * Every shard regularly publishes a ShardSummary, a partial aggregate of
+ * its patients (counts, sums and its own top SHARD_TOP_K of each risk
+ * ranking), under a sequence lock. Fleet-wide questions are answered by
+ * merging the latest summary of every shard; shards never wait for
+ * readers.
+ */
+
+#define SHARD_MAX 64
+#define SHARD_INBOX_CAPACITY 4096      // Records per inbox, a power of two
+#define SHARD_TOP_K 16                 // Patients per ranking in a summary
+#define SHARD_PUBLISH_READINGS 4096    // Readings between summaries while busy
+#define SHARD_CACHE_LINE 64
+
+// Where shards get readings from
+typedef enum {
+    SHARD_MODE_SIMULATE = 0, // Each shard generates readings for its own patients
+    SHARD_MODE_INBOX         // Readings are routed to shards with shard_runtime_submit()
+} ShardMode;
+
+// How to run the shards
+typedef struct {
+    uint32_t shard_count;     // 0 = one per CPU the process may run on
+    ShardMode mode;
+    int pin;                  // Non-zero to pin each shard's thread to its own CPU
+    ConfigStore* thresholds;  // Per-patient thresholds, read without locking, or NULL
+    Config config;            // Thresholds when there is no store
+    uint32_t patient_count;   // Simulation: patients 1..N, each registered by its shard
+    uint32_t ticks;           // Simulation: ticks to run, 0 = until stopped
+    uint32_t tick_seconds;    // Simulation: time between a patient's readings
+    int realtime;             // Simulation: wait tick_seconds between ticks instead of running flat out
+    time_t start_time;        // Simulation: time of the first reading (realtime: the wall clock)
+    unsigned int seed;        // Simulation: combined with the shard number for each shard's random state
+} ShardRuntimeOptions;
+
+// Partial aggregate of one shard, or of the fleet once merged
+typedef struct {
+    uint32_t patients;
+    uint64_t readings;        // Readings processed
+    uint64_t alarms;          // Readings that raised at least one alarm
+    uint64_t rejected;        // Readings dropped (invalid value or registry full)
+    uint32_t ticks;           // Simulation ticks completed (merged: by the slowest shard)
+    uint32_t current_below;   // Patients whose latest reading is below their range
+    uint32_t current_in;
+    uint32_t current_above;
+    double current_sum;       // Sum of the latest readings, mg/dL
+    uint32_t top_count[RISK_CRITERION_COUNT];
+    RiskEntry top[RISK_CRITERION_COUNT][SHARD_TOP_K]; // Slots are only meaningful within their shard
+} ShardSummary;
+
+// Single-producer, single-consumer ring of records, head and tail on their own cache lines
+typedef struct {
+    uint64_t head;            // Next record to take, written by the shard (atomic)
+    char head_padding[SHARD_CACHE_LINE - sizeof(uint64_t)];
+    uint64_t tail;            // Next free entry, written by the router (atomic)
+    uint64_t cached_head;     // Router's last view of head, to avoid reading the shard's line
+    char tail_padding[SHARD_CACHE_LINE - 2 * sizeof(uint64_t)];
+    IngestRecord records[SHARD_INBOX_CAPACITY];
+} ShardInbox;
+
+struct ShardRuntime;
+
+// One shard; everything but the inbox tail and the published summary is private to its thread
+typedef struct {
+    ShardInbox inbox;
+    uint64_t summary_sequence; // Seqlock of summary
+    ShardSummary summary;
+    char summary_padding[SHARD_CACHE_LINE];
+
+    struct ShardRuntime* runtime; // Runtime the shard belongs to
+    PatientRegistry registry;
+    RiskRanking ranking;
+    ShardSummary local;        // Counters as the shard thread keeps them
+    uint8_t* range_by_slot;    // Range of each patient's latest reading: 0 none, 1 below, 2 in, 3 above
+    uint32_t range_capacity;
+    uint32_t index;
+    int cpu;                   // CPU the thread is pinned to, or -1
+    int reader;                // Configuration reader slot, or -1
+    unsigned int seed;
+    uint32_t since_publish;    // Readings since the last summary
+    int done;                  // Set once a simulating shard has run its ticks (atomic)
+    int failed;
+    pthread_t thread;
+} Shard;
+
+// Structure to hold the runtime
+typedef struct ShardRuntime {
+    ShardRuntimeOptions options;
+    Shard* shards[SHARD_MAX];  // Separately allocated, cache-line aligned
+    uint32_t shard_count;
+    uint32_t started;          // Threads running
+    int stop;                  // Set to ask the shards to exit (atomic)
+} ShardRuntime;
+
+/**
+ * @brief Returns options for a simulation on one shard per CPU.
+ *
+ * @return ShardRuntimeOptions structure with default values.
+ */
+ShardRuntimeOptions shard_runtime_default_options(void);
+
+/**
+ * @brief Allocates the shards and starts their threads.
+ *
+ * @param runtime Pointer to the ShardRuntime structure to initialize.
+ * @param options Pointer to the options, copied.
+ * @return 0 on success, -1 on error.
+ */
+int shard_runtime_start(ShardRuntime* runtime, const ShardRuntimeOptions* options);
+
+/**
+ * @brief Returns the shard that owns a patient.
+ *
+ * @param runtime Pointer to the ShardRuntime structure.
+ * @param patient_id External patient identifier.
+ * @return Shard number, 0 .. shard_count - 1.
+ */
+uint32_t shard_runtime_shard_of(const ShardRuntime* runtime, uint32_t patient_id);
+
+/**
+ * @brief Routes a reading to the inbox of the patient's shard.
+ *
+ * Only one thread may submit to a runtime. Fails without blocking when
+ * the inbox is full; the caller decides whether to retry or drop.
+ *
+ * @param runtime Pointer to the ShardRuntime structure (SHARD_MODE_INBOX).
+ * @param record Pointer to the reading.
+ * @return 0 on success, -1 if the inbox is full.
+ */
+int shard_runtime_submit(ShardRuntime* runtime, const IngestRecord* record);
+
+/**
+ * @brief Merges the latest summary of every shard into a fleet summary.
+ *
+ * Can be called from any thread while the shards run; each shard's part
+ * is as of its last publication.
+ *
+ * @param runtime Pointer to the ShardRuntime structure.
+ * @param fleet Pointer to the ShardSummary structure to fill; its top lists hold the fleet's top SHARD_TOP_K.
+ * @return 0 on success, -1 on error.
+ */
+int shard_runtime_summary(ShardRuntime* runtime, ShardSummary* fleet);
+
+/**
+ * @brief Returns the number of readings routed to inboxes and not yet taken by their shards.
+ *
+ * Can be called from any thread while the shards run.
+ *
+ * @param runtime Pointer to the ShardRuntime structure.
+ * @return Readings waiting in all inboxes.
+ */
+uint64_t shard_runtime_queued(ShardRuntime* runtime);
+
+/**
+ * @brief Returns non-zero once every simulating shard has run its ticks.
+ *
+ * @param runtime Pointer to the ShardRuntime structure.
+ * @return Non-zero if the shards are done.
+ */
+int shard_runtime_done(ShardRuntime* runtime);
+
+/**
+ * @brief Stops the shards after their inboxes drain, and frees the runtime.
+ *
+ * The final summaries are published before the threads exit, so
+ * shard_runtime_summary() may not be called afterwards; pass a fleet
+ * summary to receive them.
+ *
+ * @param runtime Pointer to the ShardRuntime structure.
+ * @param fleet Pointer to receive the final fleet summary, or NULL.
+ * @return 0 on success, -1 if a shard failed.
+ */
+int shard_runtime_stop(ShardRuntime* runtime, ShardSummary* fleet);
+
+#endif // SHARD_RUNTIME_H
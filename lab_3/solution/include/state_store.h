@@ -0,0 +1,310 @@
+#ifndef STATE_STORE_H
+#define STATE_STORE_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "patient_registry.h"
+#include "config.h"
+
+/**
+ * @file state_store.h
+ * @brief Write-ahead log and checkpoints of the patient registry.
+ *
+ * Every state change (patient added, patient removed, reading recorded) is
+ * appended to an in-memory group and written to the current WAL segment
+ * with a single write and fdatasync when the caller commits the group,
+ * so the cost of durability is paid once per tick instead of once per
+ * reading.
+ *
+ * A checkpoint snapshots every patient's metadata, statistics and alarm
+ * state into a compact index record, and the glucose history into a
+ * separate section. The snapshot is copied on the caller's thread, which
+ * also starts a new WAL segment; a background thread then adds a hash
+ * table from patient id to record, writes the file, renames it over the
+ * previous checkpoint and deletes the WAL segments it covers.
+ *
+ * Recovery memory-maps the latest checkpoint and replays the remaining
+ * segments. Adds and removes are applied in log order first; readings are
+ * then replayed by several threads, each owning the patients whose id
+ * falls in its partition, so every patient still sees its readings in
+ * order. A torn group at the end of a segment is ignored.
+ *
+ * An eager open copies every patient into the registry before returning.
+ * A lazy open only maps the checkpoint: a patient is copied into the
+ * registry the first time state_store_find_patient() touches it, and a
+ * background thread pages the rest in, most recently active first, for
+ * state_store_prefetch() to copy in small batches. WAL readings of a
+ * patient still on disk are held back and replayed when it is loaded.
+ *
+ * Directory layout:
+ *   checkpoint.bin        CheckpointHeader, CheckpointSlot[table_capacity],
+ *                         CheckpointIndexRecord[n], CheckpointHistory[n]
+ *   wal-NNNNNNNN.log      WalGroupHeader + WalRecord[count], repeated
+ */
+
+#define STATE_STORE_GROUP_CAPACITY 4096 // Initial group size; the group grows until committed
+#define STATE_STORE_PATH_MAX 256
+#define STATE_STORE_CHECKPOINT_FILE "checkpoint.bin"
+
+// Kinds of logged state change
+typedef enum {
+    WAL_RECORD_ADD = 1,     // Patient registered with the default thresholds
+    WAL_RECORD_REMOVE = 2,  // Patient unregistered
+    WAL_RECORD_READING = 3, // Reading recorded, followed by statistics and alarm update
+    WAL_RECORD_DROPOUT = 4  // Sensor dropout: a missing entry shifted into the history
+} WalRecordType;
+
+// One logged state change
+typedef struct {
+    uint32_t type;        // WalRecordType
+    uint32_t patient_id;
+    int64_t timestamp;    // Reading time (WAL_RECORD_READING), or when it was due (WAL_RECORD_DROPOUT)
+    double glucose_value; // mg/dL (WAL_RECORD_READING)
+    uint64_t sequence;    // Log sequence number, increasing across segments
+} WalRecord;
+
+// Checkpoint file header
+typedef struct {
+    uint32_t magic;           // Identifies a checkpoint file
+    uint32_t version;
+    uint32_t patient_count;
+    uint32_t table_capacity;  // Power of two, at least twice patient_count
+    uint64_t last_sequence;   // Every WAL record up to this one is included
+    uint32_t covered_segment; // Every segment up to this one is included
+    uint32_t reserved;
+    uint64_t table_offset;    // CheckpointSlot[table_capacity], linear probing
+    uint64_t index_offset;    // CheckpointIndexRecord[patient_count]
+    uint64_t history_offset;  // CheckpointHistory[patient_count]
+    uint64_t checksum;        // Of the fields above
+} CheckpointHeader;
+
+// Lookup table entry; the id is repeated so lookups never touch the index
+typedef struct {
+    uint32_t patient_id;
+    uint32_t record; // Index record + 1 (0 = empty slot)
+} CheckpointSlot;
+
+// Everything about a patient except the history, read eagerly
+typedef struct {
+    uint32_t patient_id;
+    uint32_t alarm_flags;
+    uint32_t alarm_count;
+    uint32_t reserved;
+    int64_t reading_time;
+    double glucose_value;
+    GlucoseStats stats;
+    Config config;
+    uint64_t checksum; // Of this record up to here and the patient's history
+} CheckpointIndexRecord;
+
+// A patient's glucose history, paged in on first use
+typedef struct {
+    GlucoseFixed glucose_history[30];
+    uint32_t history_valid;   // Validity bits of the history; pads it to one cache line
+} CheckpointHistory;
+
+// Residency of a checkpointed patient in a lazily opened store
+typedef enum {
+    CHECKPOINT_ON_DISK = 0, // Only in the mapped checkpoint
+    CHECKPOINT_LOADED = 1,  // Copied into the registry
+    CHECKPOINT_DROPPED = 2  // Removed, replaced or unreadable; never loaded
+} CheckpointResidency;
+
+// Mapped checkpoint of a lazily opened store
+typedef struct {
+    const uint8_t* base;        // Read-only mapping, or NULL
+    size_t size;
+    const CheckpointHeader* header;
+    const CheckpointSlot* table;
+    const CheckpointIndexRecord* records;
+    const CheckpointHistory* histories;
+    uint8_t* residency;         // CheckpointResidency per record
+    uint32_t on_disk;           // Records still CHECKPOINT_ON_DISK
+
+    // Background prefetch: the thread fills order and advances paged_in
+    pthread_t prefetch_thread;
+    int prefetch_running;
+    int prefetch_stop;          // Set to ask the thread to exit
+    uint32_t* order;            // Records, most recent reading first
+    uint32_t paged_in;          // Entries of order already paged in (atomic)
+    uint32_t next;              // Next entry of order to copy into the registry
+
+    // WAL readings held back for patients still on disk, replayed on load
+    WalRecord* deferred;        // Recovered WAL records, or NULL
+    uint32_t* deferred_head;    // Per record: first held-back reading + 1 (0 = none)
+    uint32_t* deferred_next;    // Per WAL record: next held-back reading of the patient + 1
+} LazyCheckpoint;
+
+// Counters since the store was opened
+typedef struct {
+    uint64_t records_logged;
+    uint64_t groups_committed;
+    uint64_t wal_bytes;        // Bytes written to WAL segments
+    uint64_t checkpoints;      // Checkpoints completed
+    uint64_t checkpoint_bytes; // Size of the latest checkpoint
+} StateStoreStats;
+
+// What recovery found and how long it took
+typedef struct {
+    uint32_t checkpoint_patients; // Patients loaded from the checkpoint
+    uint64_t records_replayed;    // WAL records applied
+    uint64_t records_skipped;     // WAL records already covered or for unknown patients
+    uint64_t records_deferred;    // Readings held back until their patient is loaded
+    uint32_t lazy_patients;       // Patients left in the mapped checkpoint to load on demand
+    unsigned int threads;         // Threads used for reading replay
+    double checkpoint_seconds;    // Time to load the checkpoint
+    double replay_seconds;        // Time to read and replay the WAL
+} RecoveryStats;
+
+// Structure to hold an open store
+typedef struct {
+    char directory[STATE_STORE_PATH_MAX];
+    int wal_fd;                 // Current segment
+    uint32_t segment;           // Number of the current segment
+    uint64_t next_sequence;
+    int sync;                   // Non-zero to fdatasync each commit (default)
+    WalRecord* group;           // Records not yet written
+    uint32_t group_count;
+    uint32_t group_capacity;
+
+    // Background checkpoint; the fields below belong to the writer while it runs
+    pthread_t checkpoint_thread;
+    int checkpoint_running;
+    int checkpoint_result;
+    uint8_t* snapshot;          // CheckpointHeader + records
+    size_t snapshot_size;
+    size_t snapshot_capacity;
+    uint32_t oldest_segment;    // Oldest segment that may still exist on disk
+    uint32_t covered_segment;   // Last segment covered by the snapshot
+
+    LazyCheckpoint lazy;
+    StateStoreStats stats;
+} StateStore;
+
+/**
+ * @brief Opens a store, restoring its state into an empty registry.
+ *
+ * Creates the directory if it does not exist. Logging continues in a new
+ * segment, so a torn tail left by a crash is never appended to.
+ *
+ * @param store Pointer to the StateStore structure to initialize.
+ * @param directory Directory holding the checkpoint and WAL segments.
+ * @param registry Pointer to an empty registry to restore into.
+ * @param config Pointer to the thresholds for patients added through the WAL.
+ * @param replay_threads Threads for reading replay (0 = online CPUs).
+ * @param lazy Non-zero to leave checkpointed patients on disk until touched.
+ * @param recovery Pointer to receive recovery statistics, or NULL.
+ * @return 0 on success, -1 on error.
+ */
+int state_store_open(StateStore* store, const char* directory, PatientRegistry* registry,
+                     const Config* config, unsigned int replay_threads, int lazy,
+                     RecoveryStats* recovery);
+
+/**
+ * @brief Finds a patient, loading it from the mapped checkpoint if needed.
+ *
+ * Use instead of patient_registry_find() while the store may hold
+ * patients that have not been loaded yet.
+ *
+ * @param store Pointer to the open StateStore.
+ * @param registry Pointer to the registry the store was opened with.
+ * @param patient_id External patient identifier.
+ * @param index Optional pointer to receive the patient's dense position.
+ * @return Pointer to the patient's state, or NULL if the patient is unknown.
+ */
+PatientState* state_store_find_patient(StateStore* store, PatientRegistry* registry,
+                                       uint32_t patient_id, uint32_t* index);
+
+/**
+ * @brief Checks whether a patient is known, without loading it.
+ *
+ * @param store Pointer to the open StateStore, or NULL.
+ * @param registry Pointer to the registry the store was opened with.
+ * @param patient_id External patient identifier.
+ * @return 1 if the patient is in the registry or still in the mapped checkpoint, 0 otherwise.
+ */
+int state_store_has_patient(StateStore* store, PatientRegistry* registry, uint32_t patient_id);
+
+/**
+ * @brief Loads patients the background thread has already paged in.
+ *
+ * Releases the mapping once every patient is loaded.
+ *
+ * @param store Pointer to the open StateStore.
+ * @param registry Pointer to the registry the store was opened with.
+ * @param budget Maximum number of patients to load in this call.
+ * @return Number of patients still waiting in the mapped checkpoint.
+ */
+uint32_t state_store_prefetch(StateStore* store, PatientRegistry* registry, uint32_t budget);
+
+/**
+ * @brief Logs that a patient was registered.
+ *
+ * @param store Pointer to the open StateStore.
+ * @param patient_id External patient identifier.
+ * @return 0 on success, -1 on error.
+ */
+int state_store_log_add(StateStore* store, uint32_t patient_id);
+
+/**
+ * @brief Logs that a patient was unregistered.
+ *
+ * @param store Pointer to the open StateStore.
+ * @param patient_id External patient identifier.
+ * @return 0 on success, -1 on error.
+ */
+int state_store_log_remove(StateStore* store, uint32_t patient_id);
+
+/**
+ * @brief Logs a recorded reading.
+ *
+ * @param store Pointer to the open StateStore.
+ * @param patient_id External patient identifier.
+ * @param glucose_value Reading in mg/dL.
+ * @param timestamp Time of the reading.
+ * @return 0 on success, -1 on error.
+ */
+int state_store_log_reading(StateStore* store, uint32_t patient_id, double glucose_value, time_t timestamp);
+
+/**
+ * @brief Logs a sensor dropout, recorded with record_missing_reading().
+ *
+ * @param store Pointer to the open StateStore.
+ * @param patient_id External patient identifier.
+ * @param timestamp Time the missing reading was due.
+ * @return 0 on success, -1 on error.
+ */
+int state_store_log_dropout(StateStore* store, uint32_t patient_id, time_t timestamp);
+
+/**
+ * @brief Writes the pending group to the WAL as one write (group commit).
+ *
+ * @param store Pointer to the open StateStore.
+ * @return 0 on success, -1 on error.
+ */
+int state_store_commit(StateStore* store);
+
+/**
+ * @brief Starts a checkpoint of the registry in the background.
+ *
+ * Commits the pending group, waits for the previous checkpoint to finish,
+ * snapshots the registry and starts a new WAL segment. Only the snapshot
+ * copy runs on the caller's thread.
+ *
+ * @param store Pointer to the open StateStore.
+ * @param registry Pointer to the registry to snapshot.
+ * @return 0 on success, -1 on error (including a failed previous checkpoint).
+ */
+int state_store_checkpoint(StateStore* store, PatientRegistry* registry);
+
+/**
+ * @brief Commits pending records, waits for any checkpoint and closes the store.
+ *
+ * @param store Pointer to the StateStore to close.
+ * @return 0 on success, -1 on error.
+ */
+int state_store_close(StateStore* store);
+
+#endif // STATE_STORE_H
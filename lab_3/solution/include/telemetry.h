@@ -0,0 +1,111 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "patient_registry.h"
+
+/**
+ * @file telemetry.h
+ * @brief Shared-memory telemetry feed from the engine to external readers.
+ *
+ * The controller publishes every patient's latest reading, history,
+ * statistics and alarm flags into a POSIX shared-memory segment. Each
+ * patient slot is guarded by its own seqlock, so any number of readers
+ * (such as the Streamlit dashboard) can map the segment read-only and
+ * take consistent snapshots without ever blocking the engine.
+ *
+ * Segment layout (little-endian, fixed offsets; mirrored in
+ * app/telemetry_feed.py):
+ *   TelemetryHeader             64 bytes
+ *   TelemetrySlot[capacity]     TELEMETRY_SLOT_SIZE bytes each
+ */
+
+#define TELEMETRY_SHM_NAME "/glucose_telemetry"
+#define TELEMETRY_MAGIC 0x43554C47u // "GLUC"
+#define TELEMETRY_VERSION 2u
+#define TELEMETRY_HISTORY_LENGTH 30
+#define TELEMETRY_SLOT_SIZE 384 // Multiple of the cache line size
+
+// Segment header, written once at creation and updated after each tick
+typedef struct {
+    uint32_t magic;              // TELEMETRY_MAGIC
+    uint32_t version;            // TELEMETRY_VERSION
+    uint32_t capacity;           // Number of slots in the segment
+    uint32_t slot_size;          // TELEMETRY_SLOT_SIZE
+    uint32_t patient_count;      // Slots currently in use (0 .. capacity)
+    uint32_t sample_interval_s;  // Seconds between readings
+    uint64_t publish_count;      // Total slot updates since creation
+    uint64_t updated_unix_ns;    // Wall-clock time of the last update
+    uint8_t reserved[24];
+} TelemetryHeader;
+
+// Latest state of one patient
+typedef struct {
+    uint64_t sequence;                           // Seqlock: odd while being written
+    uint32_t patient_id;
+    uint32_t alarm_flags;                        // AlarmFlag bits
+    int64_t timestamp;                           // Unix time of the latest reading
+    double glucose_value;                        // Latest reading in mg/dL
+    double history[TELEMETRY_HISTORY_LENGTH];    // Newest first; entries not in history_valid hold 0.0
+    double time_in_range;                        // Percent of readings in range
+    double time_below_range;                     // Percent of readings below range
+    double time_above_range;                     // Percent of readings above range
+    double avg_glucose;                          // Mean glucose in mg/dL
+    double glucose_variability;                  // Standard deviation in mg/dL
+    uint32_t reading_count;
+    uint32_t alarm_count;
+    int32_t trend;                               // GlucoseTrend value
+    uint32_t history_valid;                      // Bit i is set if history[i] holds a reading
+    uint8_t reserved[TELEMETRY_SLOT_SIZE - 328];
+} TelemetrySlot;
+
+// Structure to hold an open telemetry segment
+typedef struct {
+    int fd;
+    void* base;
+    size_t size;
+    uint32_t capacity;
+    char name[64];
+} TelemetryFeed;
+
+/**
+ * @brief Creates (or recreates) the shared-memory segment.
+ *
+ * @param feed Pointer to the TelemetryFeed structure to initialize.
+ * @param name POSIX shared-memory name, e.g. TELEMETRY_SHM_NAME.
+ * @param capacity Number of patient slots.
+ * @param sample_interval_s Seconds between readings, for readers' time axes.
+ * @return 0 on success, -1 on error.
+ */
+int telemetry_open(TelemetryFeed* feed, const char* name, uint32_t capacity, uint32_t sample_interval_s);
+
+/**
+ * @brief Publishes a patient's latest state into a slot.
+ *
+ * @param feed Pointer to the open TelemetryFeed.
+ * @param slot_index Slot to write (usually the patient's dense position).
+ * @param patient Pointer to the patient's state.
+ * @return 0 on success, -1 on error.
+ */
+int telemetry_publish(TelemetryFeed* feed, uint32_t slot_index, const PatientState* patient);
+
+/**
+ * @brief Sets how many slots readers should consider.
+ *
+ * @param feed Pointer to the open TelemetryFeed.
+ * @param patient_count Number of slots in use.
+ * @return 0 on success, -1 on error.
+ */
+int telemetry_set_patient_count(TelemetryFeed* feed, uint32_t patient_count);
+
+/**
+ * @brief Unmaps the segment and optionally removes its name.
+ *
+ * @param feed Pointer to the TelemetryFeed to close.
+ * @param unlink_segment Non-zero to remove the segment name.
+ * @return 0 on success, -1 on error.
+ */
+int telemetry_close(TelemetryFeed* feed, int unlink_segment);
+
+#endif // TELEMETRY_H
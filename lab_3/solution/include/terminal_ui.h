@@ -0,0 +1,164 @@
+#ifndef TERMINAL_UI_H
+#define TERMINAL_UI_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "patient_registry.h"
+
+/**
+ * @file terminal_ui.h
+ * @brief Full-screen terminal dashboard with delta rendering.
+ *
+ * Each frame is drawn into an off-screen grid of cells and compared with
+ * the grid the terminal already shows; only changed cells are sent, as
+ * cursor moves, color changes and UTF-8 text. Frames are produced at a
+ * capped rate, so the cost of the display depends on the frame rate and
+ * the number of changed cells, not on how fast readings arrive.
+ */
+
+#define TERMINAL_UI_DEFAULT_FPS 10
+#define TERMINAL_UI_MAX_FPS 60
+#define TERMINAL_UI_DEFAULT_ROWS 24  // Used when the size cannot be queried
+#define TERMINAL_UI_DEFAULT_COLS 80
+#define TERMINAL_UI_MAX_ROWS 500
+#define TERMINAL_UI_MAX_COLS 1000
+
+// Cell colors and attributes
+typedef enum {
+    TERMINAL_STYLE_NORMAL = 0,
+    TERMINAL_STYLE_BOLD,
+    TERMINAL_STYLE_DIM,
+    TERMINAL_STYLE_LOW,     // Below range (red)
+    TERMINAL_STYLE_HIGH,    // Above range (yellow)
+    TERMINAL_STYLE_OK,      // In range (green)
+    TERMINAL_STYLE_HEADER,  // Title bar (reverse video)
+    TERMINAL_STYLE_COUNT
+} TerminalStyle;
+
+// One character cell
+typedef struct {
+    uint32_t glyph; // Unicode code point, 0 = never drawn
+    uint8_t style;  // TerminalStyle
+} TerminalCell;
+
+// Counters since the UI was opened
+typedef struct {
+    uint64_t frames;        // Frames presented
+    uint64_t cells_changed; // Cells sent to the terminal
+    uint64_t bytes_written; // Bytes of escape sequences and text
+} TerminalUiStats;
+
+// Fleet-wide figures shown in the title and summary lines
+typedef struct {
+    const char* mode;           // E.g. "simulation" or "ingest"
+    uint64_t readings;          // Readings processed so far
+    double readings_per_second;
+    uint64_t alarms;            // Readings that raised at least one alarm
+    uint32_t connections;       // Open device connections (ingest only)
+} TerminalStatus;
+
+// Structure to hold the terminal state
+typedef struct {
+    int fd;                  // Terminal to draw on
+    int rows;
+    int cols;
+    TerminalCell* front;     // What the terminal shows
+    TerminalCell* back;      // Frame being drawn
+    char* output;            // Escape sequences of one frame
+    size_t output_length;
+    size_t output_capacity;
+    uint64_t frame_interval_ns;
+    uint64_t last_frame_ns;  // Time the last frame was presented, 0 = never
+    int cursor_row;          // Terminal cursor after the last frame, -1 = unknown
+    int cursor_col;
+    int current_style;       // SGR state of the terminal, -1 = unknown
+    TerminalUiStats stats;
+} TerminalUI;
+
+/**
+ * @brief Switches the terminal to a full-screen alternate buffer.
+ *
+ * @param ui Pointer to the TerminalUI structure to initialize.
+ * @param fd Terminal file descriptor (e.g. STDOUT_FILENO).
+ * @param max_fps Maximum frames per second (1 to TERMINAL_UI_MAX_FPS).
+ * @return 0 on success, -1 on error.
+ */
+int terminal_ui_open(TerminalUI* ui, int fd, int max_fps);
+
+/**
+ * @brief Reports whether the frame interval has passed since the last frame.
+ *
+ * @param ui Pointer to the TerminalUI.
+ * @return Non-zero if a new frame should be drawn.
+ */
+int terminal_ui_frame_due(const TerminalUI* ui);
+
+/**
+ * @brief Starts a frame: follows terminal resizes and clears the off-screen grid.
+ *
+ * @param ui Pointer to the TerminalUI.
+ * @return 0 on success, -1 on error.
+ */
+int terminal_ui_begin_frame(TerminalUI* ui);
+
+/**
+ * @brief Draws UTF-8 text into the off-screen grid, clipped at the right edge.
+ *
+ * @param ui Pointer to the TerminalUI.
+ * @param row Row (0 = top).
+ * @param col Column (0 = left).
+ * @param style TerminalStyle of the text.
+ * @param text UTF-8 text without control characters.
+ * @return Column after the last character drawn.
+ */
+int terminal_ui_text(TerminalUI* ui, int row, int col, TerminalStyle style, const char* text);
+
+/**
+ * @brief Draws a glucose history as a one-line sparkline, oldest reading first.
+ *
+ * Each reading becomes one block character whose height follows its value
+ * and whose color shows whether it is below, within or above range.
+ * Missing readings are left blank.
+ *
+ * @param ui Pointer to the TerminalUI.
+ * @param row Row (0 = top).
+ * @param col Column of the oldest reading.
+ * @param history Readings, newest first, as in GeneratedData.
+ * @param count Number of readings.
+ * @param config Pointer to the thresholds used for the colors.
+ * @return Column after the sparkline.
+ */
+int terminal_ui_sparkline(TerminalUI* ui, int row, int col, const GlucoseFixed* history, int count,
+                          const Config* config);
+
+/**
+ * @brief Draws the fleet dashboard into the off-screen grid.
+ *
+ * Shows a title bar, a fleet summary, the detail of the patient with the
+ * most recent alarm (or the first patient) and one line per patient,
+ * patients with an active alarm first, as far as the screen allows.
+ *
+ * @param ui Pointer to the TerminalUI.
+ * @param registry Pointer to the registry to show.
+ * @param status Pointer to the fleet-wide figures.
+ * @return 0 on success, -1 on error.
+ */
+int terminal_ui_draw_fleet(TerminalUI* ui, PatientRegistry* registry, const TerminalStatus* status);
+
+/**
+ * @brief Sends the cells that differ from the previous frame to the terminal.
+ *
+ * @param ui Pointer to the TerminalUI.
+ * @return Number of bytes written, or -1 on error.
+ */
+long terminal_ui_present(TerminalUI* ui);
+
+/**
+ * @brief Restores the normal screen and cursor and frees the grids.
+ *
+ * @param ui Pointer to the TerminalUI to close.
+ * @return 0 on success, -1 on error.
+ */
+int terminal_ui_close(TerminalUI* ui);
+
+#endif // TERMINAL_UI_H
@@ -8,6 +8,96 @@
 #include <stdio.h>
 
 
+/**
+ * @brief Evaluates the level rules (hypo- and hyperglycemia) for one reading.
+ *
+ * @param glucose_value Glucose reading in mg/dL.
+ * @param config Pointer to the Config structure containing thresholds.
+ * @return Active AlarmFlag bits, ALARM_NONE if config is NULL.
+ */
+unsigned int glucose_level_alarms(double glucose_value, const Config* config) {
+    if (config == NULL) return ALARM_NONE;
+
+    unsigned int active = ALARM_NONE;
+
+    // Check for hypoglycemia
+    if (glucose_value < config->hypoglycemia_threshold) {
+        active |= ALARM_HYPOGLYCEMIA;
+    }
+
+    // Check for hyperglycemia
+    if (glucose_value > config->hyperglycemia_threshold) {
+        active |= ALARM_HYPERGLYCEMIA;
+    }
+
+    return active;
+}
+
+/**
+ * @brief Evaluates the rapid-change rules for the change between two readings.
+ *
+ * @param change Change from the previous reading in mg/dL.
+ * @param config Pointer to the Config structure containing thresholds.
+ * @return Active AlarmFlag bits, ALARM_NONE if config is NULL.
+ */
+unsigned int glucose_change_alarms(double change, const Config* config) {
+    if (config == NULL) return ALARM_NONE;
+
+    if (change > config->rapid_change_threshold) return ALARM_RAPID_INCREASE;
+    if (change < -(config->rapid_change_threshold)) return ALARM_RAPID_DECREASE;
+    return ALARM_NONE;
+}
+
+/**
+ * @brief Evaluates alarm conditions without printing anything.
+ *
+ * Applies the same rules as check_and_print_alarms() and reports the
+ * active conditions as a combination of AlarmFlag values. A rapid change
+ * is only evaluated if history entries 0 and 1 are both valid.
+ *
+ * @param data Pointer to the GeneratedData structure containing glucose data.
+ * @param config Pointer to the Config structure containing thresholds.
+ * @param flags Pointer to receive the active AlarmFlag bits.
+ * @return 0 on success, -1 on error.
+ */
+int evaluate_glucose_alarms(const GeneratedData* data, const Config* config, unsigned int* flags) {
+    if (data == NULL || config == NULL || flags == NULL) return -1;
+
+    unsigned int active = glucose_level_alarms(data->glucose_value, config);
+    // glucose_history[0] is the current value, glucose_history[1] the previous one; either may be a gap
+    if (glucose_history_valid(data, 0) && glucose_history_valid(data, 1)) {
+        active |= glucose_change_alarms(data->glucose_value - glucose_from_fixed(data->glucose_history[1]), config);
+    }
+
+    *flags = active;
+    return 0;
+}
+
+/**
+ * @brief Evaluates alarm conditions for a single reading.
+ *
+ * For callers holding plain values, such as arrays that mark gaps with
+ * 0.0: the change between the two readings is only checked if
+ * previous_value is a reading (positive). GeneratedData histories track
+ * their gaps in a validity bitmap instead; see evaluate_glucose_alarms().
+ *
+ * @param glucose_value Current glucose reading in mg/dL.
+ * @param previous_value Previous glucose reading in mg/dL, or 0.0 if none.
+ * @param config Pointer to the Config structure containing thresholds.
+ * @param flags Pointer to receive the active AlarmFlag bits.
+ * @return 0 on success, -1 on error.
+ */
+int evaluate_glucose_alarm_values(double glucose_value, double previous_value,
+                                  const Config* config, unsigned int* flags) {
+    if (config == NULL || flags == NULL) return -1;
+
+    unsigned int active = glucose_level_alarms(glucose_value, config);
+    if (previous_value > 0.0) active |= glucose_change_alarms(glucose_value - previous_value, config);
+
+    *flags = active;
+    return 0;
+}
+
 /**
  * @brief Checks and prints alarms based on glucose data and configuration.
  *
@@ -19,27 +109,34 @@
  * @return 0 on success, -1 on error.
  */
 int check_and_print_alarms(const GeneratedData* data, const Config* config) {
-    if (data == NULL || config == NULL) return -1;
+    unsigned int flags;
+    if (evaluate_glucose_alarms(data, config, &flags) != 0) return -1;
 
-    // Check for hypoglycemia
-    if (data->glucose_value < config->hypoglycemia_threshold) {
+    return print_glucose_alarms(data, flags);
+}
+
+/**
+ * @brief Prints the alarm messages for previously evaluated alarm flags.
+ *
+ * @param data Pointer to the GeneratedData structure the flags were evaluated on.
+ * @param flags AlarmFlag bits returned by evaluate_glucose_alarms().
+ * @return 0 on success, -1 on error.
+ */
+int print_glucose_alarms(const GeneratedData* data, unsigned int flags) {
+    if (data == NULL) return -1;
+
+    if (flags & ALARM_HYPOGLYCEMIA) {
         printf("ALARM: Hypoglycemia detected! Glucose value: %.1f mg/dL\n", data->glucose_value);
     }
 
-    // Check for hyperglycemia
-    if (data->glucose_value > config->hyperglycemia_threshold) {
+    if (flags & ALARM_HYPERGLYCEMIA) {
         printf("ALARM: Hyperglycemia detected! Glucose value: %.1f mg/dL\n", data->glucose_value);
     }
 
-    // Check for rapid changes (only if we have previous data)
-    if (data->glucose_history[1] != 0.0) {  // Ensure we have previous data
-        double change = data->glucose_history[0] - data->glucose_history[1];
-        
-        if (change > config->rapid_change_threshold) {
-            printf("ALARM: Rapid glucose increase detected!\n");
-        } else if (change < -(config->rapid_change_threshold)) {
-            printf("ALARM: Rapid glucose decrease detected!\n");
-        }
+    if (flags & ALARM_RAPID_INCREASE) {
+        printf("ALARM: Rapid glucose increase detected!\n");
+    } else if (flags & ALARM_RAPID_DECREASE) {
+        printf("ALARM: Rapid glucose decrease detected!\n");
     }
     
     return 0;
@@ -0,0 +1,592 @@
+/**
+ * @file archive_scan.c
+ * @brief Contains the parallel, predicate-pushdown scans over the reading archive.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../include/archive_scan.h"
+#include "../include/latency.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define EPISODE_MAP_MIN_CAPACITY 64
+
+// How much of a block a scan needs
+typedef enum {
+    BLOCK_SKIP = 0, // Nothing in the block can match
+    BLOCK_IDS,      // Only patient ids (and times) to end open episodes
+    BLOCK_FULL      // Every column
+} BlockNeed;
+
+// Episode still open at the current position of the scan; readings == 0 marks an empty map slot
+typedef struct {
+    uint32_t patient_id;
+    uint32_t readings;
+    int64_t start;
+    int64_t last;
+    GlucoseFixed nadir;
+} OpenEpisode;
+
+// Open episodes of the shard being scanned, keyed by patient id
+typedef struct {
+    OpenEpisode* slots;
+    uint32_t capacity; // Power of two
+    uint32_t count;
+} EpisodeMap;
+
+// One worker's share of a scan
+typedef struct {
+    const char* directory;
+    const ArchiveQuery* query;
+    uint32_t* next_shard;      // Shared; shards are taken with an atomic increment
+    GlucoseFixed low;          // Thresholds in fixed point
+    GlucoseFixed high;
+
+    // Partial results, merged when every worker is done
+    uint64_t count;
+    uint64_t below;
+    uint64_t above;
+    uint64_t sum;
+    uint64_t sum_squares;
+    GlucoseFixed min_value;
+    GlucoseFixed max_value;
+    uint64_t histogram[ARCHIVE_HISTOGRAM_BINS];
+    ArchiveEpisode* episodes;
+    uint32_t episode_count;
+    uint32_t episode_capacity;
+    ArchiveScanStats scan;
+
+    EpisodeMap open;
+    uint8_t* buffer;           // ARCHIVE_SCAN_READ_BYTES, or one block if larger
+    size_t buffer_size;
+    int failed;
+} ScanWorker;
+
+/**
+ * @brief Returns a query for every reading of every patient, with stats only.
+ *
+ * @return ArchiveQuery structure with default values.
+ */
+ArchiveQuery archive_default_query(void) {
+    ArchiveQuery query;
+    memset(&query, 0, sizeof(query));
+    query.from = INT64_MIN;
+    query.to = INT64_MAX;
+    query.min_patient_id = 0;
+    query.max_patient_id = UINT32_MAX;
+    query.min_value = 0;
+    query.max_value = GLUCOSE_FIXED_MAX;
+    query.config = initialize_config();
+    query.episode_max_gap = ARCHIVE_EPISODE_MAX_GAP_S;
+    query.episode_min_duration = ARCHIVE_EPISODE_MIN_DURATION_S;
+    query.outputs = ARCHIVE_OUTPUT_STATS;
+    query.threads = 0;
+    query.verify = 0;
+    return query;
+}
+
+/**
+ * @brief Returns the preferred map slot of a patient id.
+ */
+static uint32_t episode_home(uint32_t patient_id, uint32_t capacity) {
+    return (uint32_t)(patient_id * 2654435761u) & (capacity - 1);
+}
+
+/**
+ * @brief Finds a patient's open episode.
+ *
+ * @return The open episode, or NULL if the patient has none.
+ */
+static OpenEpisode* episode_find(EpisodeMap* map, uint32_t patient_id) {
+    if (map->count == 0) return NULL;
+
+    uint32_t mask = map->capacity - 1;
+    for (uint32_t i = episode_home(patient_id, map->capacity);; i = (i + 1) & mask) {
+        if (map->slots[i].readings == 0) return NULL;
+        if (map->slots[i].patient_id == patient_id) return &map->slots[i];
+    }
+}
+
+/**
+ * @brief Opens an episode for a patient that has none, growing the map if needed.
+ *
+ * @return 0 on success, -1 on error (out of memory).
+ */
+static int episode_open(EpisodeMap* map, uint32_t patient_id, int64_t t, GlucoseFixed value) {
+    if ((map->count + 1) * 2 > map->capacity) {
+        uint32_t capacity = map->capacity > 0 ? map->capacity * 2 : EPISODE_MAP_MIN_CAPACITY;
+        OpenEpisode* slots = calloc(capacity, sizeof(OpenEpisode));
+        if (slots == NULL) return -1;
+        for (uint32_t i = 0; i < map->capacity; i++) {
+            if (map->slots[i].readings == 0) continue;
+            uint32_t j = episode_home(map->slots[i].patient_id, capacity);
+            while (slots[j].readings != 0) j = (j + 1) & (capacity - 1);
+            slots[j] = map->slots[i];
+        }
+        free(map->slots);
+        map->slots = slots;
+        map->capacity = capacity;
+    }
+
+    uint32_t i = episode_home(patient_id, map->capacity);
+    while (map->slots[i].readings != 0) i = (i + 1) & (map->capacity - 1);
+    map->slots[i] = (OpenEpisode){patient_id, 1, t, t, value};
+    map->count++;
+    return 0;
+}
+
+/**
+ * @brief Removes an open episode, shifting later entries of its probe run back.
+ */
+static void episode_remove(EpisodeMap* map, OpenEpisode* episode) {
+    uint32_t mask = map->capacity - 1;
+    uint32_t hole = (uint32_t)(episode - map->slots);
+    map->slots[hole].readings = 0;
+    map->count--;
+
+    for (uint32_t j = (hole + 1) & mask; map->slots[j].readings != 0; j = (j + 1) & mask) {
+        uint32_t home = episode_home(map->slots[j].patient_id, map->capacity);
+        // Entries whose home lies cyclically in (hole, j] are already reachable
+        int reachable = hole <= j ? (home > hole && home <= j) : (home > hole || home <= j);
+        if (reachable) continue;
+        map->slots[hole] = map->slots[j];
+        map->slots[j].readings = 0;
+        hole = j;
+    }
+}
+
+/**
+ * @brief Reports a finished episode if it lasted long enough.
+ */
+static void episode_emit(ScanWorker* worker, const OpenEpisode* episode) {
+    if (episode->last - episode->start < (int64_t)worker->query->episode_min_duration) return;
+
+    if (worker->episode_count == worker->episode_capacity) {
+        uint32_t capacity = worker->episode_capacity > 0 ? worker->episode_capacity * 2 : 256;
+        ArchiveEpisode* episodes = realloc(worker->episodes, capacity * sizeof(ArchiveEpisode));
+        if (episodes == NULL) {
+            worker->failed = 1;
+            return;
+        }
+        worker->episodes = episodes;
+        worker->episode_capacity = capacity;
+    }
+    worker->episodes[worker->episode_count++] = (ArchiveEpisode){
+        episode->patient_id, episode->readings, episode->start, episode->last, episode->nadir
+    };
+}
+
+/**
+ * @brief Follows one in-range reading through the episode state of its patient.
+ */
+static void track_episode(ScanWorker* worker, uint32_t patient_id, int64_t t, GlucoseFixed value) {
+    int below = value < worker->low;
+    OpenEpisode* episode = episode_find(&worker->open, patient_id);
+    if (episode != NULL) {
+        if (below && t - episode->last <= (int64_t)worker->query->episode_max_gap) {
+            episode->readings++;
+            if (t > episode->last) episode->last = t;
+            if (value < episode->nadir) episode->nadir = value;
+            return;
+        }
+        // A reading back in range, or a long gap, ends the episode
+        episode_emit(worker, episode);
+        episode_remove(&worker->open, episode);
+    }
+    if (below && episode_open(&worker->open, patient_id, t, value) != 0) worker->failed = 1;
+}
+
+/**
+ * @brief Reports and forgets every episode still open at the end of a shard.
+ */
+static void close_open_episodes(ScanWorker* worker) {
+    EpisodeMap* map = &worker->open;
+    for (uint32_t i = 0; i < map->capacity && map->count > 0; i++) {
+        if (map->slots[i].readings == 0) continue;
+        episode_emit(worker, &map->slots[i]);
+        map->slots[i].readings = 0;
+        map->count--;
+    }
+}
+
+/**
+ * @brief Decides how much of a block the scan needs from its index entry alone.
+ */
+static BlockNeed block_need(const ScanWorker* worker, const ArchiveBlockIndex* entry) {
+    const ArchiveQuery* query = worker->query;
+    if (entry->max_time < query->from || entry->min_time >= query->to) return BLOCK_SKIP;
+    if (entry->max_patient_id < query->min_patient_id || entry->min_patient_id > query->max_patient_id) {
+        return BLOCK_SKIP;
+    }
+
+    int values = (query->outputs & (ARCHIVE_OUTPUT_STATS | ARCHIVE_OUTPUT_HISTOGRAM)) != 0 &&
+                 entry->max_value >= query->min_value && entry->min_value <= query->max_value;
+    int episodes = (query->outputs & ARCHIVE_OUTPUT_EPISODES) != 0;
+    if (values || (episodes && entry->min_value < worker->low)) return BLOCK_FULL;
+
+    // No reading here can start or extend an episode, but any of them can end one
+    return episodes && worker->open.count > 0 ? BLOCK_IDS : BLOCK_SKIP;
+}
+
+/**
+ * @brief Adds a reading to the stats and histogram.
+ */
+static void accumulate(ScanWorker* worker, GlucoseFixed value) {
+    worker->count++;
+    worker->sum += value;
+    worker->sum_squares += (uint64_t)value * value;
+    worker->below += value < worker->low;
+    worker->above += value > worker->high;
+    if (value < worker->min_value) worker->min_value = value;
+    if (value > worker->max_value) worker->max_value = value;
+}
+
+/**
+ * @brief Returns the histogram bin of a reading.
+ */
+static uint32_t histogram_bin(GlucoseFixed value) {
+    uint32_t bin = value / (ARCHIVE_HISTOGRAM_BIN_MG_DL * GLUCOSE_FIXED_SCALE);
+    return bin < ARCHIVE_HISTOGRAM_BINS ? bin : ARCHIVE_HISTOGRAM_BINS - 1;
+}
+
+/**
+ * @brief Scans a block read in full.
+ */
+static void scan_block(ScanWorker* worker, const ArchiveBlockIndex* entry, const uint8_t* payload) {
+    const ArchiveQuery* query = worker->query;
+    uint32_t count = entry->count;
+    if (query->verify &&
+        reading_archive_checksum(payload, reading_archive_payload_bytes(count)) != entry->payload_checksum) {
+        worker->scan.checksum_errors++;
+        return;
+    }
+
+    const uint32_t* ids = (const uint32_t*)(payload + reading_archive_column_offset(count, 0));
+    const uint32_t* offsets = (const uint32_t*)(payload + reading_archive_column_offset(count, 1));
+    const GlucoseFixed* values = (const GlucoseFixed*)(payload + reading_archive_column_offset(count, 2));
+    int want_values = (query->outputs & (ARCHIVE_OUTPUT_STATS | ARCHIVE_OUTPUT_HISTOGRAM)) != 0;
+    int want_histogram = (query->outputs & ARCHIVE_OUTPUT_HISTOGRAM) != 0;
+    int want_episodes = (query->outputs & ARCHIVE_OUTPUT_EPISODES) != 0;
+    worker->scan.blocks_read++;
+    worker->scan.readings_scanned += count;
+
+    // Blocks entirely inside every predicate skip the per-reading checks
+    int contained = entry->min_time >= query->from && entry->max_time < query->to &&
+                    entry->min_patient_id >= query->min_patient_id && entry->max_patient_id <= query->max_patient_id &&
+                    entry->min_value >= query->min_value && entry->max_value <= query->max_value;
+    if (contained && !want_episodes) {
+        for (uint32_t i = 0; i < count; i++) {
+            accumulate(worker, values[i]);
+            if (want_histogram) worker->histogram[histogram_bin(values[i])]++;
+        }
+        worker->scan.readings_matched += count;
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        int64_t t = entry->min_time + offsets[i];
+        if (t < query->from || t >= query->to) continue;
+        if (ids[i] < query->min_patient_id || ids[i] > query->max_patient_id) continue;
+
+        GlucoseFixed value = values[i];
+        if (want_episodes) track_episode(worker, ids[i], t, value);
+        if (!want_values || value < query->min_value || value > query->max_value) continue;
+        accumulate(worker, value);
+        if (want_histogram) worker->histogram[histogram_bin(value)]++;
+        worker->scan.readings_matched++;
+    }
+}
+
+/**
+ * @brief Ends the open episodes of the patients in a block with no reading below the threshold.
+ */
+static void scan_block_ids(ScanWorker* worker, const ArchiveBlockIndex* entry, const uint8_t* payload, int with_times) {
+    const ArchiveQuery* query = worker->query;
+    const uint32_t* ids = (const uint32_t*)(payload + reading_archive_column_offset(entry->count, 0));
+    const uint32_t* offsets = (const uint32_t*)(payload + reading_archive_column_offset(entry->count, 1));
+    worker->scan.blocks_ids_only++;
+    worker->scan.readings_scanned += entry->count;
+
+    for (uint32_t i = 0; i < entry->count && worker->open.count > 0; i++) {
+        if (with_times) {
+            int64_t t = entry->min_time + offsets[i];
+            if (t < query->from || t >= query->to) continue;
+        }
+        if (ids[i] < query->min_patient_id || ids[i] > query->max_patient_id) continue;
+
+        OpenEpisode* episode = episode_find(&worker->open, ids[i]);
+        if (episode == NULL) continue;
+        episode_emit(worker, episode);
+        episode_remove(&worker->open, episode);
+    }
+}
+
+/**
+ * @brief Reads a byte range of a shard's data file in full.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int read_range(int fd, uint8_t* buffer, size_t length, uint64_t offset) {
+    size_t done = 0;
+    while (done < length) {
+        ssize_t got = pread(fd, buffer + done, length - done, (off_t)(offset + done));
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return -1;
+        done += (size_t)got;
+    }
+    return 0;
+}
+
+/**
+ * @brief Scans one shard: every block it needs, in file order.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int scan_shard(ScanWorker* worker, uint32_t shard) {
+    ArchiveBlockIndex* entries;
+    uint32_t count;
+    if (reading_archive_load_index(worker->directory, shard, &entries, &count) != 0) return -1;
+    if (count == 0) return 0;
+    worker->scan.blocks_indexed += count;
+
+    char path[ARCHIVE_PATH_MAX];
+    int fd = reading_archive_path(worker->directory, shard, 0, path) == 0 ? open(path, O_RDONLY | O_CLOEXEC) : -1;
+    if (fd < 0) {
+        free(entries);
+        return -1;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    int result = 0;
+    int64_t from = worker->query->from, to = worker->query->to;
+    for (uint32_t i = 0; i < count && result == 0;) {
+        BlockNeed need = block_need(worker, &entries[i]);
+        if (need == BLOCK_SKIP) {
+            i++;
+            continue;
+        }
+
+        if (need == BLOCK_IDS) {
+            // Times are needed only if the block straddles the range
+            int with_times = entries[i].min_time < from || entries[i].max_time >= to;
+            size_t length = reading_archive_column_offset(entries[i].count, with_times ? 2 : 1);
+            result = read_range(fd, worker->buffer, length, entries[i].offset);
+            if (result == 0) {
+                worker->scan.bytes_read += length;
+                scan_block_ids(worker, &entries[i], worker->buffer, with_times);
+            }
+            i++;
+            continue;
+        }
+
+        // Read the run of consecutive blocks needed in full with one call
+        uint32_t last = i;
+        size_t length = reading_archive_payload_bytes(entries[i].count);
+        while (last + 1 < count && block_need(worker, &entries[last + 1]) == BLOCK_FULL &&
+               length + reading_archive_payload_bytes(entries[last + 1].count) <= worker->buffer_size) {
+            last++;
+            length += reading_archive_payload_bytes(entries[last].count);
+        }
+        result = read_range(fd, worker->buffer, length, entries[i].offset);
+        if (result == 0) {
+            worker->scan.bytes_read += length;
+            for (uint32_t b = i; b <= last; b++) {
+                scan_block(worker, &entries[b], worker->buffer + (entries[b].offset - entries[i].offset));
+            }
+        }
+        i = last + 1;
+    }
+
+    close_open_episodes(worker);
+    close(fd);
+    free(entries);
+    return result;
+}
+
+/**
+ * @brief Takes shards until none are left.
+ *
+ * @param context Pointer to the ScanWorker.
+ * @return NULL.
+ */
+static void* scan_worker(void* context) {
+    ScanWorker* worker = context;
+    struct timespec start, end;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+
+    for (;;) {
+        uint32_t shard = __atomic_fetch_add(worker->next_shard, 1, __ATOMIC_RELAXED);
+        if (shard >= ARCHIVE_SHARDS || worker->failed) break;
+        // A single patient's readings are all in one shard
+        const ArchiveQuery* query = worker->query;
+        if (query->min_patient_id == query->max_patient_id && shard != reading_archive_shard(query->min_patient_id)) {
+            continue;
+        }
+        if (scan_shard(worker, shard) != 0) worker->failed = 1;
+    }
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+    worker->scan.thread_seconds = (double)(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    return NULL;
+}
+
+/**
+ * @brief Orders episodes by patient, then start.
+ */
+static int compare_episodes(const void* a, const void* b) {
+    const ArchiveEpisode* x = a;
+    const ArchiveEpisode* y = b;
+    if (x->patient_id != y->patient_id) return x->patient_id < y->patient_id ? -1 : 1;
+    return (x->start > y->start) - (x->start < y->start);
+}
+
+/**
+ * @brief Adds a worker's partial results into the scan result.
+ *
+ * @return 0 on success, -1 on error (out of memory).
+ */
+static int merge_worker(ArchiveScanResult* result, const ScanWorker* worker, uint64_t* totals) {
+    totals[0] += worker->count;
+    totals[1] += worker->below;
+    totals[2] += worker->above;
+    totals[3] += worker->sum;
+    totals[4] += worker->sum_squares;
+    if (worker->count > 0 && worker->min_value < result->min_value) result->min_value = worker->min_value;
+    if (worker->max_value > result->max_value) result->max_value = worker->max_value;
+    for (int b = 0; b < ARCHIVE_HISTOGRAM_BINS; b++) result->histogram[b] += worker->histogram[b];
+
+    ArchiveScanStats* scan = &result->scan;
+    scan->blocks_indexed += worker->scan.blocks_indexed;
+    scan->blocks_read += worker->scan.blocks_read;
+    scan->blocks_ids_only += worker->scan.blocks_ids_only;
+    scan->readings_scanned += worker->scan.readings_scanned;
+    scan->readings_matched += worker->scan.readings_matched;
+    scan->bytes_read += worker->scan.bytes_read;
+    scan->checksum_errors += worker->scan.checksum_errors;
+    scan->thread_seconds += worker->scan.thread_seconds;
+
+    if (worker->episode_count == 0) return 0;
+    ArchiveEpisode* episodes = realloc(result->episodes,
+                                       (size_t)(result->episode_count + worker->episode_count) * sizeof(ArchiveEpisode));
+    if (episodes == NULL) return -1;
+    memcpy(episodes + result->episode_count, worker->episodes, worker->episode_count * sizeof(ArchiveEpisode));
+    result->episodes = episodes;
+    result->episode_count += worker->episode_count;
+    return 0;
+}
+
+/**
+ * @brief Scans an archive directory in parallel.
+ *
+ * Blocks still buffered by a ReadingArchive that is open for appending
+ * are not seen; flush it first.
+ *
+ * @param directory Archive directory.
+ * @param query Pointer to the query.
+ * @param result Pointer to the ArchiveScanResult structure to fill.
+ * @return 0 on success, -1 on error (invalid arguments, unreadable archive or out of memory).
+ */
+int archive_scan(const char* directory, const ArchiveQuery* query, ArchiveScanResult* result) {
+    if (directory == NULL || query == NULL || result == NULL) return -1;
+    memset(result, 0, sizeof(*result));
+    result->min_value = GLUCOSE_FIXED_MAX;
+
+    unsigned int threads = query->threads;
+    if (threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? (unsigned int)online : 1;
+    }
+    if (threads > ARCHIVE_SCAN_MAX_THREADS) threads = ARCHIVE_SCAN_MAX_THREADS;
+    if (threads > ARCHIVE_SHARDS) threads = ARCHIVE_SHARDS;
+
+    ScanWorker* workers = calloc(threads, sizeof(ScanWorker));
+    pthread_t* handles = calloc(threads, sizeof(pthread_t));
+    if (workers == NULL || handles == NULL) {
+        free(workers);
+        free(handles);
+        return -1;
+    }
+
+    uint64_t start = latency_now_ns();
+    uint32_t next_shard = 0;
+    size_t buffer_size = ARCHIVE_SCAN_READ_BYTES;
+    if (buffer_size < reading_archive_payload_bytes(ARCHIVE_BLOCK_READINGS)) {
+        buffer_size = reading_archive_payload_bytes(ARCHIVE_BLOCK_READINGS);
+    }
+    int status = 0;
+    unsigned int started = 0;
+    for (unsigned int t = 0; t < threads; t++) {
+        ScanWorker* worker = &workers[t];
+        worker->directory = directory;
+        worker->query = query;
+        worker->next_shard = &next_shard;
+        worker->low = (GlucoseFixed)(query->config.hypoglycemia_threshold * GLUCOSE_FIXED_SCALE);
+        worker->high = (GlucoseFixed)(query->config.hyperglycemia_threshold * GLUCOSE_FIXED_SCALE);
+        worker->min_value = GLUCOSE_FIXED_MAX;
+        worker->buffer_size = buffer_size;
+        worker->buffer = malloc(buffer_size);
+        if (worker->buffer == NULL) {
+            status = -1;
+            break;
+        }
+        // The calling thread is worker 0
+        if (t > 0 && pthread_create(&handles[t], NULL, scan_worker, worker) != 0) {
+            status = -1;
+            break;
+        }
+        started = t + 1;
+    }
+    if (started > 0) scan_worker(&workers[0]);
+    for (unsigned int t = 1; t < started; t++) pthread_join(handles[t], NULL);
+
+    uint64_t totals[5] = {0, 0, 0, 0, 0};
+    for (unsigned int t = 0; t < threads; t++) {
+        if (t < started && (workers[t].failed || merge_worker(result, &workers[t], totals) != 0)) status = -1;
+        free(workers[t].buffer);
+        free(workers[t].episodes);
+        free(workers[t].open.slots);
+    }
+    free(workers);
+    free(handles);
+    if (started < threads) status = -1;
+
+    // Same representation as update_glucose_statistics(), from exact integer sums
+    initialize_glucose_statistics(&result->stats);
+    if (totals[0] > 0) {
+        double count = (double)totals[0];
+        result->stats.time_below_range = (double)totals[1];
+        result->stats.time_above_range = (double)totals[2];
+        result->stats.time_in_range = (double)(totals[0] - totals[1] - totals[2]);
+        result->stats.avg_glucose = (double)totals[3] / count / GLUCOSE_FIXED_SCALE;
+        double m2 = (double)totals[4] - (double)totals[3] * (double)totals[3] / count;
+        result->stats.glucose_variability = (m2 > 0.0 ? m2 : 0.0) / (GLUCOSE_FIXED_SCALE * GLUCOSE_FIXED_SCALE);
+    } else {
+        result->min_value = 0;
+    }
+    if (result->episode_count > 1) {
+        qsort(result->episodes, result->episode_count, sizeof(ArchiveEpisode), compare_episodes);
+    }
+
+    result->scan.threads = threads;
+    result->scan.seconds = (latency_now_ns() - start) / 1e9;
+    if (status != 0) archive_scan_free(result);
+    return status;
+}
+
+/**
+ * @brief Frees the episode list of a scan result.
+ *
+ * @param result Pointer to the ArchiveScanResult structure.
+ */
+void archive_scan_free(ArchiveScanResult* result) {
+    if (result == NULL) return;
+    free(result->episodes);
+    result->episodes = NULL;
+    result->episode_count = 0;
+}
@@ -0,0 +1,264 @@
+/**
+ * @file arrow_export.c
+ * @brief Contains the Arrow IPC export of readings, alarm events and per-patient statistics.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../include/arrow_export.h"
+#include "../include/alarm.h"
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+static const ArrowField reading_fields[] = {
+    {"patient_id", ARROW_TYPE_UINT32, 0},
+    {"time", ARROW_TYPE_TIMESTAMP, 0},
+    {"glucose", ARROW_TYPE_FLOAT64, 0},
+};
+
+static const ArrowField alarm_fields[] = {
+    {"patient_id", ARROW_TYPE_UINT32, 0},
+    {"time", ARROW_TYPE_TIMESTAMP, 0},
+    {"glucose", ARROW_TYPE_FLOAT64, 0},
+    {"alarm_flags", ARROW_TYPE_UINT8, 0},
+};
+
+// Columns of patient_stats.arrow; all but patient_id and alarm_count are null for a patient without a reading
+static const ArrowField stats_fields[] = {
+    {"patient_id", ARROW_TYPE_UINT32, 0},
+    {"time", ARROW_TYPE_TIMESTAMP, 1},
+    {"glucose", ARROW_TYPE_FLOAT64, 1},
+    {"time_in_range", ARROW_TYPE_FLOAT64, 1},
+    {"time_below_range", ARROW_TYPE_FLOAT64, 1},
+    {"time_above_range", ARROW_TYPE_FLOAT64, 1},
+    {"avg_glucose", ARROW_TYPE_FLOAT64, 1},
+    {"glucose_variability", ARROW_TYPE_FLOAT64, 1},
+    {"reading_count", ARROW_TYPE_UINT32, 0},
+    {"alarm_count", ARROW_TYPE_UINT32, 0},
+};
+
+#define STATS_FIELD_COUNT (sizeof(stats_fields) / sizeof(stats_fields[0]))
+
+// Statistics of up to ARROW_EXPORT_BATCH_ROWS patients, gathered from the registry
+typedef struct {
+    uint32_t patient_id[ARROW_EXPORT_BATCH_ROWS];
+    int64_t time[ARROW_EXPORT_BATCH_ROWS];
+    double glucose[ARROW_EXPORT_BATCH_ROWS];
+    double time_in_range[ARROW_EXPORT_BATCH_ROWS];       // Percent of readings
+    double time_below_range[ARROW_EXPORT_BATCH_ROWS];    // Percent of readings
+    double time_above_range[ARROW_EXPORT_BATCH_ROWS];    // Percent of readings
+    double avg_glucose[ARROW_EXPORT_BATCH_ROWS];
+    double glucose_variability[ARROW_EXPORT_BATCH_ROWS]; // Standard deviation in mg/dL
+    uint32_t reading_count[ARROW_EXPORT_BATCH_ROWS];
+    uint32_t alarm_count[ARROW_EXPORT_BATCH_ROWS];
+    uint64_t has_reading[ARROW_EXPORT_BATCH_ROWS / 64]; // Validity of the nullable columns
+} StatsColumns;
+
+/**
+ * @brief Builds the path of a file in the export directory.
+ *
+ * @return 0 on success, -1 if the path is too long.
+ */
+static int export_path(const ArrowExport* exporter, const char* name, char* path, size_t size) {
+    int length = snprintf(path, size, "%s/%s", exporter->directory, name);
+    return length > 0 && (size_t)length < size ? 0 : -1;
+}
+
+/**
+ * @brief Writes the pending rows of a table as one record batch and empties the buffer.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int flush_events(ArrowIpcWriter* writer, ArrowEventColumns* pending) {
+    if (pending->count == 0) return 0;
+
+    ArrowColumn columns[] = {
+        {pending->patient_id, NULL},
+        {pending->time, NULL},
+        {pending->glucose, NULL},
+        {pending->alarm_flags, NULL},
+    };
+    uint32_t rows = pending->count;
+    pending->count = 0;
+    return arrow_ipc_write_batch(writer, columns, rows);
+}
+
+/**
+ * @brief Appends one row to a table's pending rows, writing them first if full.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int append_event(ArrowIpcWriter* writer, ArrowEventColumns* pending, const PatientState* patient) {
+    if (pending->count == ARROW_EXPORT_BATCH_ROWS && flush_events(writer, pending) != 0) return -1;
+
+    uint32_t row = pending->count++;
+    pending->patient_id[row] = patient->patient_id;
+    pending->time[row] = (int64_t)patient->data.reading_time;
+    pending->glucose[row] = patient->data.glucose_value;
+    pending->alarm_flags[row] = (uint8_t)patient->alarm_flags;
+    return 0;
+}
+
+/**
+ * @brief Writes the statistics of every registered patient to patient_stats.arrow.
+ *
+ * Statistics are written in their display form (percentages and standard
+ * deviation), as telemetry publishes them; patients without a reading
+ * have nulls.
+ *
+ * @return Number of patients written, or -1 on error.
+ */
+static long write_patient_stats(ArrowExport* exporter, PatientRegistry* registry) {
+    char path[ARROW_EXPORT_PATH_MAX + 32];
+    if (export_path(exporter, ARROW_EXPORT_STATS_FILE, path, sizeof(path)) != 0) return -1;
+
+    StatsColumns* batch = malloc(sizeof(StatsColumns));
+    ArrowIpcWriter writer;
+    if (batch == NULL || arrow_ipc_open(&writer, path, ARROW_IPC_FILE, stats_fields, STATS_FIELD_COUNT) != 0) {
+        free(batch);
+        return -1;
+    }
+
+    ArrowColumn columns[STATS_FIELD_COUNT] = {
+        {batch->patient_id, NULL},
+        {batch->time, batch->has_reading},
+        {batch->glucose, batch->has_reading},
+        {batch->time_in_range, batch->has_reading},
+        {batch->time_below_range, batch->has_reading},
+        {batch->time_above_range, batch->has_reading},
+        {batch->avg_glucose, batch->has_reading},
+        {batch->glucose_variability, batch->has_reading},
+        {batch->reading_count, NULL},
+        {batch->alarm_count, NULL},
+    };
+
+    int status = 0;
+    uint32_t count = patient_registry_count(registry);
+    for (uint32_t first = 0; first < count && status == 0; first += ARROW_EXPORT_BATCH_ROWS) {
+        uint32_t rows = count - first < ARROW_EXPORT_BATCH_ROWS ? count - first : ARROW_EXPORT_BATCH_ROWS;
+        memset(batch->has_reading, 0, sizeof(batch->has_reading));
+        for (uint32_t row = 0; row < rows; row++) {
+            const PatientState* patient = patient_registry_at(registry, first + row);
+            const GlucoseStats* stats = &patient->stats;
+            // The accumulators count readings, so their sum is the number of readings
+            double total = stats->time_in_range + stats->time_below_range + stats->time_above_range;
+            double scale = total > 0 ? 100.0 / total : 0.0;
+            batch->patient_id[row] = patient->patient_id;
+            batch->time[row] = (int64_t)patient->data.reading_time;
+            batch->glucose[row] = patient->data.glucose_value;
+            batch->time_in_range[row] = stats->time_in_range * scale;
+            batch->time_below_range[row] = stats->time_below_range * scale;
+            batch->time_above_range[row] = stats->time_above_range * scale;
+            batch->avg_glucose[row] = stats->avg_glucose;
+            batch->glucose_variability[row] = total > 0 ? sqrt(stats->glucose_variability / total) : 0.0;
+            batch->reading_count[row] = (uint32_t)total;
+            batch->alarm_count[row] = patient->alarm_count;
+            // A dropout does not take away the latest reading, so validity follows the count
+            batch->has_reading[row / 64] |= (uint64_t)(total > 0) << (row % 64);
+        }
+        status = arrow_ipc_write_batch(&writer, columns, rows);
+    }
+
+    if (arrow_ipc_close(&writer) != 0) status = -1;
+    exporter->stats.bytes_written += writer.stats.bytes_written;
+    free(batch);
+    return status == 0 ? (long)count : -1;
+}
+
+/**
+ * @brief Creates the export directory if needed and starts the reading and alarm files.
+ *
+ * @param exporter Pointer to the ArrowExport structure to initialize.
+ * @param directory Directory to write the files to.
+ * @return 0 on success, -1 on error.
+ */
+int arrow_export_open(ArrowExport* exporter, const char* directory) {
+    if (exporter == NULL || directory == NULL) return -1;
+    if (strlen(directory) >= sizeof(exporter->directory)) return -1;
+
+    memset(exporter, 0, sizeof(*exporter));
+    strcpy(exporter->directory, directory);
+    if (mkdir(directory, 0755) != 0 && errno != EEXIST) return -1;
+
+    char readings_path[ARROW_EXPORT_PATH_MAX + 32];
+    char alarms_path[ARROW_EXPORT_PATH_MAX + 32];
+    if (export_path(exporter, ARROW_EXPORT_READINGS_FILE, readings_path, sizeof(readings_path)) != 0 ||
+        export_path(exporter, ARROW_EXPORT_ALARMS_FILE, alarms_path, sizeof(alarms_path)) != 0) {
+        return -1;
+    }
+
+    exporter->pending_readings = malloc(sizeof(ArrowEventColumns));
+    exporter->pending_alarms = malloc(sizeof(ArrowEventColumns));
+    if (exporter->pending_readings == NULL || exporter->pending_alarms == NULL) {
+        free(exporter->pending_readings);
+        free(exporter->pending_alarms);
+        return -1;
+    }
+    exporter->pending_readings->count = 0;
+    exporter->pending_alarms->count = 0;
+
+    if (arrow_ipc_open(&exporter->readings, readings_path, ARROW_IPC_FILE, reading_fields, 3) != 0) {
+        free(exporter->pending_readings);
+        free(exporter->pending_alarms);
+        return -1;
+    }
+    if (arrow_ipc_open(&exporter->alarms, alarms_path, ARROW_IPC_FILE, alarm_fields, 4) != 0) {
+        arrow_ipc_close(&exporter->readings);
+        free(exporter->pending_readings);
+        free(exporter->pending_alarms);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Appends a patient's latest reading, and its alarms if it raised any.
+ *
+ * @param exporter Pointer to the ArrowExport structure.
+ * @param patient Pointer to the patient, after its reading was processed.
+ * @return 0 on success, -1 on error (a full batch could not be written).
+ */
+int arrow_export_reading(ArrowExport* exporter, const PatientState* patient) {
+    if (exporter == NULL || patient == NULL) return -1;
+
+    if (append_event(&exporter->readings, exporter->pending_readings, patient) != 0) return -1;
+    if (patient->alarm_flags != ALARM_NONE &&
+        append_event(&exporter->alarms, exporter->pending_alarms, patient) != 0) return -1;
+    return 0;
+}
+
+/**
+ * @brief Writes the remaining rows, the statistics of every patient and the file footers.
+ *
+ * @param exporter Pointer to the ArrowExport structure.
+ * @param registry Pointer to the registry whose patients' statistics are written, or NULL for none.
+ * @return 0 on success, -1 on error.
+ */
+int arrow_export_close(ArrowExport* exporter, PatientRegistry* registry) {
+    if (exporter == NULL || exporter->pending_readings == NULL) return -1;
+
+    int status = 0;
+    if (flush_events(&exporter->readings, exporter->pending_readings) != 0) status = -1;
+    if (flush_events(&exporter->alarms, exporter->pending_alarms) != 0) status = -1;
+    if (arrow_ipc_close(&exporter->readings) != 0) status = -1;
+    if (arrow_ipc_close(&exporter->alarms) != 0) status = -1;
+    exporter->stats.readings = exporter->readings.stats.rows;
+    exporter->stats.alarms = exporter->alarms.stats.rows;
+    exporter->stats.bytes_written = exporter->readings.stats.bytes_written + exporter->alarms.stats.bytes_written;
+
+    if (registry != NULL) {
+        long patients = write_patient_stats(exporter, registry);
+        if (patients < 0) status = -1;
+        else exporter->stats.patients = (uint32_t)patients;
+    }
+
+    free(exporter->pending_readings);
+    free(exporter->pending_alarms);
+    exporter->pending_readings = NULL;
+    exporter->pending_alarms = NULL;
+    return status;
+}
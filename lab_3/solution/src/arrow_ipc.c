@@ -0,0 +1,534 @@
+/**
+ * @file arrow_ipc.c
+ * @brief Contains the Arrow IPC stream and file writer and its Flatbuffers encoding.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../include/arrow_ipc.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define ARROW_FILE_MAGIC "ARROW1\0\0" // Magic and padding to 8 bytes at the start of a file
+#define ARROW_FILE_MAGIC_LENGTH 6     // Magic alone, at the end of a file
+#define CONTINUATION_MARKER 0xFFFFFFFFu
+#define METADATA_VERSION_V5 4
+
+// Members of the MessageHeader and Type unions (Message.fbs, Schema.fbs)
+#define HEADER_SCHEMA 1
+#define HEADER_RECORD_BATCH 3
+#define TYPE_INT 2
+#define TYPE_FLOATING_POINT 3
+#define TYPE_TIMESTAMP 10
+
+#define PRECISION_SINGLE 1
+#define PRECISION_DOUBLE 2
+#define TIME_UNIT_SECOND 0
+
+#define MAX_TABLE_FIELDS 6
+#define MAX_BATCH_IOVECS (3 + 4 * ARROW_IPC_MAX_FIELDS)
+
+static const uint8_t zero_padding[ARROW_IPC_ALIGNMENT];
+
+// Table being encoded: where it starts and where each of its fields went
+typedef struct {
+    size_t start;
+    uint16_t offsets[MAX_TABLE_FIELDS]; // From the start of the table, 0 = absent
+    int field_count;
+} FlatTable;
+
+/**
+ * @brief Appends zeroed space to the metadata, aligned from its start.
+ *
+ * @return Position of the space, or 0 if the metadata could not grow (then marked failed).
+ */
+static size_t fb_alloc(ArrowIpcMetadata* metadata, size_t bytes, size_t align) {
+    if (metadata->failed) return 0;
+
+    size_t start = (metadata->size + align - 1) / align * align;
+    if (start + bytes > metadata->capacity) {
+        size_t capacity = metadata->capacity > 0 ? metadata->capacity : 1024;
+        while (capacity < start + bytes) capacity *= 2;
+        uint8_t* data = realloc(metadata->data, capacity);
+        if (data == NULL) {
+            metadata->failed = 1;
+            return 0;
+        }
+        metadata->data = data;
+        metadata->capacity = capacity;
+    }
+    memset(metadata->data + metadata->size, 0, start + bytes - metadata->size);
+    metadata->size = start + bytes;
+    return start;
+}
+
+/**
+ * @brief Copies bytes to a position of the metadata.
+ */
+static void fb_put(ArrowIpcMetadata* metadata, size_t position, const void* value, size_t size) {
+    if (!metadata->failed) memcpy(metadata->data + position, value, size);
+}
+
+/**
+ * @brief Points the offset at slot forward to target, which must come after it.
+ */
+static void fb_link(ArrowIpcMetadata* metadata, size_t slot, size_t target) {
+    uint32_t offset = (uint32_t)(target - slot);
+    fb_put(metadata, slot, &offset, sizeof(offset));
+}
+
+/**
+ * @brief Starts a table; its fields follow, then its vtable, then the objects it refers to.
+ */
+static void fb_table_begin(ArrowIpcMetadata* metadata, FlatTable* table, int field_count) {
+    table->start = fb_alloc(metadata, sizeof(int32_t), sizeof(int32_t));
+    table->field_count = field_count;
+    memset(table->offsets, 0, sizeof(table->offsets));
+}
+
+/**
+ * @brief Adds a scalar field to the table being encoded.
+ *
+ * @return Position of the field, e.g. to link an offset field later.
+ */
+static size_t fb_table_field(ArrowIpcMetadata* metadata, FlatTable* table, int id, const void* value, size_t size) {
+    size_t position = fb_alloc(metadata, size, size);
+    table->offsets[id] = (uint16_t)(position - table->start);
+    fb_put(metadata, position, value, size);
+    return position;
+}
+
+/**
+ * @brief Adds an offset field to the table being encoded, to be linked with fb_link().
+ */
+static size_t fb_table_offset(ArrowIpcMetadata* metadata, FlatTable* table, int id) {
+    const uint32_t unlinked = 0;
+    return fb_table_field(metadata, table, id, &unlinked, sizeof(unlinked));
+}
+
+/**
+ * @brief Ends a table by writing its vtable after it.
+ *
+ * @return Position of the table.
+ */
+static size_t fb_table_end(ArrowIpcMetadata* metadata, FlatTable* table) {
+    uint16_t vtable[2 + MAX_TABLE_FIELDS];
+    size_t vtable_size = (2 + (size_t)table->field_count) * sizeof(uint16_t);
+    vtable[0] = (uint16_t)vtable_size;
+    vtable[1] = (uint16_t)(metadata->size - table->start);
+    memcpy(vtable + 2, table->offsets, (size_t)table->field_count * sizeof(uint16_t));
+
+    size_t position = fb_alloc(metadata, vtable_size, sizeof(uint16_t));
+    fb_put(metadata, position, vtable, vtable_size);
+    int32_t vtable_offset = (int32_t)((int64_t)table->start - (int64_t)position); // vtable = table - offset
+    fb_put(metadata, table->start, &vtable_offset, sizeof(vtable_offset));
+    return table->start;
+}
+
+/**
+ * @brief Appends a vector header, aligned so its first element is.
+ *
+ * @return Position of the length; elements start 4 bytes later.
+ */
+static size_t fb_vector(ArrowIpcMetadata* metadata, uint32_t count, size_t element_size, size_t element_align) {
+    size_t start = (metadata->size + 3) / 4 * 4;
+    if ((start + sizeof(uint32_t)) % element_align != 0) start += sizeof(uint32_t);
+    fb_alloc(metadata, start - metadata->size, 1);
+
+    size_t position = fb_alloc(metadata, sizeof(uint32_t) + count * element_size, sizeof(uint32_t));
+    fb_put(metadata, position, &count, sizeof(count));
+    return position;
+}
+
+/**
+ * @brief Appends a NUL-terminated string.
+ *
+ * @return Position of the string.
+ */
+static size_t fb_string(ArrowIpcMetadata* metadata, const char* text) {
+    uint32_t length = (uint32_t)strlen(text);
+    size_t position = fb_alloc(metadata, sizeof(uint32_t) + length + 1, sizeof(uint32_t));
+    fb_put(metadata, position, &length, sizeof(length));
+    fb_put(metadata, position + sizeof(uint32_t), text, length);
+    return position;
+}
+
+/**
+ * @brief Returns the width of a value of a type in bytes.
+ */
+static size_t type_width(ArrowType type) {
+    switch (type) {
+    case ARROW_TYPE_UINT8: return 1;
+    case ARROW_TYPE_UINT16: return 2;
+    case ARROW_TYPE_UINT32:
+    case ARROW_TYPE_FLOAT32: return 4;
+    default: return 8;
+    }
+}
+
+/**
+ * @brief Returns the Endianness of this host as recorded in schemas (0 = little, 1 = big).
+ */
+static int16_t host_endianness(void) {
+    const uint16_t probe = 1;
+    uint8_t first;
+    memcpy(&first, &probe, 1);
+    return first == 1 ? 0 : 1;
+}
+
+/**
+ * @brief Encodes the Type table of a column type.
+ *
+ * @return Position of the table.
+ */
+static size_t encode_type(ArrowIpcMetadata* metadata, ArrowType type) {
+    FlatTable table;
+    fb_table_begin(metadata, &table, 2);
+    size_t timezone = 0;
+    if (type == ARROW_TYPE_FLOAT32 || type == ARROW_TYPE_FLOAT64) {
+        int16_t precision = type == ARROW_TYPE_FLOAT32 ? PRECISION_SINGLE : PRECISION_DOUBLE;
+        fb_table_field(metadata, &table, 0, &precision, sizeof(precision));
+    } else if (type == ARROW_TYPE_TIMESTAMP) {
+        int16_t unit = TIME_UNIT_SECOND;
+        fb_table_field(metadata, &table, 0, &unit, sizeof(unit));
+        timezone = fb_table_offset(metadata, &table, 1);
+    } else {
+        int32_t bit_width = (int32_t)(type_width(type) * 8);
+        uint8_t is_signed = type == ARROW_TYPE_INT64;
+        fb_table_field(metadata, &table, 0, &bit_width, sizeof(bit_width));
+        fb_table_field(metadata, &table, 1, &is_signed, sizeof(is_signed));
+    }
+    size_t position = fb_table_end(metadata, &table);
+    if (type == ARROW_TYPE_TIMESTAMP) fb_link(metadata, timezone, fb_string(metadata, "UTC"));
+    return position;
+}
+
+/**
+ * @brief Encodes the Schema table of a writer.
+ *
+ * @return Position of the table.
+ */
+static size_t encode_schema(ArrowIpcWriter* writer) {
+    ArrowIpcMetadata* metadata = &writer->metadata;
+
+    FlatTable schema;
+    fb_table_begin(metadata, &schema, 2);
+    int16_t endianness = host_endianness();
+    fb_table_field(metadata, &schema, 0, &endianness, sizeof(endianness));
+    size_t fields_slot = fb_table_offset(metadata, &schema, 1);
+    size_t position = fb_table_end(metadata, &schema);
+
+    size_t fields = fb_vector(metadata, writer->field_count, sizeof(uint32_t), sizeof(uint32_t));
+    fb_link(metadata, fields_slot, fields);
+    for (uint32_t i = 0; i < writer->field_count; i++) {
+        const ArrowField* field = &writer->fields[i];
+        uint8_t nullable = field->nullable != 0;
+        uint8_t type_type = field->type == ARROW_TYPE_TIMESTAMP ? TYPE_TIMESTAMP :
+                            field->type == ARROW_TYPE_FLOAT32 || field->type == ARROW_TYPE_FLOAT64 ?
+                            TYPE_FLOATING_POINT : TYPE_INT;
+
+        FlatTable table;
+        fb_table_begin(metadata, &table, 6);
+        size_t name = fb_table_offset(metadata, &table, 0);
+        fb_table_field(metadata, &table, 1, &nullable, sizeof(nullable));
+        fb_table_field(metadata, &table, 2, &type_type, sizeof(type_type));
+        size_t type = fb_table_offset(metadata, &table, 3);
+        size_t children = fb_table_offset(metadata, &table, 5); // Readers expect the vector even when empty
+        fb_link(metadata, fields + sizeof(uint32_t) * (1 + i), fb_table_end(metadata, &table));
+
+        fb_link(metadata, name, fb_string(metadata, field->name));
+        fb_link(metadata, type, encode_type(metadata, field->type));
+        fb_link(metadata, children, fb_vector(metadata, 0, sizeof(uint32_t), sizeof(uint32_t)));
+    }
+
+    return position;
+}
+
+/**
+ * @brief Starts the metadata of a message with its Message table.
+ *
+ * @return Position of the header offset, to link to the header table.
+ */
+static size_t encode_message(ArrowIpcMetadata* metadata, uint8_t header_type, int64_t body_length) {
+    metadata->size = 0;
+    metadata->failed = 0;
+    size_t root = fb_alloc(metadata, sizeof(uint32_t), sizeof(uint32_t));
+
+    FlatTable message;
+    int16_t version = METADATA_VERSION_V5;
+    fb_table_begin(metadata, &message, 4);
+    fb_table_field(metadata, &message, 0, &version, sizeof(version));
+    fb_table_field(metadata, &message, 1, &header_type, sizeof(header_type));
+    size_t header = fb_table_offset(metadata, &message, 2);
+    fb_table_field(metadata, &message, 3, &body_length, sizeof(body_length));
+    fb_link(metadata, root, fb_table_end(metadata, &message));
+    return header;
+}
+
+/**
+ * @brief Writes iovecs in full, retrying on partial writes.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int write_iovecs(ArrowIpcWriter* writer, struct iovec* iov, int count) {
+    while (count > 0) {
+        if (iov->iov_len == 0) {
+            iov++;
+            count--;
+            continue;
+        }
+        ssize_t written = writev(writer->fd, iov, count);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return -1;
+
+        writer->stats.bytes_written += (uint64_t)written;
+        size_t left = (size_t)written;
+        while (count > 0 && left >= iov->iov_len) {
+            left -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (uint8_t*)iov->iov_base + left;
+            iov->iov_len -= left;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Writes bytes in full.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int write_bytes(ArrowIpcWriter* writer, const void* data, size_t length) {
+    struct iovec iov = {(void*)data, length};
+    return write_iovecs(writer, &iov, 1);
+}
+
+/**
+ * @brief Writes the encoded metadata as a message, followed by its body.
+ *
+ * iov[0..2] are filled here with the prefix, metadata and padding; the
+ * body goes in iov[3..].
+ *
+ * @return Length of the prefix and padded metadata, or 0 on error.
+ */
+static uint32_t write_message(ArrowIpcWriter* writer, struct iovec* iov, int body_iovecs) {
+    ArrowIpcMetadata* metadata = &writer->metadata;
+    if (metadata->failed) return 0;
+
+    // Prefix and metadata together take a multiple of 8 bytes, so the body stays aligned
+    uint32_t padded = (uint32_t)((metadata->size + 2 * sizeof(uint32_t) + 7) / 8 * 8 - 2 * sizeof(uint32_t));
+    uint32_t prefix[2] = {CONTINUATION_MARKER, padded};
+    iov[0].iov_base = prefix;
+    iov[0].iov_len = sizeof(prefix);
+    iov[1].iov_base = metadata->data;
+    iov[1].iov_len = metadata->size;
+    iov[2].iov_base = (void*)zero_padding;
+    iov[2].iov_len = padded - metadata->size;
+    if (write_iovecs(writer, iov, 3 + body_iovecs) != 0) return 0;
+    return padded + (uint32_t)sizeof(prefix);
+}
+
+/**
+ * @brief Returns the number of set bits among the first count bits of a bitmap.
+ */
+static uint64_t count_valid(const uint64_t* valid, uint32_t count) {
+    uint64_t total = 0;
+    for (uint32_t word = 0; word < count / 64; word++) total += (uint64_t)__builtin_popcountll(valid[word]);
+    if (count % 64 != 0) {
+        total += (uint64_t)__builtin_popcountll(valid[count / 64] & ((UINT64_C(1) << (count % 64)) - 1));
+    }
+    return total;
+}
+
+/**
+ * @brief Creates or replaces a file and writes the schema to it.
+ *
+ * @param writer Pointer to the ArrowIpcWriter structure to initialize.
+ * @param path File to write.
+ * @param format Stream or file variant.
+ * @param fields Pointer to the columns of the schema (copied).
+ * @param field_count Number of columns, 1 to ARROW_IPC_MAX_FIELDS.
+ * @return 0 on success, -1 on error.
+ */
+int arrow_ipc_open(ArrowIpcWriter* writer, const char* path, ArrowIpcFormat format,
+                   const ArrowField* fields, uint32_t field_count) {
+    if (writer == NULL || path == NULL || fields == NULL || field_count == 0 || field_count > ARROW_IPC_MAX_FIELDS) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < field_count; i++) {
+        if (fields[i].name == NULL || fields[i].type > ARROW_TYPE_TIMESTAMP) return -1;
+    }
+
+    memset(writer, 0, sizeof(*writer));
+    writer->format = format;
+    memcpy(writer->fields, fields, field_count * sizeof(ArrowField));
+    writer->field_count = field_count;
+    writer->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (writer->fd < 0) return -1;
+
+    struct iovec iov[3];
+    size_t header = encode_message(&writer->metadata, HEADER_SCHEMA, 0);
+    fb_link(&writer->metadata, header, encode_schema(writer));
+    if ((format == ARROW_IPC_FILE && write_bytes(writer, ARROW_FILE_MAGIC, 8) != 0) ||
+        write_message(writer, iov, 0) == 0) {
+        close(writer->fd);
+        free(writer->metadata.data);
+        memset(writer, 0, sizeof(*writer));
+        writer->fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Writes one record batch.
+ *
+ * A batch may start anywhere in the caller's value arrays, but a validity
+ * bitmap must start at bit 0 of its first word.
+ *
+ * @param writer Pointer to the ArrowIpcWriter structure.
+ * @param columns Pointer to one column per field, in schema order.
+ * @param rows Number of rows in the batch.
+ * @return 0 on success, -1 on error (including a bitmap for a non-nullable field).
+ */
+int arrow_ipc_write_batch(ArrowIpcWriter* writer, const ArrowColumn* columns, uint32_t rows) {
+    if (writer == NULL || writer->fd < 0 || columns == NULL) return -1;
+
+    // Body: validity bitmap then values of each column, each padded, straight from the caller's arrays
+    struct iovec iov[MAX_BATCH_IOVECS];
+    int64_t nodes[2 * ARROW_IPC_MAX_FIELDS];   // Length and null count per column
+    int64_t buffers[4 * ARROW_IPC_MAX_FIELDS]; // Offset and length per buffer
+    int body_iovecs = 0;
+    uint64_t body_length = 0;
+    for (uint32_t i = 0; i < writer->field_count; i++) {
+        const ArrowColumn* column = &columns[i];
+        if ((column->values == NULL && rows > 0) || (column->valid != NULL && !writer->fields[i].nullable)) return -1;
+
+        size_t lengths[2];
+        const void* data[2] = {column->valid, column->values};
+        lengths[0] = column->valid != NULL ? (rows + 7) / 8 : 0;
+        lengths[1] = rows * type_width(writer->fields[i].type);
+        nodes[2 * i] = rows;
+        nodes[2 * i + 1] = column->valid != NULL ? (int64_t)(rows - count_valid(column->valid, rows)) : 0;
+
+        for (int b = 0; b < 2; b++) {
+            size_t padding = (ARROW_IPC_ALIGNMENT - lengths[b] % ARROW_IPC_ALIGNMENT) % ARROW_IPC_ALIGNMENT;
+            buffers[4 * i + 2 * b] = (int64_t)body_length;
+            buffers[4 * i + 2 * b + 1] = (int64_t)lengths[b];
+            iov[3 + body_iovecs].iov_base = (void*)data[b];
+            iov[3 + body_iovecs++].iov_len = lengths[b];
+            iov[3 + body_iovecs].iov_base = (void*)zero_padding;
+            iov[3 + body_iovecs++].iov_len = padding;
+            body_length += lengths[b] + padding;
+        }
+    }
+
+    // RecordBatch table, then its FieldNode and Buffer structs
+    ArrowIpcMetadata* metadata = &writer->metadata;
+    size_t header = encode_message(metadata, HEADER_RECORD_BATCH, (int64_t)body_length);
+    FlatTable batch;
+    int64_t length = rows;
+    fb_table_begin(metadata, &batch, 3);
+    fb_table_field(metadata, &batch, 0, &length, sizeof(length));
+    size_t nodes_slot = fb_table_offset(metadata, &batch, 1);
+    size_t buffers_slot = fb_table_offset(metadata, &batch, 2);
+    fb_link(metadata, header, fb_table_end(metadata, &batch));
+
+    size_t vector = fb_vector(metadata, writer->field_count, 2 * sizeof(int64_t), sizeof(int64_t));
+    fb_put(metadata, vector + sizeof(uint32_t), nodes, writer->field_count * 2 * sizeof(int64_t));
+    fb_link(metadata, nodes_slot, vector);
+    vector = fb_vector(metadata, 2 * writer->field_count, 2 * sizeof(int64_t), sizeof(int64_t));
+    fb_put(metadata, vector + sizeof(uint32_t), buffers, writer->field_count * 4 * sizeof(int64_t));
+    fb_link(metadata, buffers_slot, vector);
+
+    // Files index every batch in their footer
+    if (writer->format == ARROW_IPC_FILE && writer->block_count == writer->block_capacity) {
+        uint32_t capacity = writer->block_capacity > 0 ? writer->block_capacity * 2 : 64;
+        ArrowIpcBlock* blocks = realloc(writer->blocks, capacity * sizeof(ArrowIpcBlock));
+        if (blocks == NULL) return -1;
+        writer->blocks = blocks;
+        writer->block_capacity = capacity;
+    }
+
+    uint64_t offset = writer->stats.bytes_written;
+    uint32_t metadata_length = write_message(writer, iov, body_iovecs);
+    if (metadata_length == 0) return -1;
+    if (writer->format == ARROW_IPC_FILE) {
+        ArrowIpcBlock* block = &writer->blocks[writer->block_count++];
+        block->offset = offset;
+        block->metadata_length = metadata_length;
+        block->body_length = body_length;
+    }
+    writer->stats.batches++;
+    writer->stats.rows += rows;
+    return 0;
+}
+
+/**
+ * @brief Ends the stream (and writes the footer of a file), then closes it.
+ *
+ * @param writer Pointer to the ArrowIpcWriter structure.
+ * @return 0 on success, -1 on error.
+ */
+int arrow_ipc_close(ArrowIpcWriter* writer) {
+    if (writer == NULL || writer->fd < 0) return -1;
+
+    const uint32_t end_of_stream[2] = {CONTINUATION_MARKER, 0};
+    int status = write_bytes(writer, end_of_stream, sizeof(end_of_stream));
+
+    if (writer->format == ARROW_IPC_FILE && status == 0) {
+        // Footer: the schema again and the position of every batch
+        ArrowIpcMetadata* metadata = &writer->metadata;
+        metadata->size = 0;
+        metadata->failed = 0;
+        size_t root = fb_alloc(metadata, sizeof(uint32_t), sizeof(uint32_t));
+        FlatTable footer;
+        int16_t version = METADATA_VERSION_V5;
+        fb_table_begin(metadata, &footer, 4);
+        fb_table_field(metadata, &footer, 0, &version, sizeof(version));
+        size_t schema = fb_table_offset(metadata, &footer, 1);
+        size_t dictionaries = fb_table_offset(metadata, &footer, 2);
+        size_t batches = fb_table_offset(metadata, &footer, 3);
+        fb_link(metadata, root, fb_table_end(metadata, &footer));
+        fb_link(metadata, schema, encode_schema(writer));
+        fb_link(metadata, dictionaries, fb_vector(metadata, 0, 24, sizeof(int64_t)));
+
+        size_t vector = fb_vector(metadata, writer->block_count, 24, sizeof(int64_t));
+        fb_link(metadata, batches, vector);
+        for (uint32_t i = 0; i < writer->block_count; i++) {
+            // struct Block { offset: long; metaDataLength: int; (4 bytes padding) bodyLength: long; }
+            size_t position = vector + sizeof(uint32_t) + 24 * (size_t)i;
+            int64_t offset = (int64_t)writer->blocks[i].offset;
+            int32_t metadata_length = (int32_t)writer->blocks[i].metadata_length;
+            int64_t body_length = (int64_t)writer->blocks[i].body_length;
+            fb_put(metadata, position, &offset, sizeof(offset));
+            fb_put(metadata, position + 8, &metadata_length, sizeof(metadata_length));
+            fb_put(metadata, position + 16, &body_length, sizeof(body_length));
+        }
+
+        int32_t footer_length = (int32_t)metadata->size;
+        if (metadata->failed || write_bytes(writer, metadata->data, metadata->size) != 0 ||
+            write_bytes(writer, &footer_length, sizeof(footer_length)) != 0 ||
+            write_bytes(writer, ARROW_FILE_MAGIC, ARROW_FILE_MAGIC_LENGTH) != 0) {
+            status = -1;
+        }
+    }
+
+    if (close(writer->fd) != 0) status = -1;
+    writer->fd = -1;
+    free(writer->blocks);
+    free(writer->metadata.data);
+    writer->blocks = NULL;
+    writer->metadata.data = NULL;
+    writer->metadata.capacity = 0;
+    writer->block_count = 0;
+    writer->block_capacity = 0;
+    return status;
+}
@@ -0,0 +1,545 @@
+/**
+ * @file config_store.c
+ * @brief Contains the configuration file parser and the RCU-style table store.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../include/config_store.h"
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define CONFIG_LINE_MAX 1024
+#define CONFIG_COLUMN_ALIGNMENT 64 // Columns start on a cache line for aligned vector loads
+#define CONFIG_THRESHOLD_MAX 1000  // mg/dL
+#define CONFIG_INTERVAL_MAX 3600   // Seconds
+#define CONFIG_WATCH_SLICE_MS 50   // Granularity at which the watcher notices a stop request
+
+// Settings an override line can change
+enum {
+    OVERRIDE_HYPOGLYCEMIA = 1,
+    OVERRIDE_HYPERGLYCEMIA = 2,
+    OVERRIDE_RAPID_CHANGE = 4
+};
+
+// One "patient" line of the file
+typedef struct {
+    uint32_t patient_id;
+    unsigned int mask; // OVERRIDE_* bits set on this line
+    Config values;
+    int line;
+} ConfigOverride;
+
+/**
+ * @brief Removes leading and trailing whitespace in place.
+ *
+ * @return Pointer to the first non-blank character.
+ */
+static char* trim(char* text) {
+    while (isspace((unsigned char)*text)) text++;
+    size_t length = strlen(text);
+    while (length > 0 && isspace((unsigned char)text[length - 1])) text[--length] = '\0';
+    return text;
+}
+
+/**
+ * @brief Parses a whole decimal number within a range.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int parse_int(const char* text, long min, long max, int* value) {
+    char* end;
+    errno = 0;
+    long parsed = strtol(text, &end, 10);
+    if (errno != 0 || end == text || *end != '\0' || parsed < min || parsed > max) return -1;
+    *value = (int)parsed;
+    return 0;
+}
+
+/**
+ * @brief Applies one key=value setting to a Config.
+ *
+ * @param key Setting name (a Config field name).
+ * @param value Setting value.
+ * @param config Pointer to the Config to update.
+ * @param allow_interval Non-zero if sleep_interval may be set (defaults only).
+ * @param mask Pointer to OR in the OVERRIDE_* bit of the setting, or NULL.
+ * @return 0 on success, -1 on an unknown key or invalid value.
+ */
+static int apply_setting(const char* key, const char* value, Config* config, int allow_interval, unsigned int* mask) {
+    unsigned int bit = 0;
+    int status;
+
+    if (strcmp(key, "hypoglycemia_threshold") == 0) {
+        status = parse_int(value, 1, CONFIG_THRESHOLD_MAX, &config->hypoglycemia_threshold);
+        bit = OVERRIDE_HYPOGLYCEMIA;
+    } else if (strcmp(key, "hyperglycemia_threshold") == 0) {
+        status = parse_int(value, 1, CONFIG_THRESHOLD_MAX, &config->hyperglycemia_threshold);
+        bit = OVERRIDE_HYPERGLYCEMIA;
+    } else if (strcmp(key, "rapid_change_threshold") == 0) {
+        status = parse_int(value, 1, CONFIG_THRESHOLD_MAX, &config->rapid_change_threshold);
+        bit = OVERRIDE_RAPID_CHANGE;
+    } else if (allow_interval && strcmp(key, "sleep_interval") == 0) {
+        status = parse_int(value, 1, CONFIG_INTERVAL_MAX, &config->sleep_interval);
+    } else {
+        return -1;
+    }
+
+    if (status == 0 && mask != NULL) *mask |= bit;
+    return status;
+}
+
+/**
+ * @brief Parses "patient <id> key=value ..." into an override.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int parse_override(char* text, ConfigOverride* entry) {
+    char* save;
+    char* token = strtok_r(text, " \t", &save);
+    int id;
+    if (token == NULL || parse_int(token, 0, (long)CONFIG_TABLE_MAX_ROWS - 1, &id) != 0) return -1;
+    entry->patient_id = (uint32_t)id;
+    entry->mask = 0;
+
+    while ((token = strtok_r(NULL, " \t", &save)) != NULL) {
+        char* equals = strchr(token, '=');
+        if (equals == NULL) return -1;
+        *equals = '\0';
+        if (apply_setting(token, equals + 1, &entry->values, 0, &entry->mask) != 0) return -1;
+    }
+
+    return entry->mask != 0 ? 0 : -1;
+}
+
+/**
+ * @brief Allocates a table with room for row_count rows, filled with defaults.
+ *
+ * @return New table, or NULL on error.
+ */
+static ConfigTable* allocate_table(const Config* defaults, uint32_t row_count) {
+    ConfigTable* table = calloc(1, sizeof(ConfigTable));
+    if (table == NULL) return NULL;
+    table->defaults = *defaults;
+    table->row_count = row_count;
+    if (row_count == 0) return table;
+
+    // One block for the three columns, each padded to the alignment
+    size_t column = ((size_t)row_count * sizeof(int32_t) + CONFIG_COLUMN_ALIGNMENT - 1) &
+                    ~(size_t)(CONFIG_COLUMN_ALIGNMENT - 1);
+    void* block;
+    if (posix_memalign(&block, CONFIG_COLUMN_ALIGNMENT, 3 * column) != 0) {
+        free(table);
+        return NULL;
+    }
+    table->hypoglycemia_threshold = block;
+    table->hyperglycemia_threshold = (int32_t*)((uint8_t*)block + column);
+    table->rapid_change_threshold = (int32_t*)((uint8_t*)block + 2 * column);
+
+    for (uint32_t row = 0; row < row_count; row++) {
+        table->hypoglycemia_threshold[row] = defaults->hypoglycemia_threshold;
+        table->hyperglycemia_threshold[row] = defaults->hyperglycemia_threshold;
+        table->rapid_change_threshold[row] = defaults->rapid_change_threshold;
+    }
+    return table;
+}
+
+/**
+ * @brief Builds the columns from the parsed defaults and overrides.
+ *
+ * @param error_line Pointer to receive the line of an override that leaves
+ *                   a patient with hypoglycemia >= hyperglycemia threshold.
+ * @return New table, or NULL on error.
+ */
+static ConfigTable* build_table(const Config* defaults, const ConfigOverride* overrides, size_t count,
+                                int* error_line) {
+    uint32_t row_count = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (overrides[i].patient_id >= row_count) row_count = overrides[i].patient_id + 1;
+    }
+
+    ConfigTable* table = allocate_table(defaults, row_count);
+    uint8_t* seen = calloc(row_count > 0 ? row_count : 1, 1);
+    if (table == NULL || seen == NULL) {
+        config_table_free(table);
+        free(seen);
+        return NULL;
+    }
+
+    // Later lines win, field by field
+    for (size_t i = 0; i < count; i++) {
+        const ConfigOverride* entry = &overrides[i];
+        uint32_t row = entry->patient_id;
+        if (entry->mask & OVERRIDE_HYPOGLYCEMIA) table->hypoglycemia_threshold[row] = entry->values.hypoglycemia_threshold;
+        if (entry->mask & OVERRIDE_HYPERGLYCEMIA) table->hyperglycemia_threshold[row] = entry->values.hyperglycemia_threshold;
+        if (entry->mask & OVERRIDE_RAPID_CHANGE) table->rapid_change_threshold[row] = entry->values.rapid_change_threshold;
+        if (!seen[row]) table->override_count++;
+        seen[row] = 1;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        uint32_t row = overrides[i].patient_id;
+        if (table->hypoglycemia_threshold[row] >= table->hyperglycemia_threshold[row]) {
+            *error_line = overrides[i].line;
+            config_table_free(table);
+            table = NULL;
+            break;
+        }
+    }
+
+    free(seen);
+    return table;
+}
+
+/**
+ * @brief Loads a configuration file into a new table.
+ *
+ * Settings missing from the file keep the values of initialize_config().
+ *
+ * @param path Configuration file.
+ * @param table Pointer to receive the table (free with config_table_free()).
+ * @param error_line Pointer to receive the line of a syntax error (0 for
+ *                   other errors), or NULL.
+ * @return 0 on success, -1 on error.
+ */
+int config_table_load(const char* path, ConfigTable** table, int* error_line) {
+    int local_line;
+    if (error_line == NULL) error_line = &local_line;
+    *error_line = 0;
+    if (path == NULL || table == NULL) return -1;
+
+    FILE* file = fopen(path, "r");
+    if (file == NULL) return -1;
+
+    Config defaults = initialize_config();
+    ConfigOverride* overrides = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    char buffer[CONFIG_LINE_MAX];
+    int line = 0;
+    int status = 0;
+
+    while (status == 0 && fgets(buffer, sizeof(buffer), file) != NULL) {
+        line++;
+        char* comment = strchr(buffer, '#');
+        if (comment != NULL) *comment = '\0';
+        char* text = trim(buffer);
+        if (*text == '\0') continue;
+
+        if (strncmp(text, "patient", 7) == 0 && isspace((unsigned char)text[7])) {
+            if (count == capacity) {
+                capacity = capacity ? capacity * 2 : 64;
+                ConfigOverride* grown = realloc(overrides, capacity * sizeof(ConfigOverride));
+                if (grown == NULL) {
+                    status = -1;
+                    break;
+                }
+                overrides = grown;
+            }
+            overrides[count].values = defaults;
+            overrides[count].line = line;
+            if (parse_override(text + 8, &overrides[count]) != 0) status = -1;
+            count++;
+        } else {
+            char* equals = strchr(text, '=');
+            if (equals == NULL) {
+                status = -1;
+            } else {
+                *equals = '\0';
+                status = apply_setting(trim(text), trim(equals + 1), &defaults, 1, NULL);
+            }
+        }
+        if (status != 0) *error_line = line;
+    }
+    if (ferror(file)) status = -1;
+    fclose(file);
+
+    if (status == 0 && defaults.hypoglycemia_threshold >= defaults.hyperglycemia_threshold) status = -1;
+    if (status == 0) {
+        *table = build_table(&defaults, overrides, count, error_line);
+        if (*table == NULL) status = -1;
+    }
+
+    free(overrides);
+    return status;
+}
+
+/**
+ * @brief Creates a table with default thresholds and no overrides.
+ *
+ * @param defaults Pointer to the thresholds for every patient.
+ * @return New table (free with config_table_free()), or NULL on error.
+ */
+ConfigTable* config_table_create(const Config* defaults) {
+    if (defaults == NULL) return NULL;
+    return allocate_table(defaults, 0);
+}
+
+/**
+ * @brief Frees a table that was never published or has been reclaimed.
+ *
+ * @param table Table to free, or NULL.
+ */
+void config_table_free(ConfigTable* table) {
+    if (table == NULL) return;
+    free(table->hypoglycemia_threshold); // Start of the column block
+    free(table);
+}
+
+/**
+ * @brief Initializes a store and publishes its first table.
+ *
+ * @param store Pointer to the ConfigStore structure to initialize.
+ * @param table Initial table; the store takes ownership.
+ * @return 0 on success, -1 on error.
+ */
+int config_store_init(ConfigStore* store, ConfigTable* table) {
+    if (store == NULL || table == NULL) return -1;
+
+    memset(store, 0, sizeof(*store));
+    if (pthread_mutex_init(&store->writer_lock, NULL) != 0) return -1;
+
+    // Epoch 0 marks a free reader slot, so counting starts at 1
+    table->version = 1;
+    store->epoch = 1;
+    store->current = table;
+    return 0;
+}
+
+/**
+ * @brief Registers the calling thread as a reader.
+ *
+ * @param store Pointer to the ConfigStore.
+ * @return Reader slot for config_store_quiescent(), or -1 if all slots are taken.
+ */
+int config_store_register_reader(ConfigStore* store) {
+    if (store == NULL) return -1;
+
+    int reader = -1;
+    pthread_mutex_lock(&store->writer_lock);
+    for (int slot = 0; slot < CONFIG_STORE_MAX_READERS && reader < 0; slot++) {
+        if (__atomic_load_n(&store->reader_epoch[slot], __ATOMIC_RELAXED) == 0) {
+            __atomic_store_n(&store->reader_epoch[slot], __atomic_load_n(&store->epoch, __ATOMIC_SEQ_CST),
+                             __ATOMIC_SEQ_CST);
+            reader = slot;
+        }
+    }
+    pthread_mutex_unlock(&store->writer_lock);
+
+    return reader;
+}
+
+/**
+ * @brief Unregisters a reader; it must not use any table it loaded afterwards.
+ *
+ * @param store Pointer to the ConfigStore.
+ * @param reader Slot returned by config_store_register_reader().
+ */
+void config_store_unregister_reader(ConfigStore* store, int reader) {
+    if (store == NULL || reader < 0 || reader >= CONFIG_STORE_MAX_READERS) return;
+    __atomic_store_n(&store->reader_epoch[reader], 0, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief Frees retired tables no reader can still be using (writer_lock held).
+ *
+ * A table retired at epoch E is unreachable once every reader has
+ * reported a quiescent point at epoch E or later.
+ *
+ * @return Number of tables freed.
+ */
+static uint32_t reclaim_locked(ConfigStore* store) {
+    uint64_t oldest = UINT64_MAX;
+    for (int slot = 0; slot < CONFIG_STORE_MAX_READERS; slot++) {
+        uint64_t seen = __atomic_load_n(&store->reader_epoch[slot], __ATOMIC_SEQ_CST);
+        if (seen != 0 && seen < oldest) oldest = seen;
+    }
+
+    uint32_t kept = 0;
+    uint32_t freed = 0;
+    for (uint32_t i = 0; i < store->retired_count; i++) {
+        if (store->retired_epoch[i] <= oldest) {
+            config_table_free(store->retired[i]);
+            freed++;
+        } else {
+            store->retired[kept] = store->retired[i];
+            store->retired_epoch[kept] = store->retired_epoch[i];
+            kept++;
+        }
+    }
+
+    store->retired_count = kept;
+    store->stats.reclaimed += freed;
+    return freed;
+}
+
+/**
+ * @brief Publishes a new table and retires the previous one.
+ *
+ * Never waits for readers. Fails if too many retired tables are still
+ * waiting for readers to pass a quiescent point.
+ *
+ * @param store Pointer to the ConfigStore.
+ * @param table New table; the store takes ownership on success.
+ * @return 0 on success, -1 on error.
+ */
+int config_store_publish(ConfigStore* store, ConfigTable* table) {
+    if (store == NULL || table == NULL) return -1;
+
+    pthread_mutex_lock(&store->writer_lock);
+    reclaim_locked(store);
+    if (store->retired_count == CONFIG_STORE_MAX_RETIRED) {
+        pthread_mutex_unlock(&store->writer_lock);
+        return -1;
+    }
+
+    // Swap first, then advance the epoch: a reader that sees the new epoch
+    // at its quiescent point can only load the new table afterwards
+    uint64_t epoch = store->epoch + 1;
+    table->version = epoch;
+    ConfigTable* previous = __atomic_exchange_n(&store->current, table, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&store->epoch, epoch, __ATOMIC_SEQ_CST);
+
+    store->retired[store->retired_count] = previous;
+    store->retired_epoch[store->retired_count] = epoch;
+    store->retired_count++;
+    store->stats.published++;
+    pthread_mutex_unlock(&store->writer_lock);
+
+    return 0;
+}
+
+/**
+ * @brief Frees retired tables no reader can still be using.
+ *
+ * @param store Pointer to the ConfigStore.
+ * @return Number of tables freed.
+ */
+uint32_t config_store_reclaim(ConfigStore* store) {
+    if (store == NULL) return 0;
+
+    pthread_mutex_lock(&store->writer_lock);
+    uint32_t freed = reclaim_locked(store);
+    pthread_mutex_unlock(&store->writer_lock);
+
+    return freed;
+}
+
+/**
+ * @brief Reads the modification time of a file.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int file_mtime(const char* path, struct timespec* mtime) {
+    struct stat info;
+    if (stat(path, &info) != 0) return -1;
+    *mtime = info.st_mtim;
+    return 0;
+}
+
+/**
+ * @brief Reloads the watched file whenever its modification time changes.
+ *
+ * @param argument Pointer to the ConfigStore.
+ * @return NULL.
+ */
+static void* watch_file(void* argument) {
+    ConfigStore* store = argument;
+    int waited_ms = 0;
+
+    while (!__atomic_load_n(&store->watch_stop, __ATOMIC_RELAXED)) {
+        struct timespec slice = {0, CONFIG_WATCH_SLICE_MS * 1000000L};
+        nanosleep(&slice, NULL);
+        waited_ms += CONFIG_WATCH_SLICE_MS;
+        if (waited_ms < store->watch_interval_ms) continue;
+        waited_ms = 0;
+
+        config_store_reclaim(store);
+
+        struct timespec mtime;
+        if (file_mtime(store->path, &mtime) != 0) continue;
+        if (mtime.tv_sec == store->watch_mtime.tv_sec && mtime.tv_nsec == store->watch_mtime.tv_nsec) continue;
+        store->watch_mtime = mtime; // A broken file is reported once, not on every check
+
+        ConfigTable* table;
+        int error_line;
+        if (config_table_load(store->path, &table, &error_line) != 0) {
+            printf("Warning: Failed to reload %s (line %d), keeping the current configuration\n",
+                   store->path, error_line);
+            pthread_mutex_lock(&store->writer_lock);
+            store->stats.reload_errors++;
+            pthread_mutex_unlock(&store->writer_lock);
+            continue;
+        }
+
+        uint32_t overrides = table->override_count;
+        if (config_store_publish(store, table) != 0) {
+            // Readers are behind; the next change or check tries again
+            config_table_free(table);
+            store->watch_mtime.tv_sec = 0;
+            store->watch_mtime.tv_nsec = 0;
+            pthread_mutex_lock(&store->writer_lock);
+            store->stats.reload_errors++;
+            pthread_mutex_unlock(&store->writer_lock);
+            continue;
+        }
+        printf("Reloaded configuration from %s (%u patient overrides)\n", store->path, overrides);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Starts a thread that reloads a file whenever it changes.
+ *
+ * The file's modification time is checked every interval; a file that
+ * fails to load is reported and the current table stays in place.
+ *
+ * @param store Pointer to the ConfigStore.
+ * @param path Configuration file to watch.
+ * @param interval_ms Milliseconds between checks.
+ * @return 0 on success, -1 on error.
+ */
+int config_store_watch(ConfigStore* store, const char* path, int interval_ms) {
+    if (store == NULL || path == NULL || interval_ms <= 0 || store->watch_running) return -1;
+    if (strlen(path) >= sizeof(store->path)) return -1;
+
+    strcpy(store->path, path);
+    store->watch_interval_ms = interval_ms;
+    store->watch_stop = 0;
+    if (file_mtime(path, &store->watch_mtime) != 0) return -1;
+
+    if (pthread_create(&store->watch_thread, NULL, watch_file, store) != 0) return -1;
+    store->watch_running = 1;
+    return 0;
+}
+
+/**
+ * @brief Stops the watcher and frees every table.
+ *
+ * Readers must have stopped using the store.
+ *
+ * @param store Pointer to the ConfigStore to destroy.
+ * @return 0 on success, -1 on error.
+ */
+int config_store_destroy(ConfigStore* store) {
+    if (store == NULL) return -1;
+
+    if (store->watch_running) {
+        __atomic_store_n(&store->watch_stop, 1, __ATOMIC_RELAXED);
+        pthread_join(store->watch_thread, NULL);
+        store->watch_running = 0;
+    }
+
+    for (uint32_t i = 0; i < store->retired_count; i++) config_table_free(store->retired[i]);
+    config_table_free(store->current);
+    store->retired_count = 0;
+    store->current = NULL;
+    pthread_mutex_destroy(&store->writer_lock);
+
+    return 0;
+}
@@ -3,100 +3,1533 @@
  * @brief Contains the main controller logic for glucose data generation.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include "../include/alarm.h"
 #include "../include/config.h"
+#include "../include/config_store.h"
 #include "../include/data_generator.h"
 #include "../include/analysis.h"
 #include "../include/visualization.h"
+#include "../include/latency.h"
+#include "../include/patient_registry.h"
+#include "../include/telemetry.h"
+#include "../include/ingest_server.h"
+#include "../include/state_store.h"
+#include "../include/terminal_ui.h"
+#include "../include/risk_index.h"
+#include "../include/rollup_cube.h"
+#include "../include/reading_archive.h"
+#include "../include/fleet_report.h"
+#include "../include/shard_runtime.h"
+#include "../include/latest_state.h"
+#include "../include/glucose_filter.h"
+#include "../include/glucose_kernels.h"
+#include "../include/resampler.h"
+#include "../include/arrow_export.h"
+#include "../include/metrics.h"
+#include "../include/controller.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
 #include <unistd.h> // For sleep function
 #include <stdbool.h>
+#include <signal.h>
+#include <string.h>
+#include <math.h>
+#include <sched.h>
+
+// Set from signal handlers, polled once per tick
+static volatile sig_atomic_t stop_requested = 0;
+static volatile sig_atomic_t report_requested = 0;
+
+// Seconds between ingest throughput summaries
+#define INGEST_SUMMARY_INTERVAL 5
+
+// Seconds between checkpoints of the registry when a state directory is set
+#define STATE_CHECKPOINT_INTERVAL 300
+
+// Patients copied from a lazily restored checkpoint per loop iteration
+#define STATE_PREFETCH_BATCH 4096
+
+// Milliseconds between checks of the configuration file for changes
+#define CONFIG_WATCH_INTERVAL_MS 1000
+
+// Patients listed per ranking in the at-risk report
+#define RISK_REPORT_SIZE 5
+
+// Days listed in the daily summary, ending today
+#define DAILY_SUMMARY_DAYS 7
+
+// Seconds between writes of partly filled archive blocks, bounding how stale scans can be
+#define ARCHIVE_FLUSH_INTERVAL 60
+
+// Attempts to hand a reading to a full shard inbox before it is dropped
+#define SHARD_SUBMIT_ATTEMPTS 1000
+
+// Smoothed series of every patient, indexed by registry slot
+typedef struct {
+    GlucoseFilterParams params;
+    GlucoseFilterBank bank;   // One filter per slot; bank.count slots so far
+} PatientFilters;
+
+// Readings of one simulation tick, indexed by registry slot, so the filters of
+// every patient are updated in one pass before any alarm is checked
+typedef struct {
+    double* values;           // Reading of each slot
+    uint64_t* valid;          // Validity bitmap of values: slots with a reading this tick
+    double* times;            // Time of each slot's reading
+    uint32_t capacity;        // Slots covered, a multiple of 64
+} SimulationTick;
+
+// State shared with the ingest handler
+typedef struct {
+    PatientRegistry* registry;
+    ConfigStore* thresholds;  // Current thresholds, read without locking
+    TelemetryFeed* telemetry; // NULL if not publishing
+    StateStore* store;        // NULL if not persisting
+    RiskRanking* ranking;     // Patients at risk, re-ranked on every reading
+    RollupCube* rollups;      // Hourly rollups for reports
+    ReadingArchive* archive;  // NULL if not archiving readings
+    LatestStateTable* latest; // Latest state of every patient for other threads
+    PatientFilters* smoothing; // NULL if rapid-change alarms use the raw readings
+    Resampler* resampler;     // NULL if not resampling readings onto a grid
+    ArrowExport* arrow;       // NULL if not exporting to Arrow files
+    uint64_t alarms;          // Readings that raised at least one alarm
+    uint64_t rejected;        // Readings dropped (invalid value or registry full)
+} IngestContext;
 
 /**
- * @brief Generates and displays glucose data.
- * 
- * @param data Pointer to GeneratedData structure to populate.
+ * @brief Handles SIGINT/SIGTERM by asking the main loop to stop.
+ *
+ * @param signum Signal number (unused).
+ */
+static void handle_stop_signal(int signum) {
+    (void)signum;
+    stop_requested = 1;
+}
+
+/**
+ * @brief Handles SIGUSR1 by asking the main loop to print a latency report.
+ *
+ * @param signum Signal number (unused).
+ */
+static void handle_report_signal(int signum) {
+    (void)signum;
+    report_requested = 1;
+}
+
+/**
+ * @brief Installs the controller's signal handlers.
+ *
  * @return 0 on success, -1 on error.
  */
-int generate_and_display_data(GeneratedData* data) {
-    if (data == NULL) return -1;
-    
-    if (generate_glucose_data(data) != 0) return -1;
-    if (print_glucose_data(data) != 0) return -1;
-    
+static int install_signal_handlers(void) {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    sigemptyset(&action.sa_mask);
+
+    action.sa_handler = handle_stop_signal;
+    if (sigaction(SIGINT, &action, NULL) != 0) return -1;
+    if (sigaction(SIGTERM, &action, NULL) != 0) return -1;
+
+    action.sa_handler = handle_report_signal;
+    if (sigaction(SIGUSR1, &action, NULL) != 0) return -1;
+
     return 0;
 }
 
 /**
- * @brief Analyzes glucose data and prints statistics.
- * 
- * @param stats Pointer to GlucoseStats structure.
- * @param data Pointer to GeneratedData structure.
- * @param config Pointer to Config structure.
+ * @brief Evaluates alarms without printing, updating the patient's alarm state.
+ *
+ * @param patient Pointer to the PatientState structure to check.
+ * @param filter Pointer to the patient's filter to take rapid changes from, or NULL for the raw readings.
  * @return 0 on success, -1 on error.
  */
-int analyze_data(GlucoseStats* stats, const GeneratedData* data, const Config* config) {
-    if (stats == NULL || data == NULL || config == NULL) return -1;
-    
-    if (update_glucose_statistics(stats, data, config) != 0) return -1;
-    if (print_glucose_statistics(stats) != 0) return -1;
-    
+static int update_alarms(PatientState* patient, const GlucoseFilter* filter) {
+    GlucoseSeries series = filter != NULL ? GLUCOSE_SERIES_FILTERED : GLUCOSE_SERIES_RAW;
+    if (glucose_series_alarms(&patient->data, filter, series, &patient->config, &patient->alarm_flags) != 0) return -1;
+    if (patient->alarm_flags != ALARM_NONE) patient->alarm_count++;
     return 0;
 }
 
 /**
- * @brief Checks and prints alarms.
+ * @brief Checks and prints alarms, updating the patient's alarm state.
  * 
- * @param data Pointer to GeneratedData structure.
- * @param config Pointer to Config structure.
+ * @param patient Pointer to the PatientState structure to check.
+ * @param filter Pointer to the patient's filter to take rapid changes from, or NULL for the raw readings.
  * @return 0 on success, -1 on error.
  */
-int check_alarms(const GeneratedData* data, const Config* config) {
-    if (data == NULL || config == NULL) return -1;
+int check_alarms(PatientState* patient, const GlucoseFilter* filter) {
+    if (patient == NULL) return -1;
     
-    if (check_and_print_alarms(data, config) != 0) return -1;
+    if (update_alarms(patient, filter) != 0) return -1;
+    if (print_glucose_alarms(&patient->data, patient->alarm_flags) != 0) return -1;
     
     return 0;
 }
 
 /**
- * @brief Runs the controller to manage glucose data generation.
+ * @brief Re-ranks the patient at a dense position after their statistics and rollups changed.
+ *
+ * @param ranking Pointer to the RiskRanking to update.
+ * @param rollups Pointer to the RollupCube holding the patient's last day, or NULL.
+ * @param registry Pointer to the registry holding the patient.
+ * @param index Dense position of the patient.
+ */
+static void rank_patient(RiskRanking* ranking, const RollupCube* rollups, PatientRegistry* registry,
+                         uint32_t index) {
+    PatientHandle handle;
+    if (patient_registry_handle_at(registry, index, &handle) != 0) return;
+    risk_ranking_update(ranking, handle.slot, patient_registry_at(registry, index), rollups);
+}
+
+/**
+ * @brief Adds the latest reading of the patient at a dense position to the hourly rollups.
+ *
+ * @param rollups Pointer to the RollupCube to update.
+ * @param registry Pointer to the registry holding the patient.
+ * @param index Dense position of the patient.
+ */
+static void rollup_patient(RollupCube* rollups, PatientRegistry* registry, uint32_t index) {
+    PatientHandle handle;
+    if (patient_registry_handle_at(registry, index, &handle) != 0) return;
+    const PatientState* patient = patient_registry_at(registry, index);
+    rollup_cube_add(rollups, handle.slot, patient->patient_id, patient->data.reading_time,
+                    patient->data.glucose_history[0], &patient->config);
+}
+
+/**
+ * @brief Publishes the state of the patient at a dense position for lock-free readers.
  *
- * This function initializes the data generator, updates statistics, formats
- * data as CSV, and handles visualization and alarms.
+ * @param latest Pointer to the LatestStateTable to update.
+ * @param registry Pointer to the registry holding the patient.
+ * @param index Dense position of the patient.
+ */
+static void publish_patient(LatestStateTable* latest, PatientRegistry* registry, uint32_t index) {
+    PatientHandle handle;
+    if (patient_registry_handle_at(registry, index, &handle) != 0) return;
+    latest_state_publish(latest, handle.slot, patient_registry_at(registry, index));
+}
+
+/**
+ * @brief Grows the filters to cover a slot; added filters wait for their first reading.
  *
+ * @param smoothing Pointer to the PatientFilters.
+ * @param slot Registry slot to cover.
  * @return 0 on success, -1 on error.
  */
-int run_controller(void) {
-    Config config = initialize_config();
+static int grow_filters(PatientFilters* smoothing, uint32_t slot) {
+    if (slot < smoothing->bank.count) return 0;
+    size_t capacity = smoothing->bank.count > 0 ? smoothing->bank.count : PATIENT_SLAB_CAPACITY;
+    while (capacity <= slot) capacity *= 2;
+    return glucose_filter_bank_grow(&smoothing->bank, capacity);
+}
+
+/**
+ * @brief Returns a copy of the filter of the patient at a dense position.
+ *
+ * @param smoothing Pointer to the PatientFilters, or NULL if smoothing is off.
+ * @param registry Pointer to the registry holding the patient.
+ * @param index Dense position of the patient.
+ * @param filter Pointer to the GlucoseFilter to fill.
+ * @return filter, or NULL if smoothing is off or on error.
+ */
+static GlucoseFilter* patient_filter(const PatientFilters* smoothing, PatientRegistry* registry, uint32_t index,
+                                     GlucoseFilter* filter) {
+    PatientHandle handle;
+    if (smoothing == NULL || patient_registry_handle_at(registry, index, &handle) != 0) return NULL;
+    return glucose_filter_bank_get(&smoothing->bank, handle.slot, filter) == 0 ? filter : NULL;
+}
+
+/**
+ * @brief Adds the latest reading of the patient at a dense position to their filter alone.
+ *
+ * Ingest takes this path rather than a bank update, as one frame can hold
+ * several readings of the same patient.
+ *
+ * @param smoothing Pointer to the PatientFilters, or NULL if smoothing is off.
+ * @param registry Pointer to the registry holding the patient.
+ * @param index Dense position of the patient.
+ * @param filter Pointer to the GlucoseFilter to receive the updated filter.
+ * @return filter, or NULL if smoothing is off or on error.
+ */
+static GlucoseFilter* smooth_reading(PatientFilters* smoothing, PatientRegistry* registry, uint32_t index,
+                                     GlucoseFilter* filter) {
+    PatientHandle handle;
+    if (smoothing == NULL || patient_registry_handle_at(registry, index, &handle) != 0) return NULL;
+    if (grow_filters(smoothing, handle.slot) != 0) return NULL;
+    if (glucose_filter_bank_get(&smoothing->bank, handle.slot, filter) != 0) return NULL;
+
+    const PatientState* patient = patient_registry_at(registry, index);
+    glucose_filter_update(filter, &smoothing->params, patient->data.glucose_value, patient->data.reading_time);
+    glucose_filter_bank_set(&smoothing->bank, handle.slot, filter);
+    return filter;
+}
+
+/**
+ * @brief Grows a simulation tick to cover a slot, along with the filters if smoothing.
+ *
+ * @param tick Pointer to the SimulationTick.
+ * @param smoothing Pointer to the PatientFilters, or NULL if smoothing is off.
+ * @param slot Registry slot to cover.
+ * @return 0 on success, -1 on error.
+ */
+static int grow_tick(SimulationTick* tick, PatientFilters* smoothing, uint32_t slot) {
+    if (slot >= tick->capacity) {
+        uint32_t capacity = tick->capacity > 0 ? tick->capacity : PATIENT_SLAB_CAPACITY;
+        while (capacity <= slot) capacity *= 2;
+        double* values = realloc(tick->values, capacity * sizeof(double));
+        if (values == NULL) return -1;
+        tick->values = values;
+        double* times = realloc(tick->times, capacity * sizeof(double));
+        if (times == NULL) return -1;
+        tick->times = times;
+        uint64_t* valid = realloc(tick->valid, GLUCOSE_VALIDITY_WORDS(capacity) * sizeof(uint64_t));
+        if (valid == NULL) return -1;
+        tick->valid = valid;
+        memset(values + tick->capacity, 0, (capacity - tick->capacity) * sizeof(double));
+        memset(times + tick->capacity, 0, (capacity - tick->capacity) * sizeof(double));
+        memset(valid + tick->capacity / 64, 0, (capacity - tick->capacity) / 64 * sizeof(uint64_t));
+        tick->capacity = capacity;
+    }
+    // The bank steps over every slot of the tick
+    return smoothing != NULL ? glucose_filter_bank_grow(&smoothing->bank, tick->capacity) : 0;
+}
+
+/**
+ * @brief Resamples the latest reading of the patient at a dense position onto the grid.
+ *
+ * @param resampler Pointer to the Resampler to update, or NULL if not resampling.
+ * @param registry Pointer to the registry holding the patient.
+ * @param index Dense position of the patient.
+ */
+static void resample_patient(Resampler* resampler, PatientRegistry* registry, uint32_t index) {
+    PatientHandle handle;
+    if (resampler == NULL || patient_registry_handle_at(registry, index, &handle) != 0) return;
+    const PatientState* patient = patient_registry_at(registry, index);
+    resampler_add(resampler, handle.slot, patient->patient_id, patient->data.reading_time, patient->data.glucose_value);
+}
+
+/**
+ * @brief Appends a patient's latest reading to the reading archive.
+ *
+ * @param archive Pointer to the open ReadingArchive, or NULL if there is none.
+ * @param patient Pointer to the patient.
+ */
+static void archive_patient(ReadingArchive* archive, const PatientState* patient) {
+    if (archive == NULL) return;
+    reading_archive_append(archive, patient->patient_id, patient->data.reading_time, patient->data.glucose_history[0]);
+}
+
+/**
+ * @brief Appends a patient's latest reading, and any alarm it raised, to the Arrow export.
+ *
+ * @param exporter Pointer to the open ArrowExport, or NULL if there is none.
+ * @param patient Pointer to the patient.
+ */
+static void export_patient(ArrowExport* exporter, const PatientState* patient) {
+    if (exporter == NULL) return;
+    if (arrow_export_reading(exporter, patient) != 0) printf("Warning: Failed to write the Arrow export\n");
+}
+
+/**
+ * @brief Writes partly filled archive blocks if the flush interval has passed.
+ *
+ * @param archive Pointer to the open ReadingArchive, or NULL if there is none.
+ * @param last_flush Pointer to the time of the last flush, updated on flush.
+ */
+static void flush_archive(ReadingArchive* archive, time_t* last_flush) {
+    time_t now = time(NULL);
+    if (archive == NULL || now - *last_flush < ARCHIVE_FLUSH_INTERVAL) return;
+
+    if (reading_archive_flush(archive) != 0) printf("Warning: Failed to write the reading archive\n");
+    *last_flush = now;
+}
+
+/**
+ * @brief Sets the metrics gauges owned by the main loop.
+ *
+ * Called once per loop iteration before the group commit, so the WAL
+ * gauge shows the records the commit is about to write.
+ *
+ * @param registry Pointer to the registry.
+ * @param store Pointer to the open StateStore, or NULL.
+ * @param exporter Pointer to the open ArrowExport, or NULL.
+ */
+static void update_metric_gauges(const PatientRegistry* registry, const StateStore* store,
+                                 const ArrowExport* exporter) {
+    metrics_set_gauge(METRIC_GAUGE_REGISTRY_BYTES, patient_registry_memory_bytes(registry));
+    metrics_set_gauge(METRIC_GAUGE_WAL_GROUP, store != NULL ? store->group_count : 0);
+    metrics_set_gauge(METRIC_GAUGE_RESTORE_PENDING, store != NULL ? store->lazy.on_disk : 0);
+    metrics_set_gauge(METRIC_GAUGE_ARROW_PENDING, exporter != NULL && exporter->pending_readings != NULL
+                          ? exporter->pending_readings->count + exporter->pending_alarms->count : 0);
+}
 
-    if (initialize_data_generator() != 0) return -1;
+/**
+ * @brief Returns the offset of local time from UTC at startup, in seconds.
+ *
+ * @return Seconds east of UTC.
+ */
+static int32_t local_utc_offset(void) {
+    time_t now = time(NULL);
+    struct tm utc;
+    if (gmtime_r(&now, &utc) == NULL) return 0;
+    utc.tm_isdst = -1; // Let mktime() apply daylight saving time as it does for local times
+    return (int32_t)difftime(now, mktime(&utc));
+}
+
+/**
+ * @brief Prints fleet-wide figures for each of the last days, from the hourly rollups.
+ *
+ * @param rollups Pointer to the RollupCube to report.
+ * @param registry Pointer to the registry whose patients are merged.
+ */
+static void print_daily_summary(const RollupCube* rollups, PatientRegistry* registry) {
+    time_t today = rollup_cube_day_start(rollups, time(NULL));
+    uint32_t patient_count = patient_registry_count(registry);
+
+    printf("\n--- Daily Summary ---\n");
+    for (int d = DAILY_SUMMARY_DAYS - 1; d >= 0; d--) {
+        time_t day_start = today - (time_t)d * 86400;
+        RollupBucket day = {0};
+        for (uint32_t i = 0; i < patient_count; i++) {
+            PatientHandle handle;
+            RollupBucket patient_day;
+            if (patient_registry_handle_at(registry, i, &handle) != 0) continue;
+            rollup_cube_totals(rollups, handle.slot, day_start, day_start + 86400, &patient_day);
+            rollup_bucket_merge(&day, &patient_day);
+        }
+        if (day.count == 0) continue;
+
+        GlucoseStats stats;
+        rollup_bucket_stats(&day, &stats);
+        char date[16];
+        struct tm t_storage;
+        time_t noon = day_start + 43200; // Away from midnight, whatever the offset
+        strftime(date, sizeof(date), "%Y-%m-%d", localtime_r(&noon, &t_storage));
+        printf("%s  %u readings  mean %.1f mg/dL  SD %.1f  TIR %.1f%%  TBR %.1f%%  TAR %.1f%%\n",
+               date, day.count, stats.avg_glucose, sqrt(stats.glucose_variability / day.count),
+               stats.time_in_range * 100.0 / day.count, stats.time_below_range * 100.0 / day.count,
+               stats.time_above_range * 100.0 / day.count);
+    }
+    printf("---------------------\n");
+}
+
+/**
+ * @brief Prints fleet-wide figures over every patient's resampled series.
+ *
+ * Each grid point stands for the same length of time, so these figures
+ * are time-weighted, whatever the patients' reading cadence. Grid points
+ * with an alarm come from glucose_scan_alarms_masked(), so a gap is never
+ * taken for a rapid change.
+ *
+ * @param resampler Pointer to the Resampler to report, or NULL if not resampling.
+ * @param registry Pointer to the registry whose patients are merged.
+ * @param config Pointer to the thresholds used for the ranges.
+ */
+static void print_grid_summary(const Resampler* resampler, PatientRegistry* registry, const Config* config) {
+    if (resampler == NULL) return;
+
+    GlucoseAccumulator fleet;
+    glucose_accumulator_init(&fleet);
+    uint64_t points = 0;
+    uint64_t alarmed = 0;
+    uint8_t* flags = NULL; // Scratch AlarmFlag bits of one series
+    size_t flags_capacity = 0;
+    for (uint32_t i = 0; i < patient_registry_count(registry); i++) {
+        PatientHandle handle;
+        if (patient_registry_handle_at(registry, i, &handle) != 0) continue;
+        const ResampledSeries* series = resampler_series(resampler, handle.slot);
+        if (series == NULL) continue;
+        glucose_accumulator_add_masked(&fleet, series->values, series->valid, series->count, config);
+        points += series->count;
+
+        if (series->count > flags_capacity) {
+            uint8_t* grown = realloc(flags, series->count);
+            if (grown == NULL) continue;
+            flags = grown;
+            flags_capacity = series->count;
+        }
+        long count = glucose_scan_alarms_masked(series->values, series->valid, series->count, config, flags);
+        if (count > 0) alarmed += (uint64_t)count;
+    }
+    free(flags);
+
+    const ResamplerStats* stats = &resampler->stats;
+    printf("\n--- Grid Summary (%u-minute grid) ---\n", resampler->options.interval / 60);
+    printf("%llu readings -> %llu grid points (%llu missing, %llu restarts, %llu rejected)\n",
+           (unsigned long long)stats->readings, (unsigned long long)stats->points,
+           (unsigned long long)stats->missing, (unsigned long long)stats->restarts,
+           (unsigned long long)stats->rejected);
+    if (fleet.count > 0) {
+        printf("Kept %llu points, %llu valid, %llu alarmed: mean %.1f mg/dL  SD %.1f  TIR %.1f%%  TBR %.1f%%  "
+               "TAR %.1f%%\n",
+               (unsigned long long)points, (unsigned long long)fleet.count, (unsigned long long)alarmed, fleet.mean,
+               sqrt(fleet.m2 / fleet.count), fleet.in_range * 100.0 / fleet.count,
+               fleet.below_range * 100.0 / fleet.count, fleet.above_range * 100.0 / fleet.count);
+    }
+    printf("------------------------------------\n");
+}
+
+/**
+ * @brief Prints the patients at the top of each at-risk ranking.
+ *
+ * @param ranking Pointer to the RiskRanking to report.
+ */
+static void print_risk_report(const RiskRanking* ranking) {
+    static const char* const titles[RISK_CRITERION_COUNT] = {
+        "Lowest glucose", "Time below range", "Alarm count"
+    };
+
+    printf("\n--- Patients at Risk ---\n");
+    for (int c = 0; c < RISK_CRITERION_COUNT; c++) {
+        RiskEntry top[RISK_REPORT_SIZE];
+        uint32_t count = risk_ranking_top(ranking, (RiskCriterion)c, RISK_REPORT_SIZE, top);
+        printf("%-17s", titles[c]);
+        if (count == 0) printf(" none");
+        for (uint32_t i = 0; i < count; i++) {
+            switch (c) {
+                case RISK_BY_CURRENT_LOW: printf(" %u (%.1f mg/dL)", top[i].patient_id, -top[i].score); break;
+                case RISK_BY_TIME_BELOW_RANGE: printf(" %u (%.1f%%)", top[i].patient_id, top[i].score); break;
+                default: printf(" %u (%.0f)", top[i].patient_id, top[i].score); break;
+            }
+        }
+        printf("\n");
+    }
+    printf("------------------------\n");
+}
+
+/**
+ * @brief Generates and analyzes a patient's reading for this tick, without printing.
+ *
+ * @param patient Pointer to the PatientState structure to update.
+ * @return 0 on success, -1 on error.
+ */
+static int generate_reading(PatientState* patient) {
+    LATENCY_BEGIN(generate_start);
+    int generate_result = generate_glucose_data(&patient->data);
+    LATENCY_END(LATENCY_STAGE_GENERATE, generate_start);
+    if (generate_result != 0) {
+        printf("Warning: Failed to generate data, continuing...\n");
+        return -1;
+    }
     
-    GlucoseStats stats = {0};
-    if (initialize_glucose_statistics(&stats) != 0) return -1;
+    LATENCY_BEGIN(analyze_start);
+    int analyze_result = update_glucose_statistics(&patient->stats, &patient->data, &patient->config);
+    LATENCY_END(LATENCY_STAGE_ANALYZE, analyze_start);
+    if (analyze_result != 0) {
+        printf("Warning: Failed to analyze data, continuing...\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Finishes a patient's tick once the filters are updated: display and check alarms.
+ *
+ * @param patient Pointer to the PatientState structure to check.
+ * @param display Non-zero to print the reading, statistics and alarms.
+ * @param filter Pointer to the patient's filter, or NULL if smoothing is off.
+ * @return 0 on success, -1 on error.
+ */
+static int check_patient(PatientState* patient, int display, const GlucoseFilter* filter) {
+    if (display) {
+        print_glucose_data(&patient->data);
+        print_glucose_statistics(&patient->stats);
+    }
+
+    LATENCY_BEGIN(alarm_start);
+    int alarm_result = display ? check_alarms(patient, filter) : update_alarms(patient, filter);
+    LATENCY_END(LATENCY_STAGE_ALARM, alarm_start);
+    if (alarm_result != 0) {
+        printf("Warning: Failed to check alarms, continuing...\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Records a sensor dropout: a missing entry in the patient's history.
+ *
+ * Statistics, alarms and rollups keep the last reading; the history,
+ * the latest-state table and telemetry show the gap.
+ *
+ * @param ingest Pointer to the IngestContext.
+ * @param record Pointer to the dropout record.
+ * @return 0 on success, -1 if the patient is unknown.
+ */
+static int ingest_dropout(IngestContext* ingest, const IngestRecord* record) {
+    uint32_t index;
+    PatientState* patient = state_store_find_patient(ingest->store, ingest->registry, record->patient_id, &index);
+    if (patient == NULL || record_missing_reading(&patient->data) != 0) return -1;
+
+    publish_patient(ingest->latest, ingest->registry, index);
+    if (ingest->store != NULL) state_store_log_dropout(ingest->store, record->patient_id, (time_t)record->timestamp);
+    if (ingest->telemetry != NULL && index < ingest->telemetry->capacity) {
+        telemetry_publish(ingest->telemetry, index, patient);
+    }
+    return 0;
+}
+
+/**
+ * @brief Analyzes one reading received from a device gateway.
+ *
+ * Unknown patients are registered on their first reading. Readings go
+ * through the same statistics and alarm rules as generated ones but
+ * nothing is printed, so throughput is not bound by the console.
+ *
+ * @param context Pointer to the IngestContext.
+ * @param records Readings of one frame.
+ * @param count Number of readings.
+ * @return Number of readings accepted.
+ */
+static uint32_t ingest_readings(void* context, const IngestRecord* records, size_t count) {
+    IngestContext* ingest = context;
+    uint32_t accepted = 0;
+    const ConfigTable* table = config_store_read(ingest->thresholds); // Valid until the poll returns
 
-    printf("Starting glucose data generation from controller...\n");
+    LATENCY_BEGIN(frame_start);
+    for (size_t i = 0; i < count; i++) {
+        const IngestRecord* record = &records[i];
 
-    while (1) {
-        GeneratedData data;
-        
-        if (generate_and_display_data(&data) != 0) {
-            printf("Warning: Failed to generate data, continuing...\n");
+        // NaN reports a sensor dropout of a known patient
+        if (isnan(record->glucose_value)) {
+            if (ingest_dropout(ingest, record) != 0) {
+                ingest->rejected++;
+                continue;
+            }
+            accepted++;
             continue;
         }
-        
-        if (analyze_data(&stats, &data, &config) != 0) {
-            printf("Warning: Failed to analyze data, continuing...\n");
+        if (!(record->glucose_value > 0.0f)) {
+            ingest->rejected++;
             continue;
         }
-        
-        if (check_alarms(&data, &config) != 0) {
-            printf("Warning: Failed to check alarms, continuing...\n");
+
+        uint32_t index;
+        // Restored patients not loaded yet are paged in here, on their first reading
+        PatientState* patient = state_store_find_patient(ingest->store, ingest->registry, record->patient_id, &index);
+        if (patient == NULL) {
+            PatientHandle handle;
+            if (patient_registry_add(ingest->registry, record->patient_id, &table->defaults, &handle) != 0) {
+                ingest->rejected++;
+                continue;
+            }
+            if (ingest->store != NULL) state_store_log_add(ingest->store, record->patient_id);
+            patient = patient_registry_find(ingest->registry, record->patient_id, &index);
+        }
+
+        if (record_glucose_reading(&patient->data, record->glucose_value, (time_t)record->timestamp) != 0) {
+            ingest->rejected++;
             continue;
         }
-        
-        sleep(config.sleep_interval);
+        config_table_get(table, record->patient_id, &patient->config);
+        update_glucose_statistics(&patient->stats, &patient->data, &patient->config);
+        GlucoseFilter filter;
+        update_alarms(patient, smooth_reading(ingest->smoothing, ingest->registry, index, &filter));
+        if (patient->alarm_flags != ALARM_NONE) ingest->alarms++;
+        metrics_count_reading(patient->alarm_flags);
+        rollup_patient(ingest->rollups, ingest->registry, index);
+        rank_patient(ingest->ranking, ingest->rollups, ingest->registry, index);
+        publish_patient(ingest->latest, ingest->registry, index);
+        resample_patient(ingest->resampler, ingest->registry, index);
+        archive_patient(ingest->archive, patient);
+        export_patient(ingest->arrow, patient);
+        LATENCY_END(LATENCY_STAGE_READING, frame_start);
+
+        if (ingest->store != NULL) {
+            state_store_log_reading(ingest->store, record->patient_id, record->glucose_value,
+                                    (time_t)record->timestamp);
+        }
+        if (ingest->telemetry != NULL && index < ingest->telemetry->capacity) {
+            telemetry_publish(ingest->telemetry, index, patient);
+        }
+        accepted++;
+    }
+
+    metrics_count(METRIC_REJECTED, count - accepted);
+    return accepted;
+}
+
+/**
+ * @brief Draws a dashboard frame if the frame interval has passed.
+ *
+ * @param ui Pointer to the open TerminalUI, or NULL if there is none.
+ * @param registry Pointer to the registry to show.
+ * @param status Pointer to the fleet-wide figures.
+ */
+static void refresh_dashboard(TerminalUI* ui, PatientRegistry* registry, const TerminalStatus* status) {
+    if (ui == NULL || !terminal_ui_frame_due(ui)) return;
+
+    LATENCY_BEGIN(render_start);
+    if (terminal_ui_begin_frame(ui) == 0 && terminal_ui_draw_fleet(ui, registry, status) == 0) {
+        terminal_ui_present(ui);
+    }
+    LATENCY_END(LATENCY_STAGE_RENDER, render_start);
+}
+
+/**
+ * @brief Leaves the full-screen dashboard and reports what it sent.
+ *
+ * @param ui Pointer to the open TerminalUI, or NULL if there is none.
+ */
+static void close_dashboard(TerminalUI* ui) {
+    if (ui == NULL) return;
+
+    terminal_ui_close(ui);
+    if (ui->stats.frames > 0) {
+        printf("Terminal UI: %llu frames, %.1f KiB written (%.0f bytes and %.0f cells per frame)\n",
+               (unsigned long long)ui->stats.frames, ui->stats.bytes_written / 1024.0,
+               (double)ui->stats.bytes_written / (double)ui->stats.frames,
+               (double)ui->stats.cells_changed / (double)ui->stats.frames);
+    }
+}
+
+/**
+ * @brief Receives readings from device gateways until asked to stop.
+ *
+ * @param options Pointer to the controller options.
+ * @param ingest Pointer to the IngestContext for the handler.
+ * @param reader Configuration reader slot of this thread.
+ * @param ui Pointer to the open TerminalUI, or NULL; closed before the totals are printed.
+ * @return 0 on success, -1 on error.
+ */
+static int run_ingest(const ControllerOptions* options, IngestContext* ingest, int reader, TerminalUI* ui) {
+    static IngestServer server; // Large connection table, keep it off the stack
+    if (ingest_server_open(&server, options->ingest_socket, options->ingest_port,
+                           ingest_readings, ingest) != 0) {
+        printf("Error: Failed to open the ingest server\n");
+        return -1;
+    }
+
+    if (options->ingest_socket != NULL) printf("Receiving readings on %s\n", options->ingest_socket);
+    if (options->ingest_port != 0) printf("Receiving readings on 127.0.0.1:%u\n", options->ingest_port);
+
+    time_t last_summary = time(NULL);
+    time_t last_checkpoint = last_summary;
+    time_t last_archive_flush = last_summary;
+    uint64_t last_records = 0;
+    TerminalStatus status = {"ingest", 0, 0.0, 0, 0};
+
+    // With the dashboard up, polls return in time for the next frame
+    int idle_timeout_ms = ui != NULL ? (int)(ui->frame_interval_ns / 1000000) : 1000;
+    if (idle_timeout_ms < 1) idle_timeout_ms = 1;
+
+    while (!stop_requested) {
+        if (report_requested) {
+            report_requested = 0;
+            print_latency_report();
+            print_risk_report(ingest->ranking);
+            print_daily_summary(ingest->rollups, ingest->registry);
+        }
+
+        // While restored patients are still being loaded, poll without blocking
+        uint32_t on_disk = state_store_prefetch(ingest->store, ingest->registry, STATE_PREFETCH_BATCH);
+        if (ingest_server_poll(&server, on_disk > 0 ? 1 : idle_timeout_ms) < 0) break;
+        config_store_quiescent(ingest->thresholds, reader);
+        update_metric_gauges(ingest->registry, ingest->store, ingest->arrow);
+        metrics_set_gauge(METRIC_GAUGE_INGEST_CONNECTIONS, server.open_connections);
+
+        // One group commit covers every reading received in this iteration
+        if (ingest->store != NULL && state_store_commit(ingest->store) != 0) {
+            printf("Warning: Failed to commit the write-ahead log\n");
+        }
+
+        if (ingest->telemetry != NULL) {
+            uint32_t published = patient_registry_count(ingest->registry);
+            if (published > ingest->telemetry->capacity) published = ingest->telemetry->capacity;
+            telemetry_set_patient_count(ingest->telemetry, published);
+        }
+
+        time_t now = time(NULL);
+        if (ingest->store != NULL && now - last_checkpoint >= STATE_CHECKPOINT_INTERVAL) {
+            if (state_store_checkpoint(ingest->store, ingest->registry) != 0) {
+                printf("Warning: Failed to checkpoint patient state\n");
+            }
+            last_checkpoint = now;
+        }
+        flush_archive(ingest->archive, &last_archive_flush);
+
+        if (now - last_summary >= INGEST_SUMMARY_INTERVAL) {
+            status.readings_per_second = (double)(server.stats.records - last_records) / (double)(now - last_summary);
+            if (ui == NULL) {
+                printf("Ingest: %.0f readings/s, %u connections, %u patients, %llu alarms, %llu rejected\n",
+                       status.readings_per_second, server.open_connections, patient_registry_count(ingest->registry),
+                       (unsigned long long)ingest->alarms, (unsigned long long)ingest->rejected);
+                fflush(stdout);
+            }
+            last_summary = now;
+            last_records = server.stats.records;
+        }
+
+        status.readings = server.stats.records;
+        status.alarms = ingest->alarms;
+        status.connections = server.open_connections;
+        refresh_dashboard(ui, ingest->registry, &status);
+    }
+
+    close_dashboard(ui);
+
+    printf("Ingest totals: %llu readings in %llu frames, %llu connections, %llu protocol errors, %llu ack errors\n",
+           (unsigned long long)server.stats.records, (unsigned long long)server.stats.frames,
+           (unsigned long long)server.stats.connections_accepted,
+           (unsigned long long)server.stats.protocol_errors,
+           (unsigned long long)server.stats.ack_errors);
+
+    return ingest_server_close(&server);
+}
+
+/**
+ * @brief Starts the metrics server if a port is set.
+ *
+ * @param options Pointer to the controller options.
+ * @param server Pointer to the MetricsServer structure to start.
+ * @param latest Pointer to the table to count patients in on every scrape, or NULL.
+ * @return Pointer to the running server, or NULL if there is none.
+ */
+static MetricsServer* start_metrics(const ControllerOptions* options, MetricsServer* server,
+                                    const LatestStateTable* latest) {
+    if (options->metrics_port == 0) return NULL;
+
+    if (metrics_server_start(server, options->metrics_port, latest) != 0) {
+        printf("Warning: Failed to serve metrics on 127.0.0.1:%u, continuing without them...\n", options->metrics_port);
+        return NULL;
+    }
+    printf("Serving metrics on http://127.0.0.1:%u/metrics\n", server->port);
+    return server;
+}
+
+/**
+ * @brief Stops the metrics server, if one was started.
+ *
+ * @param server Pointer to the running MetricsServer, or NULL.
+ */
+static void stop_metrics(MetricsServer* server) {
+    if (server == NULL) return;
+
+    metrics_server_stop(server);
+    printf("Metrics: %llu scrapes, %llu other requests\n", (unsigned long long)server->stats.scrapes,
+           (unsigned long long)server->stats.bad_requests);
+}
+
+/**
+ * @brief Writes the report of every archived patient and returns, instead of monitoring.
+ *
+ * @param options Pointer to the controller options.
+ * @param thresholds Pointer to the current threshold table.
+ * @return 0 on success, -1 on error.
+ */
+static int run_report(const ControllerOptions* options, const ConfigTable* thresholds) {
+    if (options->archive_dir == NULL) {
+        printf("Error: --report needs --archive-dir\n");
+        return -1;
+    }
+
+    FleetReportOptions report = fleet_report_default_options();
+    report.days = options->report_days;
+    report.thresholds = thresholds;
+    report.config = thresholds->defaults;
+
+    FleetReportRow* rows;
+    uint32_t count;
+    FleetReportStats stats;
+    if (fleet_report_build(options->archive_dir, &report, &rows, &count, &stats) != 0) {
+        printf("Error: Failed to read reading archive %s\n", options->archive_dir);
+        return -1;
+    }
+
+    // CSV for files named *.csv, the compact binary layout otherwise
+    size_t length = strlen(options->report_path);
+    FleetReportFormat format = length >= 4 && strcmp(options->report_path + length - 4, ".csv") == 0
+                                   ? FLEET_REPORT_CSV : FLEET_REPORT_BINARY;
+    uint64_t start = latency_now_ns();
+    int result = fleet_report_save(options->report_path, format, rows, count, stats.from, stats.to);
+    double write_seconds = (latency_now_ns() - start) / 1e9;
+    free(rows);
+    if (result != 0) {
+        printf("Error: Failed to write %s\n", options->report_path);
+        return -1;
+    }
+
+    printf("Wrote %u %u-day patient reports to %s: %llu readings read in %.2f s on %u threads "
+           "(%.0f reports/s, %.1f M readings/s, %.1f M readings/s per core), written in %.2f s\n",
+           count, options->report_days, options->report_path, (unsigned long long)stats.readings, stats.seconds,
+           stats.threads, count / stats.seconds, stats.readings / stats.seconds / 1e6,
+           stats.thread_seconds > 0.0 ? stats.readings / stats.thread_seconds / 1e6 : 0.0, write_seconds);
+    return 0;
+}
+
+/**
+ * @brief Routes received readings to the inboxes of their patients' shards.
+ *
+ * @param context Pointer to the ShardRuntime.
+ * @param records Readings of one frame.
+ * @param count Number of readings.
+ * @return Number of readings handed to a shard.
+ */
+static uint32_t route_readings(void* context, const IngestRecord* records, size_t count) {
+    ShardRuntime* runtime = context;
+    uint32_t accepted = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        // A full inbox means its shard is behind; give it a chance to catch up before dropping
+        int attempts = 0;
+        while (shard_runtime_submit(runtime, &records[i]) != 0 && ++attempts < SHARD_SUBMIT_ATTEMPTS) sched_yield();
+        accepted += attempts < SHARD_SUBMIT_ATTEMPTS;
+    }
+    return accepted;
+}
+
+/**
+ * @brief Prints the fleet-wide counters merged from every shard.
+ *
+ * @param label Line prefix.
+ * @param fleet Pointer to the merged ShardSummary.
+ * @param shard_count Number of shards.
+ */
+static void print_shard_summary(const char* label, const ShardSummary* fleet, uint32_t shard_count) {
+    uint32_t current = fleet->current_below + fleet->current_in + fleet->current_above;
+    printf("%s: %u shards, %u patients, %llu readings, %llu alarms, %llu rejected, "
+           "now %u below / %u in / %u above range, mean %.1f mg/dL\n",
+           label, shard_count, fleet->patients, (unsigned long long)fleet->readings,
+           (unsigned long long)fleet->alarms, (unsigned long long)fleet->rejected,
+           fleet->current_below, fleet->current_in, fleet->current_above,
+           current > 0 ? fleet->current_sum / current : 0.0);
+    fflush(stdout);
+}
+
+/**
+ * @brief Prints the fleet's patients at risk, merged from each shard's top entries.
+ *
+ * @param fleet Pointer to the merged ShardSummary.
+ */
+static void print_shard_risk_report(const ShardSummary* fleet) {
+    static const char* const titles[RISK_CRITERION_COUNT] = {
+        "Lowest glucose", "Time below range", "Alarm count"
+    };
+
+    printf("\n--- Patients at Risk ---\n");
+    for (int c = 0; c < RISK_CRITERION_COUNT; c++) {
+        uint32_t count = fleet->top_count[c] < RISK_REPORT_SIZE ? fleet->top_count[c] : RISK_REPORT_SIZE;
+        printf("%-17s", titles[c]);
+        if (count == 0) printf(" none");
+        for (uint32_t i = 0; i < count; i++) {
+            const RiskEntry* entry = &fleet->top[c][i];
+            switch (c) {
+                case RISK_BY_CURRENT_LOW: printf(" %u (%.1f mg/dL)", entry->patient_id, -entry->score); break;
+                case RISK_BY_TIME_BELOW_RANGE: printf(" %u (%.1f%%)", entry->patient_id, entry->score); break;
+                default: printf(" %u (%.0f)", entry->patient_id, entry->score); break;
+            }
+        }
+        printf("\n");
+    }
+    printf("------------------------\n");
+}
+
+/**
+ * @brief Runs the patients on one pinned shard thread per CPU instead of the main loop.
+ *
+ * Simulated patients are shared out between the shards, which generate
+ * and analyze their own readings. When ingesting, this thread only
+ * routes readings to the shard that owns each patient. The main thread
+ * never touches patient state: it merges the shards' published
+ * summaries to print fleet figures.
+ *
+ * @param options Pointer to the controller options.
+ * @param thresholds Pointer to the threshold store, read by every shard.
+ * @return 0 on success, -1 on error.
+ */
+static int run_sharded(const ControllerOptions* options, ConfigStore* thresholds) {
+    if (options->state_dir != NULL || options->publish_telemetry || options->terminal_ui ||
+        options->archive_dir != NULL || options->smooth || options->resample_minutes > 0 ||
+        options->arrow_dir != NULL) {
+        printf("Error: --shards cannot be combined with --state-dir, --telemetry, --tui, --archive-dir, --smooth, --resample or --arrow-dir\n");
+        return -1;
+    }
+
+    int ingesting = options->ingest_socket != NULL || options->ingest_port != 0;
+    ShardRuntimeOptions shard_options = shard_runtime_default_options();
+    shard_options.shard_count = options->shard_count;
+    shard_options.mode = ingesting ? SHARD_MODE_INBOX : SHARD_MODE_SIMULATE;
+    shard_options.pin = 1;
+    shard_options.thresholds = thresholds;
+    shard_options.config = config_store_read(thresholds)->defaults;
+    shard_options.patient_count = options->patient_count;
+    shard_options.tick_seconds = (uint32_t)shard_options.config.sleep_interval;
+    shard_options.realtime = 1;
+    shard_options.seed = (unsigned int)time(NULL);
+
+    static ShardRuntime runtime; // Shards are allocated separately, but the runtime is still sizeable
+    if (shard_runtime_start(&runtime, &shard_options) != 0) {
+        printf("Error: Failed to start %u shards\n", options->shard_count);
+        return -1;
+    }
+    if (ingesting) {
+        printf("Routing received readings to %u shards\n", runtime.shard_count);
+    } else {
+        printf("Running %u patients on %u shards\n", options->patient_count, runtime.shard_count);
+    }
+
+    static IngestServer server; // Large connection table, keep it off the stack
+    if (ingesting) {
+        if (ingest_server_open(&server, options->ingest_socket, options->ingest_port,
+                               route_readings, &runtime) != 0) {
+            printf("Error: Failed to open the ingest server\n");
+            shard_runtime_stop(&runtime, NULL);
+            return -1;
+        }
+        if (options->ingest_socket != NULL) printf("Receiving readings on %s\n", options->ingest_socket);
+        if (options->ingest_port != 0) printf("Receiving readings on 127.0.0.1:%u\n", options->ingest_port);
+    }
+
+    // Shards count into metrics from their own threads; there is no latest-state table to scan
+    static MetricsServer metrics_server;
+    MetricsServer* metrics = start_metrics(options, &metrics_server, NULL);
+
+    time_t last_summary = time(NULL);
+    while (!stop_requested) {
+        if (ingesting) {
+            if (ingest_server_poll(&server, 1000) < 0) break;
+            metrics_set_gauge(METRIC_GAUGE_SHARD_INBOX, shard_runtime_queued(&runtime));
+            metrics_set_gauge(METRIC_GAUGE_INGEST_CONNECTIONS, server.open_connections);
+        } else {
+            if (shard_runtime_done(&runtime)) break; // A shard failed
+            sleep(1);
+        }
+
+        ShardSummary fleet;
+        if (report_requested) {
+            report_requested = 0;
+            if (shard_runtime_summary(&runtime, &fleet) == 0) print_shard_risk_report(&fleet);
+        }
+        time_t now = time(NULL);
+        if (now - last_summary >= INGEST_SUMMARY_INTERVAL) {
+            if (shard_runtime_summary(&runtime, &fleet) == 0) print_shard_summary("Shards", &fleet, runtime.shard_count);
+            last_summary = now;
+        }
+    }
+
+    int result = 0;
+    if (ingesting) {
+        printf("Ingest totals: %llu readings in %llu frames, %llu connections, %llu protocol errors, %llu ack errors\n",
+               (unsigned long long)server.stats.records, (unsigned long long)server.stats.frames,
+               (unsigned long long)server.stats.connections_accepted,
+               (unsigned long long)server.stats.protocol_errors,
+               (unsigned long long)server.stats.ack_errors);
+        result = ingest_server_close(&server);
+    }
+
+    // Every reading routed so far is processed before the final summaries are published
+    uint32_t shard_count = runtime.shard_count;
+    ShardSummary fleet;
+    if (shard_runtime_stop(&runtime, &fleet) != 0) {
+        printf("Error: A shard failed\n");
+        result = -1;
+    }
+    print_shard_summary("Final", &fleet, shard_count);
+    if (fleet.patients > 1) print_shard_risk_report(&fleet);
+    stop_metrics(metrics);
+    return result;
+}
+
+/**
+ * @brief Returns the default controller options (a single patient).
+ *
+ * @return ControllerOptions structure with default values.
+ */
+ControllerOptions default_controller_options(void) {
+    ControllerOptions options;
+    options.patient_count = 1;
+    options.publish_telemetry = 0;
+    options.ingest_socket = NULL;
+    options.ingest_port = 0;
+    options.state_dir = NULL;
+    options.lazy_restore = 0;
+    options.config_path = NULL;
+    options.terminal_ui = 0;
+    options.frame_rate = TERMINAL_UI_DEFAULT_FPS;
+    options.archive_dir = NULL;
+    options.report_path = NULL;
+    options.report_days = FLEET_REPORT_DAYS;
+    options.shard_count = 0;
+    options.smooth = 0;
+    options.resample_minutes = 0;
+    options.arrow_dir = NULL;
+    options.metrics_port = 0;
+    return options;
+}
+
+/**
+ * @brief Parses command-line arguments into controller options.
+ *
+ * @param argc Argument count from main().
+ * @param argv Argument vector from main().
+ * @param options Pointer to the ControllerOptions structure to fill.
+ * @return 0 on success, -1 on error (unknown option or invalid value).
+ */
+int parse_controller_options(int argc, char** argv, ControllerOptions* options) {
+    if (options == NULL || (argc > 0 && argv == NULL)) return -1;
+
+    *options = default_controller_options();
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--patients") == 0 && i + 1 < argc) {
+            long count = strtol(argv[++i], NULL, 10);
+            if (count <= 0 || count > (long)PATIENT_SLAB_CAPACITY * PATIENT_REGISTRY_MAX_SLABS) return -1;
+            options->patient_count = (uint32_t)count;
+        } else if (strcmp(argv[i], "--telemetry") == 0) {
+            options->publish_telemetry = 1;
+        } else if (strcmp(argv[i], "--ingest-unix") == 0 && i + 1 < argc) {
+            options->ingest_socket = argv[++i];
+        } else if (strcmp(argv[i], "--ingest-tcp") == 0 && i + 1 < argc) {
+            long port = strtol(argv[++i], NULL, 10);
+            if (port <= 0 || port > 65535) return -1;
+            options->ingest_port = (uint16_t)port;
+        } else if (strcmp(argv[i], "--state-dir") == 0 && i + 1 < argc) {
+            options->state_dir = argv[++i];
+        } else if (strcmp(argv[i], "--lazy-restore") == 0) {
+            options->lazy_restore = 1;
+        } else if (strcmp(argv[i], "--config") == 0 && i + 1 < argc) {
+            options->config_path = argv[++i];
+        } else if (strcmp(argv[i], "--tui") == 0) {
+            options->terminal_ui = 1;
+        } else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+            long rate = strtol(argv[++i], NULL, 10);
+            if (rate < 1 || rate > TERMINAL_UI_MAX_FPS) return -1;
+            options->frame_rate = (int)rate;
+        } else if (strcmp(argv[i], "--archive-dir") == 0 && i + 1 < argc) {
+            options->archive_dir = argv[++i];
+        } else if (strcmp(argv[i], "--report") == 0 && i + 1 < argc) {
+            options->report_path = argv[++i];
+        } else if (strcmp(argv[i], "--report-days") == 0 && i + 1 < argc) {
+            long days = strtol(argv[++i], NULL, 10);
+            if (days < 1 || days > 366) return -1;
+            options->report_days = (uint32_t)days;
+        } else if (strcmp(argv[i], "--shards") == 0 && i + 1 < argc) {
+            long count = strtol(argv[++i], NULL, 10);
+            if (count < 1 || count > SHARD_MAX) return -1;
+            options->shard_count = (uint32_t)count;
+        } else if (strcmp(argv[i], "--smooth") == 0) {
+            options->smooth = 1;
+        } else if (strcmp(argv[i], "--resample") == 0 && i + 1 < argc) {
+            long minutes = strtol(argv[++i], NULL, 10);
+            if (minutes < 1 || minutes > 60) return -1;
+            options->resample_minutes = (uint32_t)minutes;
+        } else if (strcmp(argv[i], "--arrow-dir") == 0 && i + 1 < argc) {
+            options->arrow_dir = argv[++i];
+        } else if (strcmp(argv[i], "--metrics-port") == 0 && i + 1 < argc) {
+            long port = strtol(argv[++i], NULL, 10);
+            if (port <= 0 || port > 65535) return -1;
+            options->metrics_port = (uint16_t)port;
+        } else {
+            return -1;
+        }
     }
 
     return 0;
 }
+
+/**
+ * @brief Runs the controller to manage glucose data generation.
+ *
+ * This function registers the simulated patients, then generates data,
+ * updates statistics and handles visualization and alarms for each of
+ * them on every tick. If an ingest socket or port is set, readings are
+ * received from device gateways instead of being generated. If a state
+ * directory is set, the registry is restored from it at startup and every
+ * change is logged to it. If a configuration file is set, thresholds are
+ * read from it and reloaded whenever it changes. If an archive directory
+ * is set, every reading is also appended to a reading archive. If a report
+ * file is set, reports of every archived patient are written to it instead.
+ * If a shard count is set, patients are run on that many pinned shard
+ * threads, each owning its own patients, instead of the main loop. If
+ * smoothing is set, rapid-change alarms use each patient's Kalman-filtered
+ * rate of change instead of the difference of the two newest readings;
+ * it cannot be combined with a state directory. If a resampling grid is
+ * set, each patient's readings are also resampled onto it as they arrive,
+ * and fleet figures over the grid are reported.
+ * If an Arrow directory is set, readings, alarm events and per-patient
+ * statistics are exported to it as Arrow IPC files. If a metrics port is
+ * set, counters, stage latency histograms, queue depths and memory use are
+ * served on it in Prometheus text format, and stage timing is switched on.
+ *
+ * @param options Pointer to the controller options.
+ * @return 0 on success, -1 on error.
+ */
+int run_controller(const ControllerOptions* options) {
+    if (options == NULL) return -1;
+
+    Config config = initialize_config();
+
+    // Thresholds come from a table that the watcher may replace at any time
+    static ConfigStore thresholds;
+    ConfigTable* table = NULL;
+    if (options->config_path != NULL) {
+        int error_line = 0;
+        if (config_table_load(options->config_path, &table, &error_line) != 0) {
+            printf("Error: Failed to load configuration %s (line %d)\n", options->config_path, error_line);
+            return -1;
+        }
+        printf("Loaded configuration from %s (%u patient overrides)\n", options->config_path, table->override_count);
+    } else {
+        table = config_table_create(&config);
+        if (table == NULL) return -1;
+    }
+    config = table->defaults;
+    if (config_store_init(&thresholds, table) != 0) {
+        config_table_free(table);
+        return -1;
+    }
+    int reader = config_store_register_reader(&thresholds);
+    if (options->config_path != NULL &&
+        config_store_watch(&thresholds, options->config_path, CONFIG_WATCH_INTERVAL_MS) != 0) {
+        printf("Warning: Failed to watch %s, changes will not be reloaded...\n", options->config_path);
+    }
+
+    // Batch reports read the archive and exit; nothing is monitored
+    if (options->report_path != NULL) {
+        int result = run_report(options, config_store_read(&thresholds));
+        config_store_quiescent(&thresholds, reader);
+        config_store_destroy(&thresholds);
+        return result;
+    }
+
+    if (initialize_data_generator() != 0 || install_signal_handlers() != 0) {
+        config_store_destroy(&thresholds);
+        return -1;
+    }
+
+    // Shards own their patients; this thread only routes readings and merges summaries
+    if (options->shard_count > 0) {
+        int result = run_sharded(options, &thresholds);
+        config_store_quiescent(&thresholds, reader);
+        config_store_destroy(&thresholds);
+        return result;
+    }
+
+    // Replay re-evaluates alarms on the raw readings, so restored alarm state would not match filtered alarms
+    if (options->smooth && options->state_dir != NULL) {
+        printf("Error: --smooth cannot be combined with --state-dir\n");
+        config_store_destroy(&thresholds);
+        return -1;
+    }
+
+    // Stage timing is opt-in so the default console output is unchanged; scrapers get the histograms
+    const char* latency_env = getenv("GLUCOSE_LATENCY");
+    latency_set_enabled((latency_env != NULL && strcmp(latency_env, "0") != 0) || options->metrics_port != 0);
+    
+    // The registry is large (slab table), so keep it off the stack
+    static PatientRegistry registry;
+    if (patient_registry_init(&registry) != 0 ||
+        patient_registry_reserve(&registry, options->patient_count) != 0) {
+        config_store_destroy(&thresholds);
+        return -1;
+    }
+
+    // Restore the state of the previous run before anything else touches the registry
+    static StateStore store;
+    StateStore* persist = NULL;
+    if (options->state_dir != NULL) {
+        RecoveryStats recovery;
+        if (state_store_open(&store, options->state_dir, &registry, &config, 0,
+                             options->lazy_restore, &recovery) != 0) {
+            printf("Error: Failed to open state directory %s\n", options->state_dir);
+            patient_registry_destroy(&registry);
+            config_store_destroy(&thresholds);
+            return -1;
+        }
+        persist = &store;
+        printf("Recovered %u patients from %s in %.1f ms (checkpoint %.1f ms, %llu log records on %u threads %.1f ms)\n",
+               patient_registry_count(&registry) + recovery.lazy_patients, options->state_dir,
+               (recovery.checkpoint_seconds + recovery.replay_seconds) * 1e3, recovery.checkpoint_seconds * 1e3,
+               (unsigned long long)recovery.records_replayed, recovery.threads, recovery.replay_seconds * 1e3);
+        if (recovery.lazy_patients > 0) {
+            printf("%u patients will be loaded on first use or in the background (%llu log records held back)\n",
+                   recovery.lazy_patients, (unsigned long long)recovery.records_deferred);
+        }
+    }
+
+    // When ingesting, patients are registered as their readings arrive
+    int ingesting = options->ingest_socket != NULL || options->ingest_port != 0;
+    for (uint32_t id = 1; id <= options->patient_count && !ingesting; id++) {
+        if (state_store_has_patient(persist, &registry, id)) continue; // Restored
+        PatientHandle handle;
+        if (patient_registry_add(&registry, id, &config, &handle) != 0) {
+            if (persist != NULL) state_store_close(persist);
+            patient_registry_destroy(&registry);
+            config_store_destroy(&thresholds);
+            return -1;
+        }
+        if (persist != NULL) state_store_log_add(persist, id);
+    }
+
+    // Rankings follow every statistics update from here on; restored patients start ranked,
+    // by their restored statistics until their next reading reaches the rollups
+    static RiskRanking ranking;
+    risk_ranking_init(&ranking);
+    for (uint32_t i = 0; i < patient_registry_count(&registry); i++) rank_patient(&ranking, NULL, &registry, i);
+
+    // Other threads read patients' latest state from here, never from the registry
+    static LatestStateTable latest;
+    latest_state_init(&latest);
+    for (uint32_t i = 0; i < patient_registry_count(&registry); i++) publish_patient(&latest, &registry, i);
+
+    // Scrapes read per-thread counters and the latest-state table, never the registry
+    static MetricsServer metrics_server;
+    MetricsServer* metrics = start_metrics(options, &metrics_server, &latest);
+
+    // Rapid-change alarms follow the filtered rate when smoothing; filters start with each patient's next reading
+    static PatientFilters filters;
+    PatientFilters* smoothing = NULL;
+    if (options->smooth) {
+        filters.params = glucose_filter_default_params();
+        smoothing = &filters;
+        printf("Smoothing readings for rapid-change alarms (Kalman filter, sensor noise %.0f mg/dL)\n",
+               GLUCOSE_FILTER_MEASUREMENT_SD);
+    }
+
+    // Irregular readings are also aligned to a fixed grid, for time-weighted figures
+    static Resampler resampler;
+    Resampler* resampling = NULL;
+    if (options->resample_minutes > 0) {
+        ResamplerOptions resampler_options = resampler_default_options();
+        resampler_options.interval = options->resample_minutes * 60;
+        if (resampler_init(&resampler, &resampler_options) == 0) {
+            resampling = &resampler;
+            printf("Resampling readings onto a %u-minute grid (gaps over %u minutes are left missing)\n",
+                   options->resample_minutes, resampler_options.max_gap / 60);
+        }
+    }
+
+    // Reports read hourly rollups kept from here on instead of raw readings
+    static RollupCube rollups;
+    rollup_cube_init(&rollups, local_utc_offset());
+
+    // Every reading is also kept for retrospective scans (see archive_scan.h)
+    static ReadingArchive archive;
+    ReadingArchive* archiving = NULL;
+    if (options->archive_dir != NULL) {
+        if (reading_archive_open(&archive, options->archive_dir) == 0) {
+            archiving = &archive;
+            printf("Archiving readings to %s\n", options->archive_dir);
+        } else {
+            printf("Warning: Failed to open reading archive %s, continuing without it...\n", options->archive_dir);
+        }
+    }
+
+    // Readings, alarm events and statistics also go to Arrow files for analysis in pandas or Polars
+    static ArrowExport arrow;
+    ArrowExport* exporting = NULL;
+    if (options->arrow_dir != NULL) {
+        if (arrow_export_open(&arrow, options->arrow_dir) == 0) {
+            exporting = &arrow;
+            printf("Exporting Arrow IPC files to %s\n", options->arrow_dir);
+        } else {
+            printf("Warning: Failed to open Arrow export %s, continuing without it...\n", options->arrow_dir);
+        }
+    }
+
+    // Latest state goes to shared memory for dashboards, one slot per patient
+    TelemetryFeed telemetry;
+    int telemetry_active = 0;
+    if (options->publish_telemetry) {
+        // Patients a lazy restore has not loaded yet still need slots
+        uint32_t telemetry_capacity = patient_registry_count(&registry) + (persist != NULL ? persist->lazy.on_disk : 0);
+        if (telemetry_capacity < options->patient_count) telemetry_capacity = options->patient_count;
+        if (telemetry_open(&telemetry, TELEMETRY_SHM_NAME, telemetry_capacity,
+                           (uint32_t)config.sleep_interval) == 0) {
+            telemetry_active = 1;
+            telemetry_set_patient_count(&telemetry, patient_registry_count(&registry));
+            printf("Publishing telemetry to shared memory %s\n", TELEMETRY_SHM_NAME);
+        } else {
+            printf("Warning: Failed to open telemetry segment, continuing without it...\n");
+        }
+    }
+
+    // The dashboard replaces the per-reading printout
+    static TerminalUI terminal;
+    TerminalUI* ui = NULL;
+    if (options->terminal_ui) {
+        if (terminal_ui_open(&terminal, STDOUT_FILENO, options->frame_rate) == 0) {
+            fflush(stdout);
+            ui = &terminal;
+        } else {
+            printf("Warning: Failed to open the terminal UI, printing readings instead...\n");
+        }
+    }
+
+    int result = 0;
+    if (ingesting) {
+        IngestContext ingest = {&registry, &thresholds, telemetry_active ? &telemetry : NULL, persist, &ranking, &rollups, archiving, &latest, smoothing, resampling, exporting, 0, 0};
+        result = run_ingest(options, &ingest, reader, ui);
+    } else if (ui == NULL) {
+        printf("Starting glucose data generation from controller...\n");
+    }
+
+    static SimulationTick tick;
+    TerminalStatus status = {"simulation", 0, 0.0, 0, 0};
+    uint64_t simulation_start = latency_now_ns();
+    time_t last_checkpoint = time(NULL);
+    time_t last_archive_flush = last_checkpoint;
+    while (!ingesting && !stop_requested) {
+        if (report_requested) {
+            report_requested = 0;
+            print_latency_report();
+            if (patient_registry_count(&registry) > 1) print_risk_report(&ranking);
+            print_daily_summary(&rollups, &registry);
+            print_grid_summary(resampling, &registry, &config);
+        }
+
+        const ConfigTable* current = config_store_read(&thresholds);
+        uint32_t patient_count = patient_registry_count(&registry);
+        // Every patient's reading first, then all filters in one vectorized pass, then alarms and output
+        for (uint32_t i = 0; i < patient_count && !stop_requested; i++) {
+            PatientState* patient = patient_registry_at(&registry, i);
+            PatientHandle handle;
+            if (patient_registry_handle_at(&registry, i, &handle) != 0 ||
+                grow_tick(&tick, smoothing, handle.slot) != 0) {
+                continue;
+            }
+            config_table_get(current, patient->patient_id, &patient->config);
+            uint64_t bit = 1ull << (handle.slot % 64);
+            if (generate_reading(patient) == 0) {
+                tick.values[handle.slot] = patient->data.glucose_value;
+                tick.times[handle.slot] = (double)patient->data.reading_time;
+                tick.valid[handle.slot / 64] |= bit;
+            } else {
+                tick.valid[handle.slot / 64] &= ~bit;
+            }
+        }
+        if (smoothing != NULL) {
+            glucose_filter_bank_update(&smoothing->bank, &smoothing->params, tick.values, tick.valid, tick.times);
+        }
+
+        for (uint32_t i = 0; i < patient_count && !stop_requested; i++) {
+            PatientState* patient = patient_registry_at(&registry, i);
+            PatientHandle handle;
+            if (patient_registry_handle_at(&registry, i, &handle) != 0 || handle.slot >= tick.capacity ||
+                !((tick.valid[handle.slot / 64] >> (handle.slot % 64)) & 1)) {
+                metrics_count(METRIC_REJECTED, 1);
+                continue;
+            }
+            // Consumed, so a patient skipped next tick has no reading
+            tick.valid[handle.slot / 64] &= ~(1ull << (handle.slot % 64));
+            if (patient_count > 1 && ui == NULL) printf("\n=== Patient %u ===\n", patient->patient_id);
+            GlucoseFilter filter;
+            if (check_patient(patient, ui == NULL, patient_filter(smoothing, &registry, i, &filter)) != 0) {
+                metrics_count(METRIC_REJECTED, 1);
+                continue;
+            }
+            metrics_count_reading(patient->alarm_flags);
+            rollup_patient(&rollups, &registry, i);
+            rank_patient(&ranking, &rollups, &registry, i);
+            publish_patient(&latest, &registry, i);
+            resample_patient(resampling, &registry, i);
+            archive_patient(archiving, patient);
+            export_patient(exporting, patient);
+            status.readings++;
+            status.alarms += patient->alarm_flags != ALARM_NONE;
+            if (ui != NULL && (status.readings & 255) == 0) {
+                // Long ticks keep the dashboard moving; short ones only pay for a counter test
+                status.readings_per_second = status.readings / ((latency_now_ns() - simulation_start) / 1e9);
+                refresh_dashboard(ui, &registry, &status);
+            }
+            if (telemetry_active) telemetry_publish(&telemetry, i, patient);
+            if (persist != NULL) {
+                state_store_log_reading(persist, patient->patient_id, patient->data.glucose_value,
+                                        patient->data.reading_time);
+            }
+        }
+
+        // One group commit per tick covers every patient's reading
+        update_metric_gauges(&registry, persist, exporting);
+        if (persist != NULL) {
+            state_store_prefetch(persist, &registry, STATE_PREFETCH_BATCH);
+            if (state_store_commit(persist) != 0) printf("Warning: Failed to commit the write-ahead log\n");
+            if (time(NULL) - last_checkpoint >= STATE_CHECKPOINT_INTERVAL) {
+                if (state_store_checkpoint(persist, &registry) != 0) {
+                    printf("Warning: Failed to checkpoint patient state\n");
+                }
+                last_checkpoint = time(NULL);
+            }
+        }
+        // Patients a lazy restore has loaded since the last tick count too
+        if (telemetry_active) {
+            uint32_t published = patient_registry_count(&registry);
+            if (published > telemetry.capacity) published = telemetry.capacity;
+            telemetry_set_patient_count(&telemetry, published);
+        }
+        flush_archive(archiving, &last_archive_flush);
+
+        unsigned int interval = (unsigned int)current->defaults.sleep_interval;
+        config_store_quiescent(&thresholds, reader); // current is not used past this point
+        if (ui == NULL) {
+            sleep(interval);
+            continue;
+        }
+
+        // Keep drawing while waiting for the next tick, so the clock and rate stay live
+        uint64_t tick_end = latency_now_ns() + (uint64_t)interval * 1000000000ull;
+        while (!stop_requested && latency_now_ns() < tick_end) {
+            status.readings_per_second = status.readings / ((latency_now_ns() - simulation_start) / 1e9);
+            refresh_dashboard(ui, &registry, &status);
+            struct timespec frame = {0, (long)ui->frame_interval_ns};
+            nanosleep(&frame, NULL);
+        }
+    }
+    if (!ingesting) close_dashboard(ui); // run_ingest closes it itself
+
+    stop_metrics(metrics); // Before the latest-state table it scans goes away
+    if (latency_is_enabled()) print_latency_report();
+    if (patient_registry_count(&registry) > 1) print_risk_report(&ranking);
+    risk_ranking_destroy(&ranking);
+    print_daily_summary(&rollups, &registry);
+    rollup_cube_destroy(&rollups);
+    latest_state_destroy(&latest);
+    glucose_filter_bank_destroy(&filters.bank);
+    free(tick.values);
+    free(tick.valid);
+    free(tick.times);
+    print_grid_summary(resampling, &registry, &config);
+    resampler_destroy(resampling);
+
+    if (archiving != NULL) {
+        if (reading_archive_close(archiving) != 0) {
+            printf("Warning: Failed to write the reading archive %s\n", options->archive_dir);
+        }
+        printf("Reading archive: %llu readings in %llu blocks, %.1f MiB written\n",
+               (unsigned long long)archive.stats.readings, (unsigned long long)archive.stats.blocks,
+               archive.stats.bytes_written / (1024.0 * 1024.0));
+    }
+
+    if (exporting != NULL) {
+        if (arrow_export_close(exporting, &registry) != 0) {
+            printf("Warning: Failed to write the Arrow export %s\n", options->arrow_dir);
+        }
+        printf("Arrow export: %llu readings, %llu alarm events and %u patients, %.1f MiB written\n",
+               (unsigned long long)arrow.stats.readings, (unsigned long long)arrow.stats.alarms,
+               arrow.stats.patients, arrow.stats.bytes_written / (1024.0 * 1024.0));
+    }
+
+    // A final checkpoint keeps the next startup's replay short
+    if (persist != NULL) {
+        if (state_store_checkpoint(persist, &registry) != 0 || state_store_close(persist) != 0) {
+            printf("Warning: Failed to save patient state to %s\n", options->state_dir);
+        }
+    }
+
+    if (telemetry_active) telemetry_close(&telemetry, 1);
+    patient_registry_destroy(&registry);
+
+    if (thresholds.stats.published > 0 || thresholds.stats.reload_errors > 0) {
+        printf("Configuration: %llu reloads, %llu reload errors\n",
+               (unsigned long long)thresholds.stats.published,
+               (unsigned long long)thresholds.stats.reload_errors);
+    }
+    config_store_destroy(&thresholds);
+
+    return result;
+}
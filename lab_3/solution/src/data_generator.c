@@ -3,6 +3,8 @@
  * @brief Contains functions for generating glucose data and simulating anomalies.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include "../include/data_generator.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -29,44 +31,129 @@ int initialize_data_generator(void) {
  * @return 0 on success, -1 on error.
  */
 int generate_glucose_data(GeneratedData* data) {
+    return generate_glucose_data_at(data, time(NULL));
+}
+
+/**
+ * @brief Generates a new set of glucose data stamped with a given time.
+ *
+ * Same as generate_glucose_data(), but uses the supplied timestamp instead
+ * of the wall clock so simulations can run faster than real time.
+ *
+ * @param data Pointer to the GeneratedData structure to populate.
+ * @param timestamp Time of the reading.
+ * @return 0 on success, -1 on error.
+ */
+int generate_glucose_data_at(GeneratedData* data, time_t timestamp) {
+    return generate_glucose_data_r(data, timestamp, NULL);
+}
+
+/**
+ * @brief Returns the next random number from a caller's state, or from rand().
+ */
+static int next_random(unsigned int* seed) {
+    return seed != NULL ? rand_r(seed) : rand();
+}
+
+/**
+ * @brief Generates a new set of glucose data from a caller-owned random state.
+ *
+ * Same as generate_glucose_data_at(), but draws from *seed with rand_r(),
+ * so threads generating readings in parallel neither share nor lock the
+ * generator state. With a NULL seed, rand() is used.
+ *
+ * @param data Pointer to the GeneratedData structure to populate.
+ * @param timestamp Time of the reading.
+ * @param seed Pointer to the random state of the calling thread, or NULL.
+ * @return 0 on success, -1 on error.
+ */
+int generate_glucose_data_r(GeneratedData* data, time_t timestamp, unsigned int* seed) {
     if (data == NULL) return -1;
 
-    // Generate timestamp
-    time_t now = time(NULL);
-    struct tm* t = gmtime(&now);
-    strftime(data->timestamp, sizeof(data->timestamp), "%Y-%m-%dT%H:%M:%SZ", t);
+    double glucose_value;
 
     // Generate glucose value with increased chance of anomalies
-    int anomaly_chance = rand() % 10; // 0-9
+    int anomaly_chance = next_random(seed) % 10; // 0-9
     
     if (anomaly_chance < 3) {
         // 30% chance of hypoglycemia (glucose < 70 mg/dL)
-        data->glucose_value = 40 + ((double)(rand() % 30)); // 40-69 mg/dL
+        glucose_value = 40 + ((double)(next_random(seed) % 30)); // 40-69 mg/dL
     } else if (anomaly_chance < 6) {
         // 30% chance of hyperglycemia (glucose > 180 mg/dL)
-        data->glucose_value = 180 + ((double)(rand() % 70)); // 180-249 mg/dL
+        glucose_value = 180 + ((double)(next_random(seed) % 70)); // 180-249 mg/dL
     } else {
         // 40% chance of normal glucose (70-180 mg/dL)
-        data->glucose_value = 70 + ((double)(rand() % 111)); // 70-180 mg/dL
+        glucose_value = 70 + ((double)(next_random(seed) % 111)); // 70-180 mg/dL
     }
 
     // Add some random variation for more realistic readings
-    if (rand() % 5 == 0) {
+    if (next_random(seed) % 5 == 0) {
         // 20% chance of adding small random variation
-        data->glucose_value += (rand() % 21) - 10; // ±10 mg/dL variation
+        glucose_value += (next_random(seed) % 21) - 10; // ±10 mg/dL variation
         
         // Ensure we don't go below 30 or above 400
-        if (data->glucose_value < 30) data->glucose_value = 30;
-        if (data->glucose_value > 400) data->glucose_value = 400;
+        if (glucose_value < 30) glucose_value = 30;
+        if (glucose_value > 400) glucose_value = 400;
     }
 
+    return record_glucose_reading(data, glucose_value, timestamp);
+}
+
+/**
+ * @brief Records an externally measured reading and updates the glucose history.
+ *
+ * Stamps the reading, stores its value and shifts it into the history
+ * exactly as generate_glucose_data() does for simulated readings. The
+ * value is rounded to the 0.1 mg/dL resolution of the history, so the
+ * current value and glucose_history[0] always agree.
+ *
+ * @param data Pointer to the GeneratedData structure to update.
+ * @param glucose_value Measured glucose value in mg/dL.
+ * @param timestamp Time of the reading.
+ * @return 0 on success, -1 on error.
+ */
+int record_glucose_reading(GeneratedData* data, double glucose_value, time_t timestamp) {
+    if (data == NULL) return -1;
+
+    // Generate timestamp
+    struct tm t_storage;
+    struct tm* t = gmtime_r(&timestamp, &t_storage);
+    if (t == NULL) return -1;
+    strftime(data->timestamp, sizeof(data->timestamp), "%Y-%m-%dT%H:%M:%SZ", t);
+    data->reading_time = timestamp;
+    GlucoseFixed fixed_value = glucose_to_fixed(glucose_value);
+    data->glucose_value = glucose_from_fixed(fixed_value);
+
     // Shift glucose history to make room for the new value
     for (int i = 29; i > 0; i--) {
         data->glucose_history[i] = data->glucose_history[i - 1];
     }
 
     // Add the new glucose value to the history
-    data->glucose_history[0] = data->glucose_value;
+    data->glucose_history[0] = fixed_value;
+    data->history_valid = ((data->history_valid << 1) | 1u) & GLUCOSE_HISTORY_VALID_MASK;
     
     return 0;
 }
+
+/**
+ * @brief Records a sensor dropout: shifts a missing entry into the glucose history.
+ *
+ * The latest reading (glucose_value, reading_time and timestamp) is left
+ * as is, but it is no longer the previous reading of the next one, so no
+ * rapid change is evaluated across the gap.
+ *
+ * @param data Pointer to the GeneratedData structure to update.
+ * @return 0 on success, -1 on error.
+ */
+int record_missing_reading(GeneratedData* data) {
+    if (data == NULL) return -1;
+
+    for (int i = 29; i > 0; i--) {
+        data->glucose_history[i] = data->glucose_history[i - 1];
+    }
+    data->glucose_history[0] = 0;
+    data->history_valid = (data->history_valid << 1) & GLUCOSE_HISTORY_VALID_MASK;
+
+    return 0;
+}
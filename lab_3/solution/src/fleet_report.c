@@ -0,0 +1,538 @@
+/**
+ * @file fleet_report.c
+ * @brief Contains the single-pass, multi-threaded batch reports over the reading archive.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../include/fleet_report.h"
+#include "../include/archive_scan.h"
+#include "../include/latency.h"
+#include "../include/reading_archive.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PATIENT_MAP_MIN_CAPACITY 1024
+
+// Run of readings beyond a threshold; readings == 0 when there is none
+typedef struct {
+    int64_t start;
+    int64_t last;
+    uint32_t readings;
+} EpisodeRun;
+
+// Everything a report needs, accumulated one reading at a time
+typedef struct {
+    uint32_t patient_id;
+    GlucoseFixed low;    // Patient's thresholds in fixed point
+    GlucoseFixed high;
+    uint32_t count;
+    uint32_t below;
+    uint32_t above;
+    uint64_t sum;
+    uint64_t sum_squares;
+    GlucoseFixed min_value;
+    GlucoseFixed max_value;
+    EpisodeRun low_run;
+    EpisodeRun high_run;
+    uint32_t low_episodes;
+    uint32_t high_episodes;
+    uint32_t histogram[FLEET_REPORT_BINS];
+} PatientAccumulator;
+
+// One worker's share of a batch
+typedef struct {
+    const FleetReportOptions* options;
+    const char* directory;
+    ArchiveBlockIndex** entries; // Per shard, loaded once before the workers start
+    const uint32_t* entry_counts;
+    int64_t from;
+    int64_t to;
+    uint32_t* next_shard;        // Shared; shards are taken with an atomic increment
+
+    // Patients of the shard being read; the map holds accumulator index + 1
+    PatientAccumulator* patients;
+    uint32_t patient_count;
+    uint32_t patient_capacity;
+    uint32_t* map;
+    uint32_t map_capacity;       // Power of two
+
+    FleetReportRow* rows;
+    uint32_t row_count;
+    uint32_t row_capacity;
+
+    uint8_t* buffer;
+    size_t buffer_size;
+    uint64_t readings;
+    uint64_t bytes_read;
+    double thread_seconds;
+    int failed;
+} ReportWorker;
+
+/**
+ * @brief Returns options for 14-day reports up to the latest reading, with default thresholds.
+ *
+ * @return FleetReportOptions structure with default values.
+ */
+FleetReportOptions fleet_report_default_options(void) {
+    FleetReportOptions options;
+    options.from = 0;
+    options.to = 0;
+    options.days = FLEET_REPORT_DAYS;
+    options.thresholds = NULL;
+    options.config = initialize_config();
+    options.threads = 0;
+    return options;
+}
+
+/**
+ * @brief Returns the preferred map slot of a patient id.
+ */
+static uint32_t patient_home(uint32_t patient_id, uint32_t capacity) {
+    return (uint32_t)(patient_id * 2654435761u) & (capacity - 1);
+}
+
+/**
+ * @brief Rebuilds the patient map at twice the size.
+ *
+ * @return 0 on success, -1 on error (out of memory).
+ */
+static int grow_map(ReportWorker* worker) {
+    uint32_t capacity = worker->map_capacity > 0 ? worker->map_capacity * 2 : PATIENT_MAP_MIN_CAPACITY;
+    uint32_t* map = calloc(capacity, sizeof(uint32_t));
+    if (map == NULL) return -1;
+
+    for (uint32_t p = 0; p < worker->patient_count; p++) {
+        uint32_t i = patient_home(worker->patients[p].patient_id, capacity);
+        while (map[i] != 0) i = (i + 1) & (capacity - 1);
+        map[i] = p + 1;
+    }
+    free(worker->map);
+    worker->map = map;
+    worker->map_capacity = capacity;
+    return 0;
+}
+
+/**
+ * @brief Returns a patient's accumulator, starting one on the patient's first reading.
+ *
+ * @return Accumulator, or NULL on error (out of memory).
+ */
+static PatientAccumulator* find_patient(ReportWorker* worker, uint32_t patient_id) {
+    if ((worker->patient_count + 1) * 2 > worker->map_capacity && grow_map(worker) != 0) return NULL;
+
+    uint32_t mask = worker->map_capacity - 1;
+    uint32_t i = patient_home(patient_id, worker->map_capacity);
+    for (; worker->map[i] != 0; i = (i + 1) & mask) {
+        PatientAccumulator* patient = &worker->patients[worker->map[i] - 1];
+        if (patient->patient_id == patient_id) return patient;
+    }
+
+    if (worker->patient_count == worker->patient_capacity) {
+        uint32_t capacity = worker->patient_capacity > 0 ? worker->patient_capacity * 2 : 256;
+        PatientAccumulator* patients = realloc(worker->patients, capacity * sizeof(PatientAccumulator));
+        if (patients == NULL) return NULL;
+        worker->patients = patients;
+        worker->patient_capacity = capacity;
+    }
+
+    PatientAccumulator* patient = &worker->patients[worker->patient_count];
+    memset(patient, 0, sizeof(*patient));
+    Config config = worker->options->config;
+    if (worker->options->thresholds != NULL) config_table_get(worker->options->thresholds, patient_id, &config);
+    patient->patient_id = patient_id;
+    patient->low = glucose_to_fixed(config.hypoglycemia_threshold);
+    patient->high = glucose_to_fixed(config.hyperglycemia_threshold);
+    patient->min_value = GLUCOSE_FIXED_MAX;
+    worker->map[i] = ++worker->patient_count;
+    return patient;
+}
+
+/**
+ * @brief Ends a run, counting it as an episode if it lasted long enough.
+ */
+static void close_run(EpisodeRun* run, uint32_t* episodes) {
+    if (run->readings > 0 && run->last - run->start >= ARCHIVE_EPISODE_MIN_DURATION_S) (*episodes)++;
+    run->readings = 0;
+}
+
+/**
+ * @brief Follows one reading through a run, as archive_scan() follows episodes.
+ */
+static void track_run(EpisodeRun* run, int beyond, int64_t t, uint32_t* episodes) {
+    if (beyond && run->readings > 0 && t - run->last <= ARCHIVE_EPISODE_MAX_GAP_S) {
+        run->readings++;
+        if (t > run->last) run->last = t;
+        return;
+    }
+    close_run(run, episodes);
+    if (beyond) *run = (EpisodeRun){t, t, 1};
+}
+
+/**
+ * @brief Adds the in-window readings of one block to their patients.
+ *
+ * @return 0 on success, -1 on error (out of memory).
+ */
+static int report_block(ReportWorker* worker, const ArchiveBlockIndex* entry, const uint8_t* payload) {
+    const uint32_t* ids = (const uint32_t*)(payload + reading_archive_column_offset(entry->count, 0));
+    const uint32_t* offsets = (const uint32_t*)(payload + reading_archive_column_offset(entry->count, 1));
+    const GlucoseFixed* values = (const GlucoseFixed*)(payload + reading_archive_column_offset(entry->count, 2));
+
+    for (uint32_t i = 0; i < entry->count; i++) {
+        int64_t t = entry->min_time + offsets[i];
+        if (t < worker->from || t >= worker->to) continue;
+
+        PatientAccumulator* patient = find_patient(worker, ids[i]);
+        if (patient == NULL) return -1;
+
+        GlucoseFixed value = values[i];
+        int below = value < patient->low;
+        int above = value > patient->high;
+        patient->count++;
+        patient->below += below;
+        patient->above += above;
+        patient->sum += value;
+        patient->sum_squares += (uint64_t)value * value;
+        if (value < patient->min_value) patient->min_value = value;
+        if (value > patient->max_value) patient->max_value = value;
+        uint32_t bin = value / GLUCOSE_FIXED_SCALE;
+        patient->histogram[bin < FLEET_REPORT_BINS ? bin : FLEET_REPORT_BINS - 1]++;
+        track_run(&patient->low_run, below, t, &patient->low_episodes);
+        track_run(&patient->high_run, above, t, &patient->high_episodes);
+        worker->readings++;
+    }
+    return 0;
+}
+
+/**
+ * @brief Turns an accumulator into a report row.
+ */
+static void finish_patient(PatientAccumulator* patient, FleetReportRow* row) {
+    static const double percentiles[5] = {5.0, 25.0, 50.0, 75.0, 95.0};
+
+    close_run(&patient->low_run, &patient->low_episodes);
+    close_run(&patient->high_run, &patient->high_episodes);
+
+    double count = (double)patient->count;
+    double m2 = (double)patient->sum_squares - (double)patient->sum * (double)patient->sum / count;
+    memset(row, 0, sizeof(*row));
+    row->patient_id = patient->patient_id;
+    row->readings = patient->count;
+    row->avg_glucose = (float)((double)patient->sum / count / GLUCOSE_FIXED_SCALE);
+    row->sd_glucose = (float)(sqrt(m2 > 0.0 ? m2 / count : 0.0) / GLUCOSE_FIXED_SCALE);
+    row->time_below_range = (float)(patient->below * 100.0 / count);
+    row->time_above_range = (float)(patient->above * 100.0 / count);
+    row->time_in_range = (float)((patient->count - patient->below - patient->above) * 100.0 / count);
+    row->min_value = patient->min_value;
+    row->max_value = patient->max_value;
+    row->low_episodes = (uint16_t)(patient->low_episodes < UINT16_MAX ? patient->low_episodes : UINT16_MAX);
+    row->high_episodes = (uint16_t)(patient->high_episodes < UINT16_MAX ? patient->high_episodes : UINT16_MAX);
+
+    // Nearest rank, walking the histogram once for all five
+    uint32_t seen = 0;
+    uint32_t bin = 0;
+    for (int p = 0; p < 5; p++) {
+        uint32_t rank = (uint32_t)ceil(percentiles[p] / 100.0 * count);
+        if (rank == 0) rank = 1;
+        while (seen + patient->histogram[bin] < rank) seen += patient->histogram[bin++];
+        row->percentiles[p] = (GlucoseFixed)(bin * GLUCOSE_FIXED_SCALE);
+    }
+}
+
+/**
+ * @brief Appends the reports of the shard just read and forgets its patients.
+ *
+ * @return 0 on success, -1 on error (out of memory).
+ */
+static int finish_shard(ReportWorker* worker) {
+    if (worker->row_count + worker->patient_count > worker->row_capacity) {
+        uint32_t capacity = worker->row_capacity > 0 ? worker->row_capacity : 1024;
+        while (capacity < worker->row_count + worker->patient_count) capacity *= 2;
+        FleetReportRow* rows = realloc(worker->rows, capacity * sizeof(FleetReportRow));
+        if (rows == NULL) return -1;
+        worker->rows = rows;
+        worker->row_capacity = capacity;
+    }
+
+    for (uint32_t p = 0; p < worker->patient_count; p++) {
+        finish_patient(&worker->patients[p], &worker->rows[worker->row_count++]);
+    }
+    worker->patient_count = 0;
+    if (worker->map != NULL) memset(worker->map, 0, worker->map_capacity * sizeof(uint32_t));
+    return 0;
+}
+
+/**
+ * @brief Reads a byte range of a shard's data file in full.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int read_range(int fd, uint8_t* buffer, size_t length, uint64_t offset) {
+    size_t done = 0;
+    while (done < length) {
+        ssize_t got = pread(fd, buffer + done, length - done, (off_t)(offset + done));
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return -1;
+        done += (size_t)got;
+    }
+    return 0;
+}
+
+/**
+ * @brief Reads the blocks of one shard that overlap the window and reports its patients.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int report_shard(ReportWorker* worker, uint32_t shard) {
+    const ArchiveBlockIndex* entries = worker->entries[shard];
+    uint32_t count = worker->entry_counts[shard];
+    if (count == 0) return 0;
+
+    char path[ARCHIVE_PATH_MAX];
+    int fd = reading_archive_path(worker->directory, shard, 0, path) == 0 ? open(path, O_RDONLY | O_CLOEXEC) : -1;
+    if (fd < 0) return -1;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    int result = 0;
+    for (uint32_t i = 0; i < count && result == 0;) {
+        if (entries[i].max_time < worker->from || entries[i].min_time >= worker->to) {
+            i++;
+            continue;
+        }
+
+        // Read the run of consecutive blocks in the window with one call
+        uint32_t last = i;
+        size_t length = reading_archive_payload_bytes(entries[i].count);
+        while (last + 1 < count && entries[last + 1].max_time >= worker->from &&
+               entries[last + 1].min_time < worker->to &&
+               length + reading_archive_payload_bytes(entries[last + 1].count) <= worker->buffer_size) {
+            last++;
+            length += reading_archive_payload_bytes(entries[last].count);
+        }
+        result = read_range(fd, worker->buffer, length, entries[i].offset);
+        worker->bytes_read += length;
+        for (uint32_t b = i; b <= last && result == 0; b++) {
+            result = report_block(worker, &entries[b], worker->buffer + (entries[b].offset - entries[i].offset));
+        }
+        i = last + 1;
+    }
+
+    close(fd);
+    if (result == 0) result = finish_shard(worker);
+    return result;
+}
+
+/**
+ * @brief Takes shards until none are left.
+ *
+ * @param context Pointer to the ReportWorker.
+ * @return NULL.
+ */
+static void* report_worker(void* context) {
+    ReportWorker* worker = context;
+    struct timespec start, end;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+
+    for (;;) {
+        uint32_t shard = __atomic_fetch_add(worker->next_shard, 1, __ATOMIC_RELAXED);
+        if (shard >= ARCHIVE_SHARDS || worker->failed) break;
+        if (report_shard(worker, shard) != 0) worker->failed = 1;
+    }
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+    worker->thread_seconds = (double)(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    return NULL;
+}
+
+/**
+ * @brief Orders reports by patient id.
+ */
+static int compare_rows(const void* a, const void* b) {
+    const FleetReportRow* x = a;
+    const FleetReportRow* y = b;
+    return (x->patient_id > y->patient_id) - (x->patient_id < y->patient_id);
+}
+
+/**
+ * @brief Computes the report of every patient with readings in the window.
+ *
+ * @param directory Archive directory.
+ * @param options Pointer to the report options.
+ * @param rows Pointer to receive a malloc'ed array of reports in patient id order (NULL if none).
+ * @param count Pointer to receive the number of reports.
+ * @param stats Pointer to the FleetReportStats structure to fill, or NULL.
+ * @return 0 on success, -1 on error (invalid arguments, unreadable archive or out of memory).
+ */
+int fleet_report_build(const char* directory, const FleetReportOptions* options,
+                       FleetReportRow** rows, uint32_t* count, FleetReportStats* stats) {
+    if (directory == NULL || options == NULL || rows == NULL || count == NULL) return -1;
+    if (options->from == options->to && options->days == 0) return -1;
+    *rows = NULL;
+    *count = 0;
+
+    uint64_t start = latency_now_ns();
+    ArchiveBlockIndex* entries[ARCHIVE_SHARDS];
+    uint32_t entry_counts[ARCHIVE_SHARDS];
+    int64_t latest = INT64_MIN;
+    int status = 0;
+    for (uint32_t shard = 0; shard < ARCHIVE_SHARDS; shard++) {
+        entries[shard] = NULL;
+        entry_counts[shard] = 0;
+        if (status != 0) continue;
+        if (reading_archive_load_index(directory, shard, &entries[shard], &entry_counts[shard]) != 0) status = -1;
+        for (uint32_t i = 0; i < entry_counts[shard]; i++) {
+            if (entries[shard][i].max_time > latest) latest = entries[shard][i].max_time;
+        }
+    }
+
+    int64_t from = options->from, to = options->to;
+    if (from == to) {
+        to = latest != INT64_MIN ? latest + 1 : 0;
+        from = to - (int64_t)options->days * 86400;
+    }
+
+    unsigned int threads = options->threads;
+    if (threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? (unsigned int)online : 1;
+    }
+    if (threads > ARCHIVE_SCAN_MAX_THREADS) threads = ARCHIVE_SCAN_MAX_THREADS;
+
+    ReportWorker* workers = calloc(threads, sizeof(ReportWorker));
+    pthread_t* handles = calloc(threads, sizeof(pthread_t));
+    if (workers == NULL || handles == NULL) status = -1;
+
+    uint32_t next_shard = 0;
+    size_t buffer_size = ARCHIVE_SCAN_READ_BYTES;
+    if (buffer_size < reading_archive_payload_bytes(ARCHIVE_BLOCK_READINGS)) {
+        buffer_size = reading_archive_payload_bytes(ARCHIVE_BLOCK_READINGS);
+    }
+    unsigned int started = 0;
+    for (unsigned int t = 0; t < threads && status == 0; t++) {
+        ReportWorker* worker = &workers[t];
+        worker->options = options;
+        worker->directory = directory;
+        worker->entries = entries;
+        worker->entry_counts = entry_counts;
+        worker->from = from;
+        worker->to = to;
+        worker->next_shard = &next_shard;
+        worker->buffer_size = buffer_size;
+        worker->buffer = malloc(buffer_size);
+        if (worker->buffer == NULL) {
+            status = -1;
+            break;
+        }
+        // The calling thread is worker 0
+        if (t > 0 && pthread_create(&handles[t], NULL, report_worker, worker) != 0) {
+            status = -1;
+            break;
+        }
+        started = t + 1;
+    }
+    if (started > 0) report_worker(&workers[0]);
+    for (unsigned int t = 1; t < started; t++) pthread_join(handles[t], NULL);
+
+    uint64_t total_rows = 0;
+    for (unsigned int t = 0; t < started; t++) {
+        if (workers[t].failed) status = -1;
+        total_rows += workers[t].row_count;
+    }
+    if (status == 0 && total_rows > 0) {
+        *rows = malloc(total_rows * sizeof(FleetReportRow));
+        if (*rows == NULL) status = -1;
+    }
+
+    FleetReportStats totals;
+    memset(&totals, 0, sizeof(totals));
+    for (unsigned int t = 0; workers != NULL && t < threads; t++) {
+        if (status == 0 && workers[t].row_count > 0) {
+            memcpy(*rows + *count, workers[t].rows, workers[t].row_count * sizeof(FleetReportRow));
+            *count += workers[t].row_count;
+        }
+        totals.readings += workers[t].readings;
+        totals.bytes_read += workers[t].bytes_read;
+        totals.thread_seconds += workers[t].thread_seconds;
+        free(workers[t].buffer);
+        free(workers[t].rows);
+        free(workers[t].patients);
+        free(workers[t].map);
+    }
+    free(workers);
+    free(handles);
+    for (uint32_t shard = 0; shard < ARCHIVE_SHARDS; shard++) free(entries[shard]);
+
+    if (status != 0) {
+        free(*rows);
+        *rows = NULL;
+        *count = 0;
+        return -1;
+    }
+    if (*count > 1) qsort(*rows, *count, sizeof(FleetReportRow), compare_rows);
+
+    if (stats != NULL) {
+        totals.patients = *count;
+        totals.from = from;
+        totals.to = to;
+        totals.threads = threads;
+        totals.seconds = (latency_now_ns() - start) / 1e9;
+        *stats = totals;
+    }
+    return 0;
+}
+
+/**
+ * @brief Writes reports to a file.
+ *
+ * @param path File to create or replace.
+ * @param format Output format.
+ * @param rows Pointer to the reports.
+ * @param count Number of reports.
+ * @param from Window start, recorded in binary files.
+ * @param to Window end, recorded in binary files.
+ * @return 0 on success, -1 on error.
+ */
+int fleet_report_save(const char* path, FleetReportFormat format, const FleetReportRow* rows, uint32_t count,
+                      int64_t from, int64_t to) {
+    if (path == NULL || (rows == NULL && count > 0)) return -1;
+
+    FILE* file = fopen(path, format == FLEET_REPORT_CSV ? "w" : "wb");
+    if (file == NULL) return -1;
+
+    int status = 0;
+    if (format == FLEET_REPORT_CSV) {
+        if (fprintf(file, "patient_id,readings,avg_glucose,sd_glucose,time_below_range,time_in_range,"
+                          "time_above_range,min,p5,p25,p50,p75,p95,max,low_episodes,high_episodes\n") < 0) {
+            status = -1;
+        }
+        for (uint32_t i = 0; i < count && status == 0; i++) {
+            const FleetReportRow* row = &rows[i];
+            if (fprintf(file, "%u,%u,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.0f,%.0f,%.0f,%.0f,%.0f,%.1f,%u,%u\n",
+                        row->patient_id, row->readings, row->avg_glucose, row->sd_glucose,
+                        row->time_below_range, row->time_in_range, row->time_above_range,
+                        glucose_from_fixed(row->min_value), glucose_from_fixed(row->percentiles[0]),
+                        glucose_from_fixed(row->percentiles[1]), glucose_from_fixed(row->percentiles[2]),
+                        glucose_from_fixed(row->percentiles[3]), glucose_from_fixed(row->percentiles[4]),
+                        glucose_from_fixed(row->max_value), row->low_episodes, row->high_episodes) < 0) {
+                status = -1;
+            }
+        }
+    } else {
+        FleetReportHeader header = {FLEET_REPORT_MAGIC, FLEET_REPORT_VERSION, sizeof(FleetReportRow), count, from, to};
+        if (fwrite(&header, sizeof(header), 1, file) != 1 ||
+            (count > 0 && fwrite(rows, sizeof(FleetReportRow), count, file) != count)) {
+            status = -1;
+        }
+    }
+
+    if (fclose(file) != 0) status = -1;
+    return status;
+}
@@ -0,0 +1,378 @@
+/**
+ * @file glucose_filter.c
+ * @brief Contains the streaming Kalman smoother and the series-selecting trend and alarm rules.
+ */
+
+#include "../include/glucose_filter.h"
+#include "../include/alarm.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Branch-free kernels get an AVX2 clone, as in glucose_kernels.c. Without
+// trapping math, which nothing here relies on, GCC keeps the per-patient
+// selects of the bank as selects instead of branches.
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__)
+#define KERNEL_VECTORIZE __attribute__((target_clones("avx2", "default"), \
+                                        optimize("tree-vectorize", "vect-cost-model=dynamic", "no-trapping-math")))
+#define ALWAYS_INLINE __attribute__((always_inline))
+#else
+#define KERNEL_VECTORIZE
+#define ALWAYS_INLINE
+#endif
+
+// Level variance of a filter waiting for its first reading: that reading is taken as is
+#define UNKNOWN_LEVEL_VARIANCE 1e12
+
+// Estimate and covariance, passed by value so the column loop keeps everything in registers
+typedef struct {
+    double level;
+    double rate;
+    double p00;
+    double p01;
+    double p11;
+} FilterState;
+
+/**
+ * @brief Predicts a filter state forward in time, then corrects it with a reading.
+ *
+ * known is 1.0 for a reading and 0.0 for a missing one, which skips the
+ * correction without a branch. Always inlined, as the bank kernel is
+ * compiled with other math options than its callers.
+ */
+static inline ALWAYS_INLINE FilterState filter_step(FilterState s, double value, double known, double interval,
+                                                    double r, double q) {
+    // Predict: the level moves at the current rate, and the rate may have drifted
+    double level = s.level + s.rate * interval;
+    double a = s.p00 + interval * (2.0 * s.p01 + interval * s.p11) + q * interval * interval * interval / 3.0;
+    double b = s.p01 + interval * s.p11 + q * interval * interval / 2.0;
+    double c = s.p11 + q * interval;
+
+    // Correct with the reading
+    double k0 = known * a / (a + r);
+    double k1 = known * b / (a + r);
+    double innovation = value - level;
+    FilterState next = {level + k0 * innovation, s.rate + k1 * innovation, (1.0 - k0) * a, (1.0 - k0) * b, c - k1 * b};
+    return next;
+}
+
+/**
+ * @brief Runs glucose_filter_update() over columns, with restrict pointers so the loop can be vectorized.
+ *
+ * @return Number of readings taken.
+ */
+KERNEL_VECTORIZE
+static double bank_step(size_t count, double* restrict level, double* restrict rate, double* restrict p00,
+                        double* restrict p01, double* restrict p11, double* restrict interval,
+                        double* restrict last_time, double* restrict readings, const double* restrict values,
+                        const uint64_t* restrict valid, const double* restrict times, double r, double q) {
+    const double initial_rate_variance = GLUCOSE_FILTER_INITIAL_RATE_SD * GLUCOSE_FILTER_INITIAL_RATE_SD;
+
+    // Every patient is stepped without a branch: a patient without a reading
+    // to take steps by 0 minutes with a correction of weight 0, which leaves
+    // the state as it is, and a patient to restart steps from the initial
+    // state. The inner loop covers one validity word, as in glucose_kernels.c.
+    double added = 0.0;
+    for (size_t start = 0; start < count; start += 64) {
+        uint64_t word = valid[start / 64];
+        size_t n = count - start < 64 ? count - start : 64;
+        for (size_t j = 0; j < n; j++) {
+            size_t i = start + j;
+            double reading = values[i];
+            double present = (word >> j) & 1 ? 1.0 : 0.0;
+            double now = times[i];
+            double started = readings[i];
+            double gap = (now - last_time[i]) / 60.0;
+            // The reading, or 0.0 if it is missing, not positive or not newer than the previous one
+            double value = present > 0.0 ? reading : 0.0;
+            value = (started > 0.0 ? gap : 1.0) > 0.0 ? value : 0.0;
+            double known = value > 0.0 ? 1.0 : 0.0;
+            // Minutes since the previous reading; an unstarted filter counts as a gap
+            double elapsed = known > 0.0 ? (started > 0.0 ? gap : 2.0 * GLUCOSE_FILTER_MAX_GAP_MIN) : 0.0;
+            double restart = elapsed > GLUCOSE_FILTER_MAX_GAP_MIN ? 1.0 : 0.0;
+            double step = restart > 0.0 ? 0.0 : elapsed;
+
+            FilterState s = {restart > 0.0 ? 0.0 : level[i], restart > 0.0 ? 0.0 : rate[i],
+                             restart > 0.0 ? UNKNOWN_LEVEL_VARIANCE : p00[i], restart > 0.0 ? 0.0 : p01[i],
+                             restart > 0.0 ? initial_rate_variance : p11[i]};
+            s = filter_step(s, value, known, step, r, q);
+            level[i] = s.level;
+            rate[i] = s.rate;
+            p00[i] = s.p00;
+            p01[i] = s.p01;
+            p11[i] = s.p11;
+            interval[i] = known * step + (1.0 - known) * interval[i];
+            last_time[i] = known * now + (1.0 - known) * last_time[i];
+            readings[i] = known * (restart > 0.0 ? 1.0 : started + 1.0) + (1.0 - known) * started;
+            added += known;
+        }
+    }
+    return added;
+}
+
+/**
+ * @brief Returns the default noise model for CGM readings.
+ *
+ * @return GlucoseFilterParams structure with default values.
+ */
+GlucoseFilterParams glucose_filter_default_params(void) {
+    GlucoseFilterParams params;
+    params.measurement_variance = GLUCOSE_FILTER_MEASUREMENT_SD * GLUCOSE_FILTER_MEASUREMENT_SD;
+    params.process_noise = GLUCOSE_FILTER_ACCELERATION_SD * GLUCOSE_FILTER_ACCELERATION_SD;
+    return params;
+}
+
+/**
+ * @brief Resets a patient's filter; the next reading starts it.
+ *
+ * @param filter Pointer to the GlucoseFilter structure to initialize.
+ * @return 0 on success, -1 on error.
+ */
+int glucose_filter_init(GlucoseFilter* filter) {
+    if (filter == NULL) return -1;
+
+    memset(filter, 0, sizeof(*filter));
+    filter->p00 = UNKNOWN_LEVEL_VARIANCE;
+    filter->p11 = GLUCOSE_FILTER_INITIAL_RATE_SD * GLUCOSE_FILTER_INITIAL_RATE_SD;
+    return 0;
+}
+
+/**
+ * @brief Adds a reading to a patient's filter.
+ *
+ * Readings that are not positive, or not newer than the previous one,
+ * are ignored. After a gap longer than GLUCOSE_FILTER_MAX_GAP_MIN the
+ * filter restarts from the reading.
+ *
+ * @param filter Pointer to the patient's GlucoseFilter.
+ * @param params Pointer to the noise model.
+ * @param value Reading in mg/dL.
+ * @param timestamp Time of the reading.
+ * @return 0 on success, -1 on error or if the reading was ignored.
+ */
+int glucose_filter_update(GlucoseFilter* filter, const GlucoseFilterParams* params, double value, time_t timestamp) {
+    if (filter == NULL || params == NULL || !(value > 0.0)) return -1;
+    if (filter->readings > 0 && (int64_t)timestamp <= filter->last_time) return -1;
+
+    double interval = filter->readings > 0 ? ((int64_t)timestamp - filter->last_time) / 60.0 : 0.0;
+    if (interval > GLUCOSE_FILTER_MAX_GAP_MIN) {
+        glucose_filter_init(filter);
+        interval = 0.0;
+    }
+
+    FilterState state = {filter->level, filter->rate, filter->p00, filter->p01, filter->p11};
+    state = filter_step(state, value, 1.0, interval, params->measurement_variance, params->process_noise);
+    filter->level = state.level;
+    filter->rate = state.rate;
+    filter->p00 = state.p00;
+    filter->p01 = state.p01;
+    filter->p11 = state.p11;
+    filter->interval = interval;
+    filter->last_time = (int64_t)timestamp;
+    filter->readings++;
+    return 0;
+}
+
+/**
+ * @brief Allocates a bank of filters, all waiting for their first reading.
+ *
+ * @param bank Pointer to the GlucoseFilterBank structure to initialize.
+ * @param count Number of patients.
+ * @return 0 on success, -1 on error.
+ */
+int glucose_filter_bank_init(GlucoseFilterBank* bank, size_t count) {
+    if (bank == NULL || count == 0) return -1;
+
+    memset(bank, 0, sizeof(*bank));
+    if (glucose_filter_bank_grow(bank, count) != 0) {
+        glucose_filter_bank_destroy(bank);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Grows a bank; the added filters wait for their first reading.
+ *
+ * @param bank Pointer to the GlucoseFilterBank structure.
+ * @param count Number of patients wanted; a smaller count leaves the bank as is.
+ * @return 0 on success, -1 on error (the bank is unchanged).
+ */
+int glucose_filter_bank_grow(GlucoseFilterBank* bank, size_t count) {
+    if (bank == NULL) return -1;
+    if (count <= bank->count) return 0;
+
+    // Columns that were moved are kept even if a later one fails; count only grows at the end
+    double** columns[8] = {&bank->level, &bank->rate, &bank->p00, &bank->p01, &bank->p11,
+                           &bank->interval, &bank->last_time, &bank->readings};
+    for (int i = 0; i < 8; i++) {
+        double* column = realloc(*columns[i], count * sizeof(double));
+        if (column == NULL) return -1;
+        memset(column + bank->count, 0, (count - bank->count) * sizeof(double));
+        *columns[i] = column;
+    }
+    for (size_t i = bank->count; i < count; i++) {
+        bank->p00[i] = UNKNOWN_LEVEL_VARIANCE;
+        bank->p11[i] = GLUCOSE_FILTER_INITIAL_RATE_SD * GLUCOSE_FILTER_INITIAL_RATE_SD;
+    }
+    bank->count = count;
+    return 0;
+}
+
+/**
+ * @brief Frees the columns of a bank.
+ *
+ * @param bank Pointer to the GlucoseFilterBank structure to destroy.
+ * @return 0 on success, -1 on error.
+ */
+int glucose_filter_bank_destroy(GlucoseFilterBank* bank) {
+    if (bank == NULL) return -1;
+
+    free(bank->level);
+    free(bank->rate);
+    free(bank->p00);
+    free(bank->p01);
+    free(bank->p11);
+    free(bank->interval);
+    free(bank->last_time);
+    free(bank->readings);
+    memset(bank, 0, sizeof(*bank));
+    return 0;
+}
+
+/**
+ * @brief Adds one tick of readings to every filter of a bank.
+ *
+ * Entry i of values and times belongs to patient i, and bit i of the
+ * validity bitmap (layout of glucose_kernels.h) tells whether patient i
+ * has a reading this tick; other entries of values may hold anything.
+ * Each reading is handled as glucose_filter_update() would: a value that
+ * is not positive or not newer than the patient's previous reading is
+ * ignored, the prediction spans the time since that reading, and a gap
+ * longer than GLUCOSE_FILTER_MAX_GAP_MIN restarts the patient's filter.
+ * The loop has no branches, so the compiler updates several patients per
+ * vector instruction.
+ *
+ * @param bank Pointer to the GlucoseFilterBank structure.
+ * @param params Pointer to the noise model.
+ * @param values Reading of each patient for this tick, bank->count entries.
+ * @param valid Validity bitmap of values, GLUCOSE_VALIDITY_WORDS(bank->count) words.
+ * @param times Time of each reading in seconds, bank->count entries.
+ * @return Number of readings added, or -1 on error.
+ */
+long glucose_filter_bank_update(GlucoseFilterBank* bank, const GlucoseFilterParams* params,
+                                const double* values, const uint64_t* valid, const double* times) {
+    if (bank == NULL || params == NULL || values == NULL || valid == NULL || times == NULL) return -1;
+
+    return (long)bank_step(bank->count, bank->level, bank->rate, bank->p00, bank->p01, bank->p11, bank->interval,
+                           bank->last_time, bank->readings, values, valid, times, params->measurement_variance,
+                           params->process_noise);
+}
+
+/**
+ * @brief Copies one patient's filter out of a bank.
+ *
+ * @param bank Pointer to the GlucoseFilterBank structure.
+ * @param index Patient in the bank.
+ * @param filter Pointer to the GlucoseFilter structure to fill.
+ * @return 0 on success, -1 on error.
+ */
+int glucose_filter_bank_get(const GlucoseFilterBank* bank, size_t index, GlucoseFilter* filter) {
+    if (bank == NULL || filter == NULL || index >= bank->count) return -1;
+
+    filter->level = bank->level[index];
+    filter->rate = bank->rate[index];
+    filter->p00 = bank->p00[index];
+    filter->p01 = bank->p01[index];
+    filter->p11 = bank->p11[index];
+    filter->interval = bank->interval[index];
+    filter->last_time = (int64_t)bank->last_time[index];
+    filter->readings = (uint32_t)bank->readings[index];
+    return 0;
+}
+
+/**
+ * @brief Stores one patient's filter into a bank, e.g. after glucose_filter_update().
+ *
+ * @param bank Pointer to the GlucoseFilterBank structure.
+ * @param index Patient in the bank.
+ * @param filter Pointer to the patient's GlucoseFilter.
+ * @return 0 on success, -1 on error.
+ */
+int glucose_filter_bank_set(GlucoseFilterBank* bank, size_t index, const GlucoseFilter* filter) {
+    if (bank == NULL || filter == NULL || index >= bank->count) return -1;
+
+    bank->level[index] = filter->level;
+    bank->rate[index] = filter->rate;
+    bank->p00[index] = filter->p00;
+    bank->p01[index] = filter->p01;
+    bank->p11[index] = filter->p11;
+    bank->interval[index] = filter->interval;
+    bank->last_time[index] = (double)filter->last_time;
+    bank->readings[index] = (double)filter->readings;
+    return 0;
+}
+
+/**
+ * @brief Returns the change since the previous reading according to a series.
+ *
+ * @param data Pointer to the patient's GeneratedData.
+ * @param filter Pointer to the patient's GlucoseFilter (used for GLUCOSE_SERIES_FILTERED).
+ * @param series Series to look at.
+ * @param change Pointer to receive the change in mg/dL.
+ * @return 0 on success, -1 on error or if the series has no previous reading yet.
+ */
+int glucose_series_change(const GeneratedData* data, const GlucoseFilter* filter, GlucoseSeries series,
+                          double* change) {
+    if (data == NULL || change == NULL) return -1;
+
+    if (series == GLUCOSE_SERIES_FILTERED) {
+        if (filter == NULL || filter->readings < 2) return -1;
+        *change = filter->rate * filter->interval;
+        return 0;
+    }
+
+    if (!glucose_history_valid(data, 0) || !glucose_history_valid(data, 1)) return -1;
+    *change = data->glucose_value - glucose_from_fixed(data->glucose_history[1]);
+    return 0;
+}
+
+/**
+ * @brief Returns the glucose trend according to a series.
+ *
+ * @param data Pointer to the patient's GeneratedData.
+ * @param filter Pointer to the patient's GlucoseFilter (used for GLUCOSE_SERIES_FILTERED).
+ * @param series Series to look at.
+ * @return GlucoseTrend value; TREND_STABLE without a previous reading.
+ */
+GlucoseTrend glucose_series_trend(const GeneratedData* data, const GlucoseFilter* filter, GlucoseSeries series) {
+    if (series == GLUCOSE_SERIES_RAW) return calculate_glucose_trend(data);
+
+    double change;
+    if (glucose_series_change(data, filter, series, &change) != 0) return TREND_STABLE;
+    return classify_glucose_change(change);
+}
+
+/**
+ * @brief Evaluates alarms with rapid changes taken from a series.
+ *
+ * Level alarms use the raw reading in both cases. With
+ * GLUCOSE_SERIES_RAW this is exactly evaluate_glucose_alarms().
+ *
+ * @param data Pointer to the patient's GeneratedData.
+ * @param filter Pointer to the patient's GlucoseFilter (used for GLUCOSE_SERIES_FILTERED).
+ * @param series Series to take rapid changes from.
+ * @param config Pointer to the Config structure containing thresholds.
+ * @param flags Pointer to receive the active AlarmFlag bits.
+ * @return 0 on success, -1 on error.
+ */
+int glucose_series_alarms(const GeneratedData* data, const GlucoseFilter* filter, GlucoseSeries series,
+                          const Config* config, unsigned int* flags) {
+    if (data == NULL || config == NULL || flags == NULL) return -1;
+    if (series == GLUCOSE_SERIES_RAW) return evaluate_glucose_alarms(data, config, flags);
+
+    // Level rules on the raw reading, then the rapid-change rule on the filtered change
+    *flags = glucose_level_alarms(data->glucose_value, config);
+    double change;
+    if (glucose_series_change(data, filter, series, &change) == 0) *flags |= glucose_change_alarms(change, config);
+    return 0;
+}
@@ -0,0 +1,693 @@
+/**
+ * @file glucose_kernels.c
+ * @brief Contains array kernels over contiguous buffers of glucose readings.
+ */
+
+#include "../include/glucose_kernels.h"
+#include "../include/alarm.h"
+#include <math.h>
+#include <string.h>
+
+// Kernels with a branch-free loop get an AVX2 clone, picked at load time on
+// CPUs that have it; baseline x86-64 lacks the blends GCC needs to vectorize them
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__)
+#define KERNEL_VECTORIZE __attribute__((target_clones("avx2", "default"), \
+                                        optimize("tree-vectorize", "vect-cost-model=dynamic")))
+#else
+#define KERNEL_VECTORIZE
+#endif
+
+// Fixed-point readings summed per block; the block's sum still fits in 32 bits
+#define FIXED_BLOCK_SIZE 256
+
+// Lanes of the masked block sums: each lane sums its own readings, so the
+// floating-point sums are not reordered and the lanes map onto one vector
+#define MASKED_LANES 4
+
+// Integer sums of one block of fixed-point readings
+typedef struct {
+    uint32_t sum;
+    uint32_t below_range;
+    uint32_t above_range;
+    uint64_t sum_squares;
+} FixedBlockSums;
+
+/**
+ * @brief Initializes an empty accumulator.
+ *
+ * @param acc Pointer to the GlucoseAccumulator structure to initialize.
+ * @return 0 on success, -1 on error.
+ */
+int glucose_accumulator_init(GlucoseAccumulator* acc) {
+    if (acc == NULL) return -1;
+
+    memset(acc, 0, sizeof(*acc));
+    return 0;
+}
+
+/**
+ * @brief Adds readings to the accumulator.
+ *
+ * Uses Welford's update so the mean and variance stay accurate over
+ * millions of readings without keeping the readings themselves.
+ *
+ * @param acc Pointer to the GlucoseAccumulator structure to update.
+ * @param values Readings to add.
+ * @param count Number of readings.
+ * @param config Pointer to the Config structure containing threshold values.
+ * @return 0 on success, -1 on error.
+ */
+int glucose_accumulator_add(GlucoseAccumulator* acc, const double* values, size_t count, const Config* config) {
+    if (acc == NULL || config == NULL || (values == NULL && count > 0)) return -1;
+
+    double low = config->hypoglycemia_threshold;
+    double high = config->hyperglycemia_threshold;
+
+    for (size_t i = 0; i < count; i++) {
+        double value = values[i];
+
+        acc->below_range += value < low;
+        acc->above_range += value > high;
+
+        acc->count++;
+        double delta = value - acc->mean;
+        acc->mean += delta / (double)acc->count;
+        acc->m2 += delta * (value - acc->mean);
+    }
+    acc->in_range = acc->count - acc->below_range - acc->above_range;
+
+    return 0;
+}
+
+/**
+ * @brief Sums one block of at most FIXED_BLOCK_SIZE fixed-point readings.
+ */
+KERNEL_VECTORIZE
+static void sum_fixed_block(const GlucoseFixed* restrict values, size_t count, uint32_t low, uint32_t high,
+                            FixedBlockSums* restrict sums) {
+    uint32_t sum = 0;
+    uint32_t below = 0;
+    uint32_t above = 0;
+    uint64_t sum_squares = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        uint32_t value = values[i];
+        sum += value;
+        sum_squares += value * value; // At most 65535^2, which still fits in 32 bits
+        below += value < low;
+        above += value > high;
+    }
+
+    sums->sum = sum;
+    sums->below_range = below;
+    sums->above_range = above;
+    sums->sum_squares = sum_squares;
+}
+
+/**
+ * @brief Adds fixed-point readings to the accumulator.
+ *
+ * Each block's mean and sum of squared deviations are derived exactly from
+ * its integer sums and merged in with Chan's combination, as in
+ * glucose_accumulator_merge().
+ *
+ * @param acc Pointer to the GlucoseAccumulator structure to update.
+ * @param values Fixed-point readings to add.
+ * @param count Number of readings.
+ * @param config Pointer to the Config structure containing threshold values.
+ * @return 0 on success, -1 on error.
+ */
+int glucose_accumulator_add_fixed(GlucoseAccumulator* acc, const GlucoseFixed* values, size_t count,
+                                  const Config* config) {
+    if (acc == NULL || config == NULL || (values == NULL && count > 0)) return -1;
+
+    // Readings are whole tenths, so comparing with ten times the threshold is exact
+    uint32_t low = config->hypoglycemia_threshold > 0 ? (uint32_t)config->hypoglycemia_threshold * GLUCOSE_FIXED_SCALE : 0;
+    uint32_t high = config->hyperglycemia_threshold > 0 ? (uint32_t)config->hyperglycemia_threshold * GLUCOSE_FIXED_SCALE : 0;
+    const double scale = GLUCOSE_FIXED_SCALE;
+
+    for (size_t start = 0; start < count; start += FIXED_BLOCK_SIZE) {
+        size_t n = count - start < FIXED_BLOCK_SIZE ? count - start : FIXED_BLOCK_SIZE;
+        FixedBlockSums sums;
+        sum_fixed_block(values + start, n, low, high, &sums);
+
+        // n * sum_squares - sum^2 is at most 2^48, so it is exact in 64 bits
+        uint64_t spread = (uint64_t)n * sums.sum_squares - (uint64_t)sums.sum * sums.sum;
+        GlucoseAccumulator block;
+        block.count = n;
+        block.below_range = sums.below_range;
+        block.above_range = sums.above_range;
+        block.in_range = n - sums.below_range - sums.above_range;
+        block.mean = (double)sums.sum / (double)n / scale;
+        block.m2 = (double)spread / (double)n / (scale * scale);
+        glucose_accumulator_merge(acc, &block);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Returns the validity word of entries [start, start + 64) with bits past count cleared.
+ */
+static uint64_t validity_word(const uint64_t* valid, size_t start, size_t count) {
+    uint64_t word = valid[start / 64];
+    return count - start >= 64 ? word : word & ((UINT64_C(1) << (count - start)) - 1);
+}
+
+/**
+ * @brief Returns a reading, or +0.0 if its validity bit is clear.
+ *
+ * Masks the bits instead of selecting, so the compiler emits a vector AND
+ * rather than a branch, and a NaN or infinity in a gap cannot leak in.
+ */
+static inline double mask_reading(double value, uint64_t bit) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    bits &= (uint64_t)0 - bit;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/**
+ * @brief Computes the statistics of the valid readings of one block of at most 64.
+ *
+ * Two passes over the block, which is in L1 by then: the mean, then the
+ * squared deviations from it. Each of MASKED_LANES lanes sums its own
+ * readings; the unrolled lanes become one vector.
+ */
+KERNEL_VECTORIZE
+static void sum_masked_block(const double* restrict values, uint64_t word, size_t n, double low, double high,
+                             GlucoseAccumulator* restrict block) {
+    double sum[MASKED_LANES] = {0.0};
+    uint64_t below[MASKED_LANES] = {0};
+    uint64_t above[MASKED_LANES] = {0};
+    uint64_t lane_bits[MASKED_LANES]; // Validity of each lane's next reading in bit 0
+    size_t whole = n - n % MASKED_LANES;
+
+    for (int k = 0; k < MASKED_LANES; k++) lane_bits[k] = word >> k;
+    for (size_t j = 0; j < whole; j += MASKED_LANES) {
+#pragma GCC unroll 4
+        for (int k = 0; k < MASKED_LANES; k++) {
+            uint64_t bit = lane_bits[k] & 1;
+            lane_bits[k] >>= MASKED_LANES;
+            double value = mask_reading(values[j + k], bit);
+            sum[k] += value;
+            below[k] += bit & (value < low);
+            above[k] += bit & (value > high);
+        }
+    }
+    for (size_t j = whole; j < n; j++) {
+        uint64_t bit = (word >> j) & 1;
+        double value = mask_reading(values[j], bit);
+        sum[0] += value;
+        below[0] += bit & (value < low);
+        above[0] += bit & (value > high);
+    }
+
+    uint64_t count = (uint64_t)__builtin_popcountll(word);
+    double mean = (sum[0] + sum[1] + sum[2] + sum[3]) / (double)count;
+
+    double m2[MASKED_LANES] = {0.0};
+    for (int k = 0; k < MASKED_LANES; k++) lane_bits[k] = word >> k;
+    for (size_t j = 0; j < whole; j += MASKED_LANES) {
+#pragma GCC unroll 4
+        for (int k = 0; k < MASKED_LANES; k++) {
+            double delta = mask_reading(values[j + k] - mean, lane_bits[k] & 1);
+            lane_bits[k] >>= MASKED_LANES;
+            m2[k] += delta * delta;
+        }
+    }
+    for (size_t j = whole; j < n; j++) {
+        double delta = mask_reading(values[j] - mean, (word >> j) & 1);
+        m2[0] += delta * delta;
+    }
+
+    block->count = count;
+    block->below_range = below[0] + below[1] + below[2] + below[3];
+    block->above_range = above[0] + above[1] + above[2] + above[3];
+    block->in_range = count - block->below_range - block->above_range;
+    block->mean = mean;
+    block->m2 = m2[0] + m2[1] + m2[2] + m2[3];
+}
+
+/**
+ * @brief Adds the valid readings of an array with gaps to the accumulator.
+ *
+ * Blocks of 64 readings, one validity word each, are summed separately
+ * and merged in with Chan's combination, as in glucose_accumulator_merge().
+ * Blocks without any reading are skipped.
+ *
+ * @param acc Pointer to the GlucoseAccumulator structure to update.
+ * @param values Readings, valid or not.
+ * @param valid Validity bitmap of values.
+ * @param count Number of entries.
+ * @param config Pointer to the Config structure containing threshold values.
+ * @return 0 on success, -1 on error.
+ */
+int glucose_accumulator_add_masked(GlucoseAccumulator* acc, const double* values, const uint64_t* valid,
+                                   size_t count, const Config* config) {
+    if (acc == NULL || config == NULL || ((values == NULL || valid == NULL) && count > 0)) return -1;
+
+    double low = config->hypoglycemia_threshold;
+    double high = config->hyperglycemia_threshold;
+
+    for (size_t start = 0; start < count; start += 64) {
+        uint64_t word = validity_word(valid, start, count);
+        if (word == 0) continue;
+        GlucoseAccumulator block;
+        sum_masked_block(values + start, word, count - start < 64 ? count - start : 64, low, high, &block);
+        glucose_accumulator_merge(acc, &block);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Removes readings previously added to the accumulator.
+ *
+ * Reverses Welford's update, which lets a sliding window be maintained by
+ * adding the newest reading and removing the oldest one.
+ *
+ * @param acc Pointer to the GlucoseAccumulator structure to update.
+ * @param values Readings to remove.
+ * @param count Number of readings.
+ * @param config Pointer to the Config structure used when they were added.
+ * @return 0 on success, -1 on error (removing more readings than were added).
+ */
+int glucose_accumulator_remove(GlucoseAccumulator* acc, const double* values, size_t count, const Config* config) {
+    if (acc == NULL || config == NULL || (values == NULL && count > 0) || count > acc->count) return -1;
+
+    double low = config->hypoglycemia_threshold;
+    double high = config->hyperglycemia_threshold;
+
+    for (size_t i = 0; i < count; i++) {
+        double value = values[i];
+
+        acc->below_range -= value < low;
+        acc->above_range -= value > high;
+
+        if (--acc->count == 0) {
+            acc->mean = 0.0;
+            acc->m2 = 0.0;
+            continue;
+        }
+        double delta = value - acc->mean;
+        acc->mean -= delta / (double)acc->count;
+        acc->m2 -= delta * (value - acc->mean);
+        if (acc->m2 < 0.0) acc->m2 = 0.0; // Guard against rounding below zero
+    }
+    acc->in_range = acc->count - acc->below_range - acc->above_range;
+
+    return 0;
+}
+
+/**
+ * @brief Merges one accumulator into another.
+ *
+ * Uses Chan's parallel combination, so partial results computed over
+ * separate chunks merge into exactly the statistics of the whole.
+ *
+ * @param acc Pointer to the GlucoseAccumulator structure to update.
+ * @param other Pointer to the GlucoseAccumulator structure to merge in.
+ * @return 0 on success, -1 on error.
+ */
+int glucose_accumulator_merge(GlucoseAccumulator* acc, const GlucoseAccumulator* other) {
+    if (acc == NULL || other == NULL) return -1;
+    if (other->count == 0) return 0;
+
+    uint64_t total = acc->count + other->count;
+    double delta = other->mean - acc->mean;
+
+    acc->m2 += other->m2 + delta * delta * (double)acc->count * (double)other->count / (double)total;
+    acc->mean += delta * (double)other->count / (double)total;
+    acc->count = total;
+    acc->below_range += other->below_range;
+    acc->in_range += other->in_range;
+    acc->above_range += other->above_range;
+
+    return 0;
+}
+
+/**
+ * @brief Converts an accumulator into the engine's GlucoseStats form.
+ *
+ * Range fields hold reading counts and glucose_variability holds the sum
+ * of squared deviations, exactly as update_glucose_statistics() keeps
+ * them, so the result can be passed to print_glucose_statistics().
+ *
+ * @param acc Pointer to the GlucoseAccumulator structure to read.
+ * @param stats Pointer to receive the statistics.
+ * @return 0 on success, -1 on error.
+ */
+int glucose_accumulator_to_stats(const GlucoseAccumulator* acc, GlucoseStats* stats) {
+    if (acc == NULL || stats == NULL) return -1;
+
+    stats->time_in_range = (double)acc->in_range;
+    stats->time_below_range = (double)acc->below_range;
+    stats->time_above_range = (double)acc->above_range;
+    stats->avg_glucose = acc->mean;
+    stats->glucose_variability = acc->m2;
+
+    return 0;
+}
+
+/**
+ * @brief Evaluates the alarm rules for every reading in an array.
+ *
+ * Each reading is compared with the one before it for rapid changes; a
+ * previous value of 0.0 means no data, as in the engine's history.
+ *
+ * @param values Readings, oldest first.
+ * @param count Number of readings.
+ * @param config Pointer to the Config structure containing thresholds.
+ * @param flags Array of count entries to receive the AlarmFlag bits.
+ * @return Number of readings with at least one alarm, or -1 on error.
+ */
+long glucose_scan_alarms(const double* values, size_t count, const Config* config, uint8_t* flags) {
+    if (config == NULL || ((values == NULL || flags == NULL) && count > 0)) return -1;
+
+    long alarmed = 0;
+    double previous = 0.0;
+
+    for (size_t i = 0; i < count; i++) {
+        unsigned int active;
+        evaluate_glucose_alarm_values(values[i], previous, config, &active);
+
+        flags[i] = (uint8_t)active;
+        alarmed += active != ALARM_NONE;
+        previous = values[i];
+    }
+
+    return alarmed;
+}
+
+/**
+ * @brief Evaluates the alarm rules for one block of at most 64 entries with gaps.
+ *
+ * previous_word holds the validity of the entry before each one: bit j
+ * is the validity of entry j - 1. The caller clears bit 0 for the first
+ * entry of the array, so values[-1] is never used.
+ */
+KERNEL_VECTORIZE
+static long scan_masked_block(const double* restrict values, uint64_t word, uint64_t previous_word, size_t first,
+                              size_t n, double low, double high, double rapid, uint8_t* restrict flags) {
+    long alarmed = 0;
+    for (size_t j = first; j < n; j++) {
+        uint64_t bit = (word >> j) & 1;
+        uint64_t known = bit & (previous_word >> j);
+        double value = values[j];
+        double change = value - values[(ptrdiff_t)j - 1]; // Entry -1 of a later block is the last of the one before
+
+        // Same rules as evaluate_glucose_alarm_values(), as masks instead of branches; the
+        // comparisons also run on gaps, whose results the validity bits then clear
+        unsigned int active = (unsigned int)(bit & (value < low)) * ALARM_HYPOGLYCEMIA |
+                              (unsigned int)(bit & (value > high)) * ALARM_HYPERGLYCEMIA |
+                              (unsigned int)(known & (change > rapid)) * ALARM_RAPID_INCREASE |
+                              (unsigned int)(known & (change < -rapid)) * ALARM_RAPID_DECREASE;
+
+        flags[j] = (uint8_t)active;
+        alarmed += active != ALARM_NONE;
+    }
+    return alarmed;
+}
+
+/**
+ * @brief Evaluates the alarm rules for every entry of an array with gaps.
+ *
+ * Works through the array one validity word at a time. The previous
+ * entry's validity is the word shifted by one, carrying the top bit of
+ * the word before, so each block's loop has no branches.
+ *
+ * @param values Readings, oldest first, valid or not.
+ * @param valid Validity bitmap of values.
+ * @param count Number of entries.
+ * @param config Pointer to the Config structure containing thresholds.
+ * @param flags Array of count entries to receive the AlarmFlag bits.
+ * @return Number of readings with at least one alarm, or -1 on error.
+ */
+long glucose_scan_alarms_masked(const double* values, const uint64_t* valid, size_t count, const Config* config,
+                                uint8_t* flags) {
+    if (config == NULL || ((values == NULL || valid == NULL || flags == NULL) && count > 0)) return -1;
+    if (count == 0) return 0;
+
+    double low = config->hypoglycemia_threshold;
+    double high = config->hyperglycemia_threshold;
+    double rapid = config->rapid_change_threshold;
+
+    // The first entry has no predecessor; it is only checked against the level rules
+    uint64_t first_word = validity_word(valid, 0, count);
+    flags[0] = (uint8_t)((first_word & 1) ? ((values[0] < low) * ALARM_HYPOGLYCEMIA |
+                                             (values[0] > high) * ALARM_HYPERGLYCEMIA) : ALARM_NONE);
+    long alarmed = flags[0] != ALARM_NONE;
+
+    uint64_t carry = 0;
+    for (size_t start = 0; start < count; start += 64) {
+        uint64_t word = validity_word(valid, start, count);
+        size_t n = count - start < 64 ? count - start : 64;
+        alarmed += scan_masked_block(values + start, word, (word << 1) | carry, start == 0 ? 1 : 0, n, low, high,
+                                     rapid, flags + start);
+        carry = word >> 63;
+    }
+
+    return alarmed;
+}
+
+/**
+ * @brief Evaluates the alarm rules for every fixed-point reading in an array.
+ *
+ * The first reading has no predecessor; every other reading is compared
+ * with the one before it in a branch-free loop over 16-bit lanes.
+ *
+ * @param values Fixed-point readings, oldest first.
+ * @param count Number of readings.
+ * @param config Pointer to the Config structure containing thresholds.
+ * @param flags Array of count entries to receive the AlarmFlag bits.
+ * @return Number of readings with at least one alarm, or -1 on error.
+ */
+KERNEL_VECTORIZE
+long glucose_scan_alarms_fixed(const GlucoseFixed* values, size_t count, const Config* config, uint8_t* flags) {
+    if (config == NULL || ((values == NULL || flags == NULL) && count > 0)) return -1;
+    if (count == 0) return 0;
+
+    int32_t low = config->hypoglycemia_threshold * GLUCOSE_FIXED_SCALE;
+    int32_t high = config->hyperglycemia_threshold * GLUCOSE_FIXED_SCALE;
+    int32_t rapid = config->rapid_change_threshold * GLUCOSE_FIXED_SCALE;
+
+    long alarmed = 0;
+    unsigned int first = ((int32_t)values[0] < low) * ALARM_HYPOGLYCEMIA |
+                         ((int32_t)values[0] > high) * ALARM_HYPERGLYCEMIA;
+    flags[0] = (uint8_t)first;
+    alarmed += first != ALARM_NONE;
+
+    for (size_t i = 1; i < count; i++) {
+        int32_t value = values[i];
+        int32_t previous = values[i - 1];
+        int32_t change = value - previous;
+        int known = previous != 0;
+
+        // Same rules as evaluate_glucose_alarm_values(), as masks instead of branches
+        unsigned int active = (value < low) * ALARM_HYPOGLYCEMIA |
+                              (value > high) * ALARM_HYPERGLYCEMIA |
+                              (known & (change > rapid)) * ALARM_RAPID_INCREASE |
+                              (known & (change < -rapid)) * ALARM_RAPID_DECREASE;
+
+        flags[i] = (uint8_t)active;
+        alarmed += active != ALARM_NONE;
+    }
+
+    return alarmed;
+}
+
+/**
+ * @brief Evaluates the alarm rules for a run of patients with their own thresholds.
+ *
+ * Entry i of every array belongs to the same patient, e.g. patients with
+ * consecutive ids, whose thresholds are read straight from a ConfigTable's
+ * columns starting at the first id. The loop has no branches, so the
+ * compiler evaluates several patients per vector instruction.
+ *
+ * @param values Current reading of each patient.
+ * @param previous Previous reading of each patient, or 0.0 if none.
+ * @param hypoglycemia Hypoglycemia threshold of each patient.
+ * @param hyperglycemia Hyperglycemia threshold of each patient.
+ * @param rapid_change Rapid change threshold of each patient.
+ * @param count Number of patients.
+ * @param flags Array of count entries to receive the AlarmFlag bits.
+ * @return Number of patients with at least one alarm, or -1 on error.
+ */
+KERNEL_VECTORIZE
+long glucose_scan_alarm_columns(const double* restrict values, const double* restrict previous,
+                                const int32_t* restrict hypoglycemia, const int32_t* restrict hyperglycemia,
+                                const int32_t* restrict rapid_change, size_t count, uint8_t* restrict flags) {
+    if (count > 0 && (values == NULL || previous == NULL || hypoglycemia == NULL || hyperglycemia == NULL ||
+                      rapid_change == NULL || flags == NULL)) {
+        return -1;
+    }
+
+    long alarmed = 0;
+    for (size_t i = 0; i < count; i++) {
+        double change = values[i] - previous[i];
+        int known = previous[i] != 0.0;
+
+        // Same rules as evaluate_glucose_alarm_values(), as masks instead of branches
+        unsigned int active = (values[i] < hypoglycemia[i]) * ALARM_HYPOGLYCEMIA |
+                              (values[i] > hyperglycemia[i]) * ALARM_HYPERGLYCEMIA |
+                              (known & (change > rapid_change[i])) * ALARM_RAPID_INCREASE |
+                              (known & (change < -rapid_change[i])) * ALARM_RAPID_DECREASE;
+
+        flags[i] = (uint8_t)active;
+        alarmed += active != ALARM_NONE;
+    }
+
+    return alarmed;
+}
+
+/**
+ * @brief Builds the validity bitmap of an array that marks gaps with 0.0.
+ *
+ * Each word is assembled from 64 comparisons in a branch-free loop.
+ *
+ * @param values Readings.
+ * @param count Number of entries.
+ * @param valid Array of GLUCOSE_VALIDITY_WORDS(count) words to receive the bitmap.
+ * @return Number of valid entries.
+ */
+KERNEL_VECTORIZE
+size_t glucose_validity_from_values(const double* values, size_t count, uint64_t* valid) {
+    if (values == NULL || valid == NULL) return 0;
+
+    size_t total = 0;
+    for (size_t start = 0; start < count; start += 64) {
+        size_t n = count - start < 64 ? count - start : 64;
+        uint64_t word = 0;
+        for (size_t j = 0; j < n; j++) word |= (uint64_t)(values[start + j] > 0.0) << j;
+        valid[start / 64] = word;
+        total += (size_t)__builtin_popcountll(word);
+    }
+    return total;
+}
+
+/**
+ * @brief Fills short gaps by linear interpolation between the readings around them.
+ *
+ * Walks the set bits of the bitmap, so long runs of valid readings cost
+ * one word test per 64 entries. Filled entries are always before the
+ * reading being visited, so the walk never sees them.
+ *
+ * @param values Readings, oldest first; filled entries are overwritten.
+ * @param valid Validity bitmap of values; bits of filled entries are set.
+ * @param count Number of entries.
+ * @param max_gap Longest gap to fill, in entries (0 fills nothing).
+ * @return Number of entries filled.
+ */
+size_t glucose_interpolate_gaps(double* values, uint64_t* valid, size_t count, size_t max_gap) {
+    if (values == NULL || valid == NULL || max_gap == 0) return 0;
+
+    size_t filled = 0;
+    size_t last = SIZE_MAX; // Latest valid entry so far
+    for (size_t start = 0; start < count; start += 64) {
+        uint64_t word = validity_word(valid, start, count);
+        // A full word directly after a valid entry has no gap to look at
+        if (word == UINT64_MAX && last == start - 1) {
+            last = start + 63;
+            continue;
+        }
+        while (word != 0) {
+            size_t i = start + (size_t)__builtin_ctzll(word);
+            word &= word - 1;
+            size_t gap = last != SIZE_MAX ? i - last - 1 : 0;
+            if (gap > 0 && gap <= max_gap) {
+                double step = (values[i] - values[last]) / (double)(gap + 1);
+                for (size_t k = 1; k <= gap; k++) {
+                    values[last + k] = values[last] + step * (double)k;
+                    valid[(last + k) / 64] |= UINT64_C(1) << ((last + k) % 64);
+                }
+                filled += gap;
+            }
+            last = i;
+        }
+    }
+    return filled;
+}
+
+/**
+ * @brief Returns the first index of an LTTB bucket.
+ *
+ * Bucket 0 starts after the first point, bucket threshold - 2 is the last
+ * point on its own, and threshold - 1 marks the end of the array. The
+ * final edges are fixed so rounding never drops an interior point.
+ */
+static size_t lttb_bucket_edge(size_t bucket, double every, size_t count, size_t threshold) {
+    if (bucket >= threshold - 1) return count;
+    if (bucket == threshold - 2) return count - 1;
+    return (size_t)(bucket * every) + 1;
+}
+
+/**
+ * @brief Selects the points to draw for a downsampled chart.
+ *
+ * Uses largest-triangle-three-buckets (LTTB): the first and last points are
+ * always kept and one point is picked per bucket in between, namely the one
+ * forming the largest triangle with the previously picked point and the
+ * average of the next bucket. Peaks and dips survive downsampling.
+ *
+ * @param x Point x coordinates (e.g. timestamps), ascending.
+ * @param y Point y coordinates (e.g. glucose values).
+ * @param count Number of points.
+ * @param threshold Maximum number of points to select (at least 3 to downsample).
+ * @param indices Array of at least min(count, threshold) entries to receive
+ *                the selected point indices in ascending order.
+ * @return Number of selected points, or 0 on error.
+ */
+size_t glucose_lttb(const double* x, const double* y, size_t count, size_t threshold, size_t* indices) {
+    if (x == NULL || y == NULL || indices == NULL) return 0;
+
+    if (threshold >= count || threshold < 3) {
+        for (size_t i = 0; i < count; i++) indices[i] = i;
+        return count;
+    }
+
+    // Interior points are split into threshold - 2 buckets
+    double every = (double)(count - 2) / (double)(threshold - 2);
+    size_t selected = 0;
+    size_t anchor = 0;
+    indices[selected++] = 0;
+
+    for (size_t bucket = 0; bucket < threshold - 2; bucket++) {
+        size_t start = lttb_bucket_edge(bucket, every, count, threshold);
+        size_t end = lttb_bucket_edge(bucket + 1, every, count, threshold);
+        size_t next_end = lttb_bucket_edge(bucket + 2, every, count, threshold);
+
+        // Average of the next bucket (the last point for the final bucket)
+        double avg_x = 0.0;
+        double avg_y = 0.0;
+        for (size_t i = end; i < next_end; i++) {
+            avg_x += x[i];
+            avg_y += y[i];
+        }
+        if (next_end > end) {
+            avg_x /= (double)(next_end - end);
+            avg_y /= (double)(next_end - end);
+        } else {
+            avg_x = x[count - 1];
+            avg_y = y[count - 1];
+        }
+
+        size_t best = start;
+        double best_area = -1.0;
+        for (size_t i = start; i < end; i++) {
+            double area = fabs((x[anchor] - avg_x) * (y[i] - y[anchor]) -
+                               (x[anchor] - x[i]) * (avg_y - y[anchor]));
+            if (area > best_area) {
+                best_area = area;
+                best = i;
+            }
+        }
+
+        indices[selected++] = best;
+        anchor = best;
+    }
+
+    indices[selected++] = count - 1;
+    return selected;
+}
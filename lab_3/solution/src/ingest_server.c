@@ -0,0 +1,358 @@
+/**
+ * @file ingest_server.c
+ * @brief Contains the epoll-based ingest server for device readings.
+ */
+
+#define _GNU_SOURCE // accept4()
+
+#include "../include/ingest_server.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define INGEST_BUFFER_SIZE (256 * 1024) // Shared receive buffer
+#define INGEST_MAX_EVENTS 256           // Events handled per epoll_wait()
+#define INGEST_MAX_FRAME (sizeof(IngestFrameHeader) + INGEST_MAX_BATCH * sizeof(IngestRecord))
+
+// Records are read in place, so the wire layout must match the structs exactly
+typedef char ingest_header_size_check[(sizeof(IngestFrameHeader) == 16) ? 1 : -1];
+typedef char ingest_record_size_check[(sizeof(IngestRecord) == 16) ? 1 : -1];
+
+/**
+ * @brief Registers a descriptor with the epoll instance (edge-triggered).
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int watch(IngestServer* server, int fd, uint32_t events) {
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = events | EPOLLET;
+    event.data.fd = fd;
+    return epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &event);
+}
+
+/**
+ * @brief Closes a client connection and drops any partial frame.
+ */
+static void close_connection(IngestServer* server, int fd) {
+    IngestConnection* connection = &server->connections[fd];
+
+    close(fd); // Also removes the descriptor from the epoll set
+    free(connection->pending);
+    memset(connection, 0, sizeof(*connection));
+
+    server->open_connections--;
+    server->stats.connections_closed++;
+}
+
+/**
+ * @brief Accepts every pending connection on a listening socket.
+ *
+ * With edge-triggered notification the backlog must be drained completely,
+ * or the remaining connections would not be reported again.
+ */
+static void accept_connections(IngestServer* server, int listen_fd) {
+    for (;;) {
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            return; // EAGAIN, or out of descriptors until a connection closes
+        }
+
+        if ((uint32_t)fd >= server->connection_capacity || watch(server, fd, EPOLLIN | EPOLLRDHUP) != 0) {
+            close(fd);
+            continue;
+        }
+
+        if (listen_fd == server->tcp_fd) {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+
+        server->connections[fd].open = 1;
+        server->open_connections++;
+        server->stats.connections_accepted++;
+    }
+}
+
+/**
+ * @brief Keeps the unparsed tail of the receive buffer for the next read.
+ *
+ * @return 0 on success, -1 on error (out of memory).
+ */
+static int save_pending(IngestConnection* connection, const uint8_t* data, size_t length) {
+    if (length > connection->pending_capacity) {
+        uint8_t* pending = realloc(connection->pending, INGEST_MAX_FRAME);
+        if (pending == NULL) return -1;
+        connection->pending = pending;
+        connection->pending_capacity = INGEST_MAX_FRAME;
+    }
+
+    memcpy(connection->pending, data, length);
+    connection->pending_length = (uint32_t)length;
+    return 0;
+}
+
+/**
+ * @brief Parses and dispatches every complete frame in the buffer.
+ *
+ * @param server Pointer to the IngestServer.
+ * @param fd Connection the data came from (for acknowledgements).
+ * @param available Bytes of data at the start of server->buffer.
+ * @param consumed Pointer to receive the number of bytes parsed.
+ * @return Number of records dispatched, -1 on a malformed frame, or -2 if
+ *         an acknowledgement was only partly written or the peer has gone.
+ */
+static long dispatch_frames(IngestServer* server, int fd, size_t available, size_t* consumed) {
+    size_t offset = 0;
+    long records = 0;
+
+    while (available - offset >= sizeof(IngestFrameHeader)) {
+        IngestFrameHeader header;
+        memcpy(&header, server->buffer + offset, sizeof(header));
+
+        if (header.version != INGEST_FRAME_VERSION || header.count > INGEST_MAX_BATCH ||
+            header.length != sizeof(IngestFrameHeader) + (size_t)header.count * sizeof(IngestRecord)) {
+            return -1;
+        }
+        if (available - offset < header.length) break;
+
+        // Frames are multiples of 16 bytes and the buffer starts at a frame
+        // boundary, so the records are suitably aligned to use in place
+        const IngestRecord* batch = (const IngestRecord*)(server->buffer + offset + sizeof(header));
+        uint32_t accepted = server->handler(server->context, batch, header.count);
+
+        server->stats.frames++;
+        server->stats.records += header.count;
+        records += header.count;
+        offset += header.length;
+
+        if (header.flags & INGEST_FLAG_ACK) {
+            // A sender not reading its acks has them dropped whole, which never
+            // blocks the server; a partial ack would misalign every later one.
+            // A sender that already closed its socket raises EPIPE, not SIGPIPE.
+            IngestAck ack = {header.sequence, accepted};
+            ssize_t written = send(fd, &ack, sizeof(ack), MSG_NOSIGNAL);
+            if ((written >= 0 && (size_t)written < sizeof(ack)) ||
+                (written < 0 && (errno == EPIPE || errno == ECONNRESET))) {
+                *consumed = offset;
+                return -2;
+            }
+        }
+    }
+
+    *consumed = offset;
+    return records;
+}
+
+/**
+ * @brief Reads everything available on a connection and processes it.
+ *
+ * @param server Pointer to the IngestServer.
+ * @param fd Connection to read.
+ * @param hangup Non-zero if the peer has closed its side; reading then
+ *               continues until end of file so the connection is closed.
+ * @return Number of records processed.
+ */
+static long read_connection(IngestServer* server, int fd, int hangup) {
+    IngestConnection* connection = &server->connections[fd];
+    long processed = 0;
+
+    for (;;) {
+        // Continue a partially received frame at the start of the buffer
+        size_t used = connection->pending_length;
+        if (used > 0) memcpy(server->buffer, connection->pending, used);
+
+        ssize_t received = read(fd, server->buffer + used, server->buffer_size - used);
+        if (received < 0 && errno == EINTR) continue;
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return processed;
+        if (received <= 0) {
+            close_connection(server, fd); // Peer closed or socket error
+            return processed;
+        }
+        server->stats.bytes += (uint64_t)received;
+
+        size_t consumed;
+        long records = dispatch_frames(server, fd, used + (size_t)received, &consumed);
+        if (records < 0) {
+            if (records == -1) {
+                server->stats.protocol_errors++;
+            } else {
+                server->stats.ack_errors++;
+            }
+            close_connection(server, fd);
+            return processed;
+        }
+        processed += records;
+
+        if (save_pending(connection, server->buffer + consumed, used + (size_t)received - consumed) != 0) {
+            close_connection(server, fd);
+            return processed;
+        }
+
+        // A short read means the socket was drained; any later data raises a new edge
+        if (!hangup && (size_t)received < server->buffer_size - used) return processed;
+    }
+}
+
+/**
+ * @brief Creates a non-blocking listening socket bound to an address.
+ *
+ * @return Listening descriptor, or -1 on error.
+ */
+static int open_listener(int domain, const struct sockaddr* address, socklen_t length) {
+    int fd = socket(domain, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+
+    int one = 1;
+    if (domain == AF_INET) setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    if (bind(fd, address, length) != 0 || listen(fd, SOMAXCONN) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/**
+ * @brief Opens the listening sockets and the epoll instance.
+ *
+ * @param server Pointer to the IngestServer structure to initialize.
+ * @param unix_path Unix-domain socket path, or NULL for none.
+ * @param tcp_port Loopback TCP port, or 0 for none.
+ * @param handler Callback for complete frames.
+ * @param context Pointer passed to the handler.
+ * @return 0 on success, -1 on error.
+ */
+int ingest_server_open(IngestServer* server, const char* unix_path, uint16_t tcp_port,
+                       IngestHandler handler, void* context) {
+    if (server == NULL || handler == NULL || (unix_path == NULL && tcp_port == 0)) return -1;
+
+    memset(server, 0, sizeof(*server));
+    server->epoll_fd = -1;
+    server->unix_fd = -1;
+    server->tcp_fd = -1;
+    server->handler = handler;
+    server->context = context;
+
+    // One entry per possible descriptor, so connection lookup is an index
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0) return -1;
+    server->connection_capacity = limit.rlim_cur > (1u << 20) ? (1u << 20) : (uint32_t)limit.rlim_cur;
+
+    server->connections = calloc(server->connection_capacity, sizeof(IngestConnection));
+    server->buffer_size = INGEST_BUFFER_SIZE;
+    server->buffer = malloc(server->buffer_size);
+    server->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (server->connections == NULL || server->buffer == NULL || server->epoll_fd < 0) {
+        ingest_server_close(server);
+        return -1;
+    }
+
+    if (unix_path != NULL) {
+        struct sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (strlen(unix_path) >= sizeof(address.sun_path)) {
+            ingest_server_close(server);
+            return -1;
+        }
+        strcpy(address.sun_path, unix_path);
+        strcpy(server->unix_path, unix_path);
+
+        unlink(unix_path); // Remove a socket left behind by a previous run
+        server->unix_fd = open_listener(AF_UNIX, (const struct sockaddr*)&address, sizeof(address));
+        if (server->unix_fd < 0 || watch(server, server->unix_fd, EPOLLIN) != 0) {
+            ingest_server_close(server);
+            return -1;
+        }
+    }
+
+    if (tcp_port != 0) {
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons(tcp_port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        server->tcp_fd = open_listener(AF_INET, (const struct sockaddr*)&address, sizeof(address));
+        if (server->tcp_fd < 0 || watch(server, server->tcp_fd, EPOLLIN) != 0) {
+            ingest_server_close(server);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Waits for socket activity and processes it.
+ *
+ * @param server Pointer to the open IngestServer.
+ * @param timeout_ms Maximum time to wait in milliseconds (-1 waits forever).
+ * @return Number of records processed, or -1 on error.
+ */
+long ingest_server_poll(IngestServer* server, int timeout_ms) {
+    if (server == NULL || server->epoll_fd < 0) return -1;
+
+    struct epoll_event events[INGEST_MAX_EVENTS];
+    int ready = epoll_wait(server->epoll_fd, events, INGEST_MAX_EVENTS, timeout_ms);
+    if (ready < 0) return errno == EINTR ? 0 : -1;
+
+    long processed = 0;
+    for (int i = 0; i < ready; i++) {
+        int fd = events[i].data.fd;
+
+        if (fd == server->unix_fd || fd == server->tcp_fd) {
+            accept_connections(server, fd);
+        } else if (server->connections[fd].open) {
+            // Read first even on hang-up, so frames sent just before closing are kept
+            int hangup = (events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) != 0;
+            processed += read_connection(server, fd, hangup);
+        }
+    }
+
+    return processed;
+}
+
+/**
+ * @brief Closes every connection and listening socket.
+ *
+ * @param server Pointer to the IngestServer to close.
+ * @return 0 on success, -1 on error.
+ */
+int ingest_server_close(IngestServer* server) {
+    if (server == NULL) return -1;
+
+    if (server->connections != NULL) {
+        for (uint32_t fd = 0; fd < server->connection_capacity && server->open_connections > 0; fd++) {
+            if (server->connections[fd].open) close_connection(server, (int)fd);
+        }
+    }
+
+    if (server->unix_fd >= 0) {
+        close(server->unix_fd);
+        unlink(server->unix_path);
+    }
+    if (server->tcp_fd >= 0) close(server->tcp_fd);
+    if (server->epoll_fd >= 0) close(server->epoll_fd);
+
+    free(server->connections);
+    free(server->buffer);
+    server->connections = NULL;
+    server->buffer = NULL;
+    server->epoll_fd = -1;
+    server->unix_fd = -1;
+    server->tcp_fd = -1;
+
+    return 0;
+}
@@ -0,0 +1,332 @@
+/**
+ * @file latency.c
+ * @brief Contains the per-thread HDR-style latency histograms.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../include/latency.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// Histograms owned by a single recording thread
+typedef struct {
+    uint64_t counts[LATENCY_STAGE_COUNT][LATENCY_BUCKET_COUNT];
+    uint64_t total_ns[LATENCY_STAGE_COUNT];
+    uint64_t max_ns[LATENCY_STAGE_COUNT];
+} LatencyRecorder;
+
+int latency_enabled_flag = 0;
+
+// The last recorder is shared by every thread beyond LATENCY_MAX_THREADS
+#define OVERFLOW_RECORDER LATENCY_MAX_THREADS
+
+static LatencyRecorder recorders[LATENCY_MAX_THREADS + 1];
+static int recorder_count = 0;
+static __thread LatencyRecorder* local_recorder = NULL;
+
+static const char* const stage_names[LATENCY_STAGE_COUNT] = {
+    "generate",
+    "analyze",
+    "alarm",
+    "reading",
+    "render"
+};
+
+/**
+ * @brief Maps a value to its log-linear histogram bucket.
+ *
+ * Values below the sub-bucket count map to themselves. Larger values keep
+ * their top LATENCY_SUB_BUCKET_BITS + 1 significant bits, giving a relative
+ * error of at most 1 / LATENCY_SUB_BUCKET_COUNT (about 3%).
+ *
+ * @param value Value in nanoseconds.
+ * @return Bucket index in [0, LATENCY_BUCKET_COUNT).
+ */
+static int bucket_index(uint64_t value) {
+    if (value < LATENCY_SUB_BUCKET_COUNT) return (int)value;
+
+    int msb = 63 - __builtin_clzll(value);
+    if (msb >= LATENCY_MAX_VALUE_BITS) return LATENCY_BUCKET_COUNT - 1;
+
+    int shift = msb - LATENCY_SUB_BUCKET_BITS;
+    return (shift + 1) * LATENCY_SUB_BUCKET_COUNT +
+           (int)((value >> shift) - LATENCY_SUB_BUCKET_COUNT);
+}
+
+/**
+ * @brief Returns the highest value that maps to a bucket.
+ *
+ * @param index Bucket index.
+ * @return Upper bound of the bucket in nanoseconds.
+ */
+static uint64_t bucket_upper_bound(int index) {
+    if (index < LATENCY_SUB_BUCKET_COUNT) return (uint64_t)index;
+
+    int shift = index / LATENCY_SUB_BUCKET_COUNT - 1;
+    uint64_t sub = (uint64_t)(index % LATENCY_SUB_BUCKET_COUNT + LATENCY_SUB_BUCKET_COUNT);
+    return (sub << shift) + ((uint64_t)1 << shift) - 1;
+}
+
+/**
+ * @brief Returns the calling thread's recorder, claiming one on first use.
+ *
+ * A thread that finds every recorder taken caches the shared overflow
+ * recorder instead, so it claims a slot only once either way.
+ *
+ * @return Pointer to the recorder.
+ */
+static LatencyRecorder* get_local_recorder(void) {
+    if (local_recorder == NULL) {
+        int slot = __atomic_fetch_add(&recorder_count, 1, __ATOMIC_RELAXED);
+        local_recorder = &recorders[slot < LATENCY_MAX_THREADS ? slot : OVERFLOW_RECORDER];
+    }
+    return local_recorder;
+}
+
+/**
+ * @brief Returns the number of recorders that may hold samples.
+ *
+ * @return Claimed recorders, plus the overflow recorder once it is in use.
+ */
+static int active_recorders(void) {
+    int active = __atomic_load_n(&recorder_count, __ATOMIC_RELAXED);
+    return active > LATENCY_MAX_THREADS ? LATENCY_MAX_THREADS + 1 : active;
+}
+
+/**
+ * @brief Adds to a counter of a recorder.
+ *
+ * An owned recorder has a single writer, so a relaxed load/store pair is
+ * enough for concurrent readers to see untorn values. The overflow
+ * recorder is shared and takes a locked add.
+ */
+static void recorder_add(const LatencyRecorder* recorder, uint64_t* counter, uint64_t amount) {
+    if (recorder == &recorders[OVERFLOW_RECORDER]) {
+        __atomic_fetch_add(counter, amount, __ATOMIC_RELAXED);
+        return;
+    }
+    uint64_t value = __atomic_load_n(counter, __ATOMIC_RELAXED);
+    __atomic_store_n(counter, value + amount, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Raises a maximum of a recorder to a sample.
+ *
+ * The owner of a recorder stores a larger sample directly. On the shared
+ * overflow recorder, a compare-and-swap loop keeps another thread's
+ * larger maximum from being overwritten.
+ */
+static void recorder_max(const LatencyRecorder* recorder, uint64_t* maximum, uint64_t sample) {
+    uint64_t current = __atomic_load_n(maximum, __ATOMIC_RELAXED);
+    if (recorder != &recorders[OVERFLOW_RECORDER]) {
+        if (sample > current) __atomic_store_n(maximum, sample, __ATOMIC_RELAXED);
+        return;
+    }
+    while (sample > current &&
+           !__atomic_compare_exchange_n(maximum, &current, sample, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+/**
+ * @brief Enables or disables latency recording at runtime.
+ *
+ * @param enabled true to start recording, false to stop.
+ * @return 0 on success, -1 on error.
+ */
+int latency_set_enabled(bool enabled) {
+    __atomic_store_n(&latency_enabled_flag, enabled ? 1 : 0, __ATOMIC_RELAXED);
+    return 0;
+}
+
+/**
+ * @brief Reads the monotonic clock in nanoseconds.
+ *
+ * @return Current monotonic time in nanoseconds.
+ */
+uint64_t latency_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Records one latency sample into the calling thread's histogram.
+ *
+ * @param stage Stage the sample belongs to.
+ * @param elapsed_ns Measured duration in nanoseconds.
+ * @return 0 on success, -1 on error (invalid stage).
+ */
+int latency_record(LatencyStage stage, uint64_t elapsed_ns) {
+    if (stage < 0 || stage >= LATENCY_STAGE_COUNT) return -1;
+
+    LatencyRecorder* recorder = get_local_recorder();
+    recorder_add(recorder, &recorder->counts[stage][bucket_index(elapsed_ns)], 1);
+    recorder_add(recorder, &recorder->total_ns[stage], elapsed_ns);
+    recorder_max(recorder, &recorder->max_ns[stage], elapsed_ns);
+
+    return 0;
+}
+
+/**
+ * @brief Merges all per-thread histograms for a stage into a summary.
+ *
+ * The merge walks the combined bucket counts once and picks each
+ * percentile as the upper bound of the first bucket whose cumulative count
+ * reaches it, matching the reporting convention of HDR histograms.
+ *
+ * @param stage Stage to summarize.
+ * @param summary Pointer to the LatencySummary structure to fill.
+ * @return 0 on success, -1 on error.
+ */
+int latency_get_summary(LatencyStage stage, LatencySummary* summary) {
+    if (summary == NULL || stage < 0 || stage >= LATENCY_STAGE_COUNT) return -1;
+
+    uint64_t merged[LATENCY_BUCKET_COUNT];
+    memset(merged, 0, sizeof(merged));
+    memset(summary, 0, sizeof(*summary));
+
+    int active = active_recorders();
+
+    uint64_t total_ns = 0;
+    for (int r = 0; r < active; r++) {
+        const LatencyRecorder* recorder = &recorders[r];
+        for (int b = 0; b < LATENCY_BUCKET_COUNT; b++) {
+            uint64_t count = __atomic_load_n(&recorder->counts[stage][b], __ATOMIC_RELAXED);
+            merged[b] += count;
+            summary->count += count;
+        }
+        total_ns += __atomic_load_n(&recorder->total_ns[stage], __ATOMIC_RELAXED);
+        uint64_t max_ns = __atomic_load_n(&recorder->max_ns[stage], __ATOMIC_RELAXED);
+        if (max_ns > summary->max_ns) summary->max_ns = max_ns;
+    }
+
+    if (summary->count == 0) return 0;
+
+    summary->mean_ns = (double)total_ns / (double)summary->count;
+
+    // Ranks are 1-based: the sample at which the cumulative count reaches them
+    uint64_t rank_p50 = (summary->count * 500 + 999) / 1000;
+    uint64_t rank_p99 = (summary->count * 990 + 999) / 1000;
+    uint64_t rank_p999 = (summary->count * 999 + 999) / 1000;
+
+    uint64_t cumulative = 0;
+    for (int b = 0; b < LATENCY_BUCKET_COUNT; b++) {
+        if (merged[b] == 0) continue;
+        cumulative += merged[b];
+        uint64_t upper = bucket_upper_bound(b);
+        if (summary->p50_ns == 0 && cumulative >= rank_p50) summary->p50_ns = upper;
+        if (summary->p99_ns == 0 && cumulative >= rank_p99) summary->p99_ns = upper;
+        if (summary->p999_ns == 0 && cumulative >= rank_p999) {
+            summary->p999_ns = upper;
+            break;
+        }
+    }
+
+    // Bucket upper bounds can overshoot the true maximum
+    if (summary->p50_ns > summary->max_ns) summary->p50_ns = summary->max_ns;
+    if (summary->p99_ns > summary->max_ns) summary->p99_ns = summary->max_ns;
+    if (summary->p999_ns > summary->max_ns) summary->p999_ns = summary->max_ns;
+
+    return 0;
+}
+
+/**
+ * @brief Merges all per-thread histograms for a stage into cumulative counts at given bounds.
+ *
+ * Buckets are visited in ascending order, so the first bound at or above
+ * each bucket's upper bound only ever moves forward.
+ *
+ * @param stage Stage to export.
+ * @param bounds_ns Ascending upper bounds in nanoseconds.
+ * @param bound_count Number of bounds.
+ * @param counts Array of bound_count cumulative counts to fill.
+ * @param count Pointer to receive the number of samples, including those above every bound.
+ * @param total_ns Pointer to receive the sum of all samples in nanoseconds.
+ * @return 0 on success, -1 on error.
+ */
+int latency_get_histogram(LatencyStage stage, const uint64_t* bounds_ns, int bound_count, uint64_t* counts,
+                          uint64_t* count, uint64_t* total_ns) {
+    if (bounds_ns == NULL || counts == NULL || count == NULL || total_ns == NULL || bound_count < 0) return -1;
+    if (stage < 0 || stage >= LATENCY_STAGE_COUNT) return -1;
+
+    memset(counts, 0, (size_t)bound_count * sizeof(uint64_t));
+    *count = 0;
+    *total_ns = 0;
+
+    int active = active_recorders();
+
+    int bound = 0;
+    for (int b = 0; b < LATENCY_BUCKET_COUNT; b++) {
+        uint64_t merged = 0;
+        for (int r = 0; r < active; r++) merged += __atomic_load_n(&recorders[r].counts[stage][b], __ATOMIC_RELAXED);
+        if (merged == 0) continue;
+
+        *count += merged;
+        uint64_t upper = bucket_upper_bound(b);
+        while (bound < bound_count && bounds_ns[bound] < upper) bound++;
+        if (bound < bound_count) counts[bound] += merged;
+    }
+    for (int i = 1; i < bound_count; i++) counts[i] += counts[i - 1];
+    for (int r = 0; r < active; r++) *total_ns += __atomic_load_n(&recorders[r].total_ns[stage], __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+/**
+ * @brief Returns the display name of a stage.
+ *
+ * @param stage Stage to name.
+ * @return Constant string naming the stage, or "unknown".
+ */
+const char* latency_stage_name(LatencyStage stage) {
+    if (stage < 0 || stage >= LATENCY_STAGE_COUNT) return "unknown";
+    return stage_names[stage];
+}
+
+/**
+ * @brief Clears every recorded sample in all per-thread histograms.
+ *
+ * Must not run while any thread records: the clear is a plain memset, so
+ * a concurrent sample can be lost or survive the reset half-written.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int latency_reset(void) {
+    int active = active_recorders();
+
+    for (int r = 0; r < active; r++) {
+        memset(&recorders[r], 0, sizeof(recorders[r]));
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Prints p50/p99/p999/max latency for every stage with samples.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int print_latency_report(void) {
+    printf("\n--- Stage Latency (ns) ---\n");
+    printf("%-10s %10s %10s %10s %10s %10s\n", "stage", "count", "p50", "p99", "p99.9", "max");
+
+    for (int s = 0; s < LATENCY_STAGE_COUNT; s++) {
+        LatencySummary summary;
+        if (latency_get_summary((LatencyStage)s, &summary) != 0) return -1;
+        if (summary.count == 0) continue;
+
+        printf("%-10s %10llu %10llu %10llu %10llu %10llu\n",
+               latency_stage_name((LatencyStage)s),
+               (unsigned long long)summary.count,
+               (unsigned long long)summary.p50_ns,
+               (unsigned long long)summary.p99_ns,
+               (unsigned long long)summary.p999_ns,
+               (unsigned long long)summary.max_ns);
+    }
+
+    printf("--------------------------\n\n");
+
+    return 0;
+}
@@ -0,0 +1,138 @@
+/**
+ * @file latest_state.c
+ * @brief Contains the seqlock-published table of every patient's latest state.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../include/latest_state.h"
+#include "../include/seqlock.h"
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Retries before a reader yields, in case the writer was preempted in the middle of a slot
+#define LATEST_STATE_SPIN_LIMIT 64
+
+typedef char latest_state_slot_size_check[(sizeof(LatestStateSlot) == LATEST_STATE_SLOT_SIZE) ? 1 : -1];
+
+/**
+ * @brief Returns the slot's page if it has been published, or NULL.
+ */
+static LatestStateSlot* page_of(const LatestStateTable* table, uint32_t slot) {
+    uint32_t page = slot / LATEST_STATE_PAGE_SLOTS;
+    if (page >= LATEST_STATE_MAX_PAGES) return NULL;
+    return __atomic_load_n(&table->pages[page], __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Initializes an empty table.
+ *
+ * @param table Pointer to the LatestStateTable structure to initialize.
+ * @return 0 on success, -1 on error.
+ */
+int latest_state_init(LatestStateTable* table) {
+    if (table == NULL) return -1;
+    memset(table, 0, sizeof(*table));
+    return 0;
+}
+
+/**
+ * @brief Frees every page. No reader may use the table afterwards.
+ *
+ * @param table Pointer to the LatestStateTable structure to destroy.
+ * @return 0 on success, -1 on error.
+ */
+int latest_state_destroy(LatestStateTable* table) {
+    if (table == NULL) return -1;
+    for (uint32_t i = 0; i < LATEST_STATE_MAX_PAGES; i++) free(table->pages[i]);
+    memset(table, 0, sizeof(*table));
+    return 0;
+}
+
+/**
+ * @brief Publishes a patient's latest state into a slot (writer thread only).
+ *
+ * Never blocks on readers. The slot's page is allocated on first use.
+ *
+ * @param table Pointer to the LatestStateTable structure.
+ * @param slot Slot to write, usually the patient's registry slot.
+ * @param patient Pointer to the patient's state.
+ * @return 0 on success, -1 on error (invalid slot or out of memory).
+ */
+int latest_state_publish(LatestStateTable* table, uint32_t slot, const PatientState* patient) {
+    if (table == NULL || patient == NULL || slot / LATEST_STATE_PAGE_SLOTS >= LATEST_STATE_MAX_PAGES) return -1;
+
+    LatestStateSlot* page = table->pages[slot / LATEST_STATE_PAGE_SLOTS]; // Only this thread stores it
+    if (page == NULL) {
+        void* memory;
+        if (posix_memalign(&memory, LATEST_STATE_SLOT_SIZE, LATEST_STATE_PAGE_SLOTS * sizeof(LatestStateSlot)) != 0) {
+            return -1;
+        }
+        memset(memory, 0, LATEST_STATE_PAGE_SLOTS * sizeof(LatestStateSlot));
+        page = memory;
+        __atomic_store_n(&table->pages[slot / LATEST_STATE_PAGE_SLOTS], page, __ATOMIC_RELEASE);
+    }
+
+    // Computed before the write begins, to keep the window readers retry on short
+    LatestState state;
+    state.patient_id = patient->patient_id;
+    state.alarm_flags = patient->alarm_flags;
+    state.timestamp = (int64_t)patient->data.reading_time;
+    state.glucose_value = patient->data.glucose_value;
+    state.trend = (int32_t)calculate_glucose_trend(&patient->data);
+    state.alarm_count = patient->alarm_count;
+    state.stats = patient->stats;
+
+    LatestStateSlot* entry = &page[slot % LATEST_STATE_PAGE_SLOTS];
+    seqlock_write_begin(&entry->sequence);
+    entry->state = state;
+    seqlock_write_end(&entry->sequence);
+
+    if (slot >= table->slot_count) __atomic_store_n(&table->slot_count, slot + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&table->publish_count, table->publish_count + 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+/**
+ * @brief Copies a consistent snapshot of a slot, from any thread.
+ *
+ * Retries without locking while the writer is updating the slot, yielding
+ * the CPU now and then in case the writer was preempted in the middle of it.
+ *
+ * @param table Pointer to the LatestStateTable structure.
+ * @param slot Slot to read.
+ * @param state Pointer to the LatestState structure to fill.
+ * @param retries Pointer to receive the number of retried copies, or NULL.
+ * @return 0 on success, -1 if the slot has never been published.
+ */
+int latest_state_read(const LatestStateTable* table, uint32_t slot, LatestState* state, uint32_t* retries) {
+    if (retries != NULL) *retries = 0;
+    if (table == NULL || state == NULL) return -1;
+
+    const LatestStateSlot* page = page_of(table, slot);
+    if (page == NULL) return -1;
+    const LatestStateSlot* entry = &page[slot % LATEST_STATE_PAGE_SLOTS];
+
+    uint32_t attempts = 0;
+    for (;;) {
+        uint64_t start = seqlock_read_begin(&entry->sequence);
+        *state = entry->state;
+        if (!seqlock_read_retry(&entry->sequence, start)) break;
+        if (++attempts % LATEST_STATE_SPIN_LIMIT == 0) sched_yield();
+    }
+
+    if (retries != NULL) *retries = attempts;
+    return state->patient_id != 0 ? 0 : -1;
+}
+
+/**
+ * @brief Returns the number of slots readers should consider, from any thread.
+ *
+ * @param table Pointer to the LatestStateTable structure.
+ * @return Highest published slot + 1.
+ */
+uint32_t latest_state_slot_count(const LatestStateTable* table) {
+    if (table == NULL) return 0;
+    return __atomic_load_n(&table->slot_count, __ATOMIC_ACQUIRE);
+}
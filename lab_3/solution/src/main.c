@@ -9,13 +9,22 @@
 /**
  * @brief Main function to start the controller.
  *
- * This function initializes the controller, which manages the generation,
- * analysis, and visualization of glucose data.
+ * This function parses the command-line options and initializes the
+ * controller, which manages the generation, analysis, and visualization
+ * of glucose data.
  *
+ * @param argc Argument count.
+ * @param argv Argument vector.
  * @return Exit status: 0 on success, 1 on error.
  */
-int main(void) {
-    int result = run_controller();
+int main(int argc, char** argv) {
+    ControllerOptions options;
+    if (parse_controller_options(argc, argv, &options) != 0) {
+        printf("Usage: %s [--patients N] [--telemetry] [--ingest-unix PATH] [--ingest-tcp PORT] [--state-dir DIR] [--lazy-restore] [--config FILE] [--tui] [--fps N] [--archive-dir DIR] [--report FILE] [--report-days N] [--shards N] [--smooth] [--resample MIN] [--arrow-dir DIR] [--metrics-port PORT]\n", argv[0]);
+        return 1;
+    }
+
+    int result = run_controller(&options);
     if (result != 0) {
         printf("Controller failed with error code: %d\n", result);
         return 1;
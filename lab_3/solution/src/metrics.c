@@ -0,0 +1,541 @@
+/**
+ * @file metrics.c
+ * @brief Contains the per-thread engine counters and the Prometheus metrics server.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../include/metrics.h"
+#include "../include/alarm.h"
+#include "../include/latency.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+// Counters and gauges owned by a single thread, on cache lines of their own
+typedef struct {
+    uint64_t counters[METRIC_COUNTER_COUNT];
+    uint64_t gauges[METRIC_GAUGE_COUNT];
+    uint8_t padding[2 * METRICS_CACHE_LINE - (METRIC_COUNTER_COUNT + METRIC_GAUGE_COUNT) * sizeof(uint64_t)];
+} MetricsRecorder;
+
+typedef char metrics_recorder_size_check[sizeof(MetricsRecorder) % METRICS_CACHE_LINE == 0 ? 1 : -1];
+
+// Text of a response, grown as metrics are appended
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+    int failed; // Set once an append ran out of memory
+} MetricsBuffer;
+
+// Label and gauge of each glucose_queue_depth series
+typedef struct {
+    const char* queue;
+    MetricGauge gauge;
+} QueueSeries;
+
+// The last recorder is shared by every thread beyond METRICS_MAX_THREADS
+#define OVERFLOW_RECORDER METRICS_MAX_THREADS
+
+static MetricsRecorder recorders[METRICS_MAX_THREADS + 1] __attribute__((aligned(METRICS_CACHE_LINE)));
+static int recorder_count = 0;
+static __thread MetricsRecorder* local_recorder = NULL;
+
+static const char* const alarm_types[] = {"hypoglycemia", "hyperglycemia", "rapid_increase", "rapid_decrease"};
+
+static const unsigned int alarm_bits[] = {ALARM_HYPOGLYCEMIA, ALARM_HYPERGLYCEMIA, ALARM_RAPID_INCREASE,
+                                          ALARM_RAPID_DECREASE};
+
+static const QueueSeries queue_series[] = {
+    {"wal_group", METRIC_GAUGE_WAL_GROUP},
+    {"restore_pending", METRIC_GAUGE_RESTORE_PENDING},
+    {"arrow_pending", METRIC_GAUGE_ARROW_PENDING},
+    {"shard_inbox", METRIC_GAUGE_SHARD_INBOX},
+};
+
+// Upper bounds of the stage latency buckets, 1 us to 1 s
+static const uint64_t latency_bounds_ns[] = {
+    1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000,
+    1000000, 2500000, 5000000, 10000000, 25000000, 50000000, 100000000, 250000000, 500000000, 1000000000,
+};
+
+#define ALARM_TYPE_COUNT (sizeof(alarm_bits) / sizeof(alarm_bits[0]))
+#define QUEUE_SERIES_COUNT (sizeof(queue_series) / sizeof(queue_series[0]))
+#define LATENCY_BOUND_COUNT ((int)(sizeof(latency_bounds_ns) / sizeof(latency_bounds_ns[0])))
+
+/**
+ * @brief Returns the calling thread's recorder, claiming one on first use.
+ *
+ * A thread that finds every recorder taken caches the shared overflow
+ * recorder instead, so it claims a slot only once either way.
+ *
+ * @return Pointer to the recorder.
+ */
+static MetricsRecorder* get_local_recorder(void) {
+    if (local_recorder == NULL) {
+        int slot = __atomic_fetch_add(&recorder_count, 1, __ATOMIC_RELAXED);
+        local_recorder = &recorders[slot < METRICS_MAX_THREADS ? slot : OVERFLOW_RECORDER];
+    }
+    return local_recorder;
+}
+
+/**
+ * @brief Returns the number of recorders that may hold counts.
+ *
+ * @return Claimed recorders, plus the overflow recorder once it is in use.
+ */
+static int active_recorders(void) {
+    int active = __atomic_load_n(&recorder_count, __ATOMIC_RELAXED);
+    return active > METRICS_MAX_THREADS ? METRICS_MAX_THREADS + 1 : active;
+}
+
+/**
+ * @brief Adds to a counter of a recorder.
+ *
+ * An owned recorder has a single writer, so a relaxed load/store pair is
+ * enough for the scraping thread to see untorn values. The overflow
+ * recorder is shared and takes a locked add.
+ */
+static void recorder_add(const MetricsRecorder* recorder, uint64_t* counter, uint64_t amount) {
+    if (recorder == &recorders[OVERFLOW_RECORDER]) {
+        __atomic_fetch_add(counter, amount, __ATOMIC_RELAXED);
+        return;
+    }
+    uint64_t value = __atomic_load_n(counter, __ATOMIC_RELAXED);
+    __atomic_store_n(counter, value + amount, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Adds to a counter of the calling thread.
+ *
+ * @param counter Counter to add to.
+ * @param amount Amount to add.
+ * @return 0 on success, -1 on error (invalid counter).
+ */
+int metrics_count(MetricCounter counter, uint64_t amount) {
+    if (counter < 0 || counter >= METRIC_COUNTER_COUNT) return -1;
+
+    MetricsRecorder* recorder = get_local_recorder();
+
+    recorder_add(recorder, &recorder->counters[counter], amount);
+    return 0;
+}
+
+/**
+ * @brief Counts one processed reading and the alarms it raised.
+ *
+ * @param alarm_flags AlarmFlag bits of the reading.
+ * @return 0 on success.
+ */
+int metrics_count_reading(unsigned int alarm_flags) {
+    MetricsRecorder* recorder = get_local_recorder();
+
+    recorder_add(recorder, &recorder->counters[METRIC_READINGS], 1);
+    if (alarm_flags == ALARM_NONE) return 0;
+    for (size_t t = 0; t < ALARM_TYPE_COUNT; t++) {
+        if (alarm_flags & alarm_bits[t]) recorder_add(recorder, &recorder->counters[METRIC_ALARM_HYPOGLYCEMIA + t], 1);
+    }
+    return 0;
+}
+
+/**
+ * @brief Sets the calling thread's part of a gauge.
+ *
+ * Threads beyond METRICS_MAX_THREADS share one part, which holds the
+ * value set last.
+ *
+ * @param gauge Gauge to set.
+ * @param value Value as seen by the calling thread.
+ * @return 0 on success, -1 on error (invalid gauge).
+ */
+int metrics_set_gauge(MetricGauge gauge, uint64_t value) {
+    if (gauge < 0 || gauge >= METRIC_GAUGE_COUNT) return -1;
+
+    MetricsRecorder* recorder = get_local_recorder();
+
+    __atomic_store_n(&recorder->gauges[gauge], value, __ATOMIC_RELAXED);
+    return 0;
+}
+
+/**
+ * @brief Sums a counter over all threads.
+ *
+ * @param counter Counter to read.
+ * @return Sum of the counter, 0 if invalid.
+ */
+uint64_t metrics_get_counter(MetricCounter counter) {
+    if (counter < 0 || counter >= METRIC_COUNTER_COUNT) return 0;
+
+    uint64_t total = 0;
+    int active = active_recorders();
+    for (int r = 0; r < active; r++) total += __atomic_load_n(&recorders[r].counters[counter], __ATOMIC_RELAXED);
+    return total;
+}
+
+/**
+ * @brief Sums a gauge over all threads.
+ *
+ * @param gauge Gauge to read.
+ * @return Sum of the gauge, 0 if invalid.
+ */
+uint64_t metrics_get_gauge(MetricGauge gauge) {
+    if (gauge < 0 || gauge >= METRIC_GAUGE_COUNT) return 0;
+
+    uint64_t total = 0;
+    int active = active_recorders();
+    for (int r = 0; r < active; r++) total += __atomic_load_n(&recorders[r].gauges[gauge], __ATOMIC_RELAXED);
+    return total;
+}
+
+/**
+ * @brief Appends formatted text to a buffer, growing it as needed.
+ *
+ * Failures are remembered in the buffer, so a render checks once at the end.
+ */
+static void append(MetricsBuffer* buffer, const char* format, ...) {
+    if (buffer->failed) return;
+
+    for (;;) {
+        va_list args;
+        va_start(args, format);
+        int written = vsnprintf(buffer->data + buffer->length, buffer->capacity - buffer->length, format, args);
+        va_end(args);
+        if (written < 0) {
+            buffer->failed = 1;
+            return;
+        }
+        if ((size_t)written < buffer->capacity - buffer->length) {
+            buffer->length += (size_t)written;
+            return;
+        }
+
+        size_t capacity = buffer->capacity * 2 + (size_t)written;
+        char* data = realloc(buffer->data, capacity);
+        if (data == NULL) {
+            buffer->failed = 1;
+            return;
+        }
+        buffer->data = data;
+        buffer->capacity = capacity;
+    }
+}
+
+/**
+ * @brief Appends the HELP and TYPE lines of a metric family.
+ */
+static void append_family(MetricsBuffer* buffer, const char* name, const char* type, const char* help) {
+    append(buffer, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+/**
+ * @brief Appends the stage latency histograms.
+ */
+static void append_latency(MetricsBuffer* buffer) {
+    append_family(buffer, "glucose_stage_latency_seconds", "histogram",
+                  "Latency of controller stages, recorded while latency recording is enabled.");
+
+    for (int s = 0; s < LATENCY_STAGE_COUNT; s++) {
+        uint64_t counts[LATENCY_BOUND_COUNT];
+        uint64_t count;
+        uint64_t total_ns;
+        if (latency_get_histogram((LatencyStage)s, latency_bounds_ns, LATENCY_BOUND_COUNT, counts,
+                                  &count, &total_ns) != 0) {
+            buffer->failed = 1;
+            return;
+        }
+
+        const char* stage = latency_stage_name((LatencyStage)s);
+        for (int b = 0; b < LATENCY_BOUND_COUNT; b++) {
+            append(buffer, "glucose_stage_latency_seconds_bucket{stage=\"%s\",le=\"%g\"} %llu\n", stage,
+                   latency_bounds_ns[b] / 1e9, (unsigned long long)counts[b]);
+        }
+        append(buffer, "glucose_stage_latency_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %llu\n", stage,
+               (unsigned long long)count);
+        append(buffer, "glucose_stage_latency_seconds_sum{stage=\"%s\"} %.9f\n", stage, total_ns / 1e9);
+        append(buffer, "glucose_stage_latency_seconds_count{stage=\"%s\"} %llu\n", stage, (unsigned long long)count);
+    }
+}
+
+/**
+ * @brief Appends the resident and virtual size of the process, from /proc/self/statm.
+ */
+static void append_process_memory(MetricsBuffer* buffer) {
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (statm == NULL) return; // Not Linux; leave the series out
+
+    unsigned long long size_pages = 0;
+    unsigned long long resident_pages = 0;
+    int fields = fscanf(statm, "%llu %llu", &size_pages, &resident_pages);
+    fclose(statm);
+    if (fields != 2) return;
+
+    unsigned long long page_size = (unsigned long long)sysconf(_SC_PAGESIZE);
+    append_family(buffer, "process_resident_memory_bytes", "gauge", "Resident memory size in bytes.");
+    append(buffer, "process_resident_memory_bytes %llu\n", resident_pages * page_size);
+    append_family(buffer, "process_virtual_memory_bytes", "gauge", "Virtual memory size in bytes.");
+    append(buffer, "process_virtual_memory_bytes %llu\n", size_pages * page_size);
+}
+
+/**
+ * @brief Appends patient counts and the pages of a latest-state table.
+ *
+ * Reads every published slot under its seqlock, so a scrape of a large
+ * fleet costs one pass over the table but never stalls the writer.
+ */
+static void append_latest_state(MetricsBuffer* buffer, const LatestStateTable* latest) {
+    uint64_t pages = 0;
+    for (uint32_t p = 0; p < LATEST_STATE_MAX_PAGES; p++) {
+        if (__atomic_load_n(&latest->pages[p], __ATOMIC_ACQUIRE) != NULL) pages++;
+    }
+    append(buffer, "glucose_memory_bytes{area=\"latest_state\"} %llu\n",
+           (unsigned long long)(pages * LATEST_STATE_PAGE_SLOTS * sizeof(LatestStateSlot)));
+
+    uint64_t patients = 0;
+    uint64_t in_alarm[ALARM_TYPE_COUNT] = {0};
+    uint32_t slot_count = latest_state_slot_count(latest);
+    for (uint32_t slot = 0; slot < slot_count; slot++) {
+        LatestState state;
+        if (latest_state_read(latest, slot, &state, NULL) != 0) continue;
+        patients++;
+        for (size_t t = 0; t < ALARM_TYPE_COUNT; t++) in_alarm[t] += (state.alarm_flags & alarm_bits[t]) != 0;
+    }
+
+    append_family(buffer, "glucose_patients", "gauge", "Patients with a published latest state.");
+    append(buffer, "glucose_patients %llu\n", (unsigned long long)patients);
+    append_family(buffer, "glucose_patients_in_alarm", "gauge", "Patients whose latest reading raised each alarm.");
+    for (size_t t = 0; t < ALARM_TYPE_COUNT; t++) {
+        append(buffer, "glucose_patients_in_alarm{type=\"%s\"} %llu\n", alarm_types[t],
+               (unsigned long long)in_alarm[t]);
+    }
+}
+
+/**
+ * @brief Renders every metric in Prometheus text exposition format (version 0.0.4).
+ *
+ * @param latest Pointer to the table to count patients in, or NULL.
+ * @param text Pointer to receive the text, to be freed by the caller.
+ * @param length Pointer to receive the length of the text.
+ * @return 0 on success, -1 on error.
+ */
+int metrics_render(const LatestStateTable* latest, char** text, size_t* length) {
+    if (text == NULL || length == NULL) return -1;
+
+    MetricsBuffer buffer = {malloc(8192), 0, 8192, 0};
+    if (buffer.data == NULL) return -1;
+
+    append_family(&buffer, "glucose_readings_total", "counter", "Readings processed.");
+    append(&buffer, "glucose_readings_total %llu\n", (unsigned long long)metrics_get_counter(METRIC_READINGS));
+    append_family(&buffer, "glucose_readings_rejected_total", "counter",
+                  "Readings dropped (invalid value or registry full).");
+    append(&buffer, "glucose_readings_rejected_total %llu\n",
+           (unsigned long long)metrics_get_counter(METRIC_REJECTED));
+    append_family(&buffer, "glucose_alarms_total", "counter", "Readings that raised each alarm.");
+    for (size_t t = 0; t < ALARM_TYPE_COUNT; t++) {
+        append(&buffer, "glucose_alarms_total{type=\"%s\"} %llu\n", alarm_types[t],
+               (unsigned long long)metrics_get_counter((MetricCounter)(METRIC_ALARM_HYPOGLYCEMIA + t)));
+    }
+
+    append_latency(&buffer);
+
+    append_family(&buffer, "glucose_queue_depth", "gauge", "Entries waiting in the engine's queues.");
+    for (size_t q = 0; q < QUEUE_SERIES_COUNT; q++) {
+        append(&buffer, "glucose_queue_depth{queue=\"%s\"} %llu\n", queue_series[q].queue,
+               (unsigned long long)metrics_get_gauge(queue_series[q].gauge));
+    }
+    append_family(&buffer, "glucose_ingest_connections", "gauge", "Open ingest connections.");
+    append(&buffer, "glucose_ingest_connections %llu\n",
+           (unsigned long long)metrics_get_gauge(METRIC_GAUGE_INGEST_CONNECTIONS));
+
+    append_family(&buffer, "glucose_memory_bytes", "gauge", "Memory held by the engine's patient tables.");
+    append(&buffer, "glucose_memory_bytes{area=\"registry\"} %llu\n",
+           (unsigned long long)metrics_get_gauge(METRIC_GAUGE_REGISTRY_BYTES));
+    if (latest != NULL) append_latest_state(&buffer, latest);
+    append_process_memory(&buffer);
+
+    if (buffer.failed) {
+        free(buffer.data);
+        return -1;
+    }
+    *text = buffer.data;
+    *length = buffer.length;
+    return 0;
+}
+
+/**
+ * @brief Sends a whole buffer, giving up on error or timeout.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int send_all(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent <= 0) return -1;
+        data += sent;
+        length -= (size_t)sent;
+    }
+    return 0;
+}
+
+/**
+ * @brief Sends a response with a plain-text body and closes the exchange.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int send_response(int fd, const char* status, const char* content_type, const char* body, size_t length) {
+    char header[256];
+    int header_length = snprintf(header, sizeof(header),
+                                 "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+                                 status, content_type, length);
+    if (header_length < 0 || (size_t)header_length >= sizeof(header)) return -1;
+    if (send_all(fd, header, (size_t)header_length) != 0) return -1;
+    return send_all(fd, body, length);
+}
+
+/**
+ * @brief Reads one request and answers it.
+ *
+ * Only the request line matters: GET /metrics gets the metrics, any other
+ * path 404 and any other method 405. Headers are read up to
+ * METRICS_REQUEST_MAX bytes and otherwise ignored.
+ */
+static void serve_client(MetricsServer* server, int fd) {
+    struct timeval timeout = {METRICS_TIMEOUT_S, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    char request[METRICS_REQUEST_MAX + 1];
+    size_t length = 0;
+    while (length < METRICS_REQUEST_MAX) {
+        ssize_t received = recv(fd, request + length, METRICS_REQUEST_MAX - length, 0);
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) break;
+        length += (size_t)received;
+        request[length] = '\0';
+        if (strstr(request, "\r\n\r\n") != NULL || strstr(request, "\n\n") != NULL) break;
+    }
+    request[length] = '\0';
+
+    static const char text_type[] = "text/plain; charset=utf-8";
+    if (strncmp(request, "GET ", 4) != 0) {
+        server->stats.bad_requests++;
+        send_response(fd, "405 Method Not Allowed", text_type, "Method not allowed\n", 19);
+        return;
+    }
+
+    // The path ends at a space or a query string
+    const char* path = request + 4;
+    size_t path_length = strcspn(path, " ?\r\n");
+    if (path_length != 8 || strncmp(path, "/metrics", 8) != 0) {
+        server->stats.bad_requests++;
+        send_response(fd, "404 Not Found", text_type, "Not found, try /metrics\n", 24);
+        return;
+    }
+
+    char* text;
+    size_t text_length;
+    if (metrics_render(server->latest, &text, &text_length) != 0) {
+        server->stats.bad_requests++;
+        send_response(fd, "500 Internal Server Error", text_type, "Out of memory\n", 14);
+        return;
+    }
+    send_response(fd, "200 OK", "text/plain; version=0.0.4; charset=utf-8", text, text_length);
+    free(text);
+    server->stats.scrapes++;
+}
+
+/**
+ * @brief Server thread: answers one connection at a time until asked to stop.
+ */
+static void* serve_metrics(void* context) {
+    MetricsServer* server = context;
+    struct pollfd listener = {server->listen_fd, POLLIN, 0};
+
+    while (!__atomic_load_n(&server->stop, __ATOMIC_ACQUIRE)) {
+        int ready = poll(&listener, 1, METRICS_POLL_MS);
+        if (ready <= 0) continue;
+
+        int fd = accept(server->listen_fd, NULL, NULL);
+        if (fd < 0) continue;
+        serve_client(server, fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Starts serving GET /metrics on 127.0.0.1 from a new thread.
+ *
+ * The thread blocks every signal, so SIGINT and SIGTERM keep reaching the
+ * threads that poll for them.
+ *
+ * @param server Pointer to the MetricsServer structure to initialize.
+ * @param port TCP port, or 0 for any free port (see server->port).
+ * @param latest Pointer to the table to count patients in on every scrape, or NULL.
+ * @return 0 on success, -1 on error.
+ */
+int metrics_server_start(MetricsServer* server, uint16_t port, const LatestStateTable* latest) {
+    if (server == NULL) return -1;
+
+    memset(server, 0, sizeof(*server));
+    server->latest = latest;
+    server->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (server->listen_fd < 0) return -1;
+
+    int reuse = 1;
+    setsockopt(server->listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    socklen_t address_length = sizeof(address);
+    if (bind(server->listen_fd, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+        listen(server->listen_fd, METRICS_BACKLOG) != 0 ||
+        getsockname(server->listen_fd, (struct sockaddr*)&address, &address_length) != 0) {
+        close(server->listen_fd);
+        return -1;
+    }
+    server->port = ntohs(address.sin_port);
+
+    sigset_t all;
+    sigset_t previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &previous);
+    int started = pthread_create(&server->thread, NULL, serve_metrics, server) == 0;
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    if (!started) {
+        close(server->listen_fd);
+        return -1;
+    }
+
+    server->running = 1;
+    return 0;
+}
+
+/**
+ * @brief Stops the server thread and closes its socket.
+ *
+ * @param server Pointer to the MetricsServer structure.
+ * @return 0 on success, -1 on error.
+ */
+int metrics_server_stop(MetricsServer* server) {
+    if (server == NULL || !server->running) return -1;
+
+    __atomic_store_n(&server->stop, 1, __ATOMIC_RELEASE);
+    int result = pthread_join(server->thread, NULL) == 0 ? 0 : -1;
+    if (close(server->listen_fd) != 0) result = -1;
+    server->running = 0;
+    return result;
+}
@@ -0,0 +1,384 @@
+/**
+ * @file patient_registry.c
+ * @brief Contains the slab-allocated patient registry.
+ */
+
+#include "../include/patient_registry.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define NO_FREE_SLOT UINT32_MAX
+#define ID_INDEX_MIN_CAPACITY 1024
+
+/**
+ * @brief Returns the slab holding a slot or dense position.
+ */
+static PatientSlab* slab_for(const PatientRegistry* registry, uint32_t index) {
+    return registry->slabs[index / PATIENT_SLAB_CAPACITY];
+}
+
+/**
+ * @brief Allocates one more slab.
+ *
+ * Slabs are zero-filled so every slot starts at generation 0; the kernel
+ * only commits the pages as patients are added.
+ *
+ * @param registry Pointer to the PatientRegistry structure.
+ * @return 0 on success, -1 on error (out of memory or registry full).
+ */
+static int grow(PatientRegistry* registry) {
+    if (registry->slab_count >= PATIENT_REGISTRY_MAX_SLABS) return -1;
+
+    PatientSlab* slab = calloc(1, sizeof(PatientSlab));
+    if (slab == NULL) return -1;
+
+    registry->slabs[registry->slab_count++] = slab;
+    return 0;
+}
+
+/**
+ * @brief Checks that a handle refers to a currently registered patient.
+ *
+ * @return Dense position of the patient, or NO_FREE_SLOT if the handle is stale.
+ */
+static uint32_t resolve(const PatientRegistry* registry, PatientHandle handle) {
+    if (handle.slot >= registry->slot_count) return NO_FREE_SLOT;
+
+    const PatientSlab* slab = slab_for(registry, handle.slot);
+    uint32_t offset = handle.slot % PATIENT_SLAB_CAPACITY;
+    if (slab->slot_generation[offset] != handle.generation) return NO_FREE_SLOT;
+
+    uint32_t dense = slab->slot_to_dense[offset];
+    if (dense >= registry->active_count) return NO_FREE_SLOT;
+    if (slab_for(registry, dense)->dense_to_slot[dense % PATIENT_SLAB_CAPACITY] != handle.slot) {
+        return NO_FREE_SLOT;
+    }
+
+    return dense;
+}
+
+/**
+ * @brief Returns the patient id stored in a slot.
+ */
+static uint32_t slot_patient_id(const PatientRegistry* registry, uint32_t slot) {
+    uint32_t dense = slab_for(registry, slot)->slot_to_dense[slot % PATIENT_SLAB_CAPACITY];
+    return slab_for(registry, dense)->states[dense % PATIENT_SLAB_CAPACITY].patient_id;
+}
+
+/**
+ * @brief Returns the preferred id index position of a patient id.
+ */
+static uint32_t id_index_home(const PatientRegistry* registry, uint32_t patient_id) {
+    // Fibonacci hashing spreads sequential ids across the table
+    return (uint32_t)(patient_id * 2654435761u) & (registry->id_index_capacity - 1);
+}
+
+/**
+ * @brief Finds the id index position holding a patient id.
+ *
+ * @return Table position, or NO_FREE_SLOT if the id is not indexed.
+ */
+static uint32_t id_index_lookup(const PatientRegistry* registry, uint32_t patient_id) {
+    if (registry->id_index == NULL) return NO_FREE_SLOT;
+
+    uint32_t mask = registry->id_index_capacity - 1;
+    for (uint32_t pos = id_index_home(registry, patient_id); ; pos = (pos + 1) & mask) {
+        uint32_t entry = registry->id_index[pos];
+        if (entry == 0) return NO_FREE_SLOT;
+        if (slot_patient_id(registry, entry - 1) == patient_id) return pos;
+    }
+}
+
+/**
+ * @brief Inserts a slot into the id index (the id must not be present).
+ */
+static void id_index_insert(PatientRegistry* registry, uint32_t patient_id, uint32_t slot) {
+    uint32_t mask = registry->id_index_capacity - 1;
+    uint32_t pos = id_index_home(registry, patient_id);
+    while (registry->id_index[pos] != 0) pos = (pos + 1) & mask;
+    registry->id_index[pos] = slot + 1;
+}
+
+/**
+ * @brief Removes the entry at a position, shifting later probes back.
+ *
+ * Backward-shift deletion keeps every probe chain unbroken without
+ * tombstones, so lookups stay short under add/remove churn.
+ */
+static void id_index_erase(PatientRegistry* registry, uint32_t pos) {
+    uint32_t mask = registry->id_index_capacity - 1;
+    uint32_t hole = pos;
+
+    for (uint32_t next = (pos + 1) & mask; registry->id_index[next] != 0; next = (next + 1) & mask) {
+        uint32_t home = id_index_home(registry, slot_patient_id(registry, registry->id_index[next] - 1));
+        // Move the entry into the hole unless its home lies cyclically in (hole, next]
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            registry->id_index[hole] = registry->id_index[next];
+            hole = next;
+        }
+    }
+    registry->id_index[hole] = 0;
+}
+
+/**
+ * @brief Makes room in the id index for one more patient.
+ *
+ * The table is doubled (and every active patient re-inserted) whenever it
+ * would become more than half full.
+ *
+ * @return 0 on success, -1 on error (out of memory).
+ */
+static int id_index_reserve(PatientRegistry* registry, uint32_t patient_count) {
+    if ((uint64_t)patient_count * 2 <= registry->id_index_capacity) return 0;
+
+    uint32_t capacity = registry->id_index_capacity ? registry->id_index_capacity : ID_INDEX_MIN_CAPACITY;
+    while ((uint64_t)patient_count * 2 > capacity) capacity *= 2;
+
+    uint32_t* table = calloc(capacity, sizeof(uint32_t));
+    if (table == NULL) return -1;
+
+    free(registry->id_index);
+    registry->id_index = table;
+    registry->id_index_capacity = capacity;
+
+    for (uint32_t dense = 0; dense < registry->active_count; dense++) {
+        const PatientSlab* slab = slab_for(registry, dense);
+        id_index_insert(registry, slab->states[dense % PATIENT_SLAB_CAPACITY].patient_id,
+                        slab->dense_to_slot[dense % PATIENT_SLAB_CAPACITY]);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Initializes an empty registry.
+ *
+ * @param registry Pointer to the PatientRegistry structure to initialize.
+ * @return 0 on success, -1 on error.
+ */
+int patient_registry_init(PatientRegistry* registry) {
+    if (registry == NULL) return -1;
+
+    memset(registry, 0, sizeof(*registry));
+    registry->free_slot = NO_FREE_SLOT;
+
+    return 0;
+}
+
+/**
+ * @brief Releases every slab owned by the registry.
+ *
+ * @param registry Pointer to the PatientRegistry structure to destroy.
+ * @return 0 on success, -1 on error.
+ */
+int patient_registry_destroy(PatientRegistry* registry) {
+    if (registry == NULL) return -1;
+
+    for (uint32_t i = 0; i < registry->slab_count; i++) {
+        free(registry->slabs[i]);
+    }
+    free(registry->id_index);
+
+    return patient_registry_init(registry);
+}
+
+/**
+ * @brief Preallocates slabs for at least the given number of patients.
+ *
+ * @param registry Pointer to the PatientRegistry structure.
+ * @param patient_count Number of patients to reserve room for.
+ * @return 0 on success, -1 on error.
+ */
+int patient_registry_reserve(PatientRegistry* registry, uint32_t patient_count) {
+    if (registry == NULL) return -1;
+
+    while ((uint64_t)registry->slab_count * PATIENT_SLAB_CAPACITY < patient_count) {
+        if (grow(registry) != 0) return -1;
+    }
+
+    return id_index_reserve(registry, patient_count);
+}
+
+/**
+ * @brief Registers a patient in O(1), reusing a freed slot if one exists.
+ *
+ * Freed slots form an intrusive list threaded through slot_to_dense, so
+ * the only allocations are a new slab when every existing slot is in use
+ * and the occasional doubling of the id index.
+ *
+ * @param registry Pointer to the PatientRegistry structure.
+ * @param patient_id External patient identifier, unique within the registry.
+ * @param config Pointer to the thresholds to use for this patient.
+ * @param handle Pointer to receive the patient's handle.
+ * @return 0 on success, -1 on error (invalid arguments, duplicate id or registry full).
+ */
+int patient_registry_add(PatientRegistry* registry, uint32_t patient_id,
+                         const Config* config, PatientHandle* handle) {
+    if (registry == NULL || config == NULL || handle == NULL) return -1;
+    if (id_index_lookup(registry, patient_id) != NO_FREE_SLOT) return -1;
+    if (id_index_reserve(registry, registry->active_count + 1) != 0) return -1;
+
+    uint32_t slot;
+    if (registry->free_slot != NO_FREE_SLOT) {
+        slot = registry->free_slot;
+        registry->free_slot = slab_for(registry, slot)->slot_to_dense[slot % PATIENT_SLAB_CAPACITY];
+    } else {
+        if (registry->slot_count >= registry->slab_count * PATIENT_SLAB_CAPACITY &&
+            grow(registry) != 0) {
+            return -1;
+        }
+        slot = registry->slot_count++;
+    }
+
+    uint32_t dense = registry->active_count++;
+    PatientSlab* dense_slab = slab_for(registry, dense);
+    PatientState* state = &dense_slab->states[dense % PATIENT_SLAB_CAPACITY];
+
+    memset(state, 0, sizeof(*state));
+    state->patient_id = patient_id;
+    state->config = *config;
+    initialize_glucose_statistics(&state->stats);
+
+    PatientSlab* slot_slab = slab_for(registry, slot);
+    dense_slab->dense_to_slot[dense % PATIENT_SLAB_CAPACITY] = slot;
+    slot_slab->slot_to_dense[slot % PATIENT_SLAB_CAPACITY] = dense;
+
+    handle->slot = slot;
+    handle->generation = slot_slab->slot_generation[slot % PATIENT_SLAB_CAPACITY];
+
+    id_index_insert(registry, patient_id, slot);
+
+    return 0;
+}
+
+/**
+ * @brief Unregisters a patient in O(1).
+ *
+ * The last active patient is moved into the freed dense position and its
+ * slot is repointed, then the freed slot's generation is bumped so any
+ * outstanding handle to it becomes stale.
+ *
+ * @param registry Pointer to the PatientRegistry structure.
+ * @param handle Handle of the patient to remove.
+ * @return 0 on success, -1 on error (invalid or stale handle).
+ */
+int patient_registry_remove(PatientRegistry* registry, PatientHandle handle) {
+    if (registry == NULL) return -1;
+
+    uint32_t dense = resolve(registry, handle);
+    if (dense == NO_FREE_SLOT) return -1;
+
+    // Unindex while the slot still maps to the patient being removed
+    uint32_t patient_id = slab_for(registry, dense)->states[dense % PATIENT_SLAB_CAPACITY].patient_id;
+    id_index_erase(registry, id_index_lookup(registry, patient_id));
+
+    uint32_t last = registry->active_count - 1;
+    if (dense != last) {
+        PatientSlab* dense_slab = slab_for(registry, dense);
+        PatientSlab* last_slab = slab_for(registry, last);
+        uint32_t moved_slot = last_slab->dense_to_slot[last % PATIENT_SLAB_CAPACITY];
+
+        dense_slab->states[dense % PATIENT_SLAB_CAPACITY] = last_slab->states[last % PATIENT_SLAB_CAPACITY];
+        dense_slab->dense_to_slot[dense % PATIENT_SLAB_CAPACITY] = moved_slot;
+        slab_for(registry, moved_slot)->slot_to_dense[moved_slot % PATIENT_SLAB_CAPACITY] = dense;
+    }
+    registry->active_count--;
+
+    PatientSlab* slot_slab = slab_for(registry, handle.slot);
+    slot_slab->slot_generation[handle.slot % PATIENT_SLAB_CAPACITY]++;
+    slot_slab->slot_to_dense[handle.slot % PATIENT_SLAB_CAPACITY] = registry->free_slot;
+    registry->free_slot = handle.slot;
+
+    return 0;
+}
+
+/**
+ * @brief Looks up a patient's state by handle.
+ *
+ * @param registry Pointer to the PatientRegistry structure.
+ * @param handle Handle returned by patient_registry_add().
+ * @return Pointer to the patient's state, or NULL if the handle is stale.
+ */
+PatientState* patient_registry_get(PatientRegistry* registry, PatientHandle handle) {
+    if (registry == NULL) return NULL;
+
+    uint32_t dense = resolve(registry, handle);
+    if (dense == NO_FREE_SLOT) return NULL;
+
+    return &slab_for(registry, dense)->states[dense % PATIENT_SLAB_CAPACITY];
+}
+
+/**
+ * @brief Looks up a patient's state by external identifier.
+ *
+ * @param registry Pointer to the PatientRegistry structure.
+ * @param patient_id External patient identifier.
+ * @param index Optional pointer to receive the patient's dense position.
+ * @return Pointer to the patient's state, or NULL if the id is not registered.
+ */
+PatientState* patient_registry_find(PatientRegistry* registry, uint32_t patient_id, uint32_t* index) {
+    if (registry == NULL) return NULL;
+
+    uint32_t pos = id_index_lookup(registry, patient_id);
+    if (pos == NO_FREE_SLOT) return NULL;
+
+    uint32_t slot = registry->id_index[pos] - 1;
+    uint32_t dense = slab_for(registry, slot)->slot_to_dense[slot % PATIENT_SLAB_CAPACITY];
+    if (index != NULL) *index = dense;
+
+    return &slab_for(registry, dense)->states[dense % PATIENT_SLAB_CAPACITY];
+}
+
+/**
+ * @brief Returns the patient at a dense position for iteration.
+ *
+ * @param registry Pointer to the PatientRegistry structure.
+ * @param index Dense position.
+ * @return Pointer to the patient's state, or NULL if out of range.
+ */
+PatientState* patient_registry_at(PatientRegistry* registry, uint32_t index) {
+    if (registry == NULL || index >= registry->active_count) return NULL;
+
+    return &slab_for(registry, index)->states[index % PATIENT_SLAB_CAPACITY];
+}
+
+/**
+ * @brief Returns the handle of the patient at a dense position.
+ *
+ * @param registry Pointer to the PatientRegistry structure.
+ * @param index Dense position.
+ * @param handle Pointer to receive the patient's handle.
+ * @return 0 on success, -1 on error (out of range).
+ */
+int patient_registry_handle_at(const PatientRegistry* registry, uint32_t index, PatientHandle* handle) {
+    if (registry == NULL || handle == NULL || index >= registry->active_count) return -1;
+
+    uint32_t slot = slab_for(registry, index)->dense_to_slot[index % PATIENT_SLAB_CAPACITY];
+    handle->slot = slot;
+    handle->generation = slab_for(registry, slot)->slot_generation[slot % PATIENT_SLAB_CAPACITY];
+
+    return 0;
+}
+
+/**
+ * @brief Returns the number of registered patients.
+ *
+ * @param registry Pointer to the PatientRegistry structure.
+ * @return Number of registered patients (0 if registry is NULL).
+ */
+uint32_t patient_registry_count(const PatientRegistry* registry) {
+    if (registry == NULL) return 0;
+    return registry->active_count;
+}
+
+/**
+ * @brief Returns the memory currently held by the registry.
+ *
+ * @param registry Pointer to the PatientRegistry structure.
+ * @return Bytes used by the registry, its slabs and its id index.
+ */
+size_t patient_registry_memory_bytes(const PatientRegistry* registry) {
+    if (registry == NULL) return 0;
+    return sizeof(*registry) + (size_t)registry->slab_count * sizeof(PatientSlab) +
+           (size_t)registry->id_index_capacity * sizeof(uint32_t);
+}
@@ -0,0 +1,405 @@
+/**
+ * @file reading_archive.c
+ * @brief Contains the block-indexed reading archive writer and index reader.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../include/reading_archive.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CHECKSUM_SEED 1469598103934665603ull
+
+/**
+ * @brief Extends an FNV-1a style checksum over 64-bit words.
+ *
+ * @param hash Checksum so far (CHECKSUM_SEED to start).
+ * @param data Data to checksum; length must be a multiple of 8.
+ * @param length Length in bytes.
+ * @return Checksum.
+ */
+static uint64_t checksum_continue(uint64_t hash, const void* data, size_t length) {
+    const uint8_t* bytes = data;
+
+    for (size_t offset = 0; offset + 8 <= length; offset += 8) {
+        uint64_t word;
+        memcpy(&word, bytes + offset, sizeof(word));
+        hash ^= word;
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+/**
+ * @brief Computes the checksum of an index entry's fields before the checksum.
+ */
+static uint64_t entry_checksum(const ArchiveBlockIndex* entry) {
+    return checksum_continue(CHECKSUM_SEED, entry, offsetof(ArchiveBlockIndex, checksum));
+}
+
+/**
+ * @brief Writes a whole buffer at a file offset, retrying on partial writes.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int pwrite_all(int fd, const void* data, size_t length, uint64_t offset) {
+    const uint8_t* cursor = data;
+
+    while (length > 0) {
+        ssize_t written = pwrite(fd, cursor, length, (off_t)offset);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return -1;
+        cursor += written;
+        offset += (uint64_t)written;
+        length -= (size_t)written;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Returns the shard holding a patient's readings.
+ *
+ * @param patient_id External patient identifier.
+ * @return Shard number, 0 .. ARCHIVE_SHARDS - 1.
+ */
+uint32_t reading_archive_shard(uint32_t patient_id) {
+    // Fibonacci hashing spreads sequential ids across the shards
+    return (uint32_t)(patient_id * 2654435761u) >> 26;
+}
+
+typedef char archive_shard_bits_check[ARCHIVE_SHARDS == 64 ? 1 : -1]; // The shift above takes 6 bits
+
+/**
+ * @brief Builds the path of a shard's data or index file.
+ *
+ * @param directory Archive directory.
+ * @param shard Shard number.
+ * @param index Non-zero for the index file, zero for the data file.
+ * @param path Buffer of ARCHIVE_PATH_MAX bytes to receive the path.
+ * @return 0 on success, -1 on error (path too long).
+ */
+int reading_archive_path(const char* directory, uint32_t shard, int index, char* path) {
+    if (directory == NULL || path == NULL) return -1;
+    int length = snprintf(path, ARCHIVE_PATH_MAX, "%s/shard-%02u.%s", directory, shard, index ? "idx" : "dat");
+    return (length < 0 || length >= ARCHIVE_PATH_MAX) ? -1 : 0;
+}
+
+/**
+ * @brief Computes the checksum of a block payload.
+ *
+ * @param payload Pointer to the payload.
+ * @param length Payload bytes, a multiple of 8.
+ * @return Checksum.
+ */
+uint64_t reading_archive_checksum(const void* payload, size_t length) {
+    return checksum_continue(CHECKSUM_SEED, payload, length);
+}
+
+/**
+ * @brief Returns where a column starts in a block payload.
+ *
+ * Payloads hold uint32_t patient ids, uint32_t time offsets and
+ * GlucoseFixed values, count of each, in that order.
+ *
+ * @param count Readings in the block.
+ * @param column 0 = patient ids, 1 = time offsets, 2 = values.
+ * @return Byte offset of the column.
+ */
+size_t reading_archive_column_offset(uint32_t count, int column) {
+    return (size_t)column * count * sizeof(uint32_t);
+}
+
+/**
+ * @brief Returns the size of a block payload.
+ *
+ * @param count Readings in the block.
+ * @return Payload bytes, padded to a multiple of 8.
+ */
+size_t reading_archive_payload_bytes(uint32_t count) {
+    return ((size_t)count * ARCHIVE_READING_BYTES + 7) & ~(size_t)7;
+}
+
+/**
+ * @brief Reads and validates a shard's block index.
+ *
+ * Entries after the first invalid one, or past the end of the data file,
+ * are not returned.
+ *
+ * @param directory Archive directory.
+ * @param shard Shard number.
+ * @param entries Pointer to receive a malloc'ed array of entries (NULL if none).
+ * @param count Pointer to receive the number of entries.
+ * @return 0 on success (a missing shard has no entries), -1 on error.
+ */
+int reading_archive_load_index(const char* directory, uint32_t shard, ArchiveBlockIndex** entries, uint32_t* count) {
+    if (directory == NULL || entries == NULL || count == NULL || shard >= ARCHIVE_SHARDS) return -1;
+    *entries = NULL;
+    *count = 0;
+
+    char index_path[ARCHIVE_PATH_MAX], data_path[ARCHIVE_PATH_MAX];
+    if (reading_archive_path(directory, shard, 1, index_path) != 0 ||
+        reading_archive_path(directory, shard, 0, data_path) != 0) return -1;
+
+    struct stat data_stat;
+    if (stat(data_path, &data_stat) != 0) return errno == ENOENT ? 0 : -1;
+
+    int fd = open(index_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return errno == ENOENT ? 0 : -1;
+
+    struct stat index_stat;
+    if (fstat(fd, &index_stat) != 0) {
+        close(fd);
+        return -1;
+    }
+    size_t capacity = (size_t)index_stat.st_size / sizeof(ArchiveBlockIndex);
+    if (capacity == 0) {
+        close(fd);
+        return 0;
+    }
+
+    ArchiveBlockIndex* loaded = malloc(capacity * sizeof(ArchiveBlockIndex));
+    if (loaded == NULL) {
+        close(fd);
+        return -1;
+    }
+    size_t bytes = 0;
+    while (bytes < capacity * sizeof(ArchiveBlockIndex)) {
+        ssize_t got = pread(fd, (uint8_t*)loaded + bytes, capacity * sizeof(ArchiveBlockIndex) - bytes, (off_t)bytes);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) break;
+        bytes += (size_t)got;
+    }
+    close(fd);
+
+    // Keep the entries that are intact and whose payload was fully written
+    uint32_t valid = 0;
+    uint64_t expected_offset = 0;
+    for (size_t i = 0; i < bytes / sizeof(ArchiveBlockIndex); i++) {
+        const ArchiveBlockIndex* entry = &loaded[i];
+        if (entry->checksum != entry_checksum(entry) || entry->offset != expected_offset) break;
+        expected_offset += reading_archive_payload_bytes(entry->count);
+        if (expected_offset > (uint64_t)data_stat.st_size) break;
+        valid++;
+    }
+
+    if (valid == 0) {
+        free(loaded);
+        return 0;
+    }
+    *entries = loaded;
+    *count = valid;
+    return 0;
+}
+
+/**
+ * @brief Opens a shard's files for appending, dropping anything after its last intact block.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int open_shard(const char* directory, uint32_t number, ArchiveShard* shard) {
+    ArchiveBlockIndex* entries;
+    uint32_t count;
+    if (reading_archive_load_index(directory, number, &entries, &count) != 0) return -1;
+    shard->data_size = count > 0 ? entries[count - 1].offset + reading_archive_payload_bytes(entries[count - 1].count) : 0;
+    shard->index_size = (uint64_t)count * sizeof(ArchiveBlockIndex);
+    free(entries);
+
+    char data_path[ARCHIVE_PATH_MAX], index_path[ARCHIVE_PATH_MAX];
+    if (reading_archive_path(directory, number, 0, data_path) != 0 ||
+        reading_archive_path(directory, number, 1, index_path) != 0) return -1;
+
+    shard->data_fd = open(data_path, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    shard->index_fd = open(index_path, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (shard->data_fd < 0 || shard->index_fd < 0) return -1;
+
+    // Writes continue right after the last block the index vouches for
+    if (ftruncate(shard->data_fd, (off_t)shard->data_size) != 0 ||
+        ftruncate(shard->index_fd, (off_t)shard->index_size) != 0) return -1;
+    return 0;
+}
+
+/**
+ * @brief Opens or creates an archive directory for appending.
+ *
+ * @param archive Pointer to the ReadingArchive structure to initialize.
+ * @param directory Archive directory; created if missing.
+ * @return 0 on success, -1 on error.
+ */
+int reading_archive_open(ReadingArchive* archive, const char* directory) {
+    if (archive == NULL || directory == NULL) return -1;
+    if (strlen(directory) >= sizeof(archive->directory)) return -1;
+
+    memset(archive, 0, sizeof(*archive));
+    strcpy(archive->directory, directory);
+    if (mkdir(directory, 0755) != 0 && errno != EEXIST) return -1;
+
+    archive->shards = calloc(ARCHIVE_SHARDS, sizeof(ArchiveShard));
+    archive->payload = malloc(reading_archive_payload_bytes(ARCHIVE_BLOCK_READINGS));
+    if (archive->shards == NULL || archive->payload == NULL) {
+        free(archive->shards);
+        free(archive->payload);
+        return -1;
+    }
+    for (uint32_t i = 0; i < ARCHIVE_SHARDS; i++) {
+        archive->shards[i].data_fd = -1;
+        archive->shards[i].index_fd = -1;
+    }
+
+    for (uint32_t i = 0; i < ARCHIVE_SHARDS; i++) {
+        if (open_shard(directory, i, &archive->shards[i]) != 0) {
+            reading_archive_close(archive);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Writes a shard's buffered readings as one block and its index entry.
+ *
+ * Both are written at the shard's valid sizes, which only advance once
+ * the block is complete, so the next block overwrites whatever a failed
+ * write left behind. The buffer is emptied either way.
+ *
+ * @return 0 on success, -1 on error (the block's readings are dropped).
+ */
+static int write_block(ReadingArchive* archive, ArchiveShard* shard) {
+    uint32_t count = shard->count;
+    if (count == 0) return 0;
+    shard->count = 0;
+
+    ArchiveBlockIndex entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.offset = shard->data_size;
+    entry.count = count;
+    entry.min_patient_id = UINT32_MAX;
+    entry.min_value = GLUCOSE_FIXED_MAX;
+    entry.min_time = INT64_MAX;
+    entry.max_time = INT64_MIN;
+    for (uint32_t i = 0; i < count; i++) {
+        if (shard->patient_id[i] < entry.min_patient_id) entry.min_patient_id = shard->patient_id[i];
+        if (shard->patient_id[i] > entry.max_patient_id) entry.max_patient_id = shard->patient_id[i];
+        if (shard->value[i] < entry.min_value) entry.min_value = shard->value[i];
+        if (shard->value[i] > entry.max_value) entry.max_value = shard->value[i];
+        if (shard->time[i] < entry.min_time) entry.min_time = shard->time[i];
+        if (shard->time[i] > entry.max_time) entry.max_time = shard->time[i];
+    }
+    if (entry.max_time - entry.min_time > (int64_t)UINT32_MAX) { // Offsets would not fit
+        archive->stats.dropped += count;
+        return -1;
+    }
+
+    // Columnar payload: ids, time offsets, values
+    uint8_t* payload = archive->payload;
+    size_t bytes = reading_archive_payload_bytes(count);
+    memset(payload + bytes - 8, 0, 8); // Padding
+    uint32_t* ids = (uint32_t*)(payload + reading_archive_column_offset(count, 0));
+    uint32_t* offsets = (uint32_t*)(payload + reading_archive_column_offset(count, 1));
+    GlucoseFixed* values = (GlucoseFixed*)(payload + reading_archive_column_offset(count, 2));
+    for (uint32_t i = 0; i < count; i++) {
+        ids[i] = shard->patient_id[i];
+        offsets[i] = (uint32_t)(shard->time[i] - entry.min_time);
+        values[i] = shard->value[i];
+    }
+    entry.payload_checksum = reading_archive_checksum(payload, bytes);
+    entry.checksum = entry_checksum(&entry);
+
+    // The payload goes first, so an index entry never points at missing data
+    if (pwrite_all(shard->data_fd, payload, bytes, shard->data_size) != 0 ||
+        pwrite_all(shard->index_fd, &entry, sizeof(entry), shard->index_size) != 0) {
+        archive->stats.dropped += count;
+        return -1;
+    }
+
+    shard->data_size += bytes;
+    shard->index_size += sizeof(entry);
+    archive->stats.blocks++;
+    archive->stats.bytes_written += bytes + sizeof(entry);
+    return 0;
+}
+
+/**
+ * @brief Buffers a reading, writing its shard's block when the block is full.
+ *
+ * @param archive Pointer to the ReadingArchive structure.
+ * @param patient_id External patient identifier.
+ * @param reading_time Time of the reading.
+ * @param value Reading in fixed point.
+ * @return 0 on success, -1 on error.
+ */
+int reading_archive_append(ReadingArchive* archive, uint32_t patient_id, time_t reading_time, GlucoseFixed value) {
+    if (archive == NULL || archive->shards == NULL) return -1;
+
+    int64_t time = (int64_t)reading_time;
+    if (time < 0 || time >= ARCHIVE_TIME_LIMIT) {
+        archive->stats.rejected++;
+        return -1;
+    }
+
+    ArchiveShard* shard = &archive->shards[reading_archive_shard(patient_id)];
+    int result = 0;
+    if (shard->count > 0 &&
+        (time - shard->min_time > (int64_t)UINT32_MAX || shard->max_time - time > (int64_t)UINT32_MAX)) {
+        result = write_block(archive, shard);
+    }
+    if (shard->count == 0 || time < shard->min_time) shard->min_time = time;
+    if (shard->count == 0 || time > shard->max_time) shard->max_time = time;
+
+    shard->patient_id[shard->count] = patient_id;
+    shard->time[shard->count] = time;
+    shard->value[shard->count] = value;
+    shard->count++;
+    archive->stats.readings++;
+
+    if (shard->count == ARCHIVE_BLOCK_READINGS && write_block(archive, shard) != 0) result = -1;
+    return result;
+}
+
+/**
+ * @brief Writes every partly filled block, e.g. periodically or before a scan.
+ *
+ * @param archive Pointer to the ReadingArchive structure.
+ * @return 0 on success, -1 on error.
+ */
+int reading_archive_flush(ReadingArchive* archive) {
+    if (archive == NULL || archive->shards == NULL) return -1;
+
+    int result = 0;
+    for (uint32_t i = 0; i < ARCHIVE_SHARDS; i++) {
+        if (write_block(archive, &archive->shards[i]) != 0) result = -1;
+    }
+    return result;
+}
+
+/**
+ * @brief Flushes the archive and closes its files.
+ *
+ * @param archive Pointer to the ReadingArchive structure to close.
+ * @return 0 on success, -1 on error.
+ */
+int reading_archive_close(ReadingArchive* archive) {
+    if (archive == NULL) return -1;
+    if (archive->shards == NULL) return 0;
+
+    int result = 0;
+    for (uint32_t i = 0; i < ARCHIVE_SHARDS; i++) {
+        ArchiveShard* shard = &archive->shards[i];
+        if (shard->data_fd >= 0 && shard->index_fd >= 0 && write_block(archive, shard) != 0) result = -1;
+        if (shard->data_fd >= 0) close(shard->data_fd);
+        if (shard->index_fd >= 0) close(shard->index_fd);
+    }
+    free(archive->shards);
+    free(archive->payload);
+    archive->shards = NULL;
+    archive->payload = NULL;
+    return result;
+}
@@ -0,0 +1,201 @@
+/**
+ * @file resampler.c
+ * @brief Contains the streaming resampler of readings onto a fixed time grid.
+ */
+
+#include "../include/resampler.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Returns the first grid point at or after a time.
+ */
+static int64_t grid_ceil(int64_t time, uint32_t interval) {
+    int64_t remainder = time % (int64_t)interval;
+    if (remainder < 0) remainder += interval;
+    return remainder == 0 ? time : time - remainder + interval;
+}
+
+/**
+ * @brief Makes sure the resampler has a series for a slot.
+ *
+ * @return 0 on success, -1 if out of memory.
+ */
+static int ensure_slot(Resampler* resampler, uint32_t slot) {
+    if (slot < resampler->capacity) return 0;
+
+    uint32_t capacity = resampler->capacity > 0 ? resampler->capacity : 1024;
+    while (capacity <= slot) capacity *= 2;
+    ResampledSeries* series = realloc(resampler->series, capacity * sizeof(ResampledSeries));
+    if (series == NULL) return -1;
+    memset(series + resampler->capacity, 0, (capacity - resampler->capacity) * sizeof(ResampledSeries));
+    resampler->series = series;
+    resampler->capacity = capacity;
+    return 0;
+}
+
+/**
+ * @brief Appends one grid point, dropping the older half of the series first if it is full.
+ */
+static void append_point(ResampledSeries* series, const ResamplerOptions* options, double value, uint64_t valid) {
+    uint32_t window = options->window_points;
+    if (series->count == 2 * window) {
+        // The window is a multiple of 64, so the bitmap moves by whole words
+        memmove(series->values, series->values + window, window * sizeof(double));
+        memmove(series->valid, series->valid + window / 64, window / 64 * sizeof(uint64_t));
+        series->start_time += (int64_t)window * options->interval;
+        series->count = window;
+    }
+
+    uint32_t index = series->count++;
+    uint64_t bit = UINT64_C(1) << (index % 64);
+    series->values[index] = value;
+    series->valid[index / 64] = (series->valid[index / 64] & ~bit) | (valid ? bit : 0);
+}
+
+/**
+ * @brief Returns the default options: a 5-minute grid and a 20-minute gap limit.
+ *
+ * @return ResamplerOptions structure with default values.
+ */
+ResamplerOptions resampler_default_options(void) {
+    ResamplerOptions options;
+    options.interval = RESAMPLER_DEFAULT_INTERVAL;
+    options.max_gap = RESAMPLER_DEFAULT_MAX_GAP;
+    options.window_points = RESAMPLER_DEFAULT_WINDOW;
+    return options;
+}
+
+/**
+ * @brief Initializes an empty resampler.
+ *
+ * @param resampler Pointer to the Resampler structure to initialize.
+ * @param options Pointer to the grid and gap limit; interval and window_points must not be 0.
+ * @return 0 on success, -1 on error.
+ */
+int resampler_init(Resampler* resampler, const ResamplerOptions* options) {
+    if (resampler == NULL || options == NULL || options->interval == 0 || options->window_points == 0 ||
+        options->window_points > UINT32_MAX / 4) {
+        return -1;
+    }
+
+    memset(resampler, 0, sizeof(*resampler));
+    resampler->options = *options;
+    resampler->options.window_points = (options->window_points + 63) / 64 * 64;
+    return 0;
+}
+
+/**
+ * @brief Frees every series.
+ *
+ * @param resampler Pointer to the Resampler structure to destroy.
+ * @return 0 on success, -1 on error.
+ */
+int resampler_destroy(Resampler* resampler) {
+    if (resampler == NULL) return -1;
+
+    for (uint32_t i = 0; i < resampler->capacity; i++) {
+        free(resampler->series[i].values);
+        free(resampler->series[i].valid);
+    }
+    free(resampler->series);
+    memset(resampler, 0, sizeof(*resampler));
+    return 0;
+}
+
+/**
+ * @brief Adds a patient's reading and completes the grid points up to it.
+ *
+ * Every grid point after the previous reading and at or before this one
+ * is interpolated between the two, or marked missing if they are more
+ * than max_gap apart. The first reading of a series, or the first after
+ * a gap longer than its window, starts the series at the next grid point.
+ *
+ * @param resampler Pointer to the Resampler structure.
+ * @param slot Series to update, usually the patient's registry slot.
+ * @param patient_id Patient the reading belongs to.
+ * @param timestamp Time of the reading.
+ * @param value Reading in mg/dL.
+ * @return Number of grid points completed (possibly 0), or -1 on error or rejection.
+ */
+long resampler_add(Resampler* resampler, uint32_t slot, uint32_t patient_id, time_t timestamp, double value) {
+    if (resampler == NULL || patient_id == 0) return -1;
+    if (!(value > 0.0) || ensure_slot(resampler, slot) != 0) {
+        resampler->stats.rejected++;
+        return -1;
+    }
+
+    const ResamplerOptions* options = &resampler->options;
+    ResampledSeries* series = &resampler->series[slot];
+    int64_t time = (int64_t)timestamp;
+
+    // Arrays are allocated on the patient's first reading and kept when the slot is reused
+    if (series->values == NULL) {
+        series->values = malloc(2 * (size_t)options->window_points * sizeof(double));
+        series->valid = calloc(2 * (size_t)options->window_points / 64, sizeof(uint64_t));
+        if (series->values == NULL || series->valid == NULL) {
+            free(series->values);
+            free(series->valid);
+            series->values = NULL;
+            series->valid = NULL;
+            resampler->stats.rejected++;
+            return -1;
+        }
+    }
+
+    int restart = series->patient_id != patient_id;
+    if (!restart && time <= series->last_time) {
+        resampler->stats.rejected++;
+        return -1;
+    }
+
+    // Grid points from next up to the reading are completed by it
+    int64_t next = series->start_time + (int64_t)series->count * options->interval;
+    int64_t gap = time - series->last_time;
+    uint64_t due = !restart && next <= time ? (uint64_t)((time - next) / options->interval) + 1 : 0;
+    if (!restart && gap > (int64_t)options->max_gap && due > 2 * (uint64_t)options->window_points) {
+        // Nothing but missing points would be kept; start over instead
+        restart = 1;
+        resampler->stats.restarts++;
+    }
+
+    long produced = 0;
+    if (restart) {
+        series->patient_id = patient_id;
+        series->count = 0;
+        series->start_time = grid_ceil(time, options->interval);
+        if (series->start_time == time) {
+            append_point(series, options, value, 1);
+            produced = 1;
+        }
+    } else {
+        uint64_t bridged = gap <= (int64_t)options->max_gap;
+        double slope = (value - series->last_value) / (double)gap;
+        for (uint64_t i = 0; i < due; i++, next += options->interval) {
+            double point = series->last_value + slope * (double)(next - series->last_time);
+            append_point(series, options, next == time ? value : point, bridged);
+        }
+        produced = (long)due;
+        resampler->stats.missing += bridged ? 0 : due;
+    }
+
+    series->last_time = time;
+    series->last_value = value;
+    resampler->stats.readings++;
+    resampler->stats.points += (uint64_t)produced;
+    return produced;
+}
+
+/**
+ * @brief Returns a patient's resampled series.
+ *
+ * @param resampler Pointer to the Resampler structure.
+ * @param slot Series to return.
+ * @return Pointer to the series, or NULL if the slot has none.
+ */
+const ResampledSeries* resampler_series(const Resampler* resampler, uint32_t slot) {
+    if (resampler == NULL || slot >= resampler->capacity) return NULL;
+
+    const ResampledSeries* series = &resampler->series[slot];
+    return series->patient_id != 0 && series->values != NULL ? series : NULL;
+}
@@ -0,0 +1,355 @@
+/**
+ * @file risk_index.c
+ * @brief Contains the indexed heaps behind the "patients at risk" rankings.
+ */
+
+#include "../include/risk_index.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define RISK_INDEX_MIN_CAPACITY 1024
+#define RISK_TBR_WINDOW_S 86400 // Time below range is ranked over the last day of rollups
+
+/**
+ * @brief Reports whether entry a ranks above entry b.
+ */
+static int ranks_above(const RiskEntry* a, const RiskEntry* b) {
+    if (a->score != b->score) return a->score > b->score;
+    return a->patient_id < b->patient_id;
+}
+
+/**
+ * @brief Stores an entry at a heap position and records where it went.
+ */
+static void place(RiskIndex* index, uint32_t at, RiskEntry entry) {
+    index->heap[at] = entry;
+    index->position[entry.slot] = at + 1;
+}
+
+/**
+ * @brief Moves the entry at a heap position up until its parent ranks above it.
+ */
+static void sift_up(RiskIndex* index, uint32_t at) {
+    RiskEntry entry = index->heap[at];
+    while (at > 0) {
+        uint32_t parent = (at - 1) / 2;
+        if (!ranks_above(&entry, &index->heap[parent])) break;
+        place(index, at, index->heap[parent]);
+        at = parent;
+    }
+    place(index, at, entry);
+}
+
+/**
+ * @brief Moves the entry at a heap position down until it ranks above its children.
+ */
+static void sift_down(RiskIndex* index, uint32_t at) {
+    RiskEntry entry = index->heap[at];
+    for (;;) {
+        uint32_t child = 2 * at + 1;
+        if (child >= index->count) break;
+        if (child + 1 < index->count && ranks_above(&index->heap[child + 1], &index->heap[child])) child++;
+        if (!ranks_above(&index->heap[child], &entry)) break;
+        place(index, at, index->heap[child]);
+        at = child;
+    }
+    place(index, at, entry);
+}
+
+/**
+ * @brief Grows the position table so it covers a slot.
+ *
+ * @return 0 on success, -1 on error (out of memory).
+ */
+static int cover_slot(RiskIndex* index, uint32_t slot) {
+    if (slot < index->position_capacity) return 0;
+
+    uint32_t capacity = index->position_capacity > 0 ? index->position_capacity : RISK_INDEX_MIN_CAPACITY;
+    while (capacity <= slot) capacity *= 2;
+    uint32_t* position = realloc(index->position, (size_t)capacity * sizeof(uint32_t));
+    if (position == NULL) return -1;
+
+    memset(position + index->position_capacity, 0,
+           (size_t)(capacity - index->position_capacity) * sizeof(uint32_t));
+    index->position = position;
+    index->position_capacity = capacity;
+    return 0;
+}
+
+/**
+ * @brief Initializes an empty ranking.
+ *
+ * @param index Pointer to the RiskIndex structure to initialize.
+ * @return 0 on success, -1 on error.
+ */
+int risk_index_init(RiskIndex* index) {
+    if (index == NULL) return -1;
+    memset(index, 0, sizeof(*index));
+    return 0;
+}
+
+/**
+ * @brief Releases the heap and position table of a ranking.
+ *
+ * @param index Pointer to the RiskIndex structure to destroy.
+ * @return 0 on success, -1 on error.
+ */
+int risk_index_destroy(RiskIndex* index) {
+    if (index == NULL) return -1;
+    free(index->heap);
+    free(index->position);
+    memset(index, 0, sizeof(*index));
+    return 0;
+}
+
+/**
+ * @brief Inserts a patient or changes their score in O(log n).
+ *
+ * @param index Pointer to the RiskIndex structure.
+ * @param slot Registry slot of the patient.
+ * @param patient_id External patient identifier, used to break ties.
+ * @param score New score; larger is worse.
+ * @return 0 on success, -1 on error (invalid arguments or out of memory).
+ */
+int risk_index_update(RiskIndex* index, uint32_t slot, uint32_t patient_id, double score) {
+    if (index == NULL || score != score) return -1; // NaN would break the heap order
+    if (cover_slot(index, slot) != 0) return -1;
+
+    RiskEntry entry = {score, patient_id, slot};
+    uint32_t at = index->position[slot];
+    if (at != 0) {
+        // Already ranked: move the entry whichever way its new score requires
+        at--;
+        RiskEntry previous = index->heap[at];
+        if (previous.score == score && previous.patient_id == patient_id) return 0;
+        index->heap[at] = entry;
+        if (ranks_above(&entry, &previous)) {
+            sift_up(index, at);
+        } else {
+            sift_down(index, at);
+        }
+        return 0;
+    }
+
+    if (index->count == index->capacity) {
+        uint32_t capacity = index->capacity > 0 ? index->capacity * 2 : RISK_INDEX_MIN_CAPACITY;
+        RiskEntry* heap = realloc(index->heap, (size_t)capacity * sizeof(RiskEntry));
+        if (heap == NULL) return -1;
+        index->heap = heap;
+        index->capacity = capacity;
+    }
+    index->heap[index->count++] = entry;
+    sift_up(index, index->count - 1);
+    return 0;
+}
+
+/**
+ * @brief Removes a patient in O(log n); patients not ranked are ignored.
+ *
+ * @param index Pointer to the RiskIndex structure.
+ * @param slot Registry slot of the patient.
+ * @return 0 on success, -1 on error.
+ */
+int risk_index_remove(RiskIndex* index, uint32_t slot) {
+    if (index == NULL) return -1;
+    if (slot >= index->position_capacity || index->position[slot] == 0) return 0;
+
+    uint32_t at = index->position[slot] - 1;
+    index->position[slot] = 0;
+    RiskEntry last = index->heap[--index->count];
+    if (at == index->count) return 0;
+
+    // The last entry fills the hole and moves up or down from there
+    RiskEntry removed = index->heap[at];
+    index->heap[at] = last;
+    if (ranks_above(&last, &removed)) {
+        sift_up(index, at);
+    } else {
+        sift_down(index, at);
+    }
+    return 0;
+}
+
+/**
+ * @brief Pushes a heap position onto the frontier used by risk_index_top().
+ */
+static void frontier_push(const RiskEntry* heap, uint32_t* frontier, uint32_t* count, uint32_t position) {
+    uint32_t at = (*count)++;
+    while (at > 0) {
+        uint32_t parent = (at - 1) / 2;
+        if (!ranks_above(&heap[position], &heap[frontier[parent]])) break;
+        frontier[at] = frontier[parent];
+        at = parent;
+    }
+    frontier[at] = position;
+}
+
+/**
+ * @brief Pops the best heap position off the frontier used by risk_index_top().
+ */
+static uint32_t frontier_pop(const RiskEntry* heap, uint32_t* frontier, uint32_t* count) {
+    uint32_t best = frontier[0];
+    uint32_t last = frontier[--(*count)];
+    uint32_t at = 0;
+    for (;;) {
+        uint32_t child = 2 * at + 1;
+        if (child >= *count) break;
+        if (child + 1 < *count && ranks_above(&heap[frontier[child + 1]], &heap[frontier[child]])) child++;
+        if (!ranks_above(&heap[frontier[child]], &heap[last])) break;
+        frontier[at] = frontier[child];
+        at = child;
+    }
+    if (*count > 0) frontier[at] = last;
+    return best;
+}
+
+/**
+ * @brief Copies the K worst patients, worst first, in O(K log K).
+ *
+ * The heap itself is left untouched: a small frontier heap of heap
+ * positions starts at the root, and each position taken from it adds its
+ * two children, so only the top K entries and their children are visited.
+ *
+ * @param index Pointer to the RiskIndex structure.
+ * @param k Number of patients wanted (at most RISK_INDEX_TOP_MAX).
+ * @param entries Array of at least k entries to receive the patients.
+ * @return Number of entries written (fewer than k if fewer are ranked).
+ */
+uint32_t risk_index_top(const RiskIndex* index, uint32_t k, RiskEntry* entries) {
+    if (index == NULL || entries == NULL || index->count == 0) return 0;
+    if (k > RISK_INDEX_TOP_MAX) k = RISK_INDEX_TOP_MAX;
+
+    uint32_t frontier[RISK_INDEX_TOP_MAX + 1]; // Grows by at most one per entry taken
+    uint32_t frontier_count = 0;
+    frontier_push(index->heap, frontier, &frontier_count, 0);
+
+    uint32_t written = 0;
+    while (written < k && frontier_count > 0) {
+        uint32_t best = frontier_pop(index->heap, frontier, &frontier_count);
+        entries[written++] = index->heap[best];
+        if (2 * best + 1 < index->count) frontier_push(index->heap, frontier, &frontier_count, 2 * best + 1);
+        if (2 * best + 2 < index->count) frontier_push(index->heap, frontier, &frontier_count, 2 * best + 2);
+    }
+    return written;
+}
+
+/**
+ * @brief Returns the number of ranked patients.
+ *
+ * @param index Pointer to the RiskIndex structure.
+ * @return Number of ranked patients (0 if index is NULL).
+ */
+uint32_t risk_index_count(const RiskIndex* index) {
+    return index != NULL ? index->count : 0;
+}
+
+/**
+ * @brief Initializes one empty ranking per criterion.
+ *
+ * @param ranking Pointer to the RiskRanking structure to initialize.
+ * @return 0 on success, -1 on error.
+ */
+int risk_ranking_init(RiskRanking* ranking) {
+    if (ranking == NULL) return -1;
+    for (int c = 0; c < RISK_CRITERION_COUNT; c++) risk_index_init(&ranking->indexes[c]);
+    return 0;
+}
+
+/**
+ * @brief Releases every ranking.
+ *
+ * @param ranking Pointer to the RiskRanking structure to destroy.
+ * @return 0 on success, -1 on error.
+ */
+int risk_ranking_destroy(RiskRanking* ranking) {
+    if (ranking == NULL) return -1;
+    for (int c = 0; c < RISK_CRITERION_COUNT; c++) risk_index_destroy(&ranking->indexes[c]);
+    return 0;
+}
+
+/**
+ * @brief Ranks a patient by a score, or drops them when the score says they are not at risk.
+ */
+static int rank(RiskIndex* index, uint32_t slot, uint32_t patient_id, int at_risk, double score) {
+    return at_risk ? risk_index_update(index, slot, patient_id, score) : risk_index_remove(index, slot);
+}
+
+/**
+ * @brief Returns the share of a patient's readings below range, in percent.
+ *
+ * @param slot Registry slot of the patient.
+ * @param patient Pointer to the patient's current state.
+ * @param rollups Pointer to the cube to read the last 24 hours from, or NULL for all readings.
+ * @return Share of readings below range, 0 if there are none.
+ */
+static double below_range_percent(uint32_t slot, const PatientState* patient, const RollupCube* rollups) {
+    if (rollups != NULL) {
+        RollupBucket day;
+        time_t latest = patient->data.reading_time;
+        if (rollup_cube_totals(rollups, slot, latest - RISK_TBR_WINDOW_S + 3600, latest + 1, &day) != 0 ||
+            day.count == 0) return 0.0;
+        return (double)day.below / (double)day.count * 100.0;
+    }
+
+    // The statistics hold reading counts; rank by share so long and short histories compare
+    const GlucoseStats* stats = &patient->stats;
+    double total = stats->time_in_range + stats->time_below_range + stats->time_above_range;
+    return total > 0.0 ? stats->time_below_range / total * 100.0 : 0.0;
+}
+
+/**
+ * @brief Re-ranks a patient whose statistics or alarms changed.
+ *
+ * Call after update_glucose_statistics(), the alarm check and
+ * rollup_cube_add(). A patient drops out of a ranking when they have no
+ * reading, no time below range or no alarms, respectively, so only
+ * patients at risk are ranked.
+ *
+ * @param ranking Pointer to the RiskRanking structure.
+ * @param slot Registry slot of the patient.
+ * @param patient Pointer to the patient's current state.
+ * @param rollups Pointer to the cube holding the patient's hourly rollups, or NULL.
+ * @return 0 on success, -1 on error.
+ */
+int risk_ranking_update(RiskRanking* ranking, uint32_t slot, const PatientState* patient, const RollupCube* rollups) {
+    if (ranking == NULL || patient == NULL) return -1;
+
+    double below_percent = below_range_percent(slot, patient, rollups);
+
+    uint32_t id = patient->patient_id;
+    int result = 0;
+    result |= rank(&ranking->indexes[RISK_BY_CURRENT_LOW], slot, id,
+                   patient->data.reading_time != 0, -patient->data.glucose_value);
+    result |= rank(&ranking->indexes[RISK_BY_TIME_BELOW_RANGE], slot, id,
+                   below_percent > 0.0, below_percent);
+    result |= rank(&ranking->indexes[RISK_BY_ALARM_COUNT], slot, id,
+                   patient->alarm_count > 0, (double)patient->alarm_count);
+    return result;
+}
+
+/**
+ * @brief Removes a patient from every ranking, e.g. before unregistering them.
+ *
+ * @param ranking Pointer to the RiskRanking structure.
+ * @param slot Registry slot of the patient.
+ * @return 0 on success, -1 on error.
+ */
+int risk_ranking_remove(RiskRanking* ranking, uint32_t slot) {
+    if (ranking == NULL) return -1;
+    for (int c = 0; c < RISK_CRITERION_COUNT; c++) risk_index_remove(&ranking->indexes[c], slot);
+    return 0;
+}
+
+/**
+ * @brief Copies the K worst patients of one criterion, worst first.
+ *
+ * @param ranking Pointer to the RiskRanking structure.
+ * @param criterion Ranking to read.
+ * @param k Number of patients wanted (at most RISK_INDEX_TOP_MAX).
+ * @param entries Array of at least k entries to receive the patients.
+ * @return Number of entries written.
+ */
+uint32_t risk_ranking_top(const RiskRanking* ranking, RiskCriterion criterion, uint32_t k, RiskEntry* entries) {
+    if (ranking == NULL || criterion < 0 || criterion >= RISK_CRITERION_COUNT) return 0;
+    return risk_index_top(&ranking->indexes[criterion], k, entries);
+}
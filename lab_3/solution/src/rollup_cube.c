@@ -0,0 +1,415 @@
+/**
+ * @file rollup_cube.c
+ * @brief Contains the patient x day x hour rollups of glucose readings.
+ */
+
+#include "../include/rollup_cube.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SECONDS_PER_HOUR 3600
+#define ROLLUP_MIN_PATIENTS 1024
+#define ROLLUP_NO_DAY INT64_MIN // newest_day before the first reading
+// Reading times beyond this keep hour and day numbers far inside int32_t
+#define ROLLUP_TIME_LIMIT ((int64_t)INT32_MAX * SECONDS_PER_HOUR)
+
+/**
+ * @brief Divides rounding toward negative infinity, so times before the epoch bucket correctly.
+ */
+static int64_t floor_div(int64_t value, int64_t divisor) {
+    int64_t quotient = value / divisor;
+    return (value % divisor != 0 && (value < 0) != (divisor < 0)) ? quotient - 1 : quotient;
+}
+
+/**
+ * @brief Returns the local hour number since the epoch of a time.
+ */
+static int64_t hour_of(const RollupCube* cube, time_t t) {
+    return floor_div((int64_t)t + cube->utc_offset, SECONDS_PER_HOUR);
+}
+
+/**
+ * @brief Returns non-zero if a day lies too far ahead to be rolled up.
+ *
+ * A day is ahead if it is more than ROLLUP_MAX_AHEAD_DAYS after both the
+ * newest day of the cube and today's local day. The wall clock is only
+ * read when a reading passes the newest day by more than that, or for the
+ * cube's first reading, so neither a first reading from a clock in the
+ * future nor one from a clock in the past (such as time 0) can shut out
+ * the readings that follow it.
+ */
+static int day_too_far_ahead(const RollupCube* cube, int64_t day) {
+    if (cube->newest_day != ROLLUP_NO_DAY && day <= cube->newest_day + ROLLUP_MAX_AHEAD_DAYS) return 0;
+    int64_t today = floor_div(hour_of(cube, time(NULL)), ROLLUP_HOURS_PER_DAY);
+    return day > today + ROLLUP_MAX_AHEAD_DAYS;
+}
+
+/**
+ * @brief Returns a day block by index.
+ */
+static RollupDay* day_block(const RollupCube* cube, uint32_t index) {
+    return &cube->chunks[index / ROLLUP_CHUNK_DAYS][index % ROLLUP_CHUNK_DAYS];
+}
+
+/**
+ * @brief Returns the ring position of a day.
+ */
+static uint32_t ring_position(int64_t day) {
+    return (uint32_t)(day - floor_div(day, ROLLUP_DAYS) * ROLLUP_DAYS);
+}
+
+/**
+ * @brief Finds a patient's block for a day.
+ *
+ * @return The day block, or NULL if the patient has no readings that day.
+ */
+static const RollupDay* find_day(const RollupCube* cube, uint32_t slot, int64_t day) {
+    if (slot >= cube->patient_capacity) return NULL;
+
+    uint32_t block = cube->patients[slot].days[ring_position(day)];
+    if (block == 0) return NULL;
+
+    const RollupDay* found = day_block(cube, block - 1);
+    return found->day == day ? found : NULL;
+}
+
+/**
+ * @brief Takes a zeroed day block from the free list or a chunk.
+ *
+ * @return Block index + 1, or 0 on error (out of memory or cube full).
+ */
+static uint32_t take_day(RollupCube* cube) {
+    if (cube->free_day != 0) {
+        uint32_t block = cube->free_day;
+        RollupDay* day = day_block(cube, block - 1);
+        cube->free_day = day->next_free;
+        memset(day, 0, sizeof(*day));
+        return block;
+    }
+
+    if (cube->day_count == cube->chunk_count * ROLLUP_CHUNK_DAYS) {
+        if (cube->chunk_count >= ROLLUP_MAX_CHUNKS) return 0;
+        // Zero-filled, so the kernel commits pages only as days are used
+        RollupDay* chunk = calloc(ROLLUP_CHUNK_DAYS, sizeof(RollupDay));
+        if (chunk == NULL) return 0;
+        cube->chunks[cube->chunk_count++] = chunk;
+    }
+    return ++cube->day_count;
+}
+
+/**
+ * @brief Grows the patient table so it covers a slot.
+ *
+ * @return 0 on success, -1 on error (out of memory).
+ */
+static int cover_slot(RollupCube* cube, uint32_t slot) {
+    if (slot < cube->patient_capacity) return 0;
+
+    uint32_t capacity = cube->patient_capacity > 0 ? cube->patient_capacity : ROLLUP_MIN_PATIENTS;
+    while (capacity <= slot) capacity *= 2;
+    RollupPatient* patients = realloc(cube->patients, (size_t)capacity * sizeof(RollupPatient));
+    if (patients == NULL) return -1;
+
+    memset(patients + cube->patient_capacity, 0,
+           (size_t)(capacity - cube->patient_capacity) * sizeof(RollupPatient));
+    cube->patients = patients;
+    cube->patient_capacity = capacity;
+    return 0;
+}
+
+/**
+ * @brief Initializes an empty cube.
+ *
+ * @param cube Pointer to the RollupCube structure to initialize.
+ * @param utc_offset Seconds east of UTC of the local time used for days and hours.
+ * @return 0 on success, -1 on error.
+ */
+int rollup_cube_init(RollupCube* cube, int32_t utc_offset) {
+    if (cube == NULL) return -1;
+    memset(cube, 0, sizeof(*cube));
+    cube->utc_offset = utc_offset;
+    cube->newest_day = ROLLUP_NO_DAY;
+    return 0;
+}
+
+/**
+ * @brief Releases every patient ring and day block.
+ *
+ * @param cube Pointer to the RollupCube structure to destroy.
+ * @return 0 on success, -1 on error.
+ */
+int rollup_cube_destroy(RollupCube* cube) {
+    if (cube == NULL) return -1;
+    for (uint32_t i = 0; i < cube->chunk_count; i++) free(cube->chunks[i]);
+    free(cube->patients);
+    memset(cube, 0, sizeof(*cube));
+    return 0;
+}
+
+/**
+ * @brief Adds one reading to its patient's hourly bucket.
+ *
+ * Call next to update_glucose_statistics(), with the same thresholds.
+ * Readings older than the retained days of the patient or of the cube's
+ * newest day are counted in late_readings and dropped. Readings more than
+ * ROLLUP_MAX_AHEAD_DAYS after both the newest day and today, the first
+ * reading included, are counted in future_readings and dropped before
+ * they can claim a ring position. A reading further after the newest day
+ * but not after today moves the newest day forward, so a first reading
+ * from a clock in the past does not shut out current ones.
+ *
+ * @param cube Pointer to the RollupCube structure.
+ * @param slot Registry slot of the patient.
+ * @param patient_id External patient identifier; a new id in a slot starts an empty ring.
+ * @param reading_time Time of the reading.
+ * @param value Reading in fixed point.
+ * @param config Pointer to the thresholds used for the range counters.
+ * @return 0 on success, -1 on error (invalid arguments, out of memory, late or future reading).
+ */
+int rollup_cube_add(RollupCube* cube, uint32_t slot, uint32_t patient_id, time_t reading_time,
+                    GlucoseFixed value, const Config* config) {
+    if (cube == NULL || config == NULL) return -1;
+
+    if ((int64_t)reading_time > ROLLUP_TIME_LIMIT) {
+        cube->future_readings++;
+        return -1;
+    }
+    if ((int64_t)reading_time < -ROLLUP_TIME_LIMIT) {
+        cube->late_readings++;
+        return -1;
+    }
+    int64_t hour = hour_of(cube, reading_time);
+    int64_t day = floor_div(hour, ROLLUP_HOURS_PER_DAY);
+    if (day_too_far_ahead(cube, day)) {
+        cube->future_readings++;
+        return -1;
+    }
+    if (cube->newest_day != ROLLUP_NO_DAY && day <= cube->newest_day - ROLLUP_DAYS) {
+        cube->late_readings++;
+        return -1;
+    }
+
+    if (cover_slot(cube, slot) != 0) return -1;
+    if (cube->newest_day == ROLLUP_NO_DAY || day > cube->newest_day) cube->newest_day = day;
+
+    RollupPatient* patient = &cube->patients[slot];
+    if (patient->patient_id != patient_id) {
+        rollup_cube_remove(cube, slot); // The slot now belongs to someone else
+        patient->patient_id = patient_id;
+    }
+
+    uint32_t* ring = &patient->days[ring_position(day)];
+
+    RollupDay* block = *ring != 0 ? day_block(cube, *ring - 1) : NULL;
+    if (block == NULL || block->day != day) {
+        if (block != NULL && block->day > day) {
+            cube->late_readings++;
+            return -1;
+        }
+        // First reading of the day: reuse the block of the day that fell out of the ring
+        if (block != NULL) {
+            memset(block, 0, sizeof(*block));
+        } else {
+            if ((*ring = take_day(cube)) == 0) return -1;
+            block = day_block(cube, *ring - 1);
+        }
+        block->day = (int32_t)day;
+    }
+
+    RollupBucket* bucket = &block->hours[hour - day * ROLLUP_HOURS_PER_DAY];
+    if (bucket->count == 0 || value < bucket->min) bucket->min = value;
+    if (value > bucket->max) bucket->max = value;
+    bucket->count++;
+    // Same comparisons as update_glucose_statistics(); readings are already on the 0.1 mg/dL grid
+    if (value < config->hypoglycemia_threshold * GLUCOSE_FIXED_SCALE) {
+        bucket->below++;
+    } else if (value > config->hyperglycemia_threshold * GLUCOSE_FIXED_SCALE) {
+        bucket->above++;
+    }
+    bucket->sum += value;
+    bucket->sum_squares += (uint64_t)value * value;
+    return 0;
+}
+
+/**
+ * @brief Drops a patient's rollups, e.g. before unregistering them.
+ *
+ * @param cube Pointer to the RollupCube structure.
+ * @param slot Registry slot of the patient.
+ * @return 0 on success, -1 on error.
+ */
+int rollup_cube_remove(RollupCube* cube, uint32_t slot) {
+    if (cube == NULL) return -1;
+    if (slot >= cube->patient_capacity) return 0;
+
+    RollupPatient* patient = &cube->patients[slot];
+    for (int i = 0; i < ROLLUP_DAYS; i++) {
+        if (patient->days[i] == 0) continue;
+        day_block(cube, patient->days[i] - 1)->next_free = cube->free_day;
+        cube->free_day = patient->days[i];
+        patient->days[i] = 0;
+    }
+    patient->patient_id = 0;
+    return 0;
+}
+
+/**
+ * @brief Returns the start of the local day holding a time.
+ *
+ * @param cube Pointer to the RollupCube structure.
+ * @param t Any time.
+ * @return Local midnight at or before t.
+ */
+time_t rollup_cube_day_start(const RollupCube* cube, time_t t) {
+    if (cube == NULL) return t;
+    int64_t day = floor_div(hour_of(cube, t), ROLLUP_HOURS_PER_DAY);
+    return (time_t)(day * ROLLUP_HOURS_PER_DAY * SECONDS_PER_HOUR - cube->utc_offset);
+}
+
+/**
+ * @brief Merges a patient's hours [first_hour, end_hour) into one bucket, or by hour of day.
+ *
+ * Walks one day block at a time, so the cost is one ring lookup per day
+ * plus one merge per hour.
+ *
+ * @param by_hour Non-zero to merge into totals[hour of day], zero to merge into totals[0].
+ */
+static void merge_hours(const RollupCube* cube, uint32_t slot, int64_t first_hour, int64_t end_hour,
+                        int by_hour, RollupBucket* totals) {
+    if (slot >= cube->patient_capacity) return;
+    int64_t hour = first_hour;
+    while (hour < end_hour) {
+        int64_t day = floor_div(hour, ROLLUP_HOURS_PER_DAY);
+        int64_t day_end = (day + 1) * ROLLUP_HOURS_PER_DAY;
+        int64_t stop = end_hour < day_end ? end_hour : day_end;
+
+        const RollupDay* block = find_day(cube, slot, day);
+        for (; block != NULL && hour < stop; hour++) {
+            int hour_of_day = (int)(hour - day * ROLLUP_HOURS_PER_DAY);
+            rollup_bucket_merge(&totals[by_hour ? hour_of_day : 0], &block->hours[hour_of_day]);
+        }
+        hour = stop;
+    }
+}
+
+/**
+ * @brief Merges every hour of a patient that overlaps [from, to).
+ *
+ * @param cube Pointer to the RollupCube structure.
+ * @param slot Registry slot of the patient.
+ * @param from Start of the range.
+ * @param to End of the range (exclusive).
+ * @param totals Pointer to receive the merged bucket.
+ * @return 0 on success, -1 on error.
+ */
+int rollup_cube_totals(const RollupCube* cube, uint32_t slot, time_t from, time_t to, RollupBucket* totals) {
+    if (cube == NULL || totals == NULL) return -1;
+    memset(totals, 0, sizeof(*totals));
+    if (to <= from) return 0;
+
+    merge_hours(cube, slot, hour_of(cube, from), hour_of(cube, to - 1) + 1, 0, totals);
+    return 0;
+}
+
+/**
+ * @brief Merges a patient's hours into consecutive windows, e.g. days or weeks.
+ *
+ * Window i covers bucket_hours hours from from + i * bucket_hours hours.
+ *
+ * @param cube Pointer to the RollupCube structure.
+ * @param slot Registry slot of the patient.
+ * @param from Start of the first window.
+ * @param bucket_hours Hours per window (1 = hourly, 24 = daily, 168 = weekly).
+ * @param window_count Number of windows.
+ * @param windows Array of window_count buckets to receive the totals.
+ * @return 0 on success, -1 on error.
+ */
+int rollup_cube_series(const RollupCube* cube, uint32_t slot, time_t from, uint32_t bucket_hours,
+                       uint32_t window_count, RollupBucket* windows) {
+    if (cube == NULL || windows == NULL || bucket_hours == 0) return -1;
+    memset(windows, 0, (size_t)window_count * sizeof(RollupBucket));
+
+    int64_t first_hour = hour_of(cube, from);
+    for (uint32_t i = 0; i < window_count; i++) {
+        int64_t start = first_hour + (int64_t)i * bucket_hours;
+        merge_hours(cube, slot, start, start + bucket_hours, 0, &windows[i]);
+    }
+    return 0;
+}
+
+/**
+ * @brief Merges a patient's hours in [from, to) by hour of day, e.g. for TIR by hour.
+ *
+ * @param cube Pointer to the RollupCube structure.
+ * @param slot Registry slot of the patient.
+ * @param from Start of the range.
+ * @param to End of the range (exclusive).
+ * @param profile Array of ROLLUP_HOURS_PER_DAY buckets to receive the totals.
+ * @return 0 on success, -1 on error.
+ */
+int rollup_cube_hour_profile(const RollupCube* cube, uint32_t slot, time_t from, time_t to,
+                             RollupBucket profile[ROLLUP_HOURS_PER_DAY]) {
+    if (cube == NULL || profile == NULL) return -1;
+    memset(profile, 0, ROLLUP_HOURS_PER_DAY * sizeof(RollupBucket));
+    if (to <= from) return 0;
+
+    merge_hours(cube, slot, hour_of(cube, from), hour_of(cube, to - 1) + 1, 1, profile);
+    return 0;
+}
+
+/**
+ * @brief Adds one bucket into another.
+ *
+ * @param into Pointer to the bucket to add to.
+ * @param from Pointer to the bucket to add.
+ */
+void rollup_bucket_merge(RollupBucket* into, const RollupBucket* from) {
+    if (into == NULL || from == NULL || from->count == 0) return;
+
+    if (into->count == 0 || from->min < into->min) into->min = from->min;
+    if (from->max > into->max) into->max = from->max;
+    into->count += from->count;
+    into->below += from->below;
+    into->above += from->above;
+    into->sum += from->sum;
+    into->sum_squares += from->sum_squares;
+}
+
+/**
+ * @brief Converts a bucket into statistics as update_glucose_statistics() keeps them.
+ *
+ * The result can be printed with print_glucose_statistics().
+ *
+ * @param bucket Pointer to the bucket to convert.
+ * @param stats Pointer to the GlucoseStats structure to fill.
+ * @return 0 on success, -1 on error.
+ */
+int rollup_bucket_stats(const RollupBucket* bucket, GlucoseStats* stats) {
+    if (bucket == NULL || stats == NULL) return -1;
+
+    initialize_glucose_statistics(stats);
+    if (bucket->count == 0) return 0;
+
+    stats->time_below_range = bucket->below;
+    stats->time_above_range = bucket->above;
+    stats->time_in_range = bucket->count - bucket->below - bucket->above;
+    stats->avg_glucose = (double)bucket->sum / bucket->count / GLUCOSE_FIXED_SCALE;
+
+    // Sum of squared deviations, from the exact integer sums
+    double sum = (double)bucket->sum;
+    double m2 = (double)bucket->sum_squares - sum * sum / bucket->count;
+    stats->glucose_variability = (m2 > 0.0 ? m2 : 0.0) / (GLUCOSE_FIXED_SCALE * GLUCOSE_FIXED_SCALE);
+    return 0;
+}
+
+/**
+ * @brief Returns the memory currently held by the cube.
+ *
+ * @param cube Pointer to the RollupCube structure.
+ * @return Bytes used by the cube, its patient rings and day blocks.
+ */
+size_t rollup_cube_memory_bytes(const RollupCube* cube) {
+    if (cube == NULL) return 0;
+    return sizeof(*cube) + (size_t)cube->patient_capacity * sizeof(RollupPatient) +
+           (size_t)cube->chunk_count * ROLLUP_CHUNK_DAYS * sizeof(RollupDay);
+}
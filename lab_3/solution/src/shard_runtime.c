@@ -0,0 +1,557 @@
+/**
+ * @file shard_runtime.c
+ * @brief Contains the shard threads, their inboxes and the merging of their summaries.
+ */
+
+#define _GNU_SOURCE
+
+#include "../include/shard_runtime.h"
+#include "../include/alarm.h"
+#include "../include/analysis.h"
+#include "../include/data_generator.h"
+#include "../include/latency.h"
+#include "../include/metrics.h"
+#include "../include/seqlock.h"
+#include <math.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SHARD_INBOX_BATCH 256        // Records taken before the inbox head is released
+#define SHARD_IDLE_NS 50000L         // Sleep of a shard with an empty inbox
+#define SHARD_REALTIME_SLICE_NS 100000000L // Longest sleep between checks for stop in realtime ticks
+
+// Every shard and the thread driving the runtime record into a block of their own
+typedef char shard_latency_threads_check[(SHARD_MAX + 1 <= LATENCY_MAX_THREADS) ? 1 : -1];
+typedef char shard_metrics_threads_check[(SHARD_MAX + 1 <= METRICS_MAX_THREADS) ? 1 : -1];
+
+// Range of a patient's latest reading
+enum {
+    RANGE_NONE = 0,
+    RANGE_BELOW,
+    RANGE_IN,
+    RANGE_ABOVE
+};
+
+/**
+ * @brief Returns options for a simulation on one shard per CPU.
+ *
+ * @return ShardRuntimeOptions structure with default values.
+ */
+ShardRuntimeOptions shard_runtime_default_options(void) {
+    ShardRuntimeOptions options;
+    memset(&options, 0, sizeof(options));
+    options.shard_count = 0;
+    options.mode = SHARD_MODE_SIMULATE;
+    options.pin = 1;
+    options.thresholds = NULL;
+    options.config = initialize_config();
+    options.patient_count = 1;
+    options.ticks = 0;
+    options.tick_seconds = (uint32_t)options.config.sleep_interval;
+    options.realtime = 0;
+    options.start_time = time(NULL);
+    options.seed = 1;
+    return options;
+}
+
+/**
+ * @brief Returns the shard that owns a patient.
+ *
+ * @param runtime Pointer to the ShardRuntime structure.
+ * @param patient_id External patient identifier.
+ * @return Shard number, 0 .. shard_count - 1.
+ */
+uint32_t shard_runtime_shard_of(const ShardRuntime* runtime, uint32_t patient_id) {
+    uint32_t hash = patient_id * 2654435761u;
+    return (uint32_t)(((uint64_t)hash * runtime->shard_count) >> 32);
+}
+
+/**
+ * @brief Copies the shard's counters and current top lists to its published summary.
+ */
+static void publish_summary(Shard* shard) {
+    ShardSummary* local = &shard->local;
+    local->patients = patient_registry_count(&shard->registry);
+    for (int c = 0; c < RISK_CRITERION_COUNT; c++) {
+        local->top_count[c] = risk_ranking_top(&shard->ranking, (RiskCriterion)c, SHARD_TOP_K, local->top[c]);
+    }
+
+    seqlock_write_begin(&shard->summary_sequence);
+    shard->summary = *local;
+    seqlock_write_end(&shard->summary_sequence);
+    shard->since_publish = 0;
+    metrics_set_gauge(METRIC_GAUGE_REGISTRY_BYTES, patient_registry_memory_bytes(&shard->registry));
+}
+
+/**
+ * @brief Counts a dropped reading in the shard's counters and the engine metrics.
+ */
+static void reject_reading(Shard* shard) {
+    shard->local.rejected++;
+    metrics_count(METRIC_REJECTED, 1);
+}
+
+/**
+ * @brief Returns the range of a patient's latest reading.
+ */
+static uint8_t reading_range(const PatientState* patient) {
+    if (patient->data.glucose_value < patient->config.hypoglycemia_threshold) return RANGE_BELOW;
+    if (patient->data.glucose_value > patient->config.hyperglycemia_threshold) return RANGE_ABOVE;
+    return RANGE_IN;
+}
+
+/**
+ * @brief Adds or removes one patient from the counter of a range.
+ */
+static void count_range(ShardSummary* local, uint8_t range, int delta) {
+    if (range == RANGE_BELOW) local->current_below += (uint32_t)delta;
+    if (range == RANGE_IN) local->current_in += (uint32_t)delta;
+    if (range == RANGE_ABOVE) local->current_above += (uint32_t)delta;
+}
+
+/**
+ * @brief Analyzes a patient's new reading and updates the shard's counters and rankings.
+ *
+ * @param shard Pointer to the shard owning the patient.
+ * @param index Dense position of the patient.
+ * @param patient Pointer to the patient, with the new reading recorded.
+ * @param previous Previous latest reading, mg/dL.
+ * @return 0 on success, -1 on error (out of memory).
+ */
+static int analyze_reading(Shard* shard, uint32_t index, PatientState* patient, double previous) {
+    PatientHandle handle;
+    if (patient_registry_handle_at(&shard->registry, index, &handle) != 0) return -1;
+    if (handle.slot >= shard->range_capacity) {
+        uint32_t capacity = shard->range_capacity > 0 ? shard->range_capacity : 1024;
+        while (capacity <= handle.slot) capacity *= 2;
+        uint8_t* ranges = realloc(shard->range_by_slot, capacity);
+        if (ranges == NULL) return -1;
+        memset(ranges + shard->range_capacity, RANGE_NONE, capacity - shard->range_capacity);
+        shard->range_by_slot = ranges;
+        shard->range_capacity = capacity;
+    }
+
+    update_glucose_statistics(&patient->stats, &patient->data, &patient->config);
+    evaluate_glucose_alarms(&patient->data, &patient->config, &patient->alarm_flags);
+    if (patient->alarm_flags != ALARM_NONE) {
+        patient->alarm_count++;
+        shard->local.alarms++;
+    }
+    metrics_count_reading(patient->alarm_flags);
+
+    ShardSummary* local = &shard->local;
+    uint8_t old_range = shard->range_by_slot[handle.slot];
+    uint8_t new_range = reading_range(patient);
+    if (old_range != RANGE_NONE) {
+        count_range(local, old_range, -1);
+        local->current_sum -= previous;
+    }
+    count_range(local, new_range, 1);
+    local->current_sum += patient->data.glucose_value;
+    shard->range_by_slot[handle.slot] = new_range;
+    local->readings++;
+
+    risk_ranking_update(&shard->ranking, handle.slot, patient, NULL);
+    if (++shard->since_publish >= SHARD_PUBLISH_READINGS) publish_summary(shard);
+    return 0;
+}
+
+/**
+ * @brief Returns the thresholds of a patient under the current table.
+ */
+static Config patient_config(const ShardRuntimeOptions* options, const ConfigTable* table, uint32_t patient_id) {
+    Config config = table != NULL ? table->defaults : options->config;
+    if (table != NULL) config_table_get(table, patient_id, &config);
+    return config;
+}
+
+/**
+ * @brief Sleeps until a deadline, waking early if the runtime is stopped.
+ */
+static void sleep_until(ShardRuntime* runtime, const struct timespec* deadline) {
+    for (;;) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long long remaining = (long long)(deadline->tv_sec - now.tv_sec) * 1000000000LL +
+                              (deadline->tv_nsec - now.tv_nsec);
+        if (remaining <= 0 || __atomic_load_n(&runtime->stop, __ATOMIC_RELAXED)) return;
+        if (remaining > SHARD_REALTIME_SLICE_NS) remaining = SHARD_REALTIME_SLICE_NS;
+        struct timespec slice = {0, (long)remaining};
+        nanosleep(&slice, NULL);
+    }
+}
+
+/**
+ * @brief Registers the shard's patients, then generates and analyzes their readings tick by tick.
+ */
+static void run_simulation(ShardRuntime* runtime, Shard* shard) {
+    const ShardRuntimeOptions* options = &runtime->options;
+    ConfigStore* store = options->thresholds;
+
+    // Patients are registered here so their state is first touched by the CPU that owns it
+    const ConfigTable* table = store != NULL ? config_store_read(store) : NULL;
+    for (uint32_t id = 1; id <= options->patient_count; id++) {
+        if (shard_runtime_shard_of(runtime, id) != shard->index) continue;
+        Config config = patient_config(options, table, id);
+        PatientHandle handle;
+        if (patient_registry_add(&shard->registry, id, &config, &handle) != 0) {
+            shard->failed = 1;
+            __atomic_store_n(&shard->done, 1, __ATOMIC_RELEASE);
+            return;
+        }
+    }
+    if (store != NULL) config_store_quiescent(store, shard->reader);
+
+    struct timespec next_tick;
+    clock_gettime(CLOCK_MONOTONIC, &next_tick);
+    for (uint32_t tick = 0; (options->ticks == 0 || tick < options->ticks) &&
+                            !__atomic_load_n(&runtime->stop, __ATOMIC_RELAXED); tick++) {
+        table = store != NULL ? config_store_read(store) : NULL;
+        time_t now = options->realtime ? time(NULL) : options->start_time + (time_t)tick * options->tick_seconds;
+
+        uint32_t count = patient_registry_count(&shard->registry);
+        for (uint32_t i = 0; i < count; i++) {
+            PatientState* patient = patient_registry_at(&shard->registry, i);
+            if (table != NULL) config_table_get(table, patient->patient_id, &patient->config);
+            double previous = patient->data.glucose_value;
+            if (generate_glucose_data_r(&patient->data, now, &shard->seed) != 0) {
+                reject_reading(shard);
+                continue;
+            }
+            if (analyze_reading(shard, i, patient, previous) != 0) shard->failed = 1;
+        }
+
+        shard->local.ticks++;
+        if (store != NULL) config_store_quiescent(store, shard->reader); // table is not used past this point
+        publish_summary(shard);
+
+        if (options->realtime) {
+            next_tick.tv_sec += options->tick_seconds;
+            sleep_until(runtime, &next_tick);
+        }
+    }
+    __atomic_store_n(&shard->done, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Analyzes one routed reading, registering the patient on its first one.
+ *
+ * A NaN value is a dropout and only shifts a missing entry into the history.
+ */
+static void process_record(Shard* shard, const ShardRuntimeOptions* options, const ConfigTable* table,
+                           const IngestRecord* record) {
+    uint32_t index;
+    PatientState* patient = patient_registry_find(&shard->registry, record->patient_id, &index);
+
+    // NaN reports a sensor dropout: a missing history entry of a known patient
+    if (isnan(record->glucose_value)) {
+        if (patient == NULL || record_missing_reading(&patient->data) != 0) reject_reading(shard);
+        return;
+    }
+    if (!(record->glucose_value > 0.0f)) {
+        reject_reading(shard);
+        return;
+    }
+
+    if (patient == NULL) {
+        Config config = patient_config(options, table, record->patient_id);
+        PatientHandle handle;
+        if (patient_registry_add(&shard->registry, record->patient_id, &config, &handle) != 0) {
+            reject_reading(shard);
+            return;
+        }
+        patient = patient_registry_find(&shard->registry, record->patient_id, &index);
+    } else if (table != NULL) {
+        config_table_get(table, record->patient_id, &patient->config);
+    }
+
+    double previous = patient->data.glucose_value;
+    if (record_glucose_reading(&patient->data, record->glucose_value, (time_t)record->timestamp) != 0) {
+        reject_reading(shard);
+        return;
+    }
+    if (analyze_reading(shard, index, patient, previous) != 0) shard->failed = 1;
+}
+
+/**
+ * @brief Drains the shard's inbox until the runtime is stopped and the inbox is empty.
+ */
+static void run_inbox(ShardRuntime* runtime, Shard* shard) {
+    const ShardRuntimeOptions* options = &runtime->options;
+    ConfigStore* store = options->thresholds;
+    ShardInbox* inbox = &shard->inbox;
+    uint64_t head = inbox->head;
+
+    for (;;) {
+        uint64_t tail = __atomic_load_n(&inbox->tail, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            // Check stop only once empty, so everything submitted before it is processed
+            if (__atomic_load_n(&runtime->stop, __ATOMIC_ACQUIRE) &&
+                __atomic_load_n(&inbox->tail, __ATOMIC_ACQUIRE) == head) {
+                break;
+            }
+            if (shard->since_publish > 0) publish_summary(shard);
+            if (store != NULL) config_store_quiescent(store, shard->reader);
+            struct timespec idle = {0, SHARD_IDLE_NS};
+            nanosleep(&idle, NULL);
+            continue;
+        }
+
+        const ConfigTable* table = store != NULL ? config_store_read(store) : NULL;
+        if (tail - head > SHARD_INBOX_BATCH) tail = head + SHARD_INBOX_BATCH;
+        for (; head < tail; head++) {
+            process_record(shard, options, table, &inbox->records[head & (SHARD_INBOX_CAPACITY - 1)]);
+        }
+        __atomic_store_n(&inbox->head, head, __ATOMIC_RELEASE);
+        if (store != NULL) config_store_quiescent(store, shard->reader); // table is not used past this point
+    }
+}
+
+/**
+ * @brief Entry point of a shard's thread.
+ *
+ * @param context Pointer to the Shard.
+ * @return NULL.
+ */
+static void* shard_main(void* context) {
+    Shard* shard = context;
+    if (shard->cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(shard->cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) shard->cpu = -1;
+    }
+
+    if (shard->runtime->options.mode == SHARD_MODE_SIMULATE) {
+        run_simulation(shard->runtime, shard);
+    } else {
+        run_inbox(shard->runtime, shard);
+    }
+    publish_summary(shard);
+    return NULL;
+}
+
+/**
+ * @brief Frees a shard that is not running.
+ */
+static void free_shard(ShardRuntime* runtime, Shard* shard) {
+    if (shard == NULL) return;
+    patient_registry_destroy(&shard->registry);
+    risk_ranking_destroy(&shard->ranking);
+    free(shard->range_by_slot);
+    if (shard->reader >= 0) config_store_unregister_reader(runtime->options.thresholds, shard->reader);
+    free(shard);
+}
+
+/**
+ * @brief Allocates the shards and starts their threads.
+ *
+ * @param runtime Pointer to the ShardRuntime structure to initialize.
+ * @param options Pointer to the options, copied.
+ * @return 0 on success, -1 on error.
+ */
+int shard_runtime_start(ShardRuntime* runtime, const ShardRuntimeOptions* options) {
+    if (runtime == NULL || options == NULL || options->shard_count > SHARD_MAX) return -1;
+    if (options->mode == SHARD_MODE_SIMULATE && options->realtime && options->tick_seconds == 0) return -1;
+
+    memset(runtime, 0, sizeof(*runtime));
+    runtime->options = *options;
+
+    // Shards go to the CPUs the process may run on, in order
+    int cpus[SHARD_MAX];
+    uint32_t cpu_count = 0;
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE && cpu_count < SHARD_MAX; cpu++) {
+            if (CPU_ISSET(cpu, &allowed)) cpus[cpu_count++] = cpu;
+        }
+    }
+    runtime->shard_count = options->shard_count > 0 ? options->shard_count : (cpu_count > 0 ? cpu_count : 1);
+
+    for (uint32_t i = 0; i < runtime->shard_count; i++) {
+        void* memory;
+        if (posix_memalign(&memory, SHARD_CACHE_LINE, sizeof(Shard)) != 0) {
+            shard_runtime_stop(runtime, NULL);
+            return -1;
+        }
+        Shard* shard = memory;
+        memset(shard, 0, sizeof(*shard));
+        shard->runtime = runtime;
+        shard->index = i;
+        shard->cpu = options->pin && cpu_count > 0 ? cpus[i % cpu_count] : -1;
+        shard->seed = options->seed ^ ((i + 1) * 2654435761u);
+        shard->reader = options->thresholds != NULL ? config_store_register_reader(options->thresholds) : -1;
+        runtime->shards[i] = shard;
+        if (patient_registry_init(&shard->registry) != 0 || risk_ranking_init(&shard->ranking) != 0 ||
+            (options->thresholds != NULL && shard->reader < 0)) {
+            shard_runtime_stop(runtime, NULL);
+            return -1;
+        }
+    }
+
+    for (uint32_t i = 0; i < runtime->shard_count; i++) {
+        if (pthread_create(&runtime->shards[i]->thread, NULL, shard_main, runtime->shards[i]) != 0) {
+            shard_runtime_stop(runtime, NULL);
+            return -1;
+        }
+        runtime->started++;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Routes a reading to the inbox of the patient's shard.
+ *
+ * Only one thread may submit to a runtime. Fails without blocking when
+ * the inbox is full; the caller decides whether to retry or drop.
+ *
+ * @param runtime Pointer to the ShardRuntime structure (SHARD_MODE_INBOX).
+ * @param record Pointer to the reading.
+ * @return 0 on success, -1 if the inbox is full.
+ */
+int shard_runtime_submit(ShardRuntime* runtime, const IngestRecord* record) {
+    ShardInbox* inbox = &runtime->shards[shard_runtime_shard_of(runtime, record->patient_id)]->inbox;
+    uint64_t tail = inbox->tail; // Only this thread writes it
+
+    if (tail - inbox->cached_head >= SHARD_INBOX_CAPACITY) {
+        inbox->cached_head = __atomic_load_n(&inbox->head, __ATOMIC_ACQUIRE);
+        if (tail - inbox->cached_head >= SHARD_INBOX_CAPACITY) return -1;
+    }
+
+    inbox->records[tail & (SHARD_INBOX_CAPACITY - 1)] = *record;
+    __atomic_store_n(&inbox->tail, tail + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/**
+ * @brief Orders risk entries as the rankings do: higher score first, then lower patient id.
+ */
+static int entry_before(const RiskEntry* a, const RiskEntry* b) {
+    if (a->score != b->score) return a->score > b->score;
+    return a->patient_id < b->patient_id;
+}
+
+/**
+ * @brief Inserts an entry into a sorted top list of at most SHARD_TOP_K entries.
+ */
+static void merge_top(RiskEntry* top, uint32_t* count, const RiskEntry* entry) {
+    if (*count == SHARD_TOP_K && !entry_before(entry, &top[SHARD_TOP_K - 1])) return;
+
+    uint32_t position = *count < SHARD_TOP_K ? (*count)++ : SHARD_TOP_K - 1;
+    while (position > 0 && entry_before(entry, &top[position - 1])) {
+        top[position] = top[position - 1];
+        position--;
+    }
+    top[position] = *entry;
+}
+
+/**
+ * @brief Merges the latest summary of every shard into a fleet summary.
+ *
+ * Can be called from any thread while the shards run; each shard's part
+ * is as of its last publication.
+ *
+ * @param runtime Pointer to the ShardRuntime structure.
+ * @param fleet Pointer to the ShardSummary structure to fill; its top lists hold the fleet's top SHARD_TOP_K.
+ * @return 0 on success, -1 on error.
+ */
+int shard_runtime_summary(ShardRuntime* runtime, ShardSummary* fleet) {
+    if (runtime == NULL || fleet == NULL || runtime->shard_count == 0) return -1;
+
+    memset(fleet, 0, sizeof(*fleet));
+    fleet->ticks = UINT32_MAX;
+    for (uint32_t i = 0; i < runtime->shard_count; i++) {
+        Shard* shard = runtime->shards[i];
+        ShardSummary part;
+        uint64_t start;
+        do {
+            start = seqlock_read_begin(&shard->summary_sequence);
+            part = shard->summary;
+        } while (seqlock_read_retry(&shard->summary_sequence, start));
+
+        fleet->patients += part.patients;
+        fleet->readings += part.readings;
+        fleet->alarms += part.alarms;
+        fleet->rejected += part.rejected;
+        if (part.ticks < fleet->ticks) fleet->ticks = part.ticks;
+        fleet->current_below += part.current_below;
+        fleet->current_in += part.current_in;
+        fleet->current_above += part.current_above;
+        fleet->current_sum += part.current_sum;
+        // Each fleet top-K patient is in its own shard's top K
+        for (int c = 0; c < RISK_CRITERION_COUNT; c++) {
+            for (uint32_t e = 0; e < part.top_count[c] && e < SHARD_TOP_K; e++) {
+                merge_top(fleet->top[c], &fleet->top_count[c], &part.top[c][e]);
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Returns the number of readings routed to inboxes and not yet taken by their shards.
+ *
+ * Can be called from any thread while the shards run.
+ *
+ * @param runtime Pointer to the ShardRuntime structure.
+ * @return Readings waiting in all inboxes.
+ */
+uint64_t shard_runtime_queued(ShardRuntime* runtime) {
+    if (runtime == NULL) return 0;
+
+    uint64_t queued = 0;
+    for (uint32_t i = 0; i < runtime->shard_count; i++) {
+        ShardInbox* inbox = &runtime->shards[i]->inbox;
+        uint64_t head = __atomic_load_n(&inbox->head, __ATOMIC_ACQUIRE);
+        uint64_t tail = __atomic_load_n(&inbox->tail, __ATOMIC_ACQUIRE);
+        if (tail > head) queued += tail - head;
+    }
+    return queued;
+}
+
+/**
+ * @brief Returns non-zero once every simulating shard has run its ticks.
+ *
+ * @param runtime Pointer to the ShardRuntime structure.
+ * @return Non-zero if the shards are done.
+ */
+int shard_runtime_done(ShardRuntime* runtime) {
+    if (runtime == NULL) return 1;
+    for (uint32_t i = 0; i < runtime->shard_count; i++) {
+        if (!__atomic_load_n(&runtime->shards[i]->done, __ATOMIC_ACQUIRE)) return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Stops the shards after their inboxes drain, and frees the runtime.
+ *
+ * The final summaries are published before the threads exit, so
+ * shard_runtime_summary() may not be called afterwards; pass a fleet
+ * summary to receive them.
+ *
+ * @param runtime Pointer to the ShardRuntime structure.
+ * @param fleet Pointer to receive the final fleet summary, or NULL.
+ * @return 0 on success, -1 if a shard failed.
+ */
+int shard_runtime_stop(ShardRuntime* runtime, ShardSummary* fleet) {
+    if (runtime == NULL) return -1;
+
+    __atomic_store_n(&runtime->stop, 1, __ATOMIC_RELEASE);
+    for (uint32_t i = 0; i < runtime->started; i++) pthread_join(runtime->shards[i]->thread, NULL);
+
+    int result = 0;
+    if (fleet != NULL && shard_runtime_summary(runtime, fleet) != 0) result = -1;
+    for (uint32_t i = 0; i < SHARD_MAX; i++) {
+        if (runtime->shards[i] != NULL && runtime->shards[i]->failed) result = -1;
+        free_shard(runtime, runtime->shards[i]);
+        runtime->shards[i] = NULL;
+    }
+    runtime->shard_count = 0;
+    runtime->started = 0;
+    return result;
+}
@@ -0,0 +1,1242 @@
+/**
+ * @file state_store.c
+ * @brief Contains the write-ahead log, checkpoints and parallel recovery.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../include/state_store.h"
+#include "../include/alarm.h"
+#include "../include/analysis.h"
+#include "../include/data_generator.h"
+#include "../include/latency.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define WAL_GROUP_MAGIC 0x4C415747u  // "GWAL"
+#define CHECKPOINT_MAGIC 0x504B4347u // "GCKP"
+#define CHECKPOINT_VERSION 4
+#define CHECKPOINT_TEMP_FILE "checkpoint.tmp"
+#define CHECKPOINT_MIN_TABLE 16
+#define REPLAY_MAX_THREADS 64
+#define REPLAY_PREFETCH_DISTANCE 16 // WAL records ahead whose table slot is prefetched
+#define CHECKSUM_SEED 14695981039346656037ull
+#define NO_RECORD UINT32_MAX
+#define WAL_RECORD_DEFERRED 0x100 // In memory only, or'ed into the type: held back for a patient still on disk
+
+// Header written in front of every committed group
+typedef struct {
+    uint32_t magic;    // WAL_GROUP_MAGIC
+    uint32_t count;    // Records in the group
+    uint64_t checksum; // Checksum of the records
+} WalGroupHeader;
+
+// Sections are read in place, so their layout is fixed; records are checksummed as 64-bit words
+typedef char wal_record_size_check[(sizeof(WalRecord) == 32) ? 1 : -1];
+typedef char checkpoint_header_size_check[(sizeof(CheckpointHeader) == 64) ? 1 : -1];
+typedef char checkpoint_index_size_check[(sizeof(CheckpointIndexRecord) == 96) ? 1 : -1];
+typedef char checkpoint_history_size_check[(sizeof(CheckpointHistory) == 64) ? 1 : -1];
+
+// Sort key for the prefetch order
+typedef struct {
+    int64_t reading_time;
+    uint32_t record;
+} PrefetchKey;
+
+// Latest add of a patient re-registered through the WAL
+typedef struct {
+    uint32_t patient_id;
+    uint64_t sequence;
+} ReplayAdd;
+
+// Work shared by the replay threads
+typedef struct {
+    const WalRecord* records;
+    size_t record_count;
+    uint64_t after_sequence;   // Records up to this one are in the checkpoint
+    const ReplayAdd* adds;     // Sorted by patient id
+    size_t add_count;
+    PatientRegistry* registry; // Only read by the replay threads
+    unsigned int threads;
+} ReplayJob;
+
+// One replay thread's partition and result
+typedef struct {
+    const ReplayJob* job;
+    unsigned int partition;
+    uint64_t replayed;
+} ReplayWorker;
+
+/**
+ * @brief Extends an FNV-1a style checksum over 64-bit words.
+ *
+ * @param hash Checksum so far (CHECKSUM_SEED to start).
+ * @param data Data to checksum; length must be a multiple of 8.
+ * @param length Length in bytes.
+ * @return Checksum.
+ */
+static uint64_t checksum_continue(uint64_t hash, const void* data, size_t length) {
+    const uint8_t* bytes = data;
+
+    for (size_t offset = 0; offset + 8 <= length; offset += 8) {
+        uint64_t word;
+        memcpy(&word, bytes + offset, sizeof(word));
+        hash ^= word;
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+/**
+ * @brief Computes the checksum of a buffer.
+ */
+static uint64_t checksum_words(const void* data, size_t length) {
+    return checksum_continue(CHECKSUM_SEED, data, length);
+}
+
+/**
+ * @brief Computes the checksum of a patient's index record and history.
+ */
+static uint64_t record_checksum(const CheckpointIndexRecord* record, const CheckpointHistory* history) {
+    uint64_t hash = checksum_continue(CHECKSUM_SEED, record, offsetof(CheckpointIndexRecord, checksum));
+    return checksum_continue(hash, history, sizeof(*history));
+}
+
+/**
+ * @brief Returns the home bucket of a patient id in the checkpoint table.
+ */
+static uint32_t checkpoint_home(uint32_t patient_id, uint32_t capacity) {
+    return (uint32_t)(patient_id * 2654435761u) & (capacity - 1);
+}
+
+/**
+ * @brief Formats the path of a file inside the store directory.
+ *
+ * @return 0 on success, -1 if the path does not fit.
+ */
+static int store_path(char* path, size_t size, const char* directory, const char* name) {
+    int length = snprintf(path, size, "%s/%s", directory, name);
+    return (length < 0 || (size_t)length >= size) ? -1 : 0;
+}
+
+/**
+ * @brief Formats the path of a WAL segment.
+ *
+ * @return 0 on success, -1 if the path does not fit.
+ */
+static int segment_path(char* path, size_t size, const char* directory, uint32_t segment) {
+    int length = snprintf(path, size, "%s/wal-%08u.log", directory, segment);
+    return (length < 0 || (size_t)length >= size) ? -1 : 0;
+}
+
+/**
+ * @brief Flushes a directory so created, renamed or deleted entries persist.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int sync_directory(const char* directory) {
+    int fd = open(directory, O_RDONLY);
+    if (fd < 0) return -1;
+    int status = fsync(fd);
+    close(fd);
+    return status;
+}
+
+/**
+ * @brief Writes a whole buffer, retrying on partial writes.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int write_all(int fd, const void* data, size_t length) {
+    const uint8_t* cursor = data;
+
+    while (length > 0) {
+        ssize_t written = write(fd, cursor, length);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return -1;
+        cursor += written;
+        length -= (size_t)written;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Reads a file into a caller-supplied buffer.
+ *
+ * @param path File to read.
+ * @param buffer Buffer to fill.
+ * @param capacity Size of the buffer; a longer file is truncated.
+ * @return Number of bytes read.
+ */
+static size_t read_file_into(const char* path, uint8_t* buffer, size_t capacity) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+
+    size_t done = 0;
+    while (done < capacity) {
+        ssize_t got = read(fd, buffer + done, capacity - done);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) break;
+        done += (size_t)got;
+    }
+
+    close(fd);
+    return done;
+}
+
+/**
+ * @brief Lists the WAL segment numbers present in the directory, ascending.
+ *
+ * @param directory Store directory.
+ * @param count Pointer to receive the number of segments.
+ * @return Allocated array (free with free()), or NULL if there are none.
+ */
+static uint32_t* list_segments(const char* directory, size_t* count) {
+    *count = 0;
+    DIR* dir = opendir(directory);
+    if (dir == NULL) return NULL;
+
+    uint32_t* segments = NULL;
+    size_t capacity = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        unsigned int number;
+        char tail;
+        if (sscanf(entry->d_name, "wal-%8u.lo%c", &number, &tail) != 2 || tail != 'g') continue;
+
+        if (*count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            uint32_t* grown = realloc(segments, capacity * sizeof(uint32_t));
+            if (grown == NULL) break;
+            segments = grown;
+        }
+        segments[(*count)++] = number;
+    }
+    closedir(dir);
+
+    // Insertion sort; only segments written since the last checkpoint remain
+    for (size_t i = 1; i < *count; i++) {
+        uint32_t value = segments[i];
+        size_t j = i;
+        while (j > 0 && segments[j - 1] > value) {
+            segments[j] = segments[j - 1];
+            j--;
+        }
+        segments[j] = value;
+    }
+
+    return segments;
+}
+
+/**
+ * @brief Creates a new WAL segment and makes it the current one.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int open_segment(StateStore* store, uint32_t segment) {
+    char path[STATE_STORE_PATH_MAX + 32];
+    if (segment_path(path, sizeof(path), store->directory, segment) != 0) return -1;
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+    if (sync_directory(store->directory) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    if (store->wal_fd >= 0) close(store->wal_fd);
+    store->wal_fd = fd;
+    store->segment = segment;
+    return 0;
+}
+
+/**
+ * @brief Appends one record to the pending group, growing it if needed.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int append_record(StateStore* store, uint32_t type, uint32_t patient_id,
+                         double glucose_value, time_t timestamp) {
+    if (store == NULL || store->group == NULL) return -1;
+    if (store->group_count == store->group_capacity) {
+        // Group sizes are fixed by the caller's commit points, so grow rather than commit early
+        if (store->group_capacity > UINT32_MAX / 2) return -1;
+        WalRecord* grown = realloc(store->group, 2 * (size_t)store->group_capacity * sizeof(WalRecord));
+        if (grown == NULL) return -1;
+        store->group = grown;
+        store->group_capacity *= 2;
+    }
+
+    WalRecord* record = &store->group[store->group_count++];
+    record->type = type;
+    record->patient_id = patient_id;
+    record->timestamp = (int64_t)timestamp;
+    record->glucose_value = glucose_value;
+    record->sequence = store->next_sequence++;
+    store->stats.records_logged++;
+    return 0;
+}
+
+/**
+ * @brief Returns the checkpoint record of a patient id, or NO_RECORD.
+ */
+static uint32_t lookup_record(const LazyCheckpoint* lazy, uint32_t patient_id) {
+    uint32_t capacity = lazy->header->table_capacity;
+    uint32_t mask = capacity - 1;
+    uint32_t pos = checkpoint_home(patient_id, capacity);
+
+    for (uint32_t probes = 0; probes < capacity; probes++) {
+        const CheckpointSlot* slot = &lazy->table[pos];
+        if (slot->record == 0) return NO_RECORD;
+        if (slot->patient_id == patient_id && slot->record - 1 < lazy->header->patient_count) {
+            return slot->record - 1;
+        }
+        pos = (pos + 1) & mask;
+    }
+
+    return NO_RECORD;
+}
+
+/**
+ * @brief Returns the checkpoint record of a patient that is still on disk, or NO_RECORD.
+ */
+static uint32_t on_disk_record(const LazyCheckpoint* lazy, uint32_t patient_id) {
+    if (lazy->base == NULL) return NO_RECORD;
+    uint32_t record_index = lookup_record(lazy, patient_id);
+    if (record_index == NO_RECORD || lazy->residency[record_index] != CHECKPOINT_ON_DISK) return NO_RECORD;
+    return record_index;
+}
+
+/**
+ * @brief Returns non-zero for records that change a patient's history: readings and dropouts.
+ */
+static int is_history_record(const WalRecord* record) {
+    return record->type == WAL_RECORD_READING || record->type == WAL_RECORD_DROPOUT;
+}
+
+/**
+ * @brief Applies a logged reading (history, statistics and alarm state) or dropout (history only).
+ */
+static void apply_reading(PatientState* patient, const WalRecord* record) {
+    if ((record->type & ~(uint32_t)WAL_RECORD_DEFERRED) == WAL_RECORD_DROPOUT) {
+        record_missing_reading(&patient->data);
+        return;
+    }
+    record_glucose_reading(&patient->data, record->glucose_value, (time_t)record->timestamp);
+    update_glucose_statistics(&patient->stats, &patient->data, &patient->config);
+    evaluate_glucose_alarms(&patient->data, &patient->config, &patient->alarm_flags);
+    if (patient->alarm_flags != ALARM_NONE) patient->alarm_count++;
+}
+
+/**
+ * @brief Copies a checkpointed patient from the mapping into the registry.
+ *
+ * A record whose checksum does not match is dropped, not loaded. WAL
+ * readings held back for the patient are replayed on top.
+ *
+ * @return Pointer to the loaded patient, or NULL on error.
+ */
+static PatientState* load_record(LazyCheckpoint* lazy, PatientRegistry* registry, uint32_t record_index) {
+    if (lazy->residency[record_index] != CHECKPOINT_ON_DISK) return NULL;
+
+    const CheckpointIndexRecord* record = &lazy->records[record_index];
+    const CheckpointHistory* history = &lazy->histories[record_index];
+    PatientHandle handle;
+    lazy->on_disk--;
+    if (record_checksum(record, history) != record->checksum ||
+        patient_registry_add(registry, record->patient_id, &record->config, &handle) != 0) {
+        lazy->residency[record_index] = CHECKPOINT_DROPPED;
+        return NULL;
+    }
+    lazy->residency[record_index] = CHECKPOINT_LOADED;
+
+    PatientState* patient = patient_registry_get(registry, handle);
+    memcpy(patient->data.glucose_history, history->glucose_history, sizeof(history->glucose_history));
+    patient->data.history_valid = history->history_valid & GLUCOSE_HISTORY_VALID_MASK;
+    patient->data.glucose_value = record->glucose_value;
+    patient->data.reading_time = (time_t)record->reading_time;
+    if (record->reading_time != 0) {
+        struct tm t_storage;
+        time_t reading_time = (time_t)record->reading_time;
+        if (gmtime_r(&reading_time, &t_storage) != NULL) {
+            strftime(patient->data.timestamp, sizeof(patient->data.timestamp), "%Y-%m-%dT%H:%M:%SZ", &t_storage);
+        }
+    }
+    patient->stats = record->stats;
+    patient->alarm_flags = record->alarm_flags;
+    patient->alarm_count = record->alarm_count;
+
+    if (lazy->deferred_head != NULL) {
+        for (uint32_t next = lazy->deferred_head[record_index]; next != 0; next = lazy->deferred_next[next - 1]) {
+            apply_reading(patient, &lazy->deferred[next - 1]);
+        }
+    }
+    return patient;
+}
+
+/**
+ * @brief Orders prefetch keys by most recent reading first.
+ */
+static int compare_recency(const void* a, const void* b) {
+    const PrefetchKey* left = a;
+    const PrefetchKey* right = b;
+    if (left->reading_time != right->reading_time) return left->reading_time > right->reading_time ? -1 : 1;
+    return left->record < right->record ? -1 : (left->record > right->record);
+}
+
+/**
+ * @brief Pages in checkpointed histories, most recently active patients first.
+ *
+ * Runs on the prefetch thread. Only reads the mapping; copying into the
+ * registry is left to state_store_prefetch() on the owning thread.
+ *
+ * @param argument Pointer to the LazyCheckpoint.
+ * @return NULL.
+ */
+static void* prefetch_checkpoint(void* argument) {
+    LazyCheckpoint* lazy = argument;
+    uint32_t count = lazy->header->patient_count;
+
+    PrefetchKey* keys = malloc((size_t)count * sizeof(PrefetchKey));
+    for (uint32_t i = 0; i < count; i++) {
+        if (keys != NULL) {
+            keys[i].reading_time = lazy->records[i].reading_time;
+            keys[i].record = i;
+        } else {
+            lazy->order[i] = i; // Checkpoint order if there is no memory to sort
+        }
+    }
+    if (keys != NULL) {
+        qsort(keys, count, sizeof(PrefetchKey), compare_recency);
+        for (uint32_t i = 0; i < count; i++) lazy->order[i] = keys[i].record;
+        free(keys);
+    }
+
+    volatile double sink = 0.0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (i % 1024 == 0 && __atomic_load_n(&lazy->prefetch_stop, __ATOMIC_RELAXED)) break;
+
+        // A history can straddle two pages, so touch both ends
+        const CheckpointHistory* history = &lazy->histories[lazy->order[i]];
+        sink += history->glucose_history[0] + history->glucose_history[29];
+        __atomic_store_n(&lazy->paged_in, i + 1, __ATOMIC_RELEASE);
+    }
+    (void)sink;
+
+    return NULL;
+}
+
+/**
+ * @brief Stops the prefetch thread and unmaps the checkpoint.
+ */
+static void release_checkpoint(LazyCheckpoint* lazy) {
+    if (lazy->prefetch_running) {
+        __atomic_store_n(&lazy->prefetch_stop, 1, __ATOMIC_RELAXED);
+        pthread_join(lazy->prefetch_thread, NULL);
+    }
+    if (lazy->base != NULL) munmap((void*)lazy->base, lazy->size);
+    free(lazy->residency);
+    free(lazy->order);
+    free(lazy->deferred);
+    free(lazy->deferred_head);
+    free(lazy->deferred_next);
+    memset(lazy, 0, sizeof(*lazy));
+}
+
+/**
+ * @brief Maps the checkpoint file, if there is one, without loading patients.
+ *
+ * Only the header and section bounds are validated here; each patient's
+ * record is verified against its checksum when it is loaded.
+ *
+ * @param directory Store directory.
+ * @param lazy Pointer to the LazyCheckpoint to fill (left zeroed if there is no checkpoint).
+ * @return 0 on success (including no checkpoint), -1 on a corrupt checkpoint.
+ */
+static int map_checkpoint(const char* directory, LazyCheckpoint* lazy) {
+    memset(lazy, 0, sizeof(*lazy));
+
+    char path[STATE_STORE_PATH_MAX + 32];
+    if (store_path(path, sizeof(path), directory, STATE_STORE_CHECKPOINT_FILE) != 0) return -1;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return errno == ENOENT ? 0 : -1;
+
+    struct stat info;
+    void* base = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && (size_t)info.st_size >= sizeof(CheckpointHeader)) {
+        base = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd); // The mapping keeps the file alive, even after the next checkpoint replaces it
+    if (base == MAP_FAILED) return -1;
+
+    const CheckpointHeader* header = base;
+    uint64_t count = header->patient_count;
+    uint64_t capacity = header->table_capacity;
+    int valid = header->magic == CHECKPOINT_MAGIC && header->version == CHECKPOINT_VERSION &&
+                header->checksum == checksum_words(header, offsetof(CheckpointHeader, checksum)) &&
+                capacity >= CHECKPOINT_MIN_TABLE && (capacity & (capacity - 1)) == 0 && capacity >= 2 * count &&
+                header->table_offset == sizeof(CheckpointHeader) &&
+                header->index_offset == header->table_offset + capacity * sizeof(CheckpointSlot) &&
+                header->history_offset == header->index_offset + count * sizeof(CheckpointIndexRecord) &&
+                (uint64_t)info.st_size == header->history_offset + count * sizeof(CheckpointHistory);
+
+    lazy->base = base;
+    lazy->size = (size_t)info.st_size;
+    lazy->residency = valid ? calloc(count > 0 ? count : 1, 1) : NULL;
+    lazy->order = valid ? malloc((count > 0 ? count : 1) * sizeof(uint32_t)) : NULL;
+    if (lazy->residency == NULL || lazy->order == NULL) {
+        release_checkpoint(lazy);
+        return -1;
+    }
+
+    lazy->header = header;
+    lazy->table = (const CheckpointSlot*)(lazy->base + header->table_offset);
+    lazy->records = (const CheckpointIndexRecord*)(lazy->base + header->index_offset);
+    lazy->histories = (const CheckpointHistory*)(lazy->base + header->history_offset);
+    lazy->on_disk = (uint32_t)count;
+
+    // Read the lookup table and index ahead; histories are paged in on demand
+    posix_madvise((void*)lazy->base, header->history_offset, POSIX_MADV_WILLNEED);
+    posix_madvise((void*)(lazy->base + header->history_offset), (size_t)(count * sizeof(CheckpointHistory)),
+                  POSIX_MADV_RANDOM);
+
+    return 0;
+}
+
+/**
+ * @brief Reads the valid groups of every WAL segment into one array.
+ *
+ * A group whose header or checksum does not match ends its segment, which
+ * is how a write torn by a crash is detected.
+ *
+ * @param directory Store directory.
+ * @param count Pointer to receive the number of records.
+ * @param last_segment Pointer to receive the highest segment number seen (0 if none).
+ * @return Allocated records (free with free()), or NULL if there are none.
+ */
+static WalRecord* read_wal(const char* directory, size_t* count, uint32_t* last_segment) {
+    *count = 0;
+    *last_segment = 0;
+
+    size_t segment_count;
+    uint32_t* segments = list_segments(directory, &segment_count);
+
+    // One buffer sized for every segment; records are compacted over the group
+    // headers in place, so nothing is copied twice and nothing is reallocated
+    size_t total = 0;
+    for (size_t s = 0; s < segment_count; s++) {
+        char path[STATE_STORE_PATH_MAX + 32];
+        struct stat info;
+        if (segment_path(path, sizeof(path), directory, segments[s]) == 0 && stat(path, &info) == 0) {
+            total += (size_t)info.st_size;
+        }
+    }
+    uint8_t* buffer = total > 0 ? malloc(total) : NULL;
+    size_t kept = 0; // Bytes of compacted records at the start of the buffer
+
+    for (size_t s = 0; s < segment_count; s++) {
+        char path[STATE_STORE_PATH_MAX + 32];
+        if (segment_path(path, sizeof(path), directory, segments[s]) != 0) continue;
+        *last_segment = segments[s];
+        if (buffer == NULL) continue;
+
+        // A segment still growing after the sizes were taken is cut at its size then
+        uint8_t* data = buffer + kept;
+        size_t size = read_file_into(path, data, total - kept);
+
+        size_t offset = 0;
+        while (size - offset >= sizeof(WalGroupHeader)) {
+            WalGroupHeader header;
+            memcpy(&header, data + offset, sizeof(header));
+            size_t group_size = (size_t)header.count * sizeof(WalRecord);
+            if (header.magic != WAL_GROUP_MAGIC || size - offset - sizeof(header) < group_size ||
+                checksum_words(data + offset + sizeof(header), group_size) != header.checksum) {
+                break;
+            }
+
+            memmove(buffer + kept, data + offset + sizeof(header), group_size);
+            kept += group_size;
+            offset += sizeof(header) + group_size;
+        }
+    }
+
+    free(segments);
+    *count = kept / sizeof(WalRecord);
+    if (*count == 0) {
+        free(buffer);
+        return NULL;
+    }
+    return (WalRecord*)buffer;
+}
+
+/**
+ * @brief Orders ReplayAdd entries by patient id, then sequence.
+ */
+static int compare_adds(const void* a, const void* b) {
+    const ReplayAdd* left = a;
+    const ReplayAdd* right = b;
+    if (left->patient_id != right->patient_id) return left->patient_id < right->patient_id ? -1 : 1;
+    if (left->sequence != right->sequence) return left->sequence < right->sequence ? -1 : 1;
+    return 0;
+}
+
+/**
+ * @brief Returns the sequence of a patient's latest add in the WAL, or 0.
+ */
+static uint64_t latest_add(const ReplayJob* job, uint32_t patient_id) {
+    size_t low = 0;
+    size_t high = job->add_count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (job->adds[middle].patient_id < patient_id) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return (low < job->add_count && job->adds[low].patient_id == patient_id) ? job->adds[low].sequence : 0;
+}
+
+/**
+ * @brief Replays the readings of one partition of patients in log order.
+ *
+ * @param argument Pointer to the ReplayWorker.
+ * @return NULL.
+ */
+static void* replay_partition(void* argument) {
+    ReplayWorker* worker = argument;
+    const ReplayJob* job = worker->job;
+
+    for (size_t i = 0; i < job->record_count; i++) {
+        const WalRecord* record = &job->records[i];
+        if (!is_history_record(record) || record->sequence <= job->after_sequence) continue;
+        if (record->patient_id % job->threads != worker->partition) continue;
+
+        // Readings logged before the patient's latest add belong to an earlier registration
+        if (job->add_count > 0 && record->sequence < latest_add(job, record->patient_id)) continue;
+
+        PatientState* patient = patient_registry_find(job->registry, record->patient_id, NULL);
+        if (patient == NULL) continue;
+
+        apply_reading(patient, record);
+        worker->replayed++;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Holds a reading back for a patient still in the mapped checkpoint.
+ *
+ * Appends the reading to the patient's list in log order, so load_record()
+ * can replay it.
+ *
+ * @param lazy Pointer to the LazyCheckpoint.
+ * @param tails Per checkpoint record: last held-back reading + 1.
+ * @param record_index Checkpoint record of the patient.
+ * @param wal_index Position of the reading among the WAL records.
+ */
+static void defer_reading(LazyCheckpoint* lazy, uint32_t* tails, uint32_t record_index, uint32_t wal_index) {
+    lazy->deferred_next[wal_index] = 0;
+    if (tails[record_index] == 0) {
+        lazy->deferred_head[record_index] = wal_index + 1;
+    } else {
+        lazy->deferred_next[tails[record_index] - 1] = wal_index + 1;
+    }
+    tails[record_index] = wal_index + 1;
+}
+
+/**
+ * @brief Replays the WAL on top of the checkpoint.
+ *
+ * Readings and dropouts of patients still in the mapped checkpoint are
+ * marked WAL_RECORD_DEFERRED and left for load_record().
+ *
+ * @param store Pointer to the StateStore being opened.
+ * @param records WAL records in log order.
+ * @param count Number of records.
+ * @param after_sequence Last sequence included in the checkpoint.
+ * @param registry Pointer to the registry to update.
+ * @param config Pointer to the thresholds for added patients.
+ * @param threads Number of replay threads.
+ * @param recovery Pointer to the RecoveryStats to update.
+ * @return 1 if the records were kept for held-back readings, 0 on other success, -1 on error.
+ */
+static int replay_wal(StateStore* store, WalRecord* records, size_t count, uint64_t after_sequence,
+                      PatientRegistry* registry, const Config* config, unsigned int threads,
+                      RecoveryStats* recovery) {
+    ReplayAdd* adds = NULL;
+    size_t add_count = 0;
+    size_t add_capacity = 0;
+    uint64_t membership_changes = 0;
+    uint64_t deferred = 0;
+    LazyCheckpoint* lazy = &store->lazy;
+    uint32_t* tails = NULL;
+
+    if (lazy->base != NULL && lazy->on_disk > 0 && count > 0) {
+        if (count >= UINT32_MAX) return -1;
+        lazy->deferred_head = calloc(lazy->header->patient_count + 1, sizeof(uint32_t));
+        lazy->deferred_next = malloc(count * sizeof(uint32_t));
+        tails = calloc(lazy->header->patient_count + 1, sizeof(uint32_t));
+        if (lazy->deferred_head == NULL || lazy->deferred_next == NULL || tails == NULL) {
+            free(tails);
+            return -1;
+        }
+    }
+
+    // Registry changes are applied in order on this thread; nothing is loaded from the checkpoint
+    for (size_t i = 0; i < count; i++) {
+        WalRecord* record = &records[i];
+        if (record->sequence <= after_sequence) continue;
+
+        // Consecutive readings belong to different patients; start the table miss early
+        if (tails != NULL && i + REPLAY_PREFETCH_DISTANCE < count) {
+            uint32_t ahead = records[i + REPLAY_PREFETCH_DISTANCE].patient_id;
+            __builtin_prefetch(&lazy->table[checkpoint_home(ahead, lazy->header->table_capacity)]);
+        }
+
+        if (is_history_record(record)) {
+            uint32_t record_index = on_disk_record(lazy, record->patient_id);
+            if (record_index != NO_RECORD) {
+                record->type |= WAL_RECORD_DEFERRED;
+                defer_reading(lazy, tails, record_index, (uint32_t)i);
+                deferred++;
+            }
+            continue;
+        }
+
+        uint32_t record_index = on_disk_record(lazy, record->patient_id);
+        if (record->type == WAL_RECORD_ADD) {
+            if (record_index != NO_RECORD || patient_registry_find(registry, record->patient_id, NULL) != NULL) continue;
+            PatientHandle handle;
+            if (patient_registry_add(registry, record->patient_id, config, &handle) != 0) continue;
+            if (add_count == add_capacity) {
+                add_capacity = add_capacity ? add_capacity * 2 : 256;
+                ReplayAdd* grown = realloc(adds, add_capacity * sizeof(ReplayAdd));
+                if (grown == NULL) {
+                    free(adds);
+                    free(tails);
+                    return -1;
+                }
+                adds = grown;
+            }
+            adds[add_count].patient_id = record->patient_id;
+            adds[add_count].sequence = record->sequence;
+            add_count++;
+        } else if (record->type == WAL_RECORD_REMOVE) {
+            uint32_t index;
+            PatientHandle handle;
+            if (record_index != NO_RECORD) {
+                lazy->residency[record_index] = CHECKPOINT_DROPPED; // Its held-back readings die with it
+                lazy->on_disk--;
+            } else if (patient_registry_find(registry, record->patient_id, &index) == NULL ||
+                patient_registry_handle_at(registry, index, &handle) != 0 ||
+                patient_registry_remove(registry, handle) != 0) {
+                continue;
+            }
+        }
+        membership_changes++;
+    }
+
+    // Keep only the latest add of each patient
+    qsort(adds, add_count, sizeof(ReplayAdd), compare_adds);
+    size_t unique = 0;
+    for (size_t i = 0; i < add_count; i++) {
+        if (unique > 0 && adds[unique - 1].patient_id == adds[i].patient_id) unique--;
+        adds[unique++] = adds[i];
+    }
+
+    ReplayJob job = {records, count, after_sequence, adds, unique, registry, threads};
+    ReplayWorker workers[REPLAY_MAX_THREADS];
+    pthread_t thread_ids[REPLAY_MAX_THREADS];
+    unsigned int started = 0;
+
+    for (unsigned int t = 0; t < threads; t++) {
+        workers[t].job = &job;
+        workers[t].partition = t;
+        workers[t].replayed = 0;
+    }
+    // Partition 0 runs on this thread; the rest fall back to it if a thread cannot start
+    for (unsigned int t = 1; t < threads; t++) {
+        if (pthread_create(&thread_ids[t], NULL, replay_partition, &workers[t]) != 0) break;
+        started = t;
+    }
+    replay_partition(&workers[0]);
+    for (unsigned int t = 1; t <= started; t++) pthread_join(thread_ids[t], NULL);
+    for (unsigned int t = started + 1; t < threads; t++) replay_partition(&workers[t]);
+
+    uint64_t replayed = membership_changes;
+    for (unsigned int t = 0; t < threads; t++) replayed += workers[t].replayed;
+    recovery->records_replayed = replayed;
+    recovery->records_deferred = deferred;
+    recovery->records_skipped = count - replayed - deferred;
+
+    free(adds);
+    free(tails);
+    if (deferred == 0) {
+        free(lazy->deferred_head);
+        free(lazy->deferred_next);
+        lazy->deferred_head = NULL;
+        lazy->deferred_next = NULL;
+        return 0;
+    }
+    lazy->deferred = records; // Kept for load_record()
+    return 1;
+}
+
+/**
+ * @brief Opens a store, restoring its state into an empty registry.
+ *
+ * Creates the directory if it does not exist. Logging continues in a new
+ * segment, so a torn tail left by a crash is never appended to.
+ *
+ * @param store Pointer to the StateStore structure to initialize.
+ * @param directory Directory holding the checkpoint and WAL segments.
+ * @param registry Pointer to an empty registry to restore into.
+ * @param config Pointer to the thresholds for patients added through the WAL.
+ * @param replay_threads Threads for reading replay (0 = online CPUs).
+ * @param lazy Non-zero to leave checkpointed patients on disk until touched.
+ * @param recovery Pointer to receive recovery statistics, or NULL.
+ * @return 0 on success, -1 on error.
+ */
+int state_store_open(StateStore* store, const char* directory, PatientRegistry* registry,
+                     const Config* config, unsigned int replay_threads, int lazy,
+                     RecoveryStats* recovery) {
+    if (store == NULL || directory == NULL || registry == NULL || config == NULL) return -1;
+    if (strlen(directory) >= sizeof(store->directory)) return -1;
+
+    memset(store, 0, sizeof(*store));
+    strcpy(store->directory, directory);
+    store->wal_fd = -1;
+    store->sync = 1;
+
+    if (mkdir(directory, 0755) != 0 && errno != EEXIST) return -1;
+
+    RecoveryStats local;
+    if (recovery == NULL) recovery = &local;
+    memset(recovery, 0, sizeof(*recovery));
+
+    if (replay_threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        replay_threads = online > 0 ? (unsigned int)online : 1;
+    }
+    if (replay_threads > REPLAY_MAX_THREADS) replay_threads = REPLAY_MAX_THREADS;
+    recovery->threads = replay_threads;
+
+    uint64_t start = latency_now_ns();
+    LazyCheckpoint* mapped = &store->lazy;
+    if (map_checkpoint(directory, mapped) != 0) return -1;
+
+    CheckpointHeader checkpoint;
+    memset(&checkpoint, 0, sizeof(checkpoint));
+    if (mapped->base != NULL) {
+        checkpoint = *mapped->header;
+        if (lazy) {
+            // Page histories in from the start, so the WAL replay below overlaps with it
+            mapped->prefetch_running =
+                pthread_create(&mapped->prefetch_thread, NULL, prefetch_checkpoint, mapped) == 0;
+            if (!mapped->prefetch_running) {
+                for (uint32_t i = 0; i < checkpoint.patient_count; i++) mapped->order[i] = i;
+                mapped->paged_in = checkpoint.patient_count;
+            }
+        } else {
+            if (patient_registry_reserve(registry, checkpoint.patient_count) != 0) {
+                release_checkpoint(mapped);
+                return -1;
+            }
+            for (uint32_t i = 0; i < checkpoint.patient_count; i++) load_record(mapped, registry, i);
+        }
+    }
+    recovery->checkpoint_patients = checkpoint.patient_count;
+    uint64_t loaded = latency_now_ns();
+
+    size_t record_count;
+    uint32_t last_segment;
+    WalRecord* records = read_wal(directory, &record_count, &last_segment);
+    int status = replay_wal(store, records, record_count, checkpoint.last_sequence, registry, config,
+                            replay_threads, recovery);
+    uint64_t last_sequence = record_count > 0 ? records[record_count - 1].sequence : 0;
+    if (status != 1) free(records); // Otherwise kept for the held-back readings
+    if (mapped->on_disk == 0) release_checkpoint(mapped);
+    if (status < 0) {
+        release_checkpoint(mapped);
+        return -1;
+    }
+
+    recovery->checkpoint_seconds = (double)(loaded - start) / 1e9;
+    recovery->replay_seconds = (double)(latency_now_ns() - loaded) / 1e9;
+    recovery->lazy_patients = mapped->on_disk;
+
+    if (last_sequence < checkpoint.last_sequence) last_sequence = checkpoint.last_sequence;
+    if (last_segment < checkpoint.covered_segment) last_segment = checkpoint.covered_segment;
+    store->next_sequence = last_sequence + 1;
+    store->oldest_segment = checkpoint.covered_segment + 1;
+
+    store->group = malloc(STATE_STORE_GROUP_CAPACITY * sizeof(WalRecord));
+    store->group_capacity = STATE_STORE_GROUP_CAPACITY;
+    if (store->group == NULL || open_segment(store, last_segment + 1) != 0) {
+        free(store->group);
+        store->group = NULL;
+        release_checkpoint(mapped);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Finds a patient, loading it from the mapped checkpoint if needed.
+ *
+ * Use instead of patient_registry_find() while the store may hold
+ * patients that have not been loaded yet.
+ *
+ * @param store Pointer to the open StateStore.
+ * @param registry Pointer to the registry the store was opened with.
+ * @param patient_id External patient identifier.
+ * @param index Optional pointer to receive the patient's dense position.
+ * @return Pointer to the patient's state, or NULL if the patient is unknown.
+ */
+PatientState* state_store_find_patient(StateStore* store, PatientRegistry* registry,
+                                       uint32_t patient_id, uint32_t* index) {
+    PatientState* patient = patient_registry_find(registry, patient_id, index);
+    if (patient != NULL || store == NULL || store->lazy.base == NULL) return patient;
+
+    uint32_t record_index = lookup_record(&store->lazy, patient_id);
+    if (record_index == NO_RECORD) return NULL;
+
+    patient = load_record(&store->lazy, registry, record_index);
+    if (patient != NULL && index != NULL) *index = patient_registry_count(registry) - 1; // Added last
+    return patient;
+}
+
+/**
+ * @brief Checks whether a patient is known, without loading it.
+ *
+ * @param store Pointer to the open StateStore, or NULL.
+ * @param registry Pointer to the registry the store was opened with.
+ * @param patient_id External patient identifier.
+ * @return 1 if the patient is in the registry or still in the mapped checkpoint, 0 otherwise.
+ */
+int state_store_has_patient(StateStore* store, PatientRegistry* registry, uint32_t patient_id) {
+    if (patient_registry_find(registry, patient_id, NULL) != NULL) return 1;
+    return store != NULL && on_disk_record(&store->lazy, patient_id) != NO_RECORD;
+}
+
+/**
+ * @brief Loads patients the background thread has already paged in.
+ *
+ * Releases the mapping once every patient is loaded.
+ *
+ * @param store Pointer to the open StateStore.
+ * @param registry Pointer to the registry the store was opened with.
+ * @param budget Maximum number of patients to load in this call.
+ * @return Number of patients still waiting in the mapped checkpoint.
+ */
+uint32_t state_store_prefetch(StateStore* store, PatientRegistry* registry, uint32_t budget) {
+    if (store == NULL || registry == NULL || store->lazy.base == NULL) return 0;
+
+    LazyCheckpoint* lazy = &store->lazy;
+    uint32_t paged_in = __atomic_load_n(&lazy->paged_in, __ATOMIC_ACQUIRE);
+    while (budget > 0 && lazy->next < paged_in) {
+        uint32_t record_index = lazy->order[lazy->next++];
+        if (lazy->residency[record_index] != CHECKPOINT_ON_DISK) continue; // Already touched
+        load_record(lazy, registry, record_index);
+        budget--;
+    }
+
+    if (lazy->on_disk == 0) release_checkpoint(lazy);
+    return lazy->on_disk;
+}
+
+/**
+ * @brief Logs that a patient was registered.
+ *
+ * @param store Pointer to the open StateStore.
+ * @param patient_id External patient identifier.
+ * @return 0 on success, -1 on error.
+ */
+int state_store_log_add(StateStore* store, uint32_t patient_id) {
+    return append_record(store, WAL_RECORD_ADD, patient_id, 0.0, 0);
+}
+
+/**
+ * @brief Logs that a patient was unregistered.
+ *
+ * @param store Pointer to the open StateStore.
+ * @param patient_id External patient identifier.
+ * @return 0 on success, -1 on error.
+ */
+int state_store_log_remove(StateStore* store, uint32_t patient_id) {
+    return append_record(store, WAL_RECORD_REMOVE, patient_id, 0.0, 0);
+}
+
+/**
+ * @brief Logs a recorded reading.
+ *
+ * @param store Pointer to the open StateStore.
+ * @param patient_id External patient identifier.
+ * @param glucose_value Reading in mg/dL.
+ * @param timestamp Time of the reading.
+ * @return 0 on success, -1 on error.
+ */
+int state_store_log_reading(StateStore* store, uint32_t patient_id, double glucose_value, time_t timestamp) {
+    return append_record(store, WAL_RECORD_READING, patient_id, glucose_value, timestamp);
+}
+
+/**
+ * @brief Logs a sensor dropout, recorded with record_missing_reading().
+ *
+ * @param store Pointer to the open StateStore.
+ * @param patient_id External patient identifier.
+ * @param timestamp Time the missing reading was due.
+ * @return 0 on success, -1 on error.
+ */
+int state_store_log_dropout(StateStore* store, uint32_t patient_id, time_t timestamp) {
+    return append_record(store, WAL_RECORD_DROPOUT, patient_id, 0.0, timestamp);
+}
+
+/**
+ * @brief Writes the pending group to the WAL as one write (group commit).
+ *
+ * @param store Pointer to the open StateStore.
+ * @return 0 on success, -1 on error.
+ */
+int state_store_commit(StateStore* store) {
+    if (store == NULL || store->wal_fd < 0) return -1;
+    if (store->group_count == 0) return 0;
+
+    size_t group_size = store->group_count * sizeof(WalRecord);
+    WalGroupHeader header = {WAL_GROUP_MAGIC, store->group_count, checksum_words(store->group, group_size)};
+    struct iovec parts[2] = {{&header, sizeof(header)}, {store->group, group_size}};
+
+    // A single writev normally completes; fall back to plain writes if it is cut short
+    ssize_t written = writev(store->wal_fd, parts, 2);
+    if (written < 0) return -1;
+    if ((size_t)written < sizeof(header) + group_size) {
+        size_t done = (size_t)written;
+        if (done < sizeof(header) &&
+            write_all(store->wal_fd, (const uint8_t*)&header + done, sizeof(header) - done) != 0) return -1;
+        size_t group_done = done > sizeof(header) ? done - sizeof(header) : 0;
+        if (write_all(store->wal_fd, (const uint8_t*)store->group + group_done, group_size - group_done) != 0) return -1;
+    }
+    if (store->sync && fdatasync(store->wal_fd) != 0) return -1;
+
+    store->stats.groups_committed++;
+    store->stats.wal_bytes += sizeof(header) + group_size;
+    store->group_count = 0;
+    return 0;
+}
+
+/**
+ * @brief Writes the snapshot, replaces the checkpoint and drops covered segments.
+ *
+ * Runs on the checkpoint thread; only touches the snapshot fields.
+ *
+ * @param argument Pointer to the StateStore.
+ * @return NULL.
+ */
+static void* write_checkpoint(void* argument) {
+    StateStore* store = argument;
+    char temp_path[STATE_STORE_PATH_MAX + 32];
+    char final_path[STATE_STORE_PATH_MAX + 32];
+    store->checkpoint_result = -1;
+
+    if (store_path(temp_path, sizeof(temp_path), store->directory, CHECKPOINT_TEMP_FILE) != 0 ||
+        store_path(final_path, sizeof(final_path), store->directory, STATE_STORE_CHECKPOINT_FILE) != 0) {
+        return NULL;
+    }
+
+    // The lookup table is built here rather than on the caller's thread
+    const CheckpointHeader* header = (const CheckpointHeader*)store->snapshot;
+    const CheckpointIndexRecord* records = (const CheckpointIndexRecord*)(store->snapshot + sizeof(CheckpointHeader));
+    uint32_t capacity = header->table_capacity;
+    CheckpointSlot* table = calloc(capacity, sizeof(CheckpointSlot));
+    if (table == NULL) return NULL;
+    for (uint32_t i = 0; i < header->patient_count; i++) {
+        uint32_t pos = checkpoint_home(records[i].patient_id, capacity);
+        while (table[pos].record != 0) pos = (pos + 1) & (capacity - 1);
+        table[pos].patient_id = records[i].patient_id;
+        table[pos].record = i + 1;
+    }
+
+    int fd = open(temp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    int status = fd < 0 ? -1 : 0;
+    if (status == 0) status = write_all(fd, header, sizeof(CheckpointHeader));
+    if (status == 0) status = write_all(fd, table, (size_t)capacity * sizeof(CheckpointSlot));
+    if (status == 0) {
+        status = write_all(fd, store->snapshot + sizeof(CheckpointHeader),
+                           store->snapshot_size - sizeof(CheckpointHeader));
+    }
+    if (status == 0) status = fsync(fd);
+    free(table);
+    if (fd < 0) return NULL;
+    close(fd);
+
+    // The rename is the commit point: the old checkpoint stays valid until then
+    if (status != 0 || rename(temp_path, final_path) != 0 || sync_directory(store->directory) != 0) {
+        unlink(temp_path);
+        return NULL;
+    }
+
+    for (uint32_t segment = store->oldest_segment; segment <= store->covered_segment; segment++) {
+        char path[STATE_STORE_PATH_MAX + 32];
+        if (segment_path(path, sizeof(path), store->directory, segment) == 0) unlink(path);
+    }
+
+    store->checkpoint_result = 0;
+    return NULL;
+}
+
+/**
+ * @brief Records the outcome of a written checkpoint.
+ *
+ * @return 0 if the checkpoint succeeded, -1 otherwise.
+ */
+static int complete_checkpoint(StateStore* store) {
+    if (store->checkpoint_result != 0) return -1;
+
+    store->oldest_segment = store->covered_segment + 1;
+    store->stats.checkpoints++;
+    store->stats.checkpoint_bytes = store->snapshot_size +
+                                    ((const CheckpointHeader*)store->snapshot)->table_capacity * sizeof(CheckpointSlot);
+    return 0;
+}
+
+/**
+ * @brief Waits for the running checkpoint, if any, and records its outcome.
+ *
+ * @return 0 if no checkpoint failed, -1 otherwise.
+ */
+static int finish_checkpoint(StateStore* store) {
+    if (!store->checkpoint_running) return 0;
+
+    pthread_join(store->checkpoint_thread, NULL);
+    store->checkpoint_running = 0;
+    return complete_checkpoint(store);
+}
+
+/**
+ * @brief Starts a checkpoint of the registry in the background.
+ *
+ * Commits the pending group, waits for the previous checkpoint to finish,
+ * snapshots the registry and starts a new WAL segment. Only the snapshot
+ * copy runs on the caller's thread.
+ *
+ * @param store Pointer to the open StateStore.
+ * @param registry Pointer to the registry to snapshot.
+ * @return 0 on success, -1 on error (including a failed previous checkpoint).
+ */
+int state_store_checkpoint(StateStore* store, PatientRegistry* registry) {
+    if (store == NULL || registry == NULL || store->wal_fd < 0) return -1;
+    if (state_store_commit(store) != 0) return -1;
+    int previous = finish_checkpoint(store);
+
+    // Patients of a lazily opened store that were never touched are carried over as
+    // they are, unless the WAL segments about to be deleted hold readings for them
+    LazyCheckpoint* lazy = &store->lazy;
+    for (uint32_t i = 0; lazy->deferred_head != NULL && i < lazy->header->patient_count; i++) {
+        if (lazy->deferred_head[i] != 0) load_record(lazy, registry, i);
+    }
+    uint32_t loaded_count = patient_registry_count(registry);
+    uint32_t patient_count = loaded_count + lazy->on_disk;
+    size_t size = sizeof(CheckpointHeader) +
+                  (size_t)patient_count * (sizeof(CheckpointIndexRecord) + sizeof(CheckpointHistory));
+    if (size > store->snapshot_capacity) {
+        uint8_t* grown = realloc(store->snapshot, size);
+        if (grown == NULL) return -1;
+        store->snapshot = grown;
+        store->snapshot_capacity = size;
+    }
+
+    CheckpointIndexRecord* records = (CheckpointIndexRecord*)(store->snapshot + sizeof(CheckpointHeader));
+    CheckpointHistory* histories = (CheckpointHistory*)(records + patient_count);
+    for (uint32_t i = 0; i < loaded_count; i++) {
+        const PatientState* patient = patient_registry_at(registry, i);
+        CheckpointIndexRecord* record = &records[i];
+        record->patient_id = patient->patient_id;
+        record->alarm_flags = patient->alarm_flags;
+        record->alarm_count = patient->alarm_count;
+        record->reserved = 0;
+        record->reading_time = (int64_t)patient->data.reading_time;
+        record->glucose_value = patient->data.glucose_value;
+        record->stats = patient->stats;
+        record->config = patient->config;
+        memcpy(histories[i].glucose_history, patient->data.glucose_history, sizeof(histories[i].glucose_history));
+        histories[i].history_valid = patient->data.history_valid;
+        record->checksum = record_checksum(record, &histories[i]);
+    }
+    uint32_t next = loaded_count;
+    for (uint32_t i = 0; lazy->base != NULL && i < lazy->header->patient_count; i++) {
+        if (lazy->residency[i] != CHECKPOINT_ON_DISK) continue;
+        records[next] = lazy->records[i];
+        histories[next] = lazy->histories[i];
+        next++;
+    }
+
+    uint32_t capacity = CHECKPOINT_MIN_TABLE;
+    while (capacity < 2 * (uint64_t)patient_count) capacity *= 2;
+
+    CheckpointHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = CHECKPOINT_MAGIC;
+    header.version = CHECKPOINT_VERSION;
+    header.patient_count = patient_count;
+    header.table_capacity = capacity;
+    header.last_sequence = store->next_sequence - 1;
+    header.covered_segment = store->segment;
+    header.table_offset = sizeof(CheckpointHeader);
+    header.index_offset = header.table_offset + (uint64_t)capacity * sizeof(CheckpointSlot);
+    header.history_offset = header.index_offset + (uint64_t)patient_count * sizeof(CheckpointIndexRecord);
+    header.checksum = checksum_words(&header, offsetof(CheckpointHeader, checksum));
+    memcpy(store->snapshot, &header, sizeof(header));
+    store->snapshot_size = size;
+    store->covered_segment = store->segment;
+
+    // Changes after the snapshot go to a segment the checkpoint does not cover
+    if (open_segment(store, store->segment + 1) != 0) return -1;
+
+    // Without a thread the checkpoint is written synchronously
+    if (pthread_create(&store->checkpoint_thread, NULL, write_checkpoint, store) != 0) {
+        write_checkpoint(store);
+        return complete_checkpoint(store) != 0 ? -1 : previous;
+    }
+    store->checkpoint_running = 1;
+
+    return previous;
+}
+
+/**
+ * @brief Commits pending records, waits for any checkpoint and closes the store.
+ *
+ * @param store Pointer to the StateStore to close.
+ * @return 0 on success, -1 on error.
+ */
+int state_store_close(StateStore* store) {
+    if (store == NULL) return -1;
+
+    int status = 0;
+    if (store->wal_fd >= 0 && state_store_commit(store) != 0) status = -1;
+    if (finish_checkpoint(store) != 0) status = -1;
+
+    release_checkpoint(&store->lazy);
+    if (store->wal_fd >= 0) close(store->wal_fd);
+    free(store->group);
+    free(store->snapshot);
+    store->wal_fd = -1;
+    store->group = NULL;
+    store->snapshot = NULL;
+    store->snapshot_capacity = 0;
+
+    return status;
+}
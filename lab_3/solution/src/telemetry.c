@@ -0,0 +1,171 @@
+/**
+ * @file telemetry.c
+ * @brief Contains the shared-memory telemetry publisher.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../include/telemetry.h"
+#include "../include/seqlock.h"
+#include <fcntl.h>
+#include <math.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+// The Python reader hard-codes these sizes; fail the build if they drift
+typedef char telemetry_header_size_check[(sizeof(TelemetryHeader) == 64) ? 1 : -1];
+typedef char telemetry_slot_size_check[(sizeof(TelemetrySlot) == TELEMETRY_SLOT_SIZE) ? 1 : -1];
+
+/**
+ * @brief Returns the header at the start of the mapped segment.
+ */
+static TelemetryHeader* header_of(const TelemetryFeed* feed) {
+    return (TelemetryHeader*)feed->base;
+}
+
+/**
+ * @brief Returns a slot of the mapped segment.
+ */
+static TelemetrySlot* slot_of(const TelemetryFeed* feed, uint32_t index) {
+    return (TelemetrySlot*)((char*)feed->base + sizeof(TelemetryHeader)) + index;
+}
+
+/**
+ * @brief Creates (or recreates) the shared-memory segment.
+ *
+ * Any existing segment with the same name is removed first so readers
+ * never see a layout from an older engine.
+ *
+ * @param feed Pointer to the TelemetryFeed structure to initialize.
+ * @param name POSIX shared-memory name, e.g. TELEMETRY_SHM_NAME.
+ * @param capacity Number of patient slots.
+ * @param sample_interval_s Seconds between readings, for readers' time axes.
+ * @return 0 on success, -1 on error.
+ */
+int telemetry_open(TelemetryFeed* feed, const char* name, uint32_t capacity, uint32_t sample_interval_s) {
+    if (feed == NULL || name == NULL || capacity == 0 || strlen(name) >= sizeof(feed->name)) return -1;
+
+    memset(feed, 0, sizeof(*feed));
+    feed->fd = -1;
+    strcpy(feed->name, name);
+    feed->capacity = capacity;
+    feed->size = sizeof(TelemetryHeader) + (size_t)capacity * sizeof(TelemetrySlot);
+
+    shm_unlink(name);
+    feed->fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (feed->fd < 0) return -1;
+
+    if (ftruncate(feed->fd, (off_t)feed->size) != 0) {
+        telemetry_close(feed, 1);
+        return -1;
+    }
+
+    feed->base = mmap(NULL, feed->size, PROT_READ | PROT_WRITE, MAP_SHARED, feed->fd, 0);
+    if (feed->base == MAP_FAILED) {
+        feed->base = NULL;
+        telemetry_close(feed, 1);
+        return -1;
+    }
+
+    TelemetryHeader* header = header_of(feed);
+    header->version = TELEMETRY_VERSION;
+    header->capacity = capacity;
+    header->slot_size = TELEMETRY_SLOT_SIZE;
+    header->sample_interval_s = sample_interval_s;
+
+    // Readers check the magic last, so publish it once the header is complete
+    __atomic_store_n(&header->magic, TELEMETRY_MAGIC, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+/**
+ * @brief Publishes a patient's latest state into a slot.
+ *
+ * Statistics are published in their display form (percentages and
+ * standard deviation) so readers do not need to re-derive them.
+ *
+ * @param feed Pointer to the open TelemetryFeed.
+ * @param slot_index Slot to write (usually the patient's dense position).
+ * @param patient Pointer to the patient's state.
+ * @return 0 on success, -1 on error.
+ */
+int telemetry_publish(TelemetryFeed* feed, uint32_t slot_index, const PatientState* patient) {
+    if (feed == NULL || feed->base == NULL || patient == NULL || slot_index >= feed->capacity) return -1;
+
+    const GlucoseStats* stats = &patient->stats;
+    double total = stats->time_in_range + stats->time_below_range + stats->time_above_range;
+    TelemetrySlot* slot = slot_of(feed, slot_index);
+
+    seqlock_write_begin(&slot->sequence);
+
+    slot->patient_id = patient->patient_id;
+    slot->alarm_flags = patient->alarm_flags;
+    slot->timestamp = (int64_t)patient->data.reading_time;
+    slot->glucose_value = patient->data.glucose_value;
+    for (int i = 0; i < TELEMETRY_HISTORY_LENGTH; i++) {
+        slot->history[i] = glucose_from_fixed(patient->data.glucose_history[i]);
+    }
+    if (total > 0) {
+        slot->time_in_range = stats->time_in_range / total * 100.0;
+        slot->time_below_range = stats->time_below_range / total * 100.0;
+        slot->time_above_range = stats->time_above_range / total * 100.0;
+        slot->glucose_variability = sqrt(stats->glucose_variability / total);
+    } else {
+        slot->time_in_range = 0.0;
+        slot->time_below_range = 0.0;
+        slot->time_above_range = 0.0;
+        slot->glucose_variability = 0.0;
+    }
+    slot->avg_glucose = stats->avg_glucose;
+    slot->reading_count = (uint32_t)total;
+    slot->alarm_count = patient->alarm_count;
+    slot->trend = (int32_t)calculate_glucose_trend(&patient->data);
+    slot->history_valid = patient->data.history_valid;
+
+    seqlock_write_end(&slot->sequence);
+
+    TelemetryHeader* header = header_of(feed);
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    __atomic_store_n(&header->updated_unix_ns,
+                     (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec, __ATOMIC_RELAXED);
+    __atomic_store_n(&header->publish_count, header->publish_count + 1, __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+/**
+ * @brief Sets how many slots readers should consider.
+ *
+ * @param feed Pointer to the open TelemetryFeed.
+ * @param patient_count Number of slots in use.
+ * @return 0 on success, -1 on error.
+ */
+int telemetry_set_patient_count(TelemetryFeed* feed, uint32_t patient_count) {
+    if (feed == NULL || feed->base == NULL || patient_count > feed->capacity) return -1;
+
+    __atomic_store_n(&header_of(feed)->patient_count, patient_count, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/**
+ * @brief Unmaps the segment and optionally removes its name.
+ *
+ * @param feed Pointer to the TelemetryFeed to close.
+ * @param unlink_segment Non-zero to remove the segment name.
+ * @return 0 on success, -1 on error.
+ */
+int telemetry_close(TelemetryFeed* feed, int unlink_segment) {
+    if (feed == NULL) return -1;
+
+    if (feed->base != NULL) munmap(feed->base, feed->size);
+    if (feed->fd >= 0) close(feed->fd);
+    if (unlink_segment && feed->name[0] != '\0') shm_unlink(feed->name);
+
+    feed->base = NULL;
+    feed->fd = -1;
+    return 0;
+}
@@ -0,0 +1,558 @@
+/**
+ * @file terminal_ui.c
+ * @brief Contains the delta-rendering terminal dashboard.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../include/terminal_ui.h"
+#include "../include/alarm.h"
+#include "../include/analysis.h"
+#include "../include/latency.h"
+#include <errno.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SPARKLINE_MIN_MG_DL 40   // Lowest bar
+#define SPARKLINE_MAX_MG_DL 300  // Highest bar
+#define SPARKLINE_LEVELS 8       // U+2581 .. U+2588
+#define CURSOR_SKIP_MAX 4        // Unchanged cells rewritten instead of moving the cursor
+#define FORMAT_MAX 512
+
+// SGR sequence of each TerminalStyle
+static const char* const style_sequences[TERMINAL_STYLE_COUNT] = {
+    "\x1b[0m", "\x1b[0;1m", "\x1b[0;2m", "\x1b[0;31m", "\x1b[0;33m", "\x1b[0;32m", "\x1b[0;7m"
+};
+
+/**
+ * @brief Appends bytes to the frame's output buffer.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int append(TerminalUI* ui, const char* bytes, size_t length) {
+    if (ui->output_length + length > ui->output_capacity) {
+        size_t capacity = ui->output_capacity > 0 ? ui->output_capacity : 4096;
+        while (capacity < ui->output_length + length) capacity *= 2;
+        char* output = realloc(ui->output, capacity);
+        if (output == NULL) return -1;
+        ui->output = output;
+        ui->output_capacity = capacity;
+    }
+    memcpy(ui->output + ui->output_length, bytes, length);
+    ui->output_length += length;
+    return 0;
+}
+
+/**
+ * @brief Encodes a code point as UTF-8.
+ *
+ * @return Number of bytes written to buffer (1 to 4).
+ */
+static size_t encode_utf8(uint32_t glyph, char* buffer) {
+    if (glyph < 0x80) {
+        buffer[0] = (char)glyph;
+        return 1;
+    }
+    if (glyph < 0x800) {
+        buffer[0] = (char)(0xC0 | (glyph >> 6));
+        buffer[1] = (char)(0x80 | (glyph & 0x3F));
+        return 2;
+    }
+    if (glyph < 0x10000) {
+        buffer[0] = (char)(0xE0 | (glyph >> 12));
+        buffer[1] = (char)(0x80 | ((glyph >> 6) & 0x3F));
+        buffer[2] = (char)(0x80 | (glyph & 0x3F));
+        return 3;
+    }
+    buffer[0] = (char)(0xF0 | (glyph >> 18));
+    buffer[1] = (char)(0x80 | ((glyph >> 12) & 0x3F));
+    buffer[2] = (char)(0x80 | ((glyph >> 6) & 0x3F));
+    buffer[3] = (char)(0x80 | (glyph & 0x3F));
+    return 4;
+}
+
+/**
+ * @brief Decodes the next code point of a UTF-8 string.
+ *
+ * @return Code point ('?' for a malformed sequence), with text advanced past it.
+ */
+static uint32_t decode_utf8(const char** text) {
+    const unsigned char* bytes = (const unsigned char*)*text;
+    uint32_t glyph;
+    int extra;
+
+    if (bytes[0] < 0x80) {
+        glyph = bytes[0];
+        extra = 0;
+    } else if ((bytes[0] & 0xE0) == 0xC0) {
+        glyph = bytes[0] & 0x1F;
+        extra = 1;
+    } else if ((bytes[0] & 0xF0) == 0xE0) {
+        glyph = bytes[0] & 0x0F;
+        extra = 2;
+    } else if ((bytes[0] & 0xF8) == 0xF0) {
+        glyph = bytes[0] & 0x07;
+        extra = 3;
+    } else {
+        (*text)++;
+        return '?';
+    }
+
+    for (int i = 1; i <= extra; i++) {
+        if ((bytes[i] & 0xC0) != 0x80) {
+            *text += i;
+            return '?';
+        }
+        glyph = (glyph << 6) | (bytes[i] & 0x3F);
+    }
+    *text += extra + 1;
+    return glyph;
+}
+
+/**
+ * @brief Writes the whole output buffer to the terminal.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int flush_output(TerminalUI* ui) {
+    size_t written = 0;
+    while (written < ui->output_length) {
+        ssize_t result = write(ui->fd, ui->output + written, ui->output_length - written);
+        if (result < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        written += (size_t)result;
+    }
+    ui->stats.bytes_written += written;
+    ui->output_length = 0;
+    return 0;
+}
+
+/**
+ * @brief Switches the terminal to a full-screen alternate buffer.
+ *
+ * @param ui Pointer to the TerminalUI structure to initialize.
+ * @param fd Terminal file descriptor (e.g. STDOUT_FILENO).
+ * @param max_fps Maximum frames per second (1 to TERMINAL_UI_MAX_FPS).
+ * @return 0 on success, -1 on error.
+ */
+int terminal_ui_open(TerminalUI* ui, int fd, int max_fps) {
+    if (ui == NULL || fd < 0 || max_fps < 1 || max_fps > TERMINAL_UI_MAX_FPS) return -1;
+
+    memset(ui, 0, sizeof(*ui));
+    ui->fd = fd;
+    ui->frame_interval_ns = 1000000000ull / (uint64_t)max_fps;
+    ui->cursor_row = -1;
+    ui->current_style = -1;
+
+    // Alternate screen, hidden cursor; the grids are sized by the first frame
+    static const char enter[] = "\x1b[?1049h\x1b[?25l";
+    if (append(ui, enter, sizeof(enter) - 1) != 0 || flush_output(ui) != 0) {
+        free(ui->output);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Reports whether the frame interval has passed since the last frame.
+ *
+ * @param ui Pointer to the TerminalUI.
+ * @return Non-zero if a new frame should be drawn.
+ */
+int terminal_ui_frame_due(const TerminalUI* ui) {
+    if (ui == NULL) return 0;
+    return ui->last_frame_ns == 0 || latency_now_ns() - ui->last_frame_ns >= ui->frame_interval_ns;
+}
+
+/**
+ * @brief Starts a frame: follows terminal resizes and clears the off-screen grid.
+ *
+ * After a resize the terminal is cleared and the whole frame is sent.
+ *
+ * @param ui Pointer to the TerminalUI.
+ * @return 0 on success, -1 on error.
+ */
+int terminal_ui_begin_frame(TerminalUI* ui) {
+    if (ui == NULL) return -1;
+
+    int rows = TERMINAL_UI_DEFAULT_ROWS;
+    int cols = TERMINAL_UI_DEFAULT_COLS;
+    struct winsize size;
+    if (ioctl(ui->fd, TIOCGWINSZ, &size) == 0 && size.ws_row > 0 && size.ws_col > 0) {
+        rows = size.ws_row < TERMINAL_UI_MAX_ROWS ? size.ws_row : TERMINAL_UI_MAX_ROWS;
+        cols = size.ws_col < TERMINAL_UI_MAX_COLS ? size.ws_col : TERMINAL_UI_MAX_COLS;
+    }
+
+    size_t cells = (size_t)rows * (size_t)cols;
+    if (rows != ui->rows || cols != ui->cols) {
+        TerminalCell* front = realloc(ui->front, cells * sizeof(TerminalCell));
+        if (front == NULL) return -1;
+        ui->front = front;
+        TerminalCell* back = realloc(ui->back, cells * sizeof(TerminalCell));
+        if (back == NULL) return -1;
+        ui->back = back;
+        ui->rows = rows;
+        ui->cols = cols;
+
+        // Glyph 0 never matches a drawn cell, so the next frame is sent in full
+        memset(ui->front, 0, cells * sizeof(TerminalCell));
+        static const char clear[] = "\x1b[0m\x1b[2J";
+        if (append(ui, clear, sizeof(clear) - 1) != 0) return -1;
+        ui->cursor_row = -1;
+        ui->current_style = TERMINAL_STYLE_NORMAL;
+    }
+
+    for (size_t i = 0; i < cells; i++) {
+        ui->back[i].glyph = ' ';
+        ui->back[i].style = TERMINAL_STYLE_NORMAL;
+    }
+    return 0;
+}
+
+/**
+ * @brief Draws UTF-8 text into the off-screen grid, clipped at the right edge.
+ *
+ * @param ui Pointer to the TerminalUI.
+ * @param row Row (0 = top).
+ * @param col Column (0 = left).
+ * @param style TerminalStyle of the text.
+ * @param text UTF-8 text without control characters.
+ * @return Column after the last character drawn.
+ */
+int terminal_ui_text(TerminalUI* ui, int row, int col, TerminalStyle style, const char* text) {
+    if (ui == NULL || text == NULL || row < 0 || row >= ui->rows || col < 0) return col;
+
+    TerminalCell* line = &ui->back[(size_t)row * (size_t)ui->cols];
+    while (*text != '\0' && col < ui->cols) {
+        uint32_t glyph = decode_utf8(&text);
+        line[col].glyph = glyph < 0x20 ? '?' : glyph;
+        line[col].style = (uint8_t)style;
+        col++;
+    }
+    return col;
+}
+
+/**
+ * @brief Draws formatted text into the off-screen grid.
+ *
+ * @return Column after the last character drawn.
+ */
+static int draw_format(TerminalUI* ui, int row, int col, TerminalStyle style, const char* format, ...) {
+    char text[FORMAT_MAX];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    return terminal_ui_text(ui, row, col, style, text);
+}
+
+/**
+ * @brief Returns the style for a reading relative to a patient's range.
+ */
+static TerminalStyle range_style(double glucose_value, const Config* config) {
+    if (glucose_value < config->hypoglycemia_threshold) return TERMINAL_STYLE_LOW;
+    if (glucose_value > config->hyperglycemia_threshold) return TERMINAL_STYLE_HIGH;
+    return TERMINAL_STYLE_OK;
+}
+
+/**
+ * @brief Draws a glucose history as a one-line sparkline, oldest reading first.
+ *
+ * Each reading becomes one block character whose height follows its value
+ * and whose color shows whether it is below, within or above range.
+ * Missing readings are left blank.
+ *
+ * @param ui Pointer to the TerminalUI.
+ * @param row Row (0 = top).
+ * @param col Column of the oldest reading.
+ * @param history Readings, newest first, as in GeneratedData.
+ * @param count Number of readings.
+ * @param config Pointer to the thresholds used for the colors.
+ * @return Column after the sparkline.
+ */
+int terminal_ui_sparkline(TerminalUI* ui, int row, int col, const GlucoseFixed* history, int count,
+                          const Config* config) {
+    if (ui == NULL || history == NULL || config == NULL || row < 0 || row >= ui->rows || col < 0) return col;
+
+    TerminalCell* line = &ui->back[(size_t)row * (size_t)ui->cols];
+    const int low = SPARKLINE_MIN_MG_DL * GLUCOSE_FIXED_SCALE;
+    const int span = (SPARKLINE_MAX_MG_DL - SPARKLINE_MIN_MG_DL) * GLUCOSE_FIXED_SCALE;
+
+    for (int i = count - 1; i >= 0 && col < ui->cols; i--, col++) {
+        if (history[i] == 0) continue; // No reading yet
+        int level = ((int)history[i] - low) * SPARKLINE_LEVELS / span;
+        if (level < 0) level = 0;
+        if (level >= SPARKLINE_LEVELS) level = SPARKLINE_LEVELS - 1;
+        line[col].glyph = 0x2581 + (uint32_t)level;
+        line[col].style = (uint8_t)range_style(glucose_from_fixed(history[i]), config);
+    }
+    return col;
+}
+
+/**
+ * @brief Returns the trend arrow of a patient's latest reading.
+ */
+static const char* trend_arrow(const GeneratedData* data) {
+    if (!glucose_history_valid(data, 1)) return "·";
+    switch (calculate_glucose_trend(data)) {
+        case TREND_RISING: return "↑";
+        case TREND_FALLING: return "↓";
+        case TREND_STABLE:
+        default: return "→";
+    }
+}
+
+/**
+ * @brief Formats the active alarms as short words.
+ */
+static void format_alarms(unsigned int flags, char* text, size_t size) {
+    snprintf(text, size, "%s%s%s%s",
+             (flags & ALARM_HYPOGLYCEMIA) ? "LOW " : "", (flags & ALARM_HYPERGLYCEMIA) ? "HIGH " : "",
+             (flags & ALARM_RAPID_INCREASE) ? "RISE " : "", (flags & ALARM_RAPID_DECREASE) ? "FALL " : "");
+}
+
+/**
+ * @brief Draws the detail lines of one patient.
+ */
+static void draw_patient_detail(TerminalUI* ui, int row, const PatientState* patient) {
+    const GeneratedData* data = &patient->data;
+    const GlucoseStats* stats = &patient->stats;
+
+    int col = draw_format(ui, row, 1, TERMINAL_STYLE_BOLD, "Patient %u", patient->patient_id);
+    if (data->reading_time == 0) {
+        terminal_ui_text(ui, row, col + 2, TERMINAL_STYLE_DIM, "waiting for the first reading");
+        return;
+    }
+
+    double change = glucose_history_valid(data, 1) ? data->glucose_value - glucose_from_fixed(data->glucose_history[1]) : 0.0;
+    col = draw_format(ui, row, col + 2, range_style(data->glucose_value, &patient->config), "%.1f mg/dL",
+                      data->glucose_value);
+    col = draw_format(ui, row, col + 1, TERMINAL_STYLE_NORMAL, "%s %+.1f", trend_arrow(data), change);
+    if (patient->alarm_flags != ALARM_NONE) {
+        char alarms[32];
+        format_alarms(patient->alarm_flags, alarms, sizeof(alarms));
+        draw_format(ui, row, col + 3, TERMINAL_STYLE_LOW, "ALARM %s", alarms);
+    }
+
+    col = terminal_ui_text(ui, row + 1, 1, TERMINAL_STYLE_DIM, "Last 30 ");
+    col = terminal_ui_sparkline(ui, row + 1, col, data->glucose_history, 30, &patient->config);
+    draw_format(ui, row + 1, col + 2, TERMINAL_STYLE_DIM, "range %d-%d mg/dL, updated %s",
+                patient->config.hypoglycemia_threshold, patient->config.hyperglycemia_threshold, data->timestamp);
+
+    double total = stats->time_in_range + stats->time_below_range + stats->time_above_range;
+    if (total > 0) {
+        draw_format(ui, row + 2, 1, TERMINAL_STYLE_NORMAL,
+                    "TIR %.1f%%  TBR %.1f%%  TAR %.1f%%  mean %.1f mg/dL  SD %.1f  alarms %u",
+                    stats->time_in_range / total * 100.0, stats->time_below_range / total * 100.0,
+                    stats->time_above_range / total * 100.0, stats->avg_glucose,
+                    sqrt(stats->glucose_variability / total), patient->alarm_count);
+    }
+}
+
+/**
+ * @brief Draws the one-line summary of a patient in the fleet table.
+ */
+static void draw_patient_row(TerminalUI* ui, int row, const PatientState* patient) {
+    const GeneratedData* data = &patient->data;
+
+    draw_format(ui, row, 1, TERMINAL_STYLE_NORMAL, "%u", patient->patient_id);
+    if (data->reading_time == 0) {
+        terminal_ui_text(ui, row, 12, TERMINAL_STYLE_DIM, "-");
+        return;
+    }
+
+    draw_format(ui, row, 12, range_style(data->glucose_value, &patient->config), "%6.1f", data->glucose_value);
+    terminal_ui_text(ui, row, 21, TERMINAL_STYLE_NORMAL, trend_arrow(data));
+    terminal_ui_sparkline(ui, row, 25, data->glucose_history, 30, &patient->config);
+
+    const GlucoseStats* stats = &patient->stats;
+    double total = stats->time_in_range + stats->time_below_range + stats->time_above_range;
+    if (total > 0) draw_format(ui, row, 57, TERMINAL_STYLE_NORMAL, "%5.1f%%", stats->time_in_range / total * 100.0);
+    draw_format(ui, row, 65, TERMINAL_STYLE_NORMAL, "%6u", patient->alarm_count);
+
+    if (patient->alarm_flags != ALARM_NONE) {
+        char alarms[32];
+        format_alarms(patient->alarm_flags, alarms, sizeof(alarms));
+        terminal_ui_text(ui, row, 73, TERMINAL_STYLE_LOW, alarms);
+    }
+}
+
+/**
+ * @brief Draws the fleet dashboard into the off-screen grid.
+ *
+ * Shows a title bar, a fleet summary, the detail of the patient with the
+ * most recent alarm (or the first patient) and one line per patient,
+ * patients with an active alarm first, as far as the screen allows.
+ *
+ * @param ui Pointer to the TerminalUI.
+ * @param registry Pointer to the registry to show.
+ * @param status Pointer to the fleet-wide figures.
+ * @return 0 on success, -1 on error.
+ */
+int terminal_ui_draw_fleet(TerminalUI* ui, PatientRegistry* registry, const TerminalStatus* status) {
+    if (ui == NULL || registry == NULL || status == NULL || ui->back == NULL) return -1;
+
+    uint32_t count = patient_registry_count(registry);
+
+    // One pass for the current range of every patient and the alarm to focus on
+    uint32_t low = 0, in_range = 0, high = 0, waiting = 0, alarmed = 0;
+    const PatientState* focus = count > 0 ? patient_registry_at(registry, 0) : NULL;
+    time_t focus_time = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        const PatientState* patient = patient_registry_at(registry, i);
+        if (patient->data.reading_time == 0) {
+            waiting++;
+            continue;
+        }
+        switch (range_style(patient->data.glucose_value, &patient->config)) {
+            case TERMINAL_STYLE_LOW: low++; break;
+            case TERMINAL_STYLE_HIGH: high++; break;
+            default: in_range++; break;
+        }
+        if (patient->alarm_flags != ALARM_NONE) {
+            alarmed++;
+            if (patient->data.reading_time > focus_time) {
+                focus = patient;
+                focus_time = patient->data.reading_time;
+            }
+        }
+    }
+
+    // Title bar across the full width
+    for (int col = 0; col < ui->cols; col++) ui->back[col].style = TERMINAL_STYLE_HEADER;
+    char clock[16];
+    time_t now = time(NULL);
+    struct tm t_storage;
+    strftime(clock, sizeof(clock), "%H:%M:%S", localtime_r(&now, &t_storage));
+    int col = draw_format(ui, 0, 1, TERMINAL_STYLE_HEADER, "Glucose Monitor | %s | %u patients | %.0f readings/s | %llu alarms",
+                          status->mode != NULL ? status->mode : "", count, status->readings_per_second,
+                          (unsigned long long)status->alarms);
+    if (status->connections > 0) draw_format(ui, 0, col, TERMINAL_STYLE_HEADER, " | %u connections", status->connections);
+    terminal_ui_text(ui, 0, ui->cols - 9, TERMINAL_STYLE_HEADER, clock);
+
+    col = terminal_ui_text(ui, 1, 1, TERMINAL_STYLE_NORMAL, "Now: ");
+    col = draw_format(ui, 1, col, TERMINAL_STYLE_LOW, "%u low", low);
+    col = draw_format(ui, 1, col + 2, TERMINAL_STYLE_OK, "%u in range", in_range);
+    col = draw_format(ui, 1, col + 2, TERMINAL_STYLE_HIGH, "%u high", high);
+    if (waiting > 0) col = draw_format(ui, 1, col + 2, TERMINAL_STYLE_DIM, "%u waiting", waiting);
+    col = draw_format(ui, 1, col + 2, alarmed > 0 ? TERMINAL_STYLE_LOW : TERMINAL_STYLE_NORMAL,
+                      "| %u with an active alarm", alarmed);
+    draw_format(ui, 1, col + 2, TERMINAL_STYLE_DIM, "| %llu readings", (unsigned long long)status->readings);
+
+    if (focus != NULL) draw_patient_detail(ui, 3, focus);
+
+    // Table: patients with an active alarm first, then the rest, until the screen is full
+    const int table_row = 7;
+    terminal_ui_text(ui, table_row, 1, TERMINAL_STYLE_BOLD,
+                     "Patient    Glucose  Trend  Last 30 readings                TIR     Alarms  Active");
+    int row = table_row + 1;
+    int last_row = ui->rows - 2; // The bottom line holds the overflow note
+    uint32_t shown = 0;
+    for (int pass = 0; pass < 2 && row <= last_row; pass++) {
+        for (uint32_t i = 0; i < count && row <= last_row; i++) {
+            const PatientState* patient = patient_registry_at(registry, i);
+            if ((patient->alarm_flags != ALARM_NONE) != (pass == 0)) continue;
+            draw_patient_row(ui, row++, patient);
+            shown++;
+        }
+    }
+    if (shown < count) {
+        draw_format(ui, ui->rows - 1, 1, TERMINAL_STYLE_DIM, "... and %u more patients", count - shown);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Appends one cell at the cursor, switching colors if needed.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int emit_cell(TerminalUI* ui, const TerminalCell* cell) {
+    if (cell->style != ui->current_style) {
+        const char* sequence = style_sequences[cell->style];
+        if (append(ui, sequence, strlen(sequence)) != 0) return -1;
+        ui->current_style = cell->style;
+    }
+
+    char glyph[4];
+    return append(ui, glyph, encode_utf8(cell->glyph, glyph));
+}
+
+/**
+ * @brief Sends the cells that differ from the previous frame to the terminal.
+ *
+ * Runs of changed cells are written after one cursor move; short gaps of
+ * unchanged cells are rewritten rather than skipped with another move.
+ * Colors are only switched when consecutive cells differ in style.
+ *
+ * @param ui Pointer to the TerminalUI.
+ * @return Number of bytes written, or -1 on error.
+ */
+long terminal_ui_present(TerminalUI* ui) {
+    if (ui == NULL || ui->back == NULL) return -1;
+
+    for (int row = 0; row < ui->rows; row++) {
+        TerminalCell* back = &ui->back[(size_t)row * (size_t)ui->cols];
+        TerminalCell* front = &ui->front[(size_t)row * (size_t)ui->cols];
+
+        for (int col = 0; col < ui->cols; col++) {
+            if (back[col].glyph == front[col].glyph && back[col].style == front[col].style) continue;
+
+            if (row == ui->cursor_row && col > ui->cursor_col && col - ui->cursor_col <= CURSOR_SKIP_MAX) {
+                // Rewriting a few unchanged cells is shorter than a cursor move
+                for (int gap = ui->cursor_col; gap < col; gap++) {
+                    if (emit_cell(ui, &back[gap]) != 0) return -1;
+                }
+            } else if (row != ui->cursor_row || col != ui->cursor_col) {
+                char move[32];
+                int length = snprintf(move, sizeof(move), "\x1b[%d;%dH", row + 1, col + 1);
+                if (append(ui, move, (size_t)length) != 0) return -1;
+            }
+
+            if (emit_cell(ui, &back[col]) != 0) return -1;
+            front[col] = back[col];
+            ui->stats.cells_changed++;
+
+            // Past the last column the cursor position depends on the terminal's wrap mode
+            ui->cursor_row = col + 1 < ui->cols ? row : -1;
+            ui->cursor_col = col + 1;
+        }
+    }
+
+    long bytes = (long)ui->output_length;
+    if (flush_output(ui) != 0) return -1;
+    ui->stats.frames++;
+    ui->last_frame_ns = latency_now_ns();
+    return bytes;
+}
+
+/**
+ * @brief Restores the normal screen and cursor and frees the grids.
+ *
+ * @param ui Pointer to the TerminalUI to close.
+ * @return 0 on success, -1 on error.
+ */
+int terminal_ui_close(TerminalUI* ui) {
+    if (ui == NULL) return -1;
+
+    static const char leave[] = "\x1b[0m\x1b[?25h\x1b[?1049l";
+    ui->output_length = 0;
+    int status = (append(ui, leave, sizeof(leave) - 1) == 0 && flush_output(ui) == 0) ? 0 : -1;
+
+    free(ui->front);
+    free(ui->back);
+    free(ui->output);
+    ui->front = NULL;
+    ui->back = NULL;
+    ui->output = NULL;
+    return status;
+}
@@ -24,8 +24,8 @@ int print_glucose_data(const GeneratedData* data) {
     
     // Calculate rate of change
     double current_glucose = data->glucose_value;
-    double previous_glucose = data->glucose_history[1];
-    double change = current_glucose - previous_glucose;
+    double previous_glucose = glucose_from_fixed(data->glucose_history[1]);
+    double change = glucose_history_valid(data, 1) ? current_glucose - previous_glucose : 0.0;
     
     // Determine trend arrow and text
     const char* trend_arrow;
@@ -55,7 +55,11 @@ int print_glucose_data(const GeneratedData* data) {
     printf("Glucose History (last 30 entries):\n");
     
     for (int i = 0; i < 30; i++) {
-        printf("%.1f ", data->glucose_history[i]);
+        if (glucose_history_valid(data, i)) {
+            printf("%.1f ", glucose_from_fixed(data->glucose_history[i]));
+        } else {
+            printf("-- "); // Warm-up or sensor dropout
+        }
     }
     
     printf("\n--------------------\n");
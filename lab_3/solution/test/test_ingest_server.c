@@ -0,0 +1,177 @@
+/**
+ * @file test_ingest_server.c
+ * @brief Unit tests for the epoll ingest server.
+ *
+ * Covers frame dispatch, acknowledgements and connections that go away
+ * before reading their acknowledgement.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "../include/ingest_server.h"
+
+#define TEST_SOCKET "/tmp/glucose_test_ingest.sock"
+#define TEST_POLLS 20 // Poll iterations given to the server to drain a connection
+
+// Test counter
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+// Test result macros
+#define TEST_ASSERT(condition, message) \
+    do { \
+        if (condition) { \
+            printf("✓ PASS: %s\n", message); \
+            tests_passed++; \
+        } else { \
+            printf("✗ FAIL: %s\n", message); \
+            tests_failed++; \
+        } \
+    } while(0)
+
+/**
+ * @brief Handler that accepts every record.
+ */
+static uint32_t accept_all(void* context, const IngestRecord* records, size_t count) {
+    (void)context;
+    (void)records;
+    return (uint32_t)count;
+}
+
+/**
+ * @brief Connects a client to the test socket.
+ *
+ * @return Connected descriptor, or -1 on error.
+ */
+static int connect_client(void) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, TEST_SOCKET);
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief Sends one frame of count records, asking for an acknowledgement.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int send_frame(int fd, uint32_t sequence, uint16_t count) {
+    uint8_t frame[sizeof(IngestFrameHeader) + 4 * sizeof(IngestRecord)];
+    if (count > 4) return -1;
+
+    IngestFrameHeader header = {0};
+    header.length = (uint32_t)(sizeof(header) + count * sizeof(IngestRecord));
+    header.version = INGEST_FRAME_VERSION;
+    header.flags = INGEST_FLAG_ACK;
+    header.count = count;
+    header.sequence = sequence;
+    memcpy(frame, &header, sizeof(header));
+    for (uint16_t i = 0; i < count; i++) {
+        IngestRecord record = {i + 1, 120.0f, 1700000000 + i};
+        memcpy(frame + sizeof(header) + i * sizeof(record), &record, sizeof(record));
+    }
+    return write(fd, frame, header.length) == (ssize_t)header.length ? 0 : -1;
+}
+
+/**
+ * @brief Polls the server until it has no open connection left.
+ */
+static void drain(IngestServer* server) {
+    for (int i = 0; i < TEST_POLLS; i++) {
+        ingest_server_poll(server, 10);
+        if (server->open_connections == 0 && server->stats.connections_accepted > 0) return;
+    }
+}
+
+/**
+ * @brief Test that an acknowledged frame is answered with the accepted count.
+ */
+void test_acknowledgement(void) {
+    printf("\n=== Testing Acknowledgements ===\n");
+
+    IngestServer server;
+    TEST_ASSERT(ingest_server_open(&server, TEST_SOCKET, 0, accept_all, NULL) == 0, "Server opens");
+
+    int client = connect_client();
+    TEST_ASSERT(client >= 0 && send_frame(client, 7, 3) == 0, "Client sends an acknowledged frame");
+    for (int i = 0; i < TEST_POLLS && server.stats.frames == 0; i++) ingest_server_poll(&server, 10);
+
+    IngestAck ack = {0, 0};
+    TEST_ASSERT(read(client, &ack, sizeof(ack)) == (ssize_t)sizeof(ack), "Acknowledgement received");
+    TEST_ASSERT(ack.sequence == 7 && ack.accepted == 3, "Acknowledgement echoes sequence and accepted count");
+
+    close(client);
+    drain(&server);
+    TEST_ASSERT(server.stats.ack_errors == 0, "No acknowledgement error");
+    ingest_server_close(&server);
+}
+
+/**
+ * @brief Test that a client closing before reading its ack only loses its connection.
+ *
+ * Without MSG_NOSIGNAL the acknowledgement raises SIGPIPE and this test
+ * never reports.
+ */
+void test_disconnect_before_ack(void) {
+    printf("\n=== Testing Disconnect Before Acknowledgement ===\n");
+
+    IngestServer server;
+    TEST_ASSERT(ingest_server_open(&server, TEST_SOCKET, 0, accept_all, NULL) == 0, "Server opens");
+
+    int client = connect_client();
+    TEST_ASSERT(client >= 0 && send_frame(client, 1, 2) == 0, "Client sends an acknowledged frame");
+    close(client); // Gone before the server answers
+
+    drain(&server);
+    TEST_ASSERT(server.stats.records == 2, "Records of the frame are still processed");
+    TEST_ASSERT(server.stats.ack_errors == 1, "Failed acknowledgement is counted");
+    TEST_ASSERT(server.open_connections == 0, "Connection is closed");
+
+    // The server keeps serving other clients
+    client = connect_client();
+    IngestAck ack = {0, 0};
+    TEST_ASSERT(client >= 0 && send_frame(client, 2, 1) == 0, "Next client sends a frame");
+    for (int i = 0; i < TEST_POLLS && server.stats.frames < 2; i++) ingest_server_poll(&server, 10);
+    TEST_ASSERT(read(client, &ack, sizeof(ack)) == (ssize_t)sizeof(ack) && ack.sequence == 2,
+                "Next client gets its acknowledgement");
+    close(client);
+    drain(&server);
+    ingest_server_close(&server);
+}
+
+/**
+ * @brief Print test summary
+ */
+void print_test_summary(void) {
+    printf("\n");
+    printf("=====================================\n");
+    printf("Ingest server: %d passed, %d failed\n", tests_passed, tests_failed);
+    printf("=====================================\n");
+}
+
+/**
+ * @brief Main test runner
+ */
+int main(void) {
+    test_acknowledgement();
+    test_disconnect_before_ack();
+
+    print_test_summary();
+
+    // Return 0 if all tests passed, 1 otherwise
+    return (tests_failed == 0) ? 0 : 1;
+}
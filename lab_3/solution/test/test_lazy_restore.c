@@ -0,0 +1,164 @@
+/**
+ * @file test_lazy_restore.c
+ * @brief End-to-end tests of a lazy restore, run against ./data_generator.
+ *
+ * A first run simulates a few patients with --state-dir and checkpoints
+ * them at exit. A second run restores them with --lazy-restore, so they
+ * are only paged in by the background prefetch, and publishes telemetry.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "../include/telemetry.h"
+
+#define TEST_BINARY "./data_generator"
+#define TEST_STATE_DIR "/tmp/glucose_test_lazy_restore"
+#define TEST_PATIENTS "3"
+#define TEST_WAIT_MS 15000 // Longest wait for the engine to reach a state
+#define TEST_POLL_MS 100
+
+// Test counter
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+// Test result macros
+#define TEST_ASSERT(condition, message) \
+    do { \
+        if (condition) { \
+            printf("✓ PASS: %s\n", message); \
+            tests_passed++; \
+        } else { \
+            printf("✗ FAIL: %s\n", message); \
+            tests_failed++; \
+        } \
+    } while(0)
+
+/**
+ * @brief Sleeps for a number of milliseconds.
+ */
+static void sleep_ms(long milliseconds) {
+    struct timespec pause = {milliseconds / 1000, (milliseconds % 1000) * 1000000L};
+    nanosleep(&pause, NULL);
+}
+
+/**
+ * @brief Starts the engine with the given arguments, its output discarded.
+ *
+ * @return Process id, or -1 on error.
+ */
+static pid_t start_engine(char* const argv[]) {
+    pid_t pid = fork();
+    if (pid != 0) return pid;
+
+    int null_fd = open("/dev/null", O_WRONLY);
+    if (null_fd >= 0) {
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+    }
+    execv(TEST_BINARY, argv);
+    _exit(127);
+}
+
+/**
+ * @brief Stops the engine as Ctrl+C would and waits for it.
+ *
+ * @return Exit status, or -1 if it did not exit normally.
+ */
+static int stop_engine(pid_t pid) {
+    int status;
+    kill(pid, SIGINT);
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status)) return -1;
+    return WEXITSTATUS(status);
+}
+
+/**
+ * @brief Maps the telemetry header read-only.
+ *
+ * @return Pointer to the header, or NULL while the segment does not exist.
+ */
+static const TelemetryHeader* map_header(void) {
+    int fd = shm_open(TELEMETRY_SHM_NAME, O_RDONLY, 0);
+    if (fd < 0) return NULL;
+    void* base = mmap(NULL, sizeof(TelemetryHeader), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    return base == MAP_FAILED ? NULL : base;
+}
+
+/**
+ * @brief Test that telemetry counts patients a lazy restore pages in after startup.
+ */
+void test_telemetry_patient_count(void) {
+    printf("\n=== Testing Telemetry After a Lazy Restore ===\n");
+
+    char* first_run[] = {TEST_BINARY, "--patients", TEST_PATIENTS, "--state-dir", TEST_STATE_DIR, NULL};
+    char* second_run[] = {TEST_BINARY, "--patients", TEST_PATIENTS, "--state-dir", TEST_STATE_DIR,
+                          "--lazy-restore", "--telemetry", NULL};
+
+    if (system("rm -rf " TEST_STATE_DIR) != 0) {
+        TEST_ASSERT(0, "State directory cleared");
+        return;
+    }
+    pid_t pid = start_engine(first_run);
+    TEST_ASSERT(pid > 0, "First run starts");
+    if (pid <= 0) return;
+    sleep_ms(1000);
+    TEST_ASSERT(stop_engine(pid) == 0, "First run checkpoints and exits");
+
+    shm_unlink(TELEMETRY_SHM_NAME);
+    pid = start_engine(second_run);
+    TEST_ASSERT(pid > 0, "Lazy restore starts");
+    if (pid <= 0) return;
+
+    // Wait until slots are published, then for the count to cover them
+    const TelemetryHeader* header = NULL;
+    uint32_t patient_count = 0;
+    uint64_t publish_count = 0;
+    for (long waited = 0; waited < TEST_WAIT_MS; waited += TEST_POLL_MS) {
+        if (header == NULL) header = map_header();
+        if (header != NULL) {
+            publish_count = __atomic_load_n(&header->publish_count, __ATOMIC_RELAXED);
+            patient_count = __atomic_load_n(&header->patient_count, __ATOMIC_RELAXED);
+            if (publish_count > 0 && patient_count == (uint32_t)atoi(TEST_PATIENTS)) break;
+        }
+        sleep_ms(TEST_POLL_MS);
+    }
+
+    TEST_ASSERT(header != NULL, "Telemetry segment exists");
+    TEST_ASSERT(publish_count > 0, "Restored patients are published");
+    TEST_ASSERT(patient_count == (uint32_t)atoi(TEST_PATIENTS), "Patient count covers the restored patients");
+
+    if (header != NULL) munmap((void*)header, sizeof(TelemetryHeader));
+    TEST_ASSERT(stop_engine(pid) == 0, "Lazy restore exits");
+    system("rm -rf " TEST_STATE_DIR);
+}
+
+/**
+ * @brief Print test summary
+ */
+void print_test_summary(void) {
+    printf("\n");
+    printf("=====================================\n");
+    printf("Lazy restore: %d passed, %d failed\n", tests_passed, tests_failed);
+    printf("=====================================\n");
+}
+
+/**
+ * @brief Main test runner
+ */
+int main(void) {
+    test_telemetry_patient_count();
+
+    print_test_summary();
+
+    // Return 0 if all tests passed, 1 otherwise
+    return (tests_failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,153 @@
+/**
+ * @file test_rollup_cube.c
+ * @brief Unit tests for the patient x day x hour rollups.
+ *
+ * Covers the window of accepted reading times, in particular a cube whose
+ * first reading comes from a bad device clock.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../include/rollup_cube.h"
+#include "../include/config.h"
+
+#define SECONDS_PER_DAY 86400
+
+// Test counter
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+// Test result macros
+#define TEST_ASSERT(condition, message) \
+    do { \
+        if (condition) { \
+            printf("✓ PASS: %s\n", message); \
+            tests_passed++; \
+        } else { \
+            printf("✗ FAIL: %s\n", message); \
+            tests_failed++; \
+        } \
+    } while(0)
+
+/**
+ * @brief Returns the number of readings a patient has in [from, to).
+ */
+static uint32_t readings_between(const RollupCube* cube, uint32_t slot, time_t from, time_t to) {
+    RollupBucket totals;
+    if (rollup_cube_totals(cube, slot, from, to, &totals) != 0) return 0;
+    return totals.count;
+}
+
+/**
+ * @brief Test that readings at the current time are kept.
+ */
+void test_current_readings(void) {
+    printf("\n=== Testing Current Readings ===\n");
+
+    Config config = initialize_config();
+    RollupCube cube;
+    time_t now = time(NULL);
+    rollup_cube_init(&cube, 0);
+
+    TEST_ASSERT(rollup_cube_add(&cube, 0, 1, now - 600, glucose_to_fixed(120.0), &config) == 0, "First reading kept");
+    TEST_ASSERT(rollup_cube_add(&cube, 0, 1, now, glucose_to_fixed(125.0), &config) == 0, "Second reading kept");
+    TEST_ASSERT(readings_between(&cube, 0, now - SECONDS_PER_DAY, now + 1) == 2, "Both readings rolled up");
+    TEST_ASSERT(cube.late_readings == 0 && cube.future_readings == 0, "Nothing dropped");
+
+    rollup_cube_destroy(&cube);
+}
+
+/**
+ * @brief Test that a first reading from a clock in the future is dropped and does not anchor the cube.
+ */
+void test_first_reading_in_future(void) {
+    printf("\n=== Testing First Reading From a Future Clock ===\n");
+
+    Config config = initialize_config();
+    RollupCube cube;
+    time_t now = time(NULL);
+    rollup_cube_init(&cube, 0);
+
+    TEST_ASSERT(rollup_cube_add(&cube, 0, 1, now + 365L * SECONDS_PER_DAY, glucose_to_fixed(120.0), &config) != 0,
+                "Reading a year ahead dropped");
+    TEST_ASSERT(cube.future_readings == 1, "Counted as a future reading");
+    TEST_ASSERT(rollup_cube_add(&cube, 0, 1, now, glucose_to_fixed(125.0), &config) == 0, "Current reading kept");
+    TEST_ASSERT(rollup_cube_add(&cube, 0, 1, now + 300, glucose_to_fixed(130.0), &config) == 0,
+                "Next current reading kept");
+    TEST_ASSERT(cube.late_readings == 0, "No current reading dropped as late");
+    TEST_ASSERT(readings_between(&cube, 0, now - SECONDS_PER_DAY, now + SECONDS_PER_DAY) == 2,
+                "Current readings rolled up");
+
+    rollup_cube_destroy(&cube);
+}
+
+/**
+ * @brief Test that a first reading at time 0 does not shut out current readings.
+ */
+void test_first_reading_at_epoch(void) {
+    printf("\n=== Testing First Reading From a Reset Clock ===\n");
+
+    Config config = initialize_config();
+    RollupCube cube;
+    time_t now = time(NULL);
+    rollup_cube_init(&cube, 0);
+
+    rollup_cube_add(&cube, 0, 1, 0, glucose_to_fixed(120.0), &config);
+    TEST_ASSERT(rollup_cube_add(&cube, 0, 1, now, glucose_to_fixed(125.0), &config) == 0,
+                "Current reading after a time-0 reading kept");
+    TEST_ASSERT(rollup_cube_add(&cube, 1, 2, now, glucose_to_fixed(90.0), &config) == 0,
+                "Other patient's current reading kept");
+    TEST_ASSERT(cube.future_readings == 0 && cube.late_readings == 0, "Nothing dropped");
+    TEST_ASSERT(readings_between(&cube, 0, now - SECONDS_PER_DAY, now + 1) == 1, "Current reading rolled up");
+    TEST_ASSERT(rollup_cube_add(&cube, 0, 1, 0, glucose_to_fixed(120.0), &config) != 0 && cube.late_readings == 1,
+                "Time-0 reading now dropped as late");
+
+    rollup_cube_destroy(&cube);
+}
+
+/**
+ * @brief Test that a reading too far after the newest day is still dropped.
+ */
+void test_reading_ahead_of_newest_day(void) {
+    printf("\n=== Testing Readings Ahead of the Newest Day ===\n");
+
+    Config config = initialize_config();
+    RollupCube cube;
+    time_t now = time(NULL);
+    rollup_cube_init(&cube, 0);
+
+    rollup_cube_add(&cube, 0, 1, now, glucose_to_fixed(120.0), &config);
+    TEST_ASSERT(rollup_cube_add(&cube, 0, 1, now + 30L * SECONDS_PER_DAY, glucose_to_fixed(125.0), &config) != 0,
+                "Reading 30 days ahead dropped");
+    TEST_ASSERT(cube.future_readings == 1, "Counted as a future reading");
+    TEST_ASSERT(rollup_cube_add(&cube, 0, 1, now + 300, glucose_to_fixed(130.0), &config) == 0,
+                "Following current reading kept");
+
+    rollup_cube_destroy(&cube);
+}
+
+/**
+ * @brief Print test summary
+ */
+void print_test_summary(void) {
+    printf("\n");
+    printf("=====================================\n");
+    printf("Rollup cube: %d passed, %d failed\n", tests_passed, tests_failed);
+    printf("=====================================\n");
+}
+
+/**
+ * @brief Main test runner
+ */
+int main(void) {
+    test_current_readings();
+    test_first_reading_in_future();
+    test_first_reading_at_epoch();
+    test_reading_ahead_of_newest_day();
+
+    print_test_summary();
+
+    // Return 0 if all tests passed, 1 otherwise
+    return (tests_failed == 0) ? 0 : 1;
+}